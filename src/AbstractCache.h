@@ -19,8 +19,17 @@
  * @brief Class Kompas::Core::AbstractCache
  */
 
+#include <vector>
+#include <functional>
+#include <chrono>
+
 #include "PluginManager/Plugin.h"
 #include "AbstractRasterModel.h"
+#include "CacheKey.h"
+#include "CacheStatistics.h"
+#include "NegativeCache.h"
+#include "TileData.h"
+#include "TileMetadata.h"
 
 namespace Kompas { namespace Core {
 
@@ -29,6 +38,45 @@ namespace Kompas { namespace Core {
 
 See also AbstractNetworkCache, which can be used as convenient base for network
 caches.
+
+@section AbstractCache_Subclassing Subclassing
+The data are identified with CacheKey, which has fixed size and precomputed
+hash, so it can be used as key in hash tables without any allocations.
+Implementations should reimplement get(const CacheKey&) and
+set(const CacheKey&, const TileData&). The data are passed as TileData, so
+in-memory caches can store and return them without copying. Caches which can
+store only string keys (such as network caches) can reimplement
+get(const std::string&) and set(const std::string&, const std::string&)
+instead, the keys are then serialized with CacheKey::toString().
+
+Caches which can retrieve or save many data at once (e.g. with one network
+round trip) should reimplement also get(const std::vector<CacheKey>&) and
+set(const std::vector<CacheKey>&, const std::vector<TileData>&), which are
+used by rasterTiles() and setRasterTiles().
+
+Caches which remove data to make space for new data should pass the removed
+data to evicted(), so they can be saved elsewhere by the eviction listener.
+
+@section AbstractCache_Missing Missing data
+Data which don't exist anywhere can be remembered with setRasterTileMissing(),
+repeated lookups then need only one call to isRasterTileMissing() instead of
+looking into the cache and downloading the data again. The entries are kept
+in memory in NegativeCache, accessible through missing(), and they expire
+after its time to live. Saving the data with setRasterTile() removes them.
+
+@section AbstractCache_Revalidation Revalidation metadata
+Downloaded tiles can have TileMetadata with download time, expiration time
+and validators, saved with setRasterTileMetadata(). The metadata are saved as
+separate data of @ref RasterTileMetadata kind, so caches need no support for
+them. Tile without metadata (e.g. because they were evicted) is treated as
+never expiring.
+
+@section AbstractCache_Statistics Statistics
+Hits, misses, inserts, evictions and latencies of rasterTile() and
+setRasterTile() can be counted in CacheStatistics set with setStatistics().
+Evictions are counted only for caches which report evicted data. Caches
+which would need to read the evicted data should report only their key and
+size with evicted(const CacheKey&, size_t), if there is no eviction listener.
 */
 class AbstractCache: public Corrade::PluginManager::Plugin {
     PLUGIN_INTERFACE("cz.mosra.Kompas.Core.AbstractCache/0.2")
@@ -58,7 +106,7 @@ class AbstractCache: public Corrade::PluginManager::Plugin {
 
         /** @copydoc PluginManager::Plugin::Plugin */
         inline AbstractCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = ""):
-            Plugin(manager, plugin) {}
+            Plugin(manager, plugin), _statistics(0) {}
 
         /**
          * @brief Features
@@ -138,16 +186,56 @@ class AbstractCache: public Corrade::PluginManager::Plugin {
          */
         virtual void optimize() = 0;
 
+        /**
+         * @brief Schedule incremental purge
+         *
+         * Data saved before this call are not returned anymore, but their
+         * space is reclaimed gradually in maintain(), so the call doesn't
+         * block the cache for long time. Default implementation calls
+         * purge().
+         */
+        inline virtual void schedulePurge() { purge(); }
+
+        /**
+         * @brief Schedule incremental optimization
+         *
+         * The cache is optimized gradually in maintain(). Default
+         * implementation calls optimize().
+         */
+        inline virtual void scheduleOptimize() { optimize(); }
+
+        /**
+         * @brief Do part of cache maintenance
+         * @param budget    Time budget in microseconds
+         * @return Whether more maintenance work is waiting
+         *
+         * Continues work scheduled with schedulePurge() and
+         * scheduleOptimize(). Caches can also do their own housekeeping here,
+         * e.g. remove old data before the space is needed, so saving new data
+         * doesn't have to wait for it. The work is done in small steps and
+         * the function returns after approximately given time, so the cache
+         * is not blocked for long. Can be called periodically from
+         * dedicated thread, see CacheMaintainer. Default implementation
+         * does nothing and returns false.
+         */
+        inline virtual bool maintain(unsigned int budget) { return false; }
+
         /**
          * @brief Get raster tile from cache
          * @param model     Model name
          * @param layer     Layer
          * @param z         Zoom
          * @param coords    Coordinates
-         * @return  Tile data or empty string, if the tile wasn't found.
+         * @return  Tile data or empty data, if the tile wasn't found.
          */
-        std::string rasterTile(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords) {
-            return get(key(model, layer, z, coords));
+        inline TileData rasterTile(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords) {
+            CacheKey key(RasterTile, model, layer, z, coords);
+            if(!_statistics) return get(key);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            TileData data = get(key);
+            _statistics->recordGet(key, &model, &layer, data.size(), elapsed(start));
+            return data;
         }
 
         /**
@@ -158,28 +246,325 @@ class AbstractCache: public Corrade::PluginManager::Plugin {
          * @param coords    Coordinates
          * @param data      Tile data
          */
-        bool setRasterTile(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords, const std::string& data) {
-            return set(key(model, layer, z, coords), data);
+        inline bool setRasterTile(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords, const TileData& data) {
+            CacheKey key(RasterTile, model, layer, z, coords);
+            _missing.remove(key);
+            if(!_statistics) return set(key, data);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bool stored = set(key, data);
+            _statistics->recordSet(key, &model, &layer, data.size(), elapsed(start), stored);
+            return stored;
         }
 
-    protected:
+        /**
+         * @brief Get multiple raster tiles from cache
+         * @param model     Model name
+         * @param layer     Layer
+         * @param z         Zoom
+         * @param coords    Coordinates of the tiles
+         * @return Data for each tile, empty if the tile wasn't found
+         *
+         * Retrieves all tiles with one call to
+         * get(const std::vector<CacheKey>&). Statistics get latency of the
+         * whole call divided among the tiles.
+         */
+        inline std::vector<TileData> rasterTiles(const std::string& model, const std::string& layer, Zoom z, const std::vector<TileCoords>& coords) {
+            std::vector<CacheKey> keys = rasterTileKeys(model, layer, z, coords);
+            if(!_statistics || keys.empty()) return get(keys);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::vector<TileData> data = get(keys);
+            const std::uint64_t nanoseconds = elapsed(start)/keys.size();
+            for(size_t i = 0; i != keys.size(); ++i)
+                _statistics->recordGet(keys[i], &model, &layer, data[i].size(), nanoseconds);
+            return data;
+        }
+
+        /**
+         * @brief Save multiple raster tiles to cache
+         * @param model     Model name
+         * @param layer     Layer
+         * @param z         Zoom
+         * @param coords    Coordinates of the tiles
+         * @param data      Data for each tile
+         * @return For each tile whether it was saved
+         *
+         * Saves all tiles with one call to
+         * set(const std::vector<CacheKey>&, const std::vector<TileData>&).
+         * If count of data doesn't match count of coordinates, nothing is
+         * saved.
+         */
+        inline std::vector<bool> setRasterTiles(const std::string& model, const std::string& layer, Zoom z, const std::vector<TileCoords>& coords, const std::vector<TileData>& data) {
+            if(data.size() != coords.size()) return std::vector<bool>(coords.size());
+
+            std::vector<CacheKey> keys = rasterTileKeys(model, layer, z, coords);
+            for(std::vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+                _missing.remove(*it);
+            if(!_statistics || keys.empty()) return set(keys, data);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::vector<bool> stored = set(keys, data);
+            const std::uint64_t nanoseconds = elapsed(start)/keys.size();
+            for(size_t i = 0; i != keys.size(); ++i)
+                _statistics->recordSet(keys[i], &model, &layer, data[i].size(), nanoseconds, stored[i]);
+            return stored;
+        }
+
+        /**
+         * @brief Raster tile metadata
+         * @param model     Model name
+         * @param layer     Layer
+         * @param z         Zoom
+         * @param coords    Coordinates
+         * @return Metadata or empty metadata, if the tile has none.
+         *
+         * See @ref AbstractCache_Revalidation.
+         */
+        inline TileMetadata rasterTileMetadata(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords) {
+            TileData data = get(CacheKey(RasterTileMetadata, model, layer, z, coords));
+            return data.empty() ? TileMetadata() : TileMetadata::fromString(data.toString());
+        }
+
+        /**
+         * @brief Save raster tile metadata
+         * @param model     Model name
+         * @param layer     Layer
+         * @param z         Zoom
+         * @param coords    Coordinates
+         * @param metadata  Metadata
+         */
+        inline bool setRasterTileMetadata(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords, const TileMetadata& metadata) {
+            return set(CacheKey(RasterTileMetadata, model, layer, z, coords), metadata.toString());
+        }
+
+        /**
+         * @brief Whether raster tile is known to be missing
+         * @param model     Model name
+         * @param layer     Layer
+         * @param z         Zoom
+         * @param coords    Coordinates
+         *
+         * Returns true if the tile was set as missing with
+         * setRasterTileMissing() and its time to live didn't expire yet.
+         */
+        inline bool isRasterTileMissing(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords) const {
+            return _missing.contains(CacheKey(RasterTile, model, layer, z, coords));
+        }
+
+        /**
+         * @brief Remember missing raster tile
+         * @param model         Model name
+         * @param layer         Layer
+         * @param z             Zoom
+         * @param coords        Coordinates
+         * @param timeToLive    Time to live in seconds, if zero, default time
+         *      to live of missing() is used
+         */
+        inline void setRasterTileMissing(const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords, unsigned int timeToLive = 0) {
+            _missing.insert(CacheKey(RasterTile, model, layer, z, coords), timeToLive);
+        }
+
+        /**
+         * @brief Missing data
+         *
+         * Can be used to configure time to live of missing data or to forget
+         * them. Not affected by purge().
+         */
+        inline NegativeCache* missing() { return &_missing; }
+
+        /** @brief Statistics */
+        inline CacheStatistics* statistics() const { return _statistics; }
+
+        /**
+         * @brief Set statistics
+         *
+         * The statistics are not owned by the cache and must exist as long
+         * as they are set. Set to null pointer to stop counting. Should be
+         * set before the cache is accessed from multiple threads.
+         * @see @ref AbstractCache_Statistics
+         */
+        inline void setStatistics(CacheStatistics* statistics) { _statistics = statistics; }
+
+        /**
+         * @brief Raster tile data kind
+         *
+         * @see CacheKey::kind()
+         */
         static const char RasterTile = 'T';
 
+        /**
+         * @brief Raster tile metadata kind
+         *
+         * @see @ref AbstractCache_Revalidation
+         */
+        static const char RasterTileMetadata = 'M';
+
         /**
          * @brief Get data from cache
          * @param key       Key
+         *
+         * Default implementation calls get(const std::string&) with
+         * serialized key.
          */
-        virtual std::string get(const std::string& key) = 0;
+        inline virtual TileData get(const CacheKey& key) { return get(key.toString()); }
 
         /**
          * @brief Save data to cache
          * @param key       Key
          * @param data      Data
+         *
+         * Default implementation calls set(const std::string&, const std::string&)
+         * with serialized key and copy of the data.
+         */
+        inline virtual bool set(const CacheKey& key, const TileData& data) { return set(key.toString(), data.toString()); }
+
+        /**
+         * @brief Get multiple data from cache
+         * @param keys      Keys
+         * @return Data for each key, empty if the data weren't found
+         *
+         * Default implementation calls get(const CacheKey&) for each key.
+         */
+        inline virtual std::vector<TileData> get(const std::vector<CacheKey>& keys) {
+            std::vector<TileData> data(keys.size());
+            for(size_t i = 0; i != keys.size(); ++i)
+                data[i] = get(keys[i]);
+            return data;
+        }
+
+        /**
+         * @brief Save multiple data to cache
+         * @param keys      Keys
+         * @param data      Data for each key
+         * @return For each key whether the data were saved
+         *
+         * Default implementation calls set(const CacheKey&, const TileData&)
+         * for each key. If count of data doesn't match count of keys, nothing
+         * is saved. Reimplementations should do the same.
+         */
+        inline virtual std::vector<bool> set(const std::vector<CacheKey>& keys, const std::vector<TileData>& data) {
+            std::vector<bool> stored(keys.size());
+            if(data.size() != keys.size()) return stored;
+            for(size_t i = 0; i != keys.size(); ++i)
+                stored[i] = set(keys[i], data[i]);
+            return stored;
+        }
+
+        /**
+         * @brief Check presence of multiple data
+         * @param keys      Keys
+         * @return For each key whether the data are in the cache
+         *
+         * Default implementation calls get(const CacheKey&) for each key.
+         * Caches which can check presence of the data without reading them
+         * or which can check many keys at once should reimplement it.
+         */
+        inline virtual std::vector<bool> contains(const std::vector<CacheKey>& keys) {
+            std::vector<bool> found(keys.size());
+            for(size_t i = 0; i != keys.size(); ++i)
+                found[i] = !get(keys[i]).empty();
+            return found;
+        }
+
+        /**
+         * @brief Eviction listener
+         *
+         * @see setEvictionListener()
+         */
+        typedef std::function<void(const CacheKey&, const TileData&)> EvictionListener;
+
+        /**
+         * @brief Set eviction listener
+         *
+         * The listener is called with data which were removed from the cache
+         * to make space for new data or which were dropped on finalization.
+         * Data removed by purge() or replaced with newer version are not
+         * reported. The listener can be called from any thread which accesses
+         * the cache. Caches which don't report evicted data never call it.
+         * Should be set before the cache is accessed from multiple threads.
+         */
+        inline void setEvictionListener(const EvictionListener& listener) { _evictionListener = listener; }
+
+    protected:
+        /**
+         * @brief Whether eviction listener is set
+         *
+         * Can be used to avoid gathering evicted data if nobody needs them.
+         * @see hasStatistics()
+         */
+        inline bool hasEvictionListener() const { return bool(_evictionListener); }
+
+        /**
+         * @brief Whether statistics are set
+         *
+         * If statistics are set, but eviction listener isn't, only keys and
+         * sizes of evicted data are needed.
+         */
+        inline bool hasStatistics() const { return _statistics != 0; }
+
+        /**
+         * @brief Report evicted data
+         * @param key       Key
+         * @param data      Data
+         *
+         * Calls eviction listener and counts the eviction in statistics, if
+         * they are set. Should be called without holding any internal locks,
+         * as the listener can access other caches.
          */
-        virtual bool set(const std::string& key, const std::string& data) = 0;
+        inline void evicted(const CacheKey& key, const TileData& data) {
+            if(_statistics) _statistics->recordEviction(key, data.size());
+            if(_evictionListener) _evictionListener(key, data);
+        }
+
+        /**
+         * @brief Report eviction without data
+         * @param key       Key
+         * @param size      Data size
+         *
+         * Only counts the eviction in statistics, if set. Can be used instead
+         * of evicted(const CacheKey&, const TileData&) if there is no
+         * eviction listener and the data would have to be read.
+         */
+        inline void evicted(const CacheKey& key, size_t size) {
+            if(_statistics) _statistics->recordEviction(key, size);
+        }
+
+        /**
+         * @brief Get data from cache
+         * @param key       Serialized key
+         *
+         * Default implementation returns empty string.
+         */
+        inline virtual std::string get(const std::string& key) { return ""; }
+
+        /**
+         * @brief Save data to cache
+         * @param key       Serialized key
+         * @param data      Data
+         *
+         * Default implementation returns false.
+         */
+        inline virtual bool set(const std::string& key, const std::string& data) { return false; }
 
     private:
-        std::string key(const std::string &model, const std::string &layer, Core::Zoom z, Core::TileCoords coords) const;
+        EvictionListener _evictionListener;
+        NegativeCache _missing;
+        CacheStatistics* _statistics;
+
+        static inline std::vector<CacheKey> rasterTileKeys(const std::string& model, const std::string& layer, Zoom z, const std::vector<TileCoords>& coords) {
+            /* Compute the name hashes only once */
+            const std::uint32_t modelId = CacheKey::id(model), layerId = CacheKey::id(layer);
+            std::vector<CacheKey> keys;
+            keys.reserve(coords.size());
+            for(std::vector<TileCoords>::const_iterator it = coords.begin(); it != coords.end(); ++it)
+                keys.push_back(CacheKey(RasterTile, modelId, layerId, z, *it));
+            return keys;
+        }
+
+        static inline std::uint64_t elapsed(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+        }
 };
 
 }}
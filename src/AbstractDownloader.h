@@ -0,0 +1,77 @@
+#ifndef Kompas_Core_AbstractDownloader_h
+#define Kompas_Core_AbstractDownloader_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::AbstractDownloader
+ */
+
+#include <string>
+
+#include "TileMetadata.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Interface for downloading tile data
+
+Used by TileFetcher for downloading tiles which weren't found in any package
+or cache. Implementations must be safe to call from multiple threads at once.
+See HttpDownloader for simple implementation for plain HTTP.
+*/
+class CORE_EXPORT AbstractDownloader {
+    public:
+        /** @brief Destructor */
+        inline virtual ~AbstractDownloader() {}
+
+        /**
+         * @brief Download data
+         * @param url       URL
+         * @param data      Where to save downloaded data
+         * @return HTTP status code of the response (e.g. 200 on success or
+         *      404 if the data don't exist) or 0, if the connection failed.
+         *      The data are filled only on success.
+         */
+        virtual int download(const std::string& url, std::string* data) = 0;
+
+        /**
+         * @brief Download data with revalidation metadata
+         * @param url       URL
+         * @param data      Where to save downloaded data
+         * @param metadata  Metadata of previously downloaded data or empty
+         *      metadata, filled with metadata of the response
+         * @return HTTP status code of the response, see
+         *      download(const std::string&, std::string*). If the metadata
+         *      have validators and the data didn't change, returns 304 and
+         *      the data are not touched.
+         *
+         * Default implementation ignores the validators, calls
+         * download(const std::string&, std::string*) and on success sets
+         * only download time.
+         */
+        inline virtual int download(const std::string& url, std::string* data, TileMetadata* metadata) {
+            int status = download(url, data);
+            if(status == 200) {
+                *metadata = TileMetadata();
+                metadata->fetched = TileMetadata::now();
+            }
+            return status;
+        }
+};
+
+}}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef Kompas_Core_AbstractEvictionPolicy_h
+#define Kompas_Core_AbstractEvictionPolicy_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::AbstractEvictionPolicy
+ */
+
+#include <vector>
+
+#include "CacheKey.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Base for cache eviction policies
+
+Decides which entries should be removed from cache when it is full. The
+policy doesn't store any data, it only tracks keys and sizes of entries in the
+cache, the cache informs it about every lookup and insertion and removes
+entries which the policy returns as evicted.
+
+The policies are not thread-safe, the cache must guard each policy with the
+same lock as the data it describes.
+@see LruEvictionPolicy, ArcEvictionPolicy, TinyLfuEvictionPolicy
+*/
+class AbstractEvictionPolicy {
+    public:
+        /** @brief Destructor */
+        inline virtual ~AbstractEvictionPolicy() {}
+
+        /** @brief Capacity */
+        virtual size_t capacity() const = 0;
+
+        /**
+         * @brief Set capacity
+         * @param capacity  Sum of entry sizes which can be in the cache
+         * @param evicted   Where to put keys of entries which must be
+         *      removed from the cache to fit into new capacity
+         */
+        virtual void setCapacity(size_t capacity, std::vector<CacheKey>* evicted) = 0;
+
+        /** @brief Sum of sizes of all entries in the cache */
+        virtual size_t usedSize() const = 0;
+
+        /**
+         * @brief Keys of all entries in the cache
+         *
+         * Ordered from the entry which would be evicted first if only new
+         * entries were inserted from now on, so inserting the keys in this
+         * order into empty policy restores approximately the same state.
+         */
+        virtual std::vector<CacheKey> keys() const = 0;
+
+        /**
+         * @brief Entry was found in the cache
+         * @param key       Key
+         */
+        virtual void hit(const CacheKey& key) = 0;
+
+        /**
+         * @brief Entry was not found in the cache
+         * @param key       Key
+         *
+         * Default implementation does nothing.
+         */
+        inline virtual void miss(const CacheKey& key) {}
+
+        /**
+         * @brief Entry was inserted into the cache
+         * @param key       Key
+         * @param size      Entry size
+         * @param evicted   Where to put keys of entries which must be removed
+         *      from the cache to make space for the new entry. Can contain
+         *      also the new entry, if the policy rejects it.
+         *
+         * If the entry is already in the cache, its size is updated and it is
+         * treated as recently used.
+         */
+        virtual void insert(const CacheKey& key, size_t size, std::vector<CacheKey>* evicted) = 0;
+
+        /**
+         * @brief Entry was removed from the cache
+         * @param key       Key
+         *
+         * Called for entries removed by the cache itself, not for entries
+         * returned as evicted.
+         */
+        virtual void remove(const CacheKey& key) = 0;
+
+        /** @brief All entries were removed from the cache */
+        virtual void clear() = 0;
+};
+
+}}
+
+#endif
@@ -29,16 +29,18 @@ namespace Kompas { namespace Core {
 As network cache shouldn't be maintained by its users for security reasons,
 functions for getting/setting cache size, purging and optimizing the cache have
 their default dummy implementations.
+@see Plugins::MemcachedCache
 */
 class AbstractNetworkCache: public AbstractCache {
     public:
         /** @copydoc AbstractCache::AbstractCache */
-        inline AbstractNetworkCache(PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = ""):
+        inline AbstractNetworkCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = ""):
             AbstractCache(manager, plugin) {}
 
-        int features() { return MultiUser|Network; }
-        inline size_t cacheSize() { return 0; }
+        inline int features() const { return MultiUser|Network; }
+        inline size_t cacheSize() const { return 0; }
         inline void setCacheSize(size_t size) {}
+        inline size_t usedSize() const { return 0; }
         inline void purge() {}
         inline void optimize() {}
 };
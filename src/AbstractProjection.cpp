@@ -0,0 +1,46 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+    Copyright © 2010 Jan Dupal <dupal.j@seznam.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+#include "AbstractProjection.h"
+
+namespace Kompas { namespace Core {
+
+void AbstractProjection::fromLatLon(const double* latitude, const double* longitude, double* x, double* y, size_t count) const {
+    for(size_t i = 0; i != count; ++i) {
+        const Coords<double> c = fromLatLon(LatLonCoords(latitude[i], longitude[i]));
+        x[i] = c.x;
+        y[i] = c.y;
+    }
+}
+
+void AbstractProjection::toLatLon(const double* x, const double* y, double* latitude, double* longitude, size_t count) const {
+    for(size_t i = 0; i != count; ++i) {
+        const LatLonCoords c = toLatLon(Coords<double>(x[i], y[i]));
+        latitude[i] = c.latitude();
+        longitude[i] = c.longitude();
+    }
+}
+
+void AbstractProjection::fromLatLon(const LatLonCoords* coords, Coords<double>* out, size_t count) const {
+    for(size_t i = 0; i != count; ++i)
+        out[i] = fromLatLon(coords[i]);
+}
+
+void AbstractProjection::toLatLon(const Coords<double>* coords, LatLonCoords* out, size_t count) const {
+    for(size_t i = 0; i != count; ++i)
+        out[i] = toLatLon(coords[i]);
+}
+
+}}
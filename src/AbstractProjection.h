@@ -28,9 +28,13 @@ namespace Kompas { namespace Core {
 /**
  * @brief Abstract class for different map projections
  *
- * Provides converting to and from lat/lon coordinates.
+ * Provides converting to and from lat/lon coordinates. Besides single points
+ * there are variants for whole arrays of coordinates, e.g. for GPS tracks,
+ * either as separate arrays of each coordinate or as arrays of coordinate
+ * classes. Their default implementation converts the points one by one,
+ * projections should reimplement them with faster code.
  */
-class AbstractProjection: public Corrade::PluginManager::Plugin {
+class CORE_EXPORT AbstractProjection: public Corrade::PluginManager::Plugin {
     PLUGIN_INTERFACE("cz.mosra.Kompas.Core.AbstractProjection/0.2")
 
     public:
@@ -52,6 +56,56 @@ class AbstractProjection: public Corrade::PluginManager::Plugin {
          */
         virtual LatLonCoords toLatLon(const Coords<double>& coords) const = 0;
 
+        /**
+         * @brief Get raster map coordinates from array of lat/lon coordinates
+         * @param latitude  Latitudes
+         * @param longitude Longitudes
+         * @param x         Where to save X raster map coordinates
+         * @param y         Where to save Y raster map coordinates
+         * @param count     Count of points
+         *
+         * Coordinates out of range are converted as zero, the same as
+         * invalid LatLonCoords. Default implementation calls
+         * fromLatLon(const LatLonCoords&) const for each point.
+         */
+        virtual void fromLatLon(const double* latitude, const double* longitude, double* x, double* y, size_t count) const;
+
+        /**
+         * @brief Get lat/lon coordinates from array of raster map coordinates
+         * @param x         X raster map coordinates
+         * @param y         Y raster map coordinates
+         * @param latitude  Where to save latitudes
+         * @param longitude Where to save longitudes
+         * @param count     Count of points
+         *
+         * Coordinates which would be out of range are saved as zero, the same
+         * as invalid LatLonCoords. Default implementation calls
+         * toLatLon(const Coords<double>&) const for each point.
+         */
+        virtual void toLatLon(const double* x, const double* y, double* latitude, double* longitude, size_t count) const;
+
+        /**
+         * @brief Get raster map coordinates from array of lat/lon coordinates
+         * @param coords    Lat/lon coordinates
+         * @param out       Where to save raster map coordinates
+         * @param count     Count of points
+         *
+         * Default implementation calls fromLatLon(const LatLonCoords&) const
+         * for each point.
+         */
+        virtual void fromLatLon(const LatLonCoords* coords, Coords<double>* out, size_t count) const;
+
+        /**
+         * @brief Get lat/lon coordinates from array of raster map coordinates
+         * @param coords    Raster map coordinates
+         * @param out       Where to save lat/lon coordinates
+         * @param count     Count of points
+         *
+         * Default implementation calls toLatLon(const Coords<double>&) const
+         * for each point.
+         */
+        virtual void toLatLon(const Coords<double>* coords, LatLonCoords* out, size_t count) const;
+
         /**
          * @brief List of map seams
          *
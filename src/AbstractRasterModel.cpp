@@ -35,16 +35,71 @@ bool AbstractRasterModel::setOnline(bool enabled) {
     return _online;
 }
 
-string AbstractRasterModel::tileFromCache(AbstractCache* cache, const string& layer, Zoom z, const TileCoords& coords) {
+string AbstractRasterModel::tileHost(const string& layer, Zoom z, const TileCoords& coords) const {
+    const string url = tileUrl(layer, z, coords);
+    size_t begin = url.find("://");
+    if(begin == string::npos) return "";
+    begin += 3;
+
+    return url.substr(begin, url.find('/', begin)-begin);
+}
+
+vector<TileData> AbstractRasterModel::tilesFromPackage(const string& layer, Zoom z, const TileArea& area) const {
+    vector<TileData> tiles;
+    tiles.reserve(area.w*area.h);
+
+    for(unsigned int y = area.y; y != area.y+area.h; ++y)
+        for(unsigned int x = area.x; x != area.x+area.w; ++x)
+            tiles.push_back(tileFromPackage(layer, z, TileCoords(x, y)));
+
+    return tiles;
+}
+
+TileData AbstractRasterModel::tileFromCache(AbstractCache* cache, const string& layer, Zoom z, const TileCoords& coords) const {
     if(!cache)
         return "";
     return cache->rasterTile(plugin(), layer, z, coords);
 }
 
-bool AbstractRasterModel::tileToCache(AbstractCache* cache, const std::string& layer, Zoom z, const Kompas::Core::TileCoords& coords, const std::string& data) {
+vector<TileData> AbstractRasterModel::tilesFromCache(AbstractCache* cache, const string& layer, Zoom z, const vector<TileCoords>& coords) const {
+    if(!cache)
+        return vector<TileData>(coords.size());
+    return cache->rasterTiles(plugin(), layer, z, coords);
+}
+
+TileMetadata AbstractRasterModel::tileMetadataFromCache(AbstractCache* cache, const string& layer, Zoom z, const TileCoords& coords) const {
+    if(!cache)
+        return TileMetadata();
+    return cache->rasterTileMetadata(plugin(), layer, z, coords);
+}
+
+bool AbstractRasterModel::isTileMissing(const AbstractCache* cache, const string& layer, Zoom z, const TileCoords& coords) const {
+    if(!cache)
+        return false;
+    return cache->isRasterTileMissing(plugin(), layer, z, coords);
+}
+
+bool AbstractRasterModel::tileToCache(AbstractCache* cache, const std::string& layer, Zoom z, const Kompas::Core::TileCoords& coords, const TileData& data) const {
     if(!cache)
         return false;
     return cache->setRasterTile(plugin(), layer, z, coords, data);
 }
 
+vector<bool> AbstractRasterModel::tilesToCache(AbstractCache* cache, const string& layer, Zoom z, const vector<TileCoords>& coords, const vector<TileData>& data) const {
+    if(!cache)
+        return vector<bool>(coords.size());
+    return cache->setRasterTiles(plugin(), layer, z, coords, data);
+}
+
+bool AbstractRasterModel::tileMetadataToCache(AbstractCache* cache, const string& layer, Zoom z, const TileCoords& coords, const TileMetadata& metadata) const {
+    if(!cache)
+        return false;
+    return cache->setRasterTileMetadata(plugin(), layer, z, coords, metadata);
+}
+
+void AbstractRasterModel::setTileMissing(AbstractCache* cache, const string& layer, Zoom z, const TileCoords& coords, unsigned int timeToLive) const {
+    if(cache)
+        cache->setRasterTileMissing(plugin(), layer, z, coords, timeToLive);
+}
+
 }}
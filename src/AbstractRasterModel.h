@@ -27,6 +27,8 @@
 #include "Area.h"
 #include "LatLonCoords.h"
 #include "TranslatablePlugin.h"
+#include "TileData.h"
+#include "TileMetadata.h"
 
 namespace Kompas { namespace Core {
 
@@ -95,6 +97,8 @@ retrieved with packageCount() and packageAttribute().
 @see MultiplePackages
 
 Tile data can be retrieved from loaded packages with function tileFromPackage().
+If you need all tiles in some area (e.g. for rendering whole screen), use
+tilesFromPackage(), which is faster than getting the tiles one by one.
 
 <em>Getting the tiles from cache:</em>
 
@@ -113,6 +117,21 @@ If the raster model supports LoadableFromUrl feature, function tileUrl()
 returns URL of tile data, which the client can then download. The downloaded
 data should be then saved to cache using tileToCache().
 
+TileFetcher class does all the above on background threads, so the client
+doesn't have to block while waiting for the data.
+
+@subsection AbstractRasterModel_Usage_Threads Thread safety
+Functions for reading tile data (tileFromPackage(), tileFromCache(), tileUrl())
+and all const functions returning model and map parameters (such as
+zoomLevels(), area(), layers(), packageAttribute()) can be called from multiple
+threads at once on one model instance, so there is no need to have one model
+with separately opened packages for every thread. Thread safety of
+tileFromCache() depends also on the cache, see AbstractCache documentation.
+
+Functions changing the model state, i.e. addPackage(), setOnline() and all
+functions for creating packages, must not be called while any other thread is
+accessing the model.
+
 @subsection AbstractRasterModel_Usage_Write Creating map packages
 If the model supports @ref WriteableFormat feature, the data can be not only
 read, but also saved to new packages. Common process is to have one source model
@@ -124,7 +143,9 @@ feature is set on destination model.
 Package creation can be divided into three steps:
 
 -# <em>Initializing the package</em> with initializePackage() and
-optionally calling setPackageAttribute() to set any package attributes.
+optionally calling setPackageAttribute() to set any package attributes. If the
+model supports @ref ResumableFormat, interrupted package creation can be
+continued with resumePackage() instead.
 @see MultipleFileFormat
 
 -# <em>Filling the package</em> - if the package initialization succeeded,
@@ -161,7 +182,7 @@ int packageCount() const;
 // Function for getting tile from package. The function should check if given
 // layer and zoom exists in the package and if the coordinates are in area
 // for given zoom.
-std::string tileFromPackage(const std::string& layer, Zoom z, const TileCoords& coords);
+TileData tileFromPackage(const std::string& layer, Zoom z, const TileCoords& coords) const;
 @endcode
 Support for overlays can be added just with reimplementing this function:
 @code
@@ -272,6 +293,12 @@ MyOnlineRasterModel: public AbstractRasterModel {
 There are also two functions which can be reimplemented to provide additional
 information about the map: copyright() and packageAttribute().
 
+Reimplementations of tileFromPackage() and other const functions must be
+<strong>safe to call from multiple threads</strong>, see
+@ref AbstractRasterModel_Usage_Threads. If the package data are opened or
+loaded lazily, guard only the opening with a lock and keep the actual reading
+lock-free, as is done in Plugins::KompasRasterModel.
+
 @subsection AbstractRasterModel_Subclassing_Write Implementing write support
 Write support can be implemented via enabling @ref WriteableFormat feature and
 optionally another features like @ref MultipleFileFormat, @ref SequentialFormat,
@@ -363,6 +390,12 @@ class CORE_EXPORT AbstractRasterModel: public TranslatablePlugin {
              */
             SequentialFormat        = 0x20,
 
+            /**
+             * Creation of new package can be resumed after interruption.
+             * @see resumePackage(), packagedTileCount()
+             */
+            ResumableFormat         = 0x800,
+
             /**
              * One package is composed from multiple files. Used as hint when
              * saving new package, destination filename should be in clean
@@ -606,31 +639,109 @@ class CORE_EXPORT AbstractRasterModel: public TranslatablePlugin {
          */
         virtual inline std::string tileUrl(const std::string& layer, Zoom z, const TileCoords& coords) const { return ""; }
 
+        /**
+         * @brief Get host of tile URL
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @return Host of tile URL with port, if specified. Default
+         *      implementation returns host part of tileUrl(), or empty
+         *      string if the URL is empty.
+         *
+         * The host must be the same every time for the same tile, so the
+         * downloaders can limit and reuse connections for each host.
+         * @see DownloadScheduler
+         */
+        virtual std::string tileHost(const std::string& layer, Zoom z, const TileCoords& coords) const;
+
         /**
          * @brief Get tile data from cache
          * @param cache     Initialized cache instance
          * @param layer     Map layer or overlay
          * @param z         Zoom level
          * @param coords    Coordinates
-         * @return Tile data (image) or empty string, if tile was not found in
+         * @return Tile data (image) or empty data, if tile was not found in
          *      the cache.
          * @see tileToCache()
          */
-        std::string tileFromCache(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords);
+        TileData tileFromCache(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords) const;
+
+        /**
+         * @brief Get multiple tiles from cache
+         * @param cache     Initialized cache instance
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates of the tiles
+         * @return Data for each tile, empty if the tile was not found in the
+         *      cache.
+         *
+         * Faster than calling tileFromCache() for each tile, if the cache can
+         * retrieve more data at once, see AbstractCache::rasterTiles().
+         * @see tilesToCache()
+         */
+        std::vector<TileData> tilesFromCache(AbstractCache* cache, const std::string& layer, Zoom z, const std::vector<TileCoords>& coords) const;
+
+        /**
+         * @brief Get tile metadata from cache
+         * @param cache     Initialized cache instance
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @return Metadata of downloaded tile or empty metadata, if the tile
+         *      has none. The metadata can be passed to
+         *      AbstractDownloader::download() to download the tile again only
+         *      if it changed.
+         * @see tileMetadataToCache()
+         */
+        TileMetadata tileMetadataFromCache(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords) const;
+
+        /**
+         * @brief Whether tile is known to be missing
+         * @param cache     Cache instance
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @return True if the tile was set as missing with setTileMissing()
+         *      and its time to live didn't expire yet.
+         *
+         * Much faster than tileFromCache(), as it doesn't access the cache
+         * data. See also @ref AbstractCache_Missing.
+         */
+        bool isTileMissing(const AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords) const;
 
         /**
          * @brief Get tile data from package
          * @param layer     Map layer or overlay
          * @param z         Zoom level
          * @param coords    Coordinates
-         * @return Tile data (image) or empty string, if tile was not found in
+         * @return Tile data (image) or empty data, if tile was not found in
          *      any loaded package.
          *
          * Tries to get given tile from all packages in ascending order (first
-         * from first package, if not, from second package and so on).
+         * from first package, if not, from second package and so on). Can be
+         * called from multiple threads at once. The returned data can point
+         * directly into the package file, so they don't need to be copied.
          * @see addPackage(), AbstractRasterModel::MultiplePackages
          */
-        virtual std::string tileFromPackage(const std::string& layer, Zoom z, const TileCoords& coords) = 0;
+        virtual TileData tileFromPackage(const std::string& layer, Zoom z, const TileCoords& coords) const = 0;
+
+        /**
+         * @brief Get tile data for whole area from package
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param area      Tile area
+         * @return Tile data for all tiles in the area in row-major order, i.e.
+         *      data of tile at coordinates @c x, @c y are at index
+         *      <tt>(y - area.y)*area.w + x - area.x</tt>. Tiles which were
+         *      not found in any package are empty.
+         *
+         * Default implementation calls tileFromPackage() for every tile in
+         * the area. Reimplementations should search for the package, layer
+         * and archive only once for the whole area and read the tiles in
+         * order in which they are stored. Can be called from multiple threads
+         * at once.
+         */
+        virtual std::vector<TileData> tilesFromPackage(const std::string& layer, Zoom z, const TileArea& area) const;
 
         /*@}*/
 
@@ -652,6 +763,32 @@ class CORE_EXPORT AbstractRasterModel: public TranslatablePlugin {
          */
         inline virtual bool initializePackage(const std::string& filename, const TileSize& tileSize, const std::vector<Zoom>& zoomLevels, const TileArea& area, const std::vector<std::string>& layers, const std::vector<std::string>& overlays) { return false; }
 
+        /**
+         * @brief Resume creation of package
+         *
+         * Same as initializePackage(), but keeps tiles which were already
+         * saved to the package before the creation was interrupted. The
+         * parameters must be the same as for the interrupted package. Saving
+         * then continues after the last kept tile, see packagedTileCount().
+         * If there is nothing to resume, creates new package. Default
+         * implementation returns false.
+         * @see AbstractRasterModel::ResumableFormat
+         */
+        inline virtual bool resumePackage(const std::string& filename, const TileSize& tileSize, const std::vector<Zoom>& zoomLevels, const TileArea& area, const std::vector<std::string>& layers, const std::vector<std::string>& overlays) { return false; }
+
+        /**
+         * @brief Count of tiles saved to package
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @return Count of tiles of given layer and zoom level which are
+         *      saved in the package, in row-major order. Default
+         *      implementation returns 0.
+         *
+         * After resumePackage() the tiles are saved again starting from the
+         * one after them.
+         */
+        inline virtual unsigned int packagedTileCount(const std::string& layer, Zoom z) { return 0; }
+
         /**
          * @brief Set package attribute
          * @param type      Attribute type
@@ -674,7 +811,49 @@ class CORE_EXPORT AbstractRasterModel: public TranslatablePlugin {
          *      setCache() and saving succeeded).
          * @see tileFromCache()
          */
-        bool tileToCache(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords, const std::string& data);
+        bool tileToCache(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords, const TileData& data) const;
+
+        /**
+         * @brief Save multiple tiles to cache
+         * @param cache     Initialized cache instance
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates of the tiles
+         * @param data      Data for each tile
+         * @return For each tile whether it was saved to cache.
+         *
+         * See also AbstractCache::setRasterTiles().
+         * @see tilesFromCache()
+         */
+        std::vector<bool> tilesToCache(AbstractCache* cache, const std::string& layer, Zoom z, const std::vector<TileCoords>& coords, const std::vector<TileData>& data) const;
+
+        /**
+         * @brief Save tile metadata to cache
+         * @param cache     Initialized cache instance
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @param metadata  Metadata filled by AbstractDownloader::download()
+         * @return True if the metadata were saved.
+         * @see tileMetadataFromCache()
+         */
+        bool tileMetadataToCache(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords, const TileMetadata& metadata) const;
+
+        /**
+         * @brief Remember that tile doesn't exist
+         * @param cache         Cache instance
+         * @param layer         Map layer or overlay
+         * @param z             Zoom level
+         * @param coords        Coordinates
+         * @param timeToLive    Time to live in seconds, if zero, default time
+         *      to live of the cache is used
+         *
+         * Should be called when the tile wasn't found in any package and
+         * the server reported that it doesn't exist. Saving the tile with
+         * tileToCache() removes the mark.
+         * @see isTileMissing()
+         */
+        void setTileMissing(AbstractCache* cache, const std::string& layer, Zoom z, const TileCoords& coords, unsigned int timeToLive = 0) const;
 
         /**
          * @brief Save tile to package
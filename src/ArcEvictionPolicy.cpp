@@ -0,0 +1,143 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "ArcEvictionPolicy.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+ArcEvictionPolicy::ArcEvictionPolicy(size_t capacity): _capacity(capacity), _target(0) {
+    fill(sizes, sizes+4, 0);
+}
+
+void ArcEvictionPolicy::setCapacity(size_t capacity, vector<CacheKey>* evicted) {
+    _capacity = capacity;
+    _target = min(_target, _capacity);
+    replace(evicted);
+    trimGhosts();
+}
+
+vector<CacheKey> ArcEvictionPolicy::keys() const {
+    /* Ghost queues contain only keys of entries not in the cache */
+    vector<CacheKey> k;
+    k.reserve(queues[Recent].size() + queues[Frequent].size());
+    for(Entries::const_reverse_iterator it = queues[Recent].rbegin(); it != queues[Recent].rend(); ++it)
+        k.push_back(it->first);
+    for(Entries::const_reverse_iterator it = queues[Frequent].rbegin(); it != queues[Frequent].rend(); ++it)
+        k.push_back(it->first);
+
+    return k;
+}
+
+void ArcEvictionPolicy::hit(const CacheKey& key) {
+    unordered_map<CacheKey, Position>::iterator found = index.find(key);
+    if(found == index.end() || (found->second.queue != Recent && found->second.queue != Frequent))
+        return;
+
+    move(found->second, Frequent);
+}
+
+void ArcEvictionPolicy::insert(const CacheKey& key, size_t size, vector<CacheKey>* evicted) {
+    unordered_map<CacheKey, Position>::iterator found = index.find(key);
+
+    /* New entry */
+    if(found == index.end()) {
+        queues[Recent].push_front(make_pair(key, size));
+        index.insert(make_pair(key, Position(Recent, queues[Recent].begin())));
+        sizes[Recent] += size;
+
+    } else {
+        Position& position = found->second;
+
+        /* Entry evicted from Recent too early, enlarge it */
+        if(position.queue == RecentGhost) {
+            size_t delta = max(size, size_t(double(size)*sizes[FrequentGhost]/max(sizes[RecentGhost], size_t(1))));
+            _target = min(_capacity, _target + delta);
+
+        /* Entry evicted from Frequent too early, enlarge it */
+        } else if(position.queue == FrequentGhost) {
+            size_t delta = max(size, size_t(double(size)*sizes[RecentGhost]/max(sizes[FrequentGhost], size_t(1))));
+            _target = _target > delta ? _target - delta : 0;
+        }
+
+        /* Update the size and put the entry into Frequent */
+        sizes[position.queue] -= position.it->second;
+        position.it->second = size;
+        sizes[position.queue] += size;
+        move(position, Frequent);
+    }
+
+    replace(evicted);
+    trimGhosts();
+}
+
+void ArcEvictionPolicy::remove(const CacheKey& key) {
+    unordered_map<CacheKey, Position>::iterator found = index.find(key);
+    if(found == index.end()) return;
+
+    sizes[found->second.queue] -= found->second.it->second;
+    queues[found->second.queue].erase(found->second.it);
+    index.erase(found);
+}
+
+void ArcEvictionPolicy::clear() {
+    for(int i = 0; i != 4; ++i) {
+        queues[i].clear();
+        sizes[i] = 0;
+    }
+    index.clear();
+    _target = 0;
+}
+
+void ArcEvictionPolicy::move(Position& position, Queue to) {
+    sizes[position.queue] -= position.it->second;
+    sizes[to] += position.it->second;
+    queues[to].splice(queues[to].begin(), queues[position.queue], position.it);
+    position.queue = to;
+}
+
+void ArcEvictionPolicy::replace(vector<CacheKey>* evicted) {
+    while(sizes[Recent] + sizes[Frequent] > _capacity) {
+        /* Evict from Recent if it is larger than target, from Frequent
+           otherwise */
+        Queue from = !queues[Recent].empty() && (sizes[Recent] > _target || queues[Frequent].empty()) ? Recent : Frequent;
+        Queue to = from == Recent ? RecentGhost : FrequentGhost;
+
+        const CacheKey& key = queues[from].back().first;
+        evicted->push_back(key);
+        move(index.find(key)->second, to);
+    }
+}
+
+void ArcEvictionPolicy::trimGhosts() {
+    /* Recent with its ghosts are at most as large as the cache */
+    while(!queues[RecentGhost].empty() && sizes[Recent] + sizes[RecentGhost] > _capacity) {
+        sizes[RecentGhost] -= queues[RecentGhost].back().second;
+        index.erase(queues[RecentGhost].back().first);
+        queues[RecentGhost].pop_back();
+    }
+
+    /* Everything together is at most twice as large as the cache */
+    while(!queues[FrequentGhost].empty() && sizes[Recent] + sizes[Frequent] + sizes[RecentGhost] + sizes[FrequentGhost] > 2*_capacity) {
+        sizes[FrequentGhost] -= queues[FrequentGhost].back().second;
+        index.erase(queues[FrequentGhost].back().first);
+        queues[FrequentGhost].pop_back();
+    }
+}
+
+}}
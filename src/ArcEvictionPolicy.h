@@ -0,0 +1,94 @@
+#ifndef Kompas_Core_ArcEvictionPolicy_h
+#define Kompas_Core_ArcEvictionPolicy_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::ArcEvictionPolicy
+ */
+
+#include <list>
+#include <unordered_map>
+
+#include "AbstractEvictionPolicy.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Adaptive replacement cache eviction policy
+
+Entries used only once and entries used repeatedly are kept in separate
+queues. Keys of entries evicted from each queue are remembered in ghost
+queues and hits in them adapt the ratio between both queues, so single pass
+over many entries flushes only entries which were used once.
+
+Sizes of the queues are measured in entry sizes instead of entry counts, so
+the policy works also with entries of different sizes.
+*/
+class CORE_EXPORT ArcEvictionPolicy: public AbstractEvictionPolicy {
+    public:
+        /**
+         * @brief Constructor
+         * @param capacity  Capacity
+         */
+        ArcEvictionPolicy(size_t capacity = 0);
+
+        inline size_t capacity() const { return _capacity; }
+        void setCapacity(size_t capacity, std::vector<CacheKey>* evicted);
+        inline size_t usedSize() const { return sizes[Recent] + sizes[Frequent]; }
+        std::vector<CacheKey> keys() const;
+
+        /**
+         * @brief Target size of queue with entries used once
+         *
+         * Adapted on every insertion of entry found in ghost queues.
+         */
+        inline size_t target() const { return _target; }
+
+        void hit(const CacheKey& key);
+        void insert(const CacheKey& key, size_t size, std::vector<CacheKey>* evicted);
+        void remove(const CacheKey& key);
+        void clear();
+
+    private:
+        enum Queue {
+            Recent,         /* Entries used once */
+            Frequent,       /* Entries used more times */
+            RecentGhost,    /* Keys recently evicted from Recent */
+            FrequentGhost   /* Keys recently evicted from Frequent */
+        };
+
+        typedef std::list<std::pair<CacheKey, size_t> > Entries;
+
+        struct Position {
+            inline Position(Queue queue, Entries::iterator it): queue(queue), it(it) {}
+
+            Queue queue;
+            Entries::iterator it;
+        };
+
+        size_t _capacity, _target;
+        Entries queues[4];      /* Most recently used first */
+        size_t sizes[4];
+        std::unordered_map<CacheKey, Position> index;
+
+        void move(Position& position, Queue to);
+        void replace(std::vector<CacheKey>* evicted);
+        void trimGhosts();
+};
+
+}}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheKey.h"
+
+#include <sstream>
+#include <mutex>
+#include <unordered_map>
+
+#include "Utility/Endianness.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+
+namespace Kompas { namespace Core {
+
+namespace {
+    /* Names of all given IDs */
+    struct Names {
+        mutex guard;
+        unordered_map<uint32_t, string> names;
+    };
+
+    Names& names() {
+        static Names names;
+        return names;
+    }
+
+    string nameOrId(uint32_t id) {
+        string name = CacheKey::name(id);
+        if(!name.empty()) return name;
+
+        ostringstream out;
+        out << '#' << hex << id;
+        return out.str();
+    }
+}
+
+uint32_t CacheKey::id(const string& name) {
+    /* The registry only grows and given IDs never change, so each thread can
+       remember them and the lock is taken only for names it sees first time */
+    static thread_local unordered_map<string, uint32_t> memo;
+    unordered_map<string, uint32_t>::const_iterator memoized = memo.find(name);
+    if(memoized != memo.end()) return memoized->second;
+
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    for(string::const_iterator it = name.begin(); it != name.end(); ++it) {
+        h ^= static_cast<unsigned char>(*it);
+        h *= 16777619u;
+    }
+
+    /* Take next unused ID, if the hash is used by another name */
+    Names& n = names();
+    lock_guard<mutex> lock(n.guard);
+    for(;; ++h) {
+        unordered_map<uint32_t, string>::const_iterator found = n.names.find(h);
+        if(found == n.names.end()) {
+            n.names.insert(make_pair(h, name));
+            break;
+        }
+
+        if(found->second == name) break;
+    }
+
+    memo.insert(make_pair(name, h));
+    return h;
+}
+
+string CacheKey::name(uint32_t id) {
+    static thread_local unordered_map<uint32_t, string> memo;
+    unordered_map<uint32_t, string>::const_iterator memoized = memo.find(id);
+    if(memoized != memo.end()) return memoized->second;
+
+    Names& n = names();
+    lock_guard<mutex> lock(n.guard);
+    unordered_map<uint32_t, string>::const_iterator found = n.names.find(id);
+    if(found == n.names.end()) return string();
+
+    /* Unknown IDs aren't remembered, they can be given later */
+    memo.insert(*found);
+    return found->second;
+}
+
+string CacheKey::toString() const {
+    uint32_t numbers[] = {
+        Endianness::littleEndian<uint32_t>(_z),
+        Endianness::littleEndian<uint32_t>(_x),
+        Endianness::littleEndian<uint32_t>(_y)
+    };
+
+    string out = _kind + string(reinterpret_cast<const char*>(numbers), sizeof(numbers));
+    out += nameOrId(_model);
+    out += '\0';
+    out += nameOrId(_layer);
+    out += '\0';
+    return out;
+}
+
+}}
@@ -0,0 +1,149 @@
+#ifndef Kompas_Core_CacheKey_h
+#define Kompas_Core_CacheKey_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::CacheKey
+ */
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+#include "AbstractRasterModel.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Fixed-size cache key
+
+Identifies data in cache without building any strings. Model and layer names
+are stored as 32bit IDs given by id(), hash of the whole key is computed at
+construction time, so the key can be used directly in hash tables.
+
+The IDs are unique in the process, but they are not guaranteed to be the same
+in all processes. Caches which keep the data across processes thus must keep
+also the names and compare them with name().
+@see AbstractCache
+*/
+class CORE_EXPORT CacheKey {
+    public:
+        /**
+         * @brief Name ID
+         *
+         * The ID is 32bit FNV-1a hash of given model or layer name. If the
+         * hash is already used by another name, next unused value is taken,
+         * so different names never have the same ID. The IDs are thus the
+         * same in all processes, unless the names collide.
+         *
+         * Given IDs are remembered in each thread, so only the first call for
+         * given name in given thread has to lock the process-wide registry.
+         * The registry is never shrunk, it's meant for model and layer names,
+         * whose count is small and bounded, not for arbitrary user data.
+         */
+        static std::uint32_t id(const std::string& name);
+
+        /**
+         * @brief Name for given ID
+         *
+         * Returns empty string, if the ID wasn't given by id().
+         */
+        static std::string name(std::uint32_t id);
+
+        /** @brief Default constructor */
+        inline CacheKey(): _kind(0), _model(0), _layer(0), _z(0), _x(0), _y(0), _hash(0) {}
+
+        /**
+         * @brief Constructor
+         * @param kind      Data kind, e.g. AbstractCache::RasterTile
+         * @param model     Model ID, see id()
+         * @param layer     Layer ID, see id()
+         * @param z         Zoom
+         * @param coords    Coordinates
+         */
+        inline CacheKey(char kind, std::uint32_t model, std::uint32_t layer, Zoom z, const TileCoords& coords): _kind(kind), _model(model), _layer(layer), _z(z), _x(coords.x), _y(coords.y), _hash(computeHash()) {}
+
+        /**
+         * @brief Constructor
+         * @param kind      Data kind, e.g. AbstractCache::RasterTile
+         * @param model     Model name
+         * @param layer     Layer name
+         * @param z         Zoom
+         * @param coords    Coordinates
+         */
+        inline CacheKey(char kind, const std::string& model, const std::string& layer, Zoom z, const TileCoords& coords): _kind(kind), _model(id(model)), _layer(id(layer)), _z(z), _x(coords.x), _y(coords.y), _hash(computeHash()) {}
+
+        inline char kind() const { return _kind; }              /**< @brief Data kind */
+        inline std::uint32_t model() const { return _model; }   /**< @brief Model ID */
+        inline std::uint32_t layer() const { return _layer; }   /**< @brief Layer ID */
+        inline Zoom z() const { return _z; }                    /**< @brief Zoom */
+
+        /** @brief Coordinates */
+        inline TileCoords coords() const { return TileCoords(_x, _y); }
+
+        /** @brief Precomputed hash of the key */
+        inline std::uint64_t hash() const { return _hash; }
+
+        /** @brief Equality operator */
+        inline bool operator==(const CacheKey& other) const {
+            return _hash == other._hash && _x == other._x && _y == other._y &&
+                _z == other._z && _layer == other._layer &&
+                _model == other._model && _kind == other._kind;
+        }
+
+        /** @brief Non-equality operator */
+        inline bool operator!=(const CacheKey& other) const { return !operator==(other); }
+
+        /**
+         * @brief Serialize the key
+         *
+         * Returns data kind, zoom and coordinates as 32bit little endian
+         * numbers, followed by model and layer name, each terminated with
+         * null byte. IDs which weren't given by id() are serialized as
+         * <tt>#</tt> followed by hexadecimal ID. Used for caches which work
+         * with string keys.
+         */
+        std::string toString() const;
+
+    private:
+        char _kind;
+        std::uint32_t _model, _layer, _z, _x, _y;
+        std::uint64_t _hash;
+
+        inline std::uint64_t computeHash() const {
+            std::uint64_t h = std::uint64_t(_x) << 32 | _y;
+            h ^= (std::uint64_t(_model) << 32 | _layer)*0x9e3779b97f4a7c15ull;
+            h ^= (std::uint64_t(_z) << 8 | static_cast<unsigned char>(_kind))*0xc2b2ae3d27d4eb4full;
+
+            /* MurmurHash3 finalizer */
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            return h ^ (h >> 33);
+        }
+};
+
+}}
+
+namespace std {
+    /** @brief Hash for Kompas::Core::CacheKey */
+    template<> struct hash<Kompas::Core::CacheKey> {
+        inline size_t operator()(const Kompas::Core::CacheKey& key) const { return key.hash(); }
+    };
+}
+
+#endif
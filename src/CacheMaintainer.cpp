@@ -0,0 +1,65 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheMaintainer.h"
+
+#include <chrono>
+
+#include "AbstractCache.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+CacheMaintainer::CacheMaintainer(AbstractCache* cache, unsigned int slice, unsigned int pause, unsigned int idleInterval): cache(cache), _slice(slice), _pause(pause), _idleInterval(idleInterval), _steps(0), busy(false), woken(false), stopping(false) {
+    worker = thread(&CacheMaintainer::run, this);
+}
+
+CacheMaintainer::~CacheMaintainer() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    worker.join();
+}
+
+void CacheMaintainer::wake() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        woken = true;
+    }
+    condition.notify_all();
+}
+
+void CacheMaintainer::run() {
+    unique_lock<std::mutex> lock(mutex);
+    while(!stopping) {
+        woken = false;
+        lock.unlock();
+
+        busy = cache->maintain(_slice);
+        ++_steps;
+
+        /* Throttle the work or wait for new work, the pause can be
+           interrupted only by stopping */
+        lock.lock();
+        if(busy) {
+            if(_pause) condition.wait_for(lock, chrono::microseconds(_pause), [this]() { return stopping; });
+        } else condition.wait_for(lock, chrono::milliseconds(_idleInterval), [this]() { return stopping || woken; });
+    }
+}
+
+}}
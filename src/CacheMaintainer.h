@@ -0,0 +1,130 @@
+#ifndef Kompas_Core_CacheMaintainer_h
+#define Kompas_Core_CacheMaintainer_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::CacheMaintainer
+ */
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "utilities.h"
+
+namespace Kompas { namespace Core {
+
+class AbstractCache;
+
+/**
+@brief Background cache maintenance
+
+Calls AbstractCache::maintain() from dedicated thread. Each call gets time
+budget of slice() and is followed by pause(), so the maintenance takes at most
+<tt>slice/(slice + pause)</tt> of cache time and of disk bandwidth and other
+threads accessing the cache don't wait long. When the cache has no more work,
+the thread sleeps for idleInterval() or until wake() is called.
+@code
+DiskCache cache;
+cache.initializeCache("/path/to/cache");
+CacheMaintainer maintainer(&cache);
+
+// Purge the cache without blocking it
+cache.schedulePurge();
+maintainer.wake();
+@endcode
+
+The cache must support access from multiple threads and must be initialized
+while the maintainer exists.
+*/
+class CORE_EXPORT CacheMaintainer {
+    public:
+        /**
+         * @brief Constructor
+         * @param cache         Cache
+         * @param slice         Time budget for one maintenance step in
+         *      microseconds
+         * @param pause         Pause between maintenance steps in
+         *      microseconds
+         * @param idleInterval  Interval of checking for new work when there
+         *      is nothing to do, in milliseconds
+         *
+         * Starts the maintenance thread.
+         */
+        CacheMaintainer(AbstractCache* cache, unsigned int slice = 2000, unsigned int pause = 8000, unsigned int idleInterval = 1000);
+
+        /**
+         * @brief Destructor
+         *
+         * Stops the maintenance thread after current step.
+         */
+        ~CacheMaintainer();
+
+        /** @brief Time budget for one step in microseconds */
+        inline unsigned int slice() const { return _slice; }
+
+        /** @brief Set time budget for one step in microseconds */
+        inline void setSlice(unsigned int slice) { _slice = slice; }
+
+        /** @brief Pause between steps in microseconds */
+        inline unsigned int pause() const { return _pause; }
+
+        /**
+         * @brief Set pause between steps in microseconds
+         *
+         * Longer pause makes the maintenance slower, but with less impact on
+         * other cache users.
+         */
+        inline void setPause(unsigned int pause) { _pause = pause; }
+
+        /** @brief Interval of checking for new work in milliseconds */
+        inline unsigned int idleInterval() const { return _idleInterval; }
+
+        /** @brief Set interval of checking for new work in milliseconds */
+        inline void setIdleInterval(unsigned int interval) { _idleInterval = interval; }
+
+        /**
+         * @brief Wake the thread
+         *
+         * Should be called after scheduling maintenance work, e.g. with
+         * AbstractCache::schedulePurge(), so the work starts immediately.
+         */
+        void wake();
+
+        /** @brief Count of maintenance steps done */
+        inline unsigned long long steps() const { return _steps; }
+
+        /** @brief Whether the cache has maintenance work waiting */
+        inline bool isBusy() const { return busy; }
+
+    private:
+        AbstractCache* cache;
+        std::atomic<unsigned int> _slice, _pause, _idleInterval;
+        std::atomic<unsigned long long> _steps;
+        std::atomic<bool> busy;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool woken, stopping;
+        std::thread worker;
+
+        void run();
+};
+
+}}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheSeeder.h"
+
+#include <cmath>
+#include <set>
+#include <algorithm>
+#include <thread>
+
+#include "Utility/utilities.h"
+#include "AbstractCache.h"
+#include "AbstractDownloader.h"
+#include "AbstractProjection.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+
+namespace Kompas { namespace Core {
+
+/* Tiles to process, divided into batches */
+struct CacheSeeder::Job {
+    std::string layer;
+    vector<pair<Zoom, TileArea> > areas;
+
+    std::mutex mutex;
+    size_t area;                    /* Current area */
+    unsigned long long position;    /* Next tile in current area */
+
+    /* Take next batch, returns false if there is nothing left */
+    bool take(size_t size, Zoom* z, vector<TileCoords>* tiles) {
+        tiles->clear();
+
+        lock_guard<std::mutex> lock(mutex);
+        for(; area != areas.size(); ++area, position = 0) {
+            const TileArea& a = areas[area].second;
+            const unsigned long long count = (unsigned long long)(a.w)*a.h;
+            if(position == count) continue;
+
+            /* Batch doesn't span more zoom levels */
+            *z = areas[area].first;
+            for(; position != count && tiles->size() != size; ++position)
+                tiles->push_back(TileCoords(a.x + position%a.w, a.y + position/a.w));
+            return true;
+        }
+
+        return false;
+    }
+};
+
+TileArea CacheSeeder::tileArea(const AbstractRasterModel* model, const LatLonCoords& a, const LatLonCoords& b, Zoom z) {
+    const AbstractProjection* projection = model->projection();
+    set<Zoom> zoomLevels = model->zoomLevels();
+    if(!projection || !a.isValid() || !b.isValid() || zoomLevels.empty() || z < *zoomLevels.begin())
+        return TileArea();
+
+    /* Tiles covering the region */
+    const Coords<double> first = projection->fromLatLon(a),
+        second = projection->fromLatLon(b);
+    const double size = pow2(z);
+    const double left = max(0.0, floor(min(first.x, second.x)*size)),
+        top = max(0.0, floor(min(first.y, second.y)*size)),
+        right = min(size, floor(max(first.x, second.x)*size) + 1),
+        bottom = min(size, floor(max(first.y, second.y)*size) + 1);
+    if(left >= right || top >= bottom) return TileArea();
+
+    /* Clip to model area */
+    const TileArea modelArea = model->area()*pow2(z-*zoomLevels.begin());
+    const unsigned int x = max(static_cast<unsigned int>(left), modelArea.x),
+        y = max(static_cast<unsigned int>(top), modelArea.y),
+        x2 = min(static_cast<unsigned int>(right), modelArea.x+modelArea.w),
+        y2 = min(static_cast<unsigned int>(bottom), modelArea.y+modelArea.h);
+    if(x >= x2 || y >= y2) return TileArea();
+
+    return TileArea(x, y, x2-x, y2-y);
+}
+
+CacheSeeder::CacheSeeder(const AbstractRasterModel* model, AbstractCache* cache, AbstractDownloader* downloader, unsigned int threadCount): model(model), cache(cache), downloader(downloader), threadCount(threadCount ? threadCount : 1), _batchSize(64), cancelled(false), total(0), done(0), present(0), missing(0), seeded(0), failed(0) {}
+
+CacheSeeder::Progress CacheSeeder::seed(const string& layer, const LatLonCoords& a, const LatLonCoords& b, Zoom minZoom, Zoom maxZoom) {
+    cancelled = false;
+    total = done = present = missing = seeded = failed = 0;
+
+    Job job;
+    job.layer = layer;
+    job.area = 0;
+    job.position = 0;
+
+    /* Only zoom levels provided by the model */
+    set<Zoom> zoomLevels = model->zoomLevels();
+    for(set<Zoom>::const_iterator it = zoomLevels.lower_bound(minZoom); it != zoomLevels.end() && *it <= maxZoom; ++it) {
+        TileArea area = tileArea(model, a, b, *it);
+        if(area.w == 0 || area.h == 0) continue;
+
+        job.areas.push_back(make_pair(*it, area));
+        total += (unsigned long long)(area.w)*area.h;
+    }
+
+    vector<thread> threads;
+    for(unsigned int i = 0; i != threadCount; ++i)
+        threads.push_back(thread(&CacheSeeder::run, this, &job));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    return progress();
+}
+
+CacheSeeder::Progress CacheSeeder::progress() const {
+    Progress p;
+    p.total = total;
+    p.done = done;
+    p.present = present;
+    p.missing = missing;
+    p.seeded = seeded;
+    p.failed = failed;
+    return p;
+}
+
+void CacheSeeder::run(Job* job) {
+    Zoom z;
+    vector<TileCoords> tiles;
+    while(!cancelled && job->take(_batchSize, &z, &tiles)) {
+        process(job->layer, z, tiles);
+
+        if(_progressCallback) {
+            lock_guard<std::mutex> lock(callbackMutex);
+            _progressCallback(progress());
+        }
+    }
+}
+
+void CacheSeeder::process(const string& layer, Zoom z, const vector<TileCoords>& tiles) {
+    /* Check presence of whole batch at once */
+    const uint32_t modelId = CacheKey::id(model->plugin()), layerId = CacheKey::id(layer);
+    vector<CacheKey> keys;
+    keys.reserve(tiles.size());
+    for(vector<TileCoords>::const_iterator it = tiles.begin(); it != tiles.end(); ++it)
+        keys.push_back(CacheKey(AbstractCache::RasterTile, modelId, layerId, z, *it));
+    vector<bool> found = cache->contains(keys);
+
+    for(size_t i = 0; i != tiles.size(); ++i) {
+        if(found[i]) ++present;
+        else if(model->isTileMissing(cache, layer, z, tiles[i])) ++missing;
+        else seedTile(layer, z, tiles[i]);
+
+        ++done;
+    }
+}
+
+void CacheSeeder::seedTile(const string& layer, Zoom z, const TileCoords& coords) {
+    TileData data = model->tileFromPackage(layer, z, coords);
+
+    if(data.empty() && downloader && model->online()) {
+        string url = model->tileUrl(layer, z, coords);
+        string downloaded;
+        int status = url.empty() ? 0 : downloader->download(url, &downloaded);
+
+        /* The tile doesn't exist, don't look for it again */
+        if(status == 404 || status == 410) {
+            model->setTileMissing(cache, layer, z, coords);
+            ++missing;
+            return;
+        }
+
+        if(status == 200) data = TileData(std::move(downloaded));
+    }
+
+    if(!data.empty() && model->tileToCache(cache, layer, z, coords, data)) ++seeded;
+    else ++failed;
+}
+
+}}
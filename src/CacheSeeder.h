@@ -0,0 +1,175 @@
+#ifndef Kompas_Core_CacheSeeder_h
+#define Kompas_Core_CacheSeeder_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::CacheSeeder
+ */
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+#include "AbstractRasterModel.h"
+#include "LatLonCoords.h"
+
+namespace Kompas { namespace Core {
+
+class AbstractCache;
+class AbstractDownloader;
+
+/**
+@brief Cache pre-seeding
+
+Fills cache with all tiles of given region and zoom range in advance, e.g.
+before the map is used without network connection.
+@code
+OpenStreetMapRasterModel model;
+DiskCache cache;
+cache.initializeCache("/path/to/cache");
+HttpDownloader downloader;
+
+CacheSeeder seeder(&model, &cache, &downloader, 8);
+seeder.setProgressCallback([](const CacheSeeder::Progress& p) {
+    std::cout << p.done << '/' << p.total << std::endl;
+});
+seeder.seed("Mapnik", LatLonCoords(50.2, 14.2), LatLonCoords(49.9, 14.7), 10, 16);
+@endcode
+
+The region is converted to tile area through model projection. Projected
+coordinates from 0 to 1 are expected to span the whole map, which at zoom
+@c z has <tt>2^z</tt> tiles in each direction, as is usual for web maps. The
+area is then clipped to model area. Zoom levels not provided by the model are
+skipped.
+
+The tiles are processed in batches by worker threads. Presence of each batch
+in the cache is checked at once with AbstractCache::contains(), present tiles
+and tiles known to be missing are skipped. The rest is taken from model
+packages or, if the model is online and downloader is set, downloaded, and
+saved to the cache. Tiles which don't exist on the server are remembered as
+missing.
+
+Command-line utility @c kompas-seed seeds caches with this class.
+*/
+class CORE_EXPORT CacheSeeder {
+    public:
+        /** @brief Progress */
+        struct Progress {
+            inline Progress(): total(0), done(0), present(0), missing(0), seeded(0), failed(0) {}
+
+            unsigned long long total,   /**< @brief Count of all tiles */
+                done,                   /**< @brief Count of processed tiles */
+                present,                /**< @brief Tiles already in cache */
+                missing,                /**< @brief Tiles which don't exist */
+                seeded,                 /**< @brief Tiles saved to cache */
+                failed;                 /**< @brief Tiles which couldn't be retrieved or saved */
+        };
+
+        /**
+         * @brief Progress callback
+         *
+         * @see setProgressCallback()
+         */
+        typedef std::function<void(const Progress&)> ProgressCallback;
+
+        /**
+         * @brief Tile area for given region
+         * @param model     Raster model
+         * @param a         One corner of the region
+         * @param b         Opposite corner of the region
+         * @param z         Zoom
+         * @return Tiles covering the region, clipped to model area. Empty
+         *      area if the model has no projection or the region is outside
+         *      the model.
+         */
+        static TileArea tileArea(const AbstractRasterModel* model, const LatLonCoords& a, const LatLonCoords& b, Zoom z);
+
+        /**
+         * @brief Constructor
+         * @param model         Raster model
+         * @param cache         Initialized cache
+         * @param downloader    Downloader for tiles which aren't in any
+         *      package. If null, only packages are used.
+         * @param threadCount   Count of worker threads
+         */
+        CacheSeeder(const AbstractRasterModel* model, AbstractCache* cache, AbstractDownloader* downloader = 0, unsigned int threadCount = 4);
+
+        /** @brief Count of tiles checked at once */
+        inline size_t batchSize() const { return _batchSize; }
+
+        /**
+         * @brief Set count of tiles checked at once
+         *
+         * Default is 64.
+         */
+        inline void setBatchSize(size_t size) { _batchSize = size ? size : 1; }
+
+        /**
+         * @brief Set progress callback
+         *
+         * The callback is called after each processed batch from worker
+         * threads, but never from two threads at once.
+         */
+        inline void setProgressCallback(const ProgressCallback& callback) { _progressCallback = callback; }
+
+        /**
+         * @brief Seed the cache
+         * @param layer     Layer
+         * @param a         One corner of the region
+         * @param b         Opposite corner of the region
+         * @param minZoom   Minimal zoom
+         * @param maxZoom   Maximal zoom
+         * @return Final progress
+         *
+         * Blocks until all tiles are processed or cancel() is called.
+         */
+        Progress seed(const std::string& layer, const LatLonCoords& a, const LatLonCoords& b, Zoom minZoom, Zoom maxZoom);
+
+        /**
+         * @brief Cancel seeding
+         *
+         * Can be called from any thread, including the progress callback.
+         * Batches being processed are finished.
+         */
+        inline void cancel() { cancelled = true; }
+
+        /** @brief Current progress */
+        Progress progress() const;
+
+    private:
+        struct Job;
+
+        const AbstractRasterModel* model;
+        AbstractCache* cache;
+        AbstractDownloader* downloader;
+        unsigned int threadCount;
+        size_t _batchSize;
+        ProgressCallback _progressCallback;
+
+        std::atomic<bool> cancelled;
+        std::atomic<unsigned long long> total, done, present, missing, seeded, failed;
+        std::mutex callbackMutex;
+
+        void run(Job* job);
+        void process(const std::string& layer, Zoom z, const std::vector<TileCoords>& tiles);
+        void seedTile(const std::string& layer, Zoom z, const TileCoords& coords);
+};
+
+}}
+
+#endif
@@ -0,0 +1,363 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheStatistics.h"
+
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+namespace {
+    /* Instance IDs, never reused */
+    atomic<uint64_t> nextId(0);
+
+    /* Histogram bucket is count of significant bits */
+    size_t bucketOf(uint64_t nanoseconds) {
+        size_t i = 0;
+        while(nanoseconds && i != CacheStatistics::Histogram::BucketCount-1) {
+            nanoseconds >>= 1;
+            ++i;
+        }
+
+        return i;
+    }
+
+    inline bool isEmpty(const CacheStatistics::Counters& counters) {
+        return !counters.hits && !counters.misses && !counters.inserts &&
+            !counters.evictions && !counters.getLatency.count() &&
+            !counters.setLatency.count();
+    }
+}
+
+CacheStatistics::Histogram::Histogram() {
+    fill(buckets, buckets+BucketCount, 0);
+}
+
+void CacheStatistics::Histogram::add(uint64_t nanoseconds) {
+    ++buckets[bucketOf(nanoseconds)];
+}
+
+uint64_t CacheStatistics::Histogram::count() const {
+    uint64_t count = 0;
+    for(size_t i = 0; i != BucketCount; ++i)
+        count += buckets[i];
+    return count;
+}
+
+uint64_t CacheStatistics::Histogram::percentile(double p) const {
+    const uint64_t total = count();
+    if(!total) return 0;
+
+    /* Rank of the measurement, counted from one */
+    const uint64_t rank = max(uint64_t(p*total + 0.5), uint64_t(1));
+    uint64_t count = 0;
+    for(size_t i = 0; i != BucketCount; ++i) {
+        count += buckets[i];
+        if(count >= rank) return uint64_t(1) << i;
+    }
+
+    return uint64_t(1) << (BucketCount-1);
+}
+
+CacheStatistics::Histogram& CacheStatistics::Histogram::operator+=(const Histogram& other) {
+    for(size_t i = 0; i != BucketCount; ++i)
+        buckets[i] += other.buckets[i];
+    return *this;
+}
+
+CacheStatistics::Counters::Counters(): hits(0), misses(0), inserts(0), evictions(0), bytesRead(0), bytesWritten(0), bytesEvicted(0) {}
+
+double CacheStatistics::Counters::hitRatio() const {
+    return hits+misses ? double(hits)/(hits+misses) : 0.0;
+}
+
+CacheStatistics::Counters& CacheStatistics::Counters::operator+=(const Counters& other) {
+    hits += other.hits;
+    misses += other.misses;
+    inserts += other.inserts;
+    evictions += other.evictions;
+    bytesRead += other.bytesRead;
+    bytesWritten += other.bytesWritten;
+    bytesEvicted += other.bytesEvicted;
+    getLatency += other.getLatency;
+    setLatency += other.setLatency;
+    return *this;
+}
+
+CacheStatistics::LocalCounters::LocalCounters() {
+    reset();
+}
+
+void CacheStatistics::LocalCounters::addTo(Counters& counters) const {
+    counters.hits += hits.load(memory_order_relaxed);
+    counters.misses += misses.load(memory_order_relaxed);
+    counters.inserts += inserts.load(memory_order_relaxed);
+    counters.evictions += evictions.load(memory_order_relaxed);
+    counters.bytesRead += bytesRead.load(memory_order_relaxed);
+    counters.bytesWritten += bytesWritten.load(memory_order_relaxed);
+    counters.bytesEvicted += bytesEvicted.load(memory_order_relaxed);
+    for(size_t i = 0; i != Histogram::BucketCount; ++i) {
+        counters.getLatency.buckets[i] += getLatency[i].load(memory_order_relaxed);
+        counters.setLatency.buckets[i] += setLatency[i].load(memory_order_relaxed);
+    }
+}
+
+void CacheStatistics::LocalCounters::reset() {
+    hits.store(0, memory_order_relaxed);
+    misses.store(0, memory_order_relaxed);
+    inserts.store(0, memory_order_relaxed);
+    evictions.store(0, memory_order_relaxed);
+    bytesRead.store(0, memory_order_relaxed);
+    bytesWritten.store(0, memory_order_relaxed);
+    bytesEvicted.store(0, memory_order_relaxed);
+    for(size_t i = 0; i != Histogram::BucketCount; ++i) {
+        getLatency[i].store(0, memory_order_relaxed);
+        setLatency[i].store(0, memory_order_relaxed);
+    }
+}
+
+CacheStatistics::CacheStatistics(): id(nextId.fetch_add(1)) {}
+
+CacheStatistics::~CacheStatistics() {
+    for(vector<Local*>::const_iterator it = locals.begin(); it != locals.end(); ++it)
+        delete *it;
+}
+
+void CacheStatistics::recordGet(const CacheKey& key, const string* model, const string* layer, size_t size, uint64_t nanoseconds) {
+    LocalCounters& c = counters(local(), key, model, layer);
+
+    if(size) {
+        c.hits.fetch_add(1, memory_order_relaxed);
+        c.bytesRead.fetch_add(size, memory_order_relaxed);
+    } else c.misses.fetch_add(1, memory_order_relaxed);
+    c.getLatency[bucketOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+}
+
+void CacheStatistics::recordSet(const CacheKey& key, const string* model, const string* layer, size_t size, uint64_t nanoseconds, bool stored) {
+    LocalCounters& c = counters(local(), key, model, layer);
+
+    if(stored) {
+        c.inserts.fetch_add(1, memory_order_relaxed);
+        c.bytesWritten.fetch_add(size, memory_order_relaxed);
+    }
+    c.setLatency[bucketOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+}
+
+void CacheStatistics::recordEviction(const CacheKey& key, size_t size) {
+    LocalCounters& c = counters(local(), key, 0, 0);
+
+    c.evictions.fetch_add(1, memory_order_relaxed);
+    c.bytesEvicted.fetch_add(size, memory_order_relaxed);
+}
+
+void CacheStatistics::addName(const string& name) {
+    lock_guard<std::mutex> lock(namesMutex);
+    names.insert(make_pair(CacheKey::id(name), name));
+}
+
+string CacheStatistics::name(uint32_t id) const {
+    lock_guard<std::mutex> lock(namesMutex);
+    map<uint32_t, string>::const_iterator found = names.find(id);
+    return found == names.end() ? string() : found->second;
+}
+
+CacheStatistics::Counters CacheStatistics::total() const {
+    vector<Entry> entries = snapshot();
+
+    Counters total;
+    for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        total += it->counters;
+
+    return total;
+}
+
+CacheStatistics::Counters CacheStatistics::counters(const string& model, const string& layer, int z) const {
+    const uint32_t modelId = CacheKey::id(model), layerId = CacheKey::id(layer);
+    vector<Entry> entries = snapshot();
+
+    Counters total;
+    for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        if(it->model != modelId ||
+           (!layer.empty() && it->layer != layerId) ||
+           (z >= 0 && it->z != Zoom(z))) continue;
+        total += it->counters;
+    }
+
+    return total;
+}
+
+vector<CacheStatistics::Entry> CacheStatistics::snapshot() const {
+    /* Merge counters of all threads */
+    map<pair<pair<uint32_t, uint32_t>, Zoom>, Counters> merged;
+    {
+        lock_guard<std::mutex> lock(localsMutex);
+        for(vector<Local*>::const_iterator it = locals.begin(); it != locals.end(); ++it) {
+            lock_guard<std::mutex> localLock((*it)->mutex);
+            for(unordered_map<Breakdown, LocalCounters, BreakdownHash>::const_iterator c = (*it)->counters.begin(); c != (*it)->counters.end(); ++c)
+                c->second.addTo(merged[make_pair(make_pair(c->first.model, c->first.layer), c->first.z)]);
+        }
+    }
+
+    vector<Entry> entries;
+    entries.reserve(merged.size());
+    for(map<pair<pair<uint32_t, uint32_t>, Zoom>, Counters>::const_iterator it = merged.begin(); it != merged.end(); ++it) {
+        if(isEmpty(it->second)) continue;
+
+        Entry e;
+        e.model = it->first.first.first;
+        e.layer = it->first.first.second;
+        e.z = it->first.second;
+        e.counters = it->second;
+        entries.push_back(e);
+    }
+
+    return entries;
+}
+
+namespace {
+    void histogramToJson(ostringstream& out, const CacheStatistics::Histogram& histogram) {
+        out << "{\"count\":" << histogram.count()
+            << ",\"p50\":" << histogram.percentile(0.5)
+            << ",\"p90\":" << histogram.percentile(0.9)
+            << ",\"p99\":" << histogram.percentile(0.99)
+            << ",\"buckets\":[";
+
+        bool first = true;
+        for(size_t i = 0; i != CacheStatistics::Histogram::BucketCount; ++i) {
+            if(!histogram.bucket(i)) continue;
+            if(!first) out << ',';
+            out << '[' << (uint64_t(1) << i) << ',' << histogram.bucket(i) << ']';
+            first = false;
+        }
+
+        out << "]}";
+    }
+
+    void countersToJson(ostringstream& out, const CacheStatistics::Counters& counters) {
+        out << "\"hits\":" << counters.hits
+            << ",\"misses\":" << counters.misses
+            << ",\"inserts\":" << counters.inserts
+            << ",\"evictions\":" << counters.evictions
+            << ",\"bytesRead\":" << counters.bytesRead
+            << ",\"bytesWritten\":" << counters.bytesWritten
+            << ",\"bytesEvicted\":" << counters.bytesEvicted
+            << ",\"hitRatio\":" << counters.hitRatio()
+            << ",\"getLatency\":";
+        histogramToJson(out, counters.getLatency);
+        out << ",\"setLatency\":";
+        histogramToJson(out, counters.setLatency);
+    }
+
+    string jsonString(const string& s) {
+        string out("\"");
+        for(string::const_iterator it = s.begin(); it != s.end(); ++it) {
+            if(*it == '"' || *it == '\\') out += '\\';
+            if(static_cast<unsigned char>(*it) < 0x20) {
+                char escaped[7];
+                sprintf(escaped, "\\u%04x", *it);
+                out += escaped;
+            } else out += *it;
+        }
+
+        return out + '"';
+    }
+}
+
+string CacheStatistics::toJson() const {
+    vector<Entry> entries = snapshot();
+
+    Counters total;
+    for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        total += it->counters;
+
+    ostringstream out;
+    out << "{\"total\":{";
+    countersToJson(out, total);
+    out << "},\"entries\":[";
+    for(vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        if(it != entries.begin()) out << ',';
+        out << "{\"model\":" << jsonString(nameOrId(it->model))
+            << ",\"layer\":" << jsonString(nameOrId(it->layer))
+            << ",\"zoom\":" << it->z << ',';
+        countersToJson(out, it->counters);
+        out << '}';
+    }
+    out << "]}";
+
+    return out.str();
+}
+
+void CacheStatistics::reset() {
+    /* The counters are only zeroed, as their threads use them without
+       locking */
+    lock_guard<std::mutex> lock(localsMutex);
+    for(vector<Local*>::const_iterator it = locals.begin(); it != locals.end(); ++it) {
+        lock_guard<std::mutex> localLock((*it)->mutex);
+        for(unordered_map<Breakdown, LocalCounters, BreakdownHash>::iterator c = (*it)->counters.begin(); c != (*it)->counters.end(); ++c)
+            c->second.reset();
+    }
+}
+
+CacheStatistics::Local& CacheStatistics::local() {
+    /* Each thread remembers its counters in all instances by their IDs,
+       which are never reused, so a new instance at the same address doesn't
+       find counters of destroyed one */
+    static thread_local unordered_map<uint64_t, Local*> own;
+
+    unordered_map<uint64_t, Local*>::const_iterator found = own.find(id);
+    if(found != own.end()) return *found->second;
+
+    Local* l = new Local;
+    {
+        lock_guard<std::mutex> lock(localsMutex);
+        locals.push_back(l);
+    }
+    own.insert(make_pair(id, l));
+    return *l;
+}
+
+CacheStatistics::LocalCounters& CacheStatistics::counters(Local& local, const CacheKey& key, const string* model, const string* layer) {
+    Breakdown b;
+    b.model = key.model();
+    b.layer = key.layer();
+    b.z = key.z();
+
+    /* Only this thread adds the counters, so they can be found without the
+       lock */
+    unordered_map<Breakdown, LocalCounters, BreakdownHash>::iterator found = local.counters.find(b);
+    if(found != local.counters.end()) return found->second;
+
+    /* Remember names of new model and layer */
+    if(model) addName(*model);
+    if(layer) addName(*layer);
+
+    lock_guard<std::mutex> lock(local.mutex);
+    return local.counters[b];
+}
+
+string CacheStatistics::nameOrId(uint32_t id) const {
+    string n = name(id);
+    if(!n.empty()) return n;
+
+    ostringstream out;
+    out << '#' << hex << id;
+    return out.str();
+}
+
+}}
@@ -0,0 +1,273 @@
+#ifndef Kompas_Core_CacheStatistics_h
+#define Kompas_Core_CacheStatistics_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::CacheStatistics
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
+#include "CacheKey.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Cache statistics
+
+Counts hits, misses, inserts, evictions and transferred bytes and measures
+latency of getting and saving data, separately for each model, layer and
+zoom. Can be attached to any cache with AbstractCache::setStatistics().
+@code
+CacheStatistics statistics;
+cache->setStatistics(&statistics);
+
+// ...
+
+double hitRatio = statistics.total().hitRatio();
+std::cout << statistics.toJson();
+@endcode
+
+Each thread records to its own counters without any locking, so threads
+recording at the same time don't wait for each other and don't share cache
+lines. snapshot(), total(), counters() and toJson() merge the counters of all
+threads, they can be called any time, while the cache is in use. Counters of
+finished threads are kept until the statistics are destroyed.
+*/
+class CORE_EXPORT CacheStatistics {
+    public:
+        /**
+         * @brief Latency histogram
+         *
+         * Bucket @c i contains latencies from <tt>2^(i-1)</tt> (inclusive) to
+         * <tt>2^i</tt> nanoseconds (exclusive), first bucket contains zero
+         * latencies, last bucket contains everything longer.
+         */
+        class CORE_EXPORT Histogram {
+            public:
+                /** @brief Count of buckets */
+                static const size_t BucketCount = 40;
+
+                /** @brief Constructor */
+                Histogram();
+
+                /** @brief Add latency in nanoseconds */
+                void add(std::uint64_t nanoseconds);
+
+                /** @brief Count of measurements in given bucket */
+                inline std::uint64_t bucket(size_t i) const { return buckets[i]; }
+
+                /** @brief Count of all measurements */
+                std::uint64_t count() const;
+
+                /**
+                 * @brief Percentile
+                 * @param p     Percentile from 0 to 1, e.g. 0.99
+                 * @return Upper bound of bucket containing the percentile in
+                 *      nanoseconds, 0 if there are no measurements.
+                 */
+                std::uint64_t percentile(double p) const;
+
+                /** @brief Add measurements of another histogram */
+                Histogram& operator+=(const Histogram& other);
+
+            private:
+                friend class CacheStatistics;
+
+                std::uint64_t buckets[BucketCount];
+        };
+
+        /** @brief Counters */
+        struct CORE_EXPORT Counters {
+            /** @brief Constructor */
+            Counters();
+
+            std::uint64_t hits,         /**< @brief Found data */
+                misses,                 /**< @brief Data which weren't found */
+                inserts,                /**< @brief Saved data */
+                evictions,              /**< @brief Evicted data */
+                bytesRead,              /**< @brief Size of found data */
+                bytesWritten,           /**< @brief Size of saved data */
+                bytesEvicted;           /**< @brief Size of evicted data */
+            Histogram getLatency,       /**< @brief Latency of getting data */
+                setLatency;             /**< @brief Latency of saving data */
+
+            /** @brief Ratio of hits to all lookups, 0 if there were none */
+            double hitRatio() const;
+
+            /** @brief Add another counters */
+            Counters& operator+=(const Counters& other);
+        };
+
+        /** @brief Counters of one model, layer and zoom */
+        struct Entry {
+            std::uint32_t model,        /**< @brief Model ID */
+                layer;                  /**< @brief Layer ID */
+            Zoom z;                     /**< @brief Zoom */
+            Counters counters;          /**< @brief Counters */
+        };
+
+        /** @brief Constructor */
+        CacheStatistics();
+
+        /** @brief Destructor */
+        ~CacheStatistics();
+
+        /**
+         * @brief Record get
+         * @param key           Key
+         * @param size          Data size, 0 if the data weren't found
+         * @param nanoseconds   Latency
+         */
+        inline void recordGet(const CacheKey& key, size_t size, std::uint64_t nanoseconds) {
+            recordGet(key, 0, 0, size, nanoseconds);
+        }
+
+        /**
+         * @brief Record get with model and layer name
+         *
+         * The names are remembered for toJson(), if they weren't known
+         * already. Names can be also set with addName().
+         */
+        void recordGet(const CacheKey& key, const std::string* model, const std::string* layer, size_t size, std::uint64_t nanoseconds);
+
+        /**
+         * @brief Record set
+         * @param key           Key
+         * @param size          Data size
+         * @param nanoseconds   Latency
+         * @param stored        Whether the data were saved. Unsaved data are
+         *      counted only in latency.
+         */
+        inline void recordSet(const CacheKey& key, size_t size, std::uint64_t nanoseconds, bool stored = true) {
+            recordSet(key, 0, 0, size, nanoseconds, stored);
+        }
+
+        /** @brief Record set with model and layer name */
+        void recordSet(const CacheKey& key, const std::string* model, const std::string* layer, size_t size, std::uint64_t nanoseconds, bool stored = true);
+
+        /**
+         * @brief Record eviction
+         * @param key           Key
+         * @param size          Data size
+         */
+        void recordEviction(const CacheKey& key, size_t size);
+
+        /**
+         * @brief Add model or layer name
+         *
+         * Used in toJson() instead of name ID.
+         */
+        void addName(const std::string& name);
+
+        /** @brief Model or layer name for given ID, empty if unknown */
+        std::string name(std::uint32_t id) const;
+
+        /** @brief Counters for all models, layers and zoom levels */
+        Counters total() const;
+
+        /**
+         * @brief Counters for given model, layer and zoom
+         * @param model     Model name
+         * @param layer     Layer name, if empty, all layers are counted
+         * @param z         Zoom, if negative, all zoom levels are counted
+         */
+        Counters counters(const std::string& model, const std::string& layer = "", int z = -1) const;
+
+        /**
+         * @brief All counters sorted by model ID, layer ID and zoom
+         *
+         * Counters with nothing recorded since last reset() are omitted.
+         */
+        std::vector<Entry> snapshot() const;
+
+        /**
+         * @brief Statistics as JSON
+         *
+         * Object with @c total counters and @c entries array of counters for
+         * each model, layer and zoom. Latency histograms contain @c count,
+         * @c p50, @c p90, @c p99 percentiles in nanoseconds and nonzero
+         * @c buckets as pairs of bucket upper bound and count.
+         */
+        std::string toJson() const;
+
+        /** @brief Reset all counters */
+        void reset();
+
+    private:
+        struct Breakdown {
+            std::uint32_t model, layer;
+            Zoom z;
+
+            inline bool operator==(const Breakdown& other) const {
+                return model == other.model && layer == other.layer && z == other.z;
+            }
+        };
+
+        struct BreakdownHash {
+            inline size_t operator()(const Breakdown& b) const {
+                return (std::uint64_t(b.model) << 32 | b.layer)*0x9e3779b97f4a7c15ull ^ b.z;
+            }
+        };
+
+        /* Counters written only by one thread, other threads only read
+           them when merging or reset them */
+        struct LocalCounters {
+            LocalCounters();
+
+            std::atomic<std::uint64_t> hits,
+                misses,
+                inserts,
+                evictions,
+                bytesRead,
+                bytesWritten,
+                bytesEvicted,
+                getLatency[Histogram::BucketCount],
+                setLatency[Histogram::BucketCount];
+
+            void addTo(Counters& counters) const;
+            void reset();
+        };
+
+        /* Counters of one thread */
+        struct Local {
+            /* Guards adding new counters, the thread takes it only then */
+            mutable std::mutex mutex;
+            std::unordered_map<Breakdown, LocalCounters, BreakdownHash> counters;
+        };
+
+        const std::uint64_t id;                 /* Unique ID of the instance */
+
+        mutable std::mutex localsMutex;
+        std::vector<Local*> locals;
+
+        mutable std::mutex namesMutex;
+        std::map<std::uint32_t, std::string> names;
+
+        Local& local();
+        LocalCounters& counters(Local& local, const CacheKey& key, const std::string* model, const std::string* layer);
+        std::string nameOrId(std::uint32_t id) const;
+};
+
+}}
+
+#endif
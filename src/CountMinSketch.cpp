@@ -0,0 +1,75 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CountMinSketch.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+CountMinSketch::CountMinSketch(size_t width): additions(0) {
+    size_t w = 2;
+    shift = 63;
+    while(w < width) {
+        w <<= 1;
+        --shift;
+    }
+
+    mask = w-1;
+    counters.resize(Depth*w/2);
+}
+
+void CountMinSketch::increment(uint64_t hash) {
+    size_t indices[Depth];
+    unsigned int min = MaxFrequency;
+    for(unsigned int row = 0; row != Depth; ++row) {
+        indices[row] = index(hash, row);
+        min = std::min(min, counter(indices[row]));
+    }
+
+    if(min == MaxFrequency) return;
+
+    /* Conservative update, increment only the smallest counters */
+    for(unsigned int row = 0; row != Depth; ++row)
+        if(counter(indices[row]) == min)
+            counters[indices[row] >> 1] += 1 << ((indices[row] & 1)*4);
+
+    if(++additions == 10*width()) age();
+}
+
+unsigned int CountMinSketch::frequency(uint64_t hash) const {
+    unsigned int min = MaxFrequency;
+    for(unsigned int row = 0; row != Depth; ++row)
+        min = std::min(min, counter(index(hash, row)));
+
+    return min;
+}
+
+void CountMinSketch::clear() {
+    fill(counters.begin(), counters.end(), 0);
+    additions = 0;
+}
+
+void CountMinSketch::age() {
+    /* Halve both counters in each byte */
+    for(vector<uint8_t>::iterator it = counters.begin(); it != counters.end(); ++it)
+        *it = (*it >> 1) & 0x77;
+
+    additions /= 2;
+}
+
+}}
@@ -0,0 +1,101 @@
+#ifndef Kompas_Core_CountMinSketch_h
+#define Kompas_Core_CountMinSketch_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::CountMinSketch
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Count-min sketch
+
+Approximate frequency counter with fixed memory usage. Each hash increments
+one 4bit counter in each of four rows, the frequency is the smallest of them,
+so it can be overestimated by collisions, but never underestimated. Only the
+smallest counters are incremented, which reduces the overestimation.
+
+After ten times more increments than is the width, all counters are halved,
+so the sketch follows changes in frequency over time.
+*/
+class CORE_EXPORT CountMinSketch {
+    public:
+        /** @brief Max frequency */
+        static const unsigned int MaxFrequency = 15;
+
+        /**
+         * @brief Constructor
+         * @param width     Count of counters in each row, rounded up to power
+         *      of two. Should be similar to count of tracked items.
+         */
+        CountMinSketch(size_t width = 64);
+
+        /** @brief Count of counters in each row */
+        inline size_t width() const { return mask+1; }
+
+        /**
+         * @brief Increment frequency
+         * @param hash      Hash of the item, all 64 bits should be well
+         *      distributed
+         */
+        void increment(std::uint64_t hash);
+
+        /**
+         * @brief Frequency
+         * @param hash      Hash of the item
+         * @return Estimated frequency, at most MaxFrequency.
+         */
+        unsigned int frequency(std::uint64_t hash) const;
+
+        /** @brief Reset all counters to zero */
+        void clear();
+
+    private:
+        static const unsigned int Depth = 4;
+
+        size_t mask, additions;
+        unsigned int shift;
+        std::vector<std::uint8_t> counters;     /* Two counters in a byte */
+
+        inline size_t index(std::uint64_t hash, unsigned int row) const {
+            /* Multiplicative hashing with different constant for each row,
+               taking the upper bits */
+            static const std::uint64_t seeds[] = {
+                0x9e3779b97f4a7c15ull,
+                0xc2b2ae3d27d4eb4full,
+                0x165667b19e3779f9ull,
+                0xd6e8feb86659fd93ull
+            };
+            return (mask+1)*row + ((hash*seeds[row]) >> shift);
+        }
+
+        inline unsigned int counter(size_t i) const {
+            return (counters[i >> 1] >> ((i & 1)*4)) & 0xF;
+        }
+
+        void age();
+};
+
+}}
+
+#endif
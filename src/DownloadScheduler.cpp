@@ -0,0 +1,224 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "DownloadScheduler.h"
+
+#include <cmath>
+
+#include "AbstractDownloader.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+bool DownloadScheduler::Key::operator<(const Key& other) const {
+    if(z != other.z) return z < other.z;
+    if(coords.y != other.coords.y) return coords.y < other.coords.y;
+    if(coords.x != other.coords.x) return coords.x < other.coords.x;
+    return layer < other.layer;
+}
+
+DownloadScheduler::DownloadScheduler(const AbstractRasterModel* model, AbstractDownloader* downloader, unsigned int threadCount, unsigned int hostConnections): model(model), downloader(downloader), _hostConnections(hostConnections ? hostConnections : 1), stopping(false), hasViewport(false), viewportZoom(0), margin(0), active(0) {
+    if(threadCount == 0) threadCount = 1;
+
+    threads.reserve(threadCount);
+    for(unsigned int i = 0; i != threadCount; ++i)
+        threads.push_back(thread(&DownloadScheduler::worker, this));
+}
+
+DownloadScheduler::~DownloadScheduler() {
+    cancelAll();
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+}
+
+void DownloadScheduler::setViewport(Zoom z, const TileArea& area, unsigned int margin) {
+    vector<Request*> cancelled;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        hasViewport = true;
+        viewportZoom = z;
+        viewport = area;
+        this->margin = margin;
+
+        /* Rebuild the queue with new priorities */
+        Queue reordered;
+        for(Queue::const_iterator it = queue.begin(); it != queue.end(); ++it) {
+            uint64_t p;
+            if(priority(it->second->key, &p))
+                it->second->position = reordered.insert(make_pair(p, it->second));
+            else {
+                requests.erase(it->second->key);
+                cancelled.push_back(it->second);
+            }
+        }
+        queue.swap(reordered);
+    }
+
+    for(vector<Request*>::const_iterator it = cancelled.begin(); it != cancelled.end(); ++it)
+        finish(*it, Cancelled, TileData());
+}
+
+bool DownloadScheduler::request(const string& layer, Zoom z, const TileCoords& coords, const Callback& callback) {
+    if(!(model->features() & AbstractRasterModel::LoadableFromUrl) || !model->online()) return false;
+
+    Key key(layer, z, coords);
+    lock_guard<std::mutex> lock(mutex);
+
+    /* The tile is already waiting or being downloaded */
+    map<Key, Request*>::const_iterator found = requests.find(key);
+    if(found != requests.end()) {
+        found->second->callbacks.push_back(callback);
+        return true;
+    }
+
+    string url = model->tileUrl(layer, z, coords);
+    if(url.empty()) return false;
+
+    /* Tiles outside the viewport have lowest priority until next viewport
+       change cancels them */
+    uint64_t p;
+    if(!priority(key, &p)) p = ~uint64_t(0);
+
+    Request* r = new Request(key);
+    r->url = url;
+    r->host = model->tileHost(layer, z, coords);
+    r->callbacks.push_back(callback);
+    r->position = queue.insert(make_pair(p, r));
+    requests.insert(make_pair(key, r));
+
+    condition.notify_one();
+    return true;
+}
+
+bool DownloadScheduler::cancel(const string& layer, Zoom z, const TileCoords& coords) {
+    Request* r;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        map<Key, Request*>::iterator found = requests.find(Key(layer, z, coords));
+        if(found == requests.end() || found->second->running) return false;
+
+        r = found->second;
+        queue.erase(r->position);
+        requests.erase(found);
+    }
+
+    finish(r, Cancelled, TileData());
+    return true;
+}
+
+void DownloadScheduler::cancelAll() {
+    Queue cancelled;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for(Queue::const_iterator it = queue.begin(); it != queue.end(); ++it)
+            requests.erase(it->second->key);
+        cancelled.swap(queue);
+    }
+
+    for(Queue::const_iterator it = cancelled.begin(); it != cancelled.end(); ++it)
+        finish(it->second, Cancelled, TileData());
+}
+
+size_t DownloadScheduler::queuedCount() const {
+    lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+size_t DownloadScheduler::activeCount() const {
+    lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+bool DownloadScheduler::priority(const Key& key, uint64_t* priority) const {
+    if(!hasViewport) {
+        *priority = 0;
+        return true;
+    }
+
+    /* Center of the tile in viewport zoom */
+    const double scale = key.z >= viewportZoom ? 1.0/pow2(key.z-viewportZoom) : pow2(viewportZoom-key.z);
+    const double x = (key.coords.x+0.5)*scale, y = (key.coords.y+0.5)*scale;
+    if(x < double(viewport.x)-margin || x > double(viewport.x)+viewport.w+margin ||
+       y < double(viewport.y)-margin || y > double(viewport.y)+viewport.h+margin)
+        return false;
+
+    /* Zoom difference in upper bits, squared distance in quarter tiles in
+       lower bits */
+    const double dx = x - viewport.x - viewport.w/2.0, dy = y - viewport.y - viewport.h/2.0;
+    const uint64_t zoomDistance = key.z > viewportZoom ? key.z-viewportZoom : viewportZoom-key.z;
+    *priority = zoomDistance << 40 | min(uint64_t((dx*dx + dy*dy)*16), (uint64_t(1) << 40)-1);
+    return true;
+}
+
+DownloadScheduler::Request* DownloadScheduler::take() {
+    /* First request whose host has free connection */
+    for(Queue::iterator it = queue.begin(); it != queue.end(); ++it) {
+        unsigned int& connections = activeHosts[it->second->host];
+        if(connections >= _hostConnections) continue;
+
+        Request* r = it->second;
+        ++connections;
+        ++active;
+        queue.erase(it);
+        r->running = true;
+        return r;
+    }
+
+    return 0;
+}
+
+void DownloadScheduler::worker() {
+    unique_lock<std::mutex> lock(mutex);
+    for(;;) {
+        Request* r = 0;
+        while(!stopping && !(r = take()))
+            condition.wait(lock);
+        if(!r) return;
+        lock.unlock();
+
+        string data;
+        int status = downloader->download(r->url, &data);
+
+        /* After removing the request, new requests for the same tile will be
+           downloaded again, so no callback can be added after this */
+        lock.lock();
+        --activeHosts[r->host];
+        --active;
+        requests.erase(r->key);
+        lock.unlock();
+
+        /* Another request for the same host can be taken */
+        condition.notify_all();
+        finish(r, status, status == 200 ? TileData(std::move(data)) : TileData());
+        lock.lock();
+    }
+}
+
+void DownloadScheduler::finish(Request* r, int status, const TileData& data) {
+    for(vector<Callback>::const_iterator it = r->callbacks.begin(); it != r->callbacks.end(); ++it)
+        (*it)(r->key.layer, r->key.z, r->key.coords, status, data);
+
+    delete r;
+}
+
+}}
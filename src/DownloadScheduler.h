@@ -0,0 +1,203 @@
+#ifndef Kompas_Core_DownloadScheduler_h
+#define Kompas_Core_DownloadScheduler_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::DownloadScheduler
+ */
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "AbstractRasterModel.h"
+
+namespace Kompas { namespace Core {
+
+class AbstractDownloader;
+
+/**
+@brief Prioritized download scheduler
+
+Downloads tiles of @ref AbstractRasterModel::LoadableFromUrl "online models"
+on background threads with given downloader, so the transport can be
+replaced (e.g. with local HTTP server in tests).
+@code
+DownloadScheduler scheduler(&model, &downloader);
+scheduler.setViewport(12, TileArea(2210, 1385, 6, 4));
+scheduler.request("base", 12, TileCoords(2212, 1386), [](const std::string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+    // ...
+});
+@endcode
+
+Requests are not downloaded in order in which they came, but by their
+distance from the viewport set with setViewport() -- tiles of the viewport
+zoom go first, ordered by distance of their center from the viewport center,
+then tiles of neighbouring zoom levels. Requests with the same priority are
+downloaded in order in which they came. Setting new viewport cancels all
+waiting requests which are outside of it, so tiles which scrolled away don't
+take bandwidth. Without viewport, requests are downloaded in order in which
+they came.
+
+Multiple requests for the same tile are coalesced into one download. At most
+hostConnections() downloads run at once for each host, as returned by
+AbstractRasterModel::tileHost(), other requests for the same host wait, even
+if they have higher priority than requests for other hosts.
+
+Downloads which already started can't be cancelled, their callbacks are
+called when they finish. The model and downloader are accessed from multiple
+threads at once, so they must be thread-safe. The model state must not be
+changed while the scheduler exists.
+@see TileFetcher
+*/
+class CORE_EXPORT DownloadScheduler {
+    public:
+        /** @brief Status passed to callback of cancelled request */
+        static const int Cancelled = -1;
+
+        /**
+         * @brief Callback for finished request
+         *
+         * Gets layer, zoom, coordinates, HTTP status (0 if the connection
+         * failed, @ref Cancelled if the request was cancelled) and data,
+         * which are non-empty only for status 200. Called from worker thread
+         * or from the thread which cancelled the request.
+         */
+        typedef std::function<void(const std::string&, Zoom, const TileCoords&, int, const TileData&)> Callback;
+
+        /**
+         * @brief Constructor
+         * @param model             Online raster model
+         * @param downloader        Downloader
+         * @param threadCount       Count of worker threads
+         * @param hostConnections   Max count of concurrent downloads from
+         *      one host
+         */
+        DownloadScheduler(const AbstractRasterModel* model, AbstractDownloader* downloader, unsigned int threadCount = 4, unsigned int hostConnections = 2);
+
+        /**
+         * @brief Destructor
+         *
+         * Cancels all waiting requests and waits for running downloads.
+         */
+        ~DownloadScheduler();
+
+        /** @brief Max count of concurrent downloads from one host */
+        inline unsigned int hostConnections() const { return _hostConnections; }
+
+        /**
+         * @brief Set viewport
+         * @param z         Zoom level
+         * @param area      Visible tiles
+         * @param margin    Count of tiles around the area which are kept
+         *      in queue
+         *
+         * Reorders waiting requests by distance from center of the area and
+         * cancels those which are outside the area enlarged by the margin.
+         * Tiles of other zoom levels are compared with their position in
+         * given zoom level.
+         */
+        void setViewport(Zoom z, const TileArea& area, unsigned int margin = 1);
+
+        /**
+         * @brief Request tile
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @param callback  Callback
+         * @return False, if the model is not online or has no URL for the
+         *      tile. The callback is not called in that case.
+         */
+        bool request(const std::string& layer, Zoom z, const TileCoords& coords, const Callback& callback);
+
+        /**
+         * @brief Cancel request
+         * @return Whether the request was waiting and was cancelled
+         *
+         * Calls all callbacks of the request with @ref Cancelled status.
+         */
+        bool cancel(const std::string& layer, Zoom z, const TileCoords& coords);
+
+        /** @brief Cancel all waiting requests */
+        void cancelAll();
+
+        /** @brief Count of waiting requests */
+        size_t queuedCount() const;
+
+        /** @brief Count of running downloads */
+        size_t activeCount() const;
+
+    private:
+        struct Key {
+            inline Key(const std::string& layer, Zoom z, const TileCoords& coords): layer(layer), z(z), coords(coords) {}
+
+            bool operator<(const Key& other) const;
+
+            std::string layer;
+            Zoom z;
+            TileCoords coords;
+        };
+
+        struct Request;
+
+        /* Sorted by priority, lowest first, equal priorities keep insertion
+           order */
+        typedef std::multimap<std::uint64_t, Request*> Queue;
+
+        struct Request {
+            inline Request(const Key& key): key(key), running(false) {}
+
+            Key key;
+            std::string url, host;
+            std::vector<Callback> callbacks;
+            Queue::iterator position;       /* Valid only if not running */
+            bool running;
+        };
+
+        const AbstractRasterModel* model;
+        AbstractDownloader* downloader;
+        const unsigned int _hostConnections;
+
+        mutable std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping, hasViewport;
+        Zoom viewportZoom;
+        TileArea viewport;
+        unsigned int margin;
+        Queue queue;
+        std::map<Key, Request*> requests;       /* Waiting and running */
+        std::map<std::string, unsigned int> activeHosts;
+        size_t active;
+        std::vector<std::thread> threads;
+
+        /* Whether the tile is in viewport and its priority */
+        bool priority(const Key& key, std::uint64_t* priority) const;
+
+        Request* take();
+        void worker();
+        void finish(Request* request, int status, const TileData& data);
+
+        DownloadScheduler(const DownloadScheduler& other);
+        DownloadScheduler& operator=(const DownloadScheduler& other);
+};
+
+}}
+
+#endif
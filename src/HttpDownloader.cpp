@@ -0,0 +1,151 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "HttpDownloader.h"
+
+#include <cstdlib>
+#include <cctype>
+
+#include "Socket.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+namespace {
+    /* Value of header with given lowercase name (including colon) */
+    bool header(const string& response, size_t headerEnd, const string& name, string* value) {
+        for(size_t pos = response.find("\r\n")+2; pos < headerEnd; pos = response.find("\r\n", pos)+2) {
+            bool matches = pos+name.size() <= headerEnd;
+            for(size_t i = 0; i != name.size() && matches; ++i)
+                if(tolower(static_cast<unsigned char>(response[pos+i])) != name[i]) matches = false;
+            if(!matches) continue;
+
+            size_t begin = pos+name.size(), end = response.find("\r\n", pos);
+            while(begin < end && response[begin] == ' ') ++begin;
+            *value = response.substr(begin, end-begin);
+            return true;
+        }
+
+        return false;
+    }
+
+    void updateMetadata(const string& response, size_t headerEnd, int status, TileMetadata* metadata) {
+        const int64_t now = TileMetadata::now();
+        const int64_t lifetime = metadata->expires ? metadata->expires-metadata->fetched : 0;
+        if(status == 200) *metadata = TileMetadata();
+        metadata->fetched = now;
+
+        string value;
+        if(header(response, headerEnd, "etag:", &value)) metadata->etag = value;
+        if(header(response, headerEnd, "last-modified:", &value)) metadata->lastModified = value;
+
+        /* Cache-Control has precedence over Expires, invalid Expires means
+           the data are already expired */
+        bool expirationKnown = false;
+        if(header(response, headerEnd, "cache-control:", &value)) {
+            size_t maxAge = value.find("max-age=");
+            if(value.find("no-cache") != string::npos || value.find("no-store") != string::npos) {
+                metadata->expires = now;
+                expirationKnown = true;
+            } else if(maxAge != string::npos) {
+                metadata->expires = now + atol(value.c_str()+maxAge+8);
+                expirationKnown = true;
+            }
+        }
+        if(!expirationKnown && header(response, headerEnd, "expires:", &value)) {
+            int64_t expires = TileMetadata::parseHttpDate(value);
+            metadata->expires = expires ? expires : now;
+            expirationKnown = true;
+        }
+
+        /* Not modified data without expiration keep their lifetime */
+        if(!expirationKnown && status == 304 && lifetime)
+            metadata->expires = now + lifetime;
+    }
+}
+
+bool HttpDownloader::parseUrl(const string& url, string* host, unsigned short* port, string* path) {
+    static const string scheme("http://");
+    if(url.compare(0, scheme.size(), scheme) != 0) return false;
+
+    size_t pathBegin = url.find('/', scheme.size());
+    if(pathBegin == string::npos) pathBegin = url.size();
+
+    string hostPort = url.substr(scheme.size(), pathBegin-scheme.size());
+    size_t colon = hostPort.find(':');
+    *host = hostPort.substr(0, colon);
+    if(host->empty()) return false;
+
+    if(colon == string::npos)
+        *port = 80;
+    else {
+        int p = atoi(hostPort.c_str()+colon+1);
+        if(p <= 0 || p > 65535) return false;
+        *port = p;
+    }
+
+    *path = pathBegin == url.size() ? "/" : url.substr(pathBegin);
+    return true;
+}
+
+int HttpDownloader::download(const string& url, string* data, TileMetadata* metadata) {
+    string host, path;
+    unsigned short port;
+    if(!parseUrl(url, &host, &port, &path)) return 0;
+
+    Socket socket;
+    if(!socket.connect(host, port, timeout)) return 0;
+
+    string conditions;
+    if(metadata && !metadata->etag.empty())
+        conditions += "If-None-Match: " + metadata->etag + "\r\n";
+    if(metadata && !metadata->lastModified.empty())
+        conditions += "If-Modified-Since: " + metadata->lastModified + "\r\n";
+
+    if(!socket.send("GET " + path + " HTTP/1.0\r\nHost: " + host + "\r\nUser-Agent: Kompas\r\n" + conditions + "Connection: close\r\n\r\n"))
+        return 0;
+
+    /* Read whole response, the server closes the connection after it */
+    string response;
+    char buffer[16384];
+    long size;
+    while((size = socket.receive(buffer, sizeof(buffer))) > 0)
+        response.append(buffer, size);
+    if(size < 0) return 0;
+
+    /* Status line: HTTP/1.x CODE Message */
+    size_t headerEnd = response.find("\r\n\r\n");
+    if(response.compare(0, 5, "HTTP/") != 0 || headerEnd == string::npos)
+        return 0;
+    size_t space = response.find(' ');
+    if(space == string::npos || space > headerEnd) return 0;
+    int status = atoi(response.c_str()+space+1);
+
+    /* Body is everything after headers. If the server sent Content-Length
+       and the data are shorter, the transfer was interrupted. Responses
+       without body can have Content-Length of the entity they describe. */
+    string body = response.substr(headerEnd+4), contentLength;
+    const bool hasBody = status >= 200 && status != 204 && status != 304;
+    if(hasBody && header(response, headerEnd, "content-length:", &contentLength) && static_cast<size_t>(atol(contentLength.c_str())) != body.size())
+        return 0;
+
+    if(status == 200) *data = body;
+    if(metadata && (status == 200 || status == 304))
+        updateMetadata(response, headerEnd, status, metadata);
+    return status;
+}
+
+}}
@@ -0,0 +1,77 @@
+#ifndef Kompas_Core_HttpDownloader_h
+#define Kompas_Core_HttpDownloader_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::HttpDownloader
+ */
+
+#include "AbstractDownloader.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Plain HTTP downloader
+
+Downloads data from @c http:// URLs with simple HTTP/1.0 GET requests, one
+connection per request. Redirects, HTTPS and proxies are not supported.
+
+Conditional requests send validators from TileMetadata in @c If-None-Match
+and @c If-Modified-Since headers. Expiration time is taken from
+@c Cache-Control @c max-age, @c no-cache or @c no-store, if present, otherwise
+from @c Expires header. If the server answers <tt>304 Not Modified</tt>
+without any expiration, the data keep their previous lifetime.
+*/
+class CORE_EXPORT HttpDownloader: public AbstractDownloader {
+    public:
+        /**
+         * @brief Constructor
+         * @param timeout   Timeout for sending and receiving data, in
+         *      milliseconds. Establishing the connection itself isn't
+         *      limited by it, see Socket::connect().
+         */
+        inline HttpDownloader(unsigned int timeout = 30000): timeout(timeout) {}
+
+        inline int download(const std::string& url, std::string* data) {
+            return download(url, data, 0);
+        }
+
+        /**
+         * @copydoc AbstractDownloader::download(const std::string&, std::string*, TileMetadata*)
+         *
+         * If @p metadata is null, unconditional request is sent.
+         */
+        int download(const std::string& url, std::string* data, TileMetadata* metadata);
+
+        /**
+         * @brief Split URL into parts
+         * @param url       URL in form <tt>http://host[:port][/path]</tt>
+         * @param host      Where to save host name
+         * @param port      Where to save port (80, if not specified in the
+         *      URL)
+         * @param path      Where to save path (@c /, if not specified in the
+         *      URL)
+         * @return Whether the URL is valid
+         */
+        static bool parseUrl(const std::string& url, std::string* host, unsigned short* port, std::string* path);
+
+    private:
+        unsigned int timeout;
+};
+
+}}
+
+#endif
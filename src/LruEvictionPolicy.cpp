@@ -0,0 +1,81 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "LruEvictionPolicy.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+void LruEvictionPolicy::setCapacity(size_t capacity, vector<CacheKey>* evicted) {
+    _capacity = capacity;
+    shrink(evicted);
+}
+
+vector<CacheKey> LruEvictionPolicy::keys() const {
+    vector<CacheKey> k;
+    k.reserve(index.size());
+    for(Entries::const_reverse_iterator it = entries.rbegin(); it != entries.rend(); ++it)
+        k.push_back(it->first);
+
+    return k;
+}
+
+void LruEvictionPolicy::hit(const CacheKey& key) {
+    unordered_map<CacheKey, Entries::iterator>::const_iterator found = index.find(key);
+    if(found != index.end())
+        entries.splice(entries.begin(), entries, found->second);
+}
+
+void LruEvictionPolicy::insert(const CacheKey& key, size_t size, vector<CacheKey>* evicted) {
+    unordered_map<CacheKey, Entries::iterator>::const_iterator found = index.find(key);
+    if(found != index.end()) {
+        _usedSize -= found->second->second;
+        found->second->second = size;
+        entries.splice(entries.begin(), entries, found->second);
+    } else {
+        entries.push_front(make_pair(key, size));
+        index.insert(make_pair(key, entries.begin()));
+    }
+
+    _usedSize += size;
+    shrink(evicted);
+}
+
+void LruEvictionPolicy::remove(const CacheKey& key) {
+    unordered_map<CacheKey, Entries::iterator>::iterator found = index.find(key);
+    if(found == index.end()) return;
+
+    _usedSize -= found->second->second;
+    entries.erase(found->second);
+    index.erase(found);
+}
+
+void LruEvictionPolicy::clear() {
+    entries.clear();
+    index.clear();
+    _usedSize = 0;
+}
+
+void LruEvictionPolicy::shrink(vector<CacheKey>* evicted) {
+    while(_usedSize > _capacity) {
+        _usedSize -= entries.back().second;
+        index.erase(entries.back().first);
+        evicted->push_back(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+}}
@@ -0,0 +1,66 @@
+#ifndef Kompas_Core_LruEvictionPolicy_h
+#define Kompas_Core_LruEvictionPolicy_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::LruEvictionPolicy
+ */
+
+#include <list>
+#include <unordered_map>
+
+#include "AbstractEvictionPolicy.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Least recently used eviction policy
+
+Removes entries which weren't used for the longest time. Simple and fast, but
+single pass over many entries (e.g. seeding the cache with a region) flushes
+all frequently used entries from the cache.
+*/
+class CORE_EXPORT LruEvictionPolicy: public AbstractEvictionPolicy {
+    public:
+        /**
+         * @brief Constructor
+         * @param capacity  Capacity
+         */
+        inline LruEvictionPolicy(size_t capacity = 0): _capacity(capacity), _usedSize(0) {}
+
+        inline size_t capacity() const { return _capacity; }
+        void setCapacity(size_t capacity, std::vector<CacheKey>* evicted);
+        inline size_t usedSize() const { return _usedSize; }
+        std::vector<CacheKey> keys() const;
+
+        void hit(const CacheKey& key);
+        void insert(const CacheKey& key, size_t size, std::vector<CacheKey>* evicted);
+        void remove(const CacheKey& key);
+        void clear();
+
+    private:
+        typedef std::list<std::pair<CacheKey, size_t> > Entries;
+
+        size_t _capacity, _usedSize;
+        Entries entries;    /* Most recently used first */
+        std::unordered_map<CacheKey, Entries::iterator> index;
+
+        void shrink(std::vector<CacheKey>* evicted);
+};
+
+}}
+
+#endif
@@ -0,0 +1,135 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Utility/Debug.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+
+namespace Kompas { namespace Core {
+
+#ifndef _WIN32
+MappedFile::MappedFile(const string& filename, Mode mode, size_t size): _isValid(false), mode(mode), _size(0), _data(0) {
+    fd = open(filename.c_str(), mode == ReadOnly ? O_RDONLY : O_RDWR|O_CREAT, 0644);
+    if(fd == -1) {
+        Error() << "Cannot open file" << filename << "for mapping";
+        return;
+    }
+
+    /* Resize the file, if requested */
+    if(mode == ReadWrite && size != 0 && ftruncate(fd, size) != 0) {
+        Error() << "Cannot resize file" << filename << "to" << size << "bytes";
+        return;
+    }
+
+    struct stat s;
+    if(fstat(fd, &s) != 0) {
+        Error() << "Cannot get size of file" << filename;
+        return;
+    }
+    _size = s.st_size;
+
+    /* Empty file cannot be mapped, but it is still valid file */
+    if(_size == 0) {
+        _isValid = true;
+        return;
+    }
+
+    void* data = mmap(0, _size, mode == ReadOnly ? PROT_READ : PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if(data == MAP_FAILED) {
+        Error() << "Cannot map file" << filename;
+        _size = 0;
+        return;
+    }
+
+    _data = static_cast<char*>(data);
+    _isValid = true;
+}
+
+MappedFile::~MappedFile() {
+    if(_data) munmap(_data, _size);
+    if(fd != -1) close(fd);
+}
+
+bool MappedFile::flush() {
+    if(mode == ReadOnly || !_data) return false;
+    return msync(_data, _size, MS_SYNC) == 0;
+}
+#else
+MappedFile::MappedFile(const string& filename, Mode mode, size_t size): _isValid(false), mode(mode), _size(0), _data(0), file(INVALID_HANDLE_VALUE), mapping(0) {
+    file = CreateFileA(filename.c_str(), mode == ReadOnly ? GENERIC_READ : GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, 0, mode == ReadOnly ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if(file == INVALID_HANDLE_VALUE) {
+        Error() << "Cannot open file" << filename << "for mapping";
+        return;
+    }
+
+    /* Resize the file, if requested */
+    if(mode == ReadWrite && size != 0) {
+        LARGE_INTEGER s;
+        s.QuadPart = size;
+        if(!SetFilePointerEx(file, s, 0, FILE_BEGIN) || !SetEndOfFile(file)) {
+            Error() << "Cannot resize file" << filename << "to" << size << "bytes";
+            return;
+        }
+    }
+
+    LARGE_INTEGER s;
+    if(!GetFileSizeEx(file, &s)) {
+        Error() << "Cannot get size of file" << filename;
+        return;
+    }
+    _size = s.QuadPart;
+
+    /* Empty file cannot be mapped, but it is still valid file */
+    if(_size == 0) {
+        _isValid = true;
+        return;
+    }
+
+    mapping = CreateFileMappingA(file, 0, mode == ReadOnly ? PAGE_READONLY : PAGE_READWRITE, 0, 0, 0);
+    if(mapping) _data = static_cast<char*>(MapViewOfFile(mapping, mode == ReadOnly ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, 0));
+    if(!_data) {
+        Error() << "Cannot map file" << filename;
+        _size = 0;
+        return;
+    }
+
+    _isValid = true;
+}
+
+MappedFile::~MappedFile() {
+    if(_data) UnmapViewOfFile(_data);
+    if(mapping) CloseHandle(mapping);
+    if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+bool MappedFile::flush() {
+    if(mode == ReadOnly || !_data) return false;
+    return FlushViewOfFile(_data, _size) && FlushFileBuffers(file);
+}
+#endif
+
+}}
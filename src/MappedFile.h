@@ -0,0 +1,108 @@
+#ifndef Kompas_Core_MappedFile_h
+#define Kompas_Core_MappedFile_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::MappedFile
+ */
+
+#include <string>
+
+#include "utilities.h"
+
+namespace Kompas { namespace Core {
+
+/**
+ * @brief Memory-mapped file
+ *
+ * Maps whole file into memory. Read-only mapping can be safely accessed from
+ * multiple threads at once, as there is no shared file position to seek.
+ */
+class CORE_EXPORT MappedFile {
+    public:
+        /** @brief Mapping mode */
+        enum Mode {
+            ReadOnly,       /**< @brief Map existing file for reading */
+
+            /**
+             * Map file for reading and writing. If the file doesn't exist, it
+             * is created, if size is specified, the file is resized to it.
+             */
+            ReadWrite
+        };
+
+        /**
+         * @brief Constructor
+         * @param filename      File to map
+         * @param mode          Mapping mode
+         * @param size          For @ref ReadWrite mode, the file is resized
+         *      to given size before mapping. If set to 0, current file size is
+         *      used. Ignored for @ref ReadOnly mode.
+         *
+         * Success of the operation can be verified with isValid(). Mapping an
+         * empty file succeeds, but data() returns zero pointer.
+         */
+        MappedFile(const std::string& filename, Mode mode = ReadOnly, size_t size = 0);
+
+        /**
+         * @brief Destructor
+         *
+         * Unmaps the file, changes made in @ref ReadWrite mode are written back.
+         */
+        ~MappedFile();
+
+        /** @brief Whether the file was successfully mapped */
+        inline bool isValid() const { return _isValid; }
+
+        /** @brief Size of mapped data */
+        inline size_t size() const { return _size; }
+
+        /** @brief Mapped data */
+        inline const char* data() const { return _data; }
+
+        /**
+         * @brief Mapped data
+         *
+         * The data can be modified only in @ref ReadWrite mode.
+         */
+        inline char* data() { return _data; }
+
+        /**
+         * @brief Write changes back to the file
+         * @return Whether the flushing succeeded. In @ref ReadOnly mode always
+         *      returns false.
+         */
+        bool flush();
+
+    private:
+        bool _isValid;
+        Mode mode;
+        size_t _size;
+        char* _data;
+
+        #ifdef _WIN32
+        void *file, *mapping;
+        #else
+        int fd;
+        #endif
+
+        MappedFile(const MappedFile& other);
+        MappedFile& operator=(const MappedFile& other);
+};
+
+}}
+
+#endif
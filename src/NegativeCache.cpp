@@ -0,0 +1,99 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "NegativeCache.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+namespace {
+    const size_t CacheLine = 64;
+}
+
+NegativeCache::NegativeCache(size_t capacity, unsigned int timeToLive): _timeToLive(timeToLive), epoch(chrono::steady_clock::now()) {
+    size_t buckets = 1;
+    while(buckets*BucketSize < capacity) buckets <<= 1;
+    mask = buckets-1;
+
+    /* Allocate one more cache line, so the table can be aligned */
+    const size_t size = buckets*BucketSize + CacheLine/sizeof(uint64_t);
+    storage.reset(new atomic<uint64_t>[size]);
+    table = reinterpret_cast<atomic<uint64_t>*>((reinterpret_cast<size_t>(storage.get())+CacheLine-1)/CacheLine*CacheLine);
+    clear();
+}
+
+bool NegativeCache::contains(const CacheKey& key) const {
+    const uint32_t t = tag(key), time = now();
+    const atomic<uint64_t>* b = bucket(key);
+    for(size_t i = 0; i != BucketSize; ++i) {
+        const uint64_t entry = b[i].load(memory_order_relaxed);
+        if(tag(entry) == t && expiration(entry) > time) return true;
+    }
+
+    return false;
+}
+
+void NegativeCache::insert(const CacheKey& key, unsigned int timeToLive) {
+    const uint32_t t = tag(key);
+    const uint64_t entry = uint64_t(t) << 32 | (now() + (timeToLive ? timeToLive : _timeToLive));
+
+    /* Replace the same key or entry which expires first. Concurrent insert
+       into the same bucket can overwrite it, which only causes another
+       lookup of the data. */
+    atomic<uint64_t>* b = bucket(key);
+    atomic<uint64_t>* replaced = b;
+    for(size_t i = 0; i != BucketSize; ++i) {
+        const uint64_t e = b[i].load(memory_order_relaxed);
+        if(tag(e) == t) {
+            replaced = b+i;
+            break;
+        }
+
+        if(expiration(e) < expiration(replaced->load(memory_order_relaxed)))
+            replaced = b+i;
+    }
+
+    replaced->store(entry, memory_order_relaxed);
+}
+
+void NegativeCache::remove(const CacheKey& key) {
+    const uint32_t t = tag(key);
+    atomic<uint64_t>* b = bucket(key);
+    for(size_t i = 0; i != BucketSize; ++i) {
+        uint64_t e = b[i].load(memory_order_relaxed);
+        if(tag(e) == t) b[i].compare_exchange_strong(e, 0, memory_order_relaxed);
+    }
+}
+
+void NegativeCache::clear() {
+    for(size_t i = 0; i != capacity(); ++i)
+        table[i].store(0, memory_order_relaxed);
+}
+
+size_t NegativeCache::count() const {
+    const uint32_t time = now();
+    size_t count = 0;
+    for(size_t i = 0; i != capacity(); ++i)
+        if(expiration(table[i].load(memory_order_relaxed)) > time) ++count;
+
+    return count;
+}
+
+uint32_t NegativeCache::now() const {
+    return chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now()-epoch).count()+1;
+}
+
+}}
@@ -0,0 +1,127 @@
+#ifndef Kompas_Core_NegativeCache_h
+#define Kompas_Core_NegativeCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::NegativeCache
+ */
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+#include "CacheKey.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Cache of missing data
+
+Remembers keys of data which don't exist anywhere (e.g. tiles of sea areas
+which are in no package and the server returns 404 for them), so they aren't
+looked up again until their time to live expires.
+
+Each entry has only 64 bits -- upper half of key hash and expiration time in
+seconds. The table is divided into buckets of eight entries, which fit into
+one cache line, and each key can be only in one bucket, so lookup is one
+memory access. When the bucket is full, entry which expires first is
+replaced. Two keys with the same bucket and the same upper half of hash are
+considered equal, which can happen with probability about one to 2^29 for
+full table.
+
+The entries are accessed atomically, so the cache can be used from multiple
+threads at once without locking. setTimeToLive() must not be called while
+the cache is being accessed.
+@see AbstractCache::isRasterTileMissing()
+*/
+class CORE_EXPORT NegativeCache {
+    public:
+        /**
+         * @brief Constructor
+         * @param capacity      Max count of entries, rounded up to power of
+         *      two. At least one bucket is always allocated.
+         * @param timeToLive    Default time to live in seconds
+         */
+        NegativeCache(size_t capacity = 4096, unsigned int timeToLive = 3600);
+
+        /** @brief Max count of entries */
+        inline size_t capacity() const { return (mask+1)*BucketSize; }
+
+        /** @brief Default time to live in seconds */
+        inline unsigned int timeToLive() const { return _timeToLive; }
+
+        /** @brief Set default time to live in seconds */
+        inline void setTimeToLive(unsigned int seconds) { _timeToLive = seconds; }
+
+        /**
+         * @brief Whether the data are known to be missing
+         *
+         * Returns true if the key was inserted and its time to live didn't
+         * expire yet.
+         */
+        bool contains(const CacheKey& key) const;
+
+        /**
+         * @brief Remember missing data
+         * @param key           Key
+         * @param timeToLive    Time to live in seconds, if zero, default time
+         *      to live is used
+         *
+         * If the key is already present, its expiration time is updated.
+         */
+        void insert(const CacheKey& key, unsigned int timeToLive = 0);
+
+        /**
+         * @brief Forget missing data
+         *
+         * Should be called when the data appear, e.g. when they are saved to
+         * cache.
+         */
+        void remove(const CacheKey& key);
+
+        /** @brief Remove all entries */
+        void clear();
+
+        /** @brief Count of entries which didn't expire yet */
+        size_t count() const;
+
+    private:
+        static const size_t BucketSize = 8;
+
+        size_t mask;
+        unsigned int _timeToLive;
+        std::chrono::steady_clock::time_point epoch;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> storage;
+        std::atomic<std::uint64_t>* table;  /* Aligned to cache line */
+
+        /* Entry is tag in upper half and expiration in lower half, empty
+           entry has zero expiration, so it's always expired */
+        static inline std::uint32_t tag(const CacheKey& key) { return key.hash() >> 32; }
+        static inline std::uint32_t tag(std::uint64_t entry) { return entry >> 32; }
+        static inline std::uint32_t expiration(std::uint64_t entry) { return entry & 0xFFFFFFFFu; }
+
+        inline std::atomic<std::uint64_t>* bucket(const CacheKey& key) const {
+            return table + (key.hash() & mask)*BucketSize;
+        }
+
+        /* Seconds since construction, starting from one */
+        std::uint32_t now() const;
+};
+
+}}
+
+#endif
@@ -0,0 +1,328 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+
+#include "CompositeCache.h"
+
+using namespace std;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(CompositeCache, Kompas::Plugins::CompositeCache,
+                "cz.mosra.Kompas.Core.AbstractCache/0.2")
+
+namespace Kompas { namespace Plugins {
+
+CompositeCache::CompositeCache(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractCache(manager, plugin), _upper(0), _lower(0), _upperHits(0), _lowerHits(0), _misses(0), _demotions(0) {}
+
+CompositeCache::~CompositeCache() {
+    finalizeCache();
+    setTiers(0, 0);
+}
+
+void CompositeCache::setTiers(AbstractCache* upper, AbstractCache* lower) {
+    if(_upper) _upper->setEvictionListener(EvictionListener());
+
+    _upper = upper;
+    _lower = lower;
+
+    if(_upper) _upper->setEvictionListener([this](const CacheKey& key, const TileData& data) {
+        demote(key, data);
+    });
+}
+
+int CompositeCache::features() const {
+    if(!_upper || !_lower) return 0;
+
+    return (_lower->features() & ~MultiUser) | (_upper->features() & _lower->features() & MultiUser);
+}
+
+bool CompositeCache::initializeCache(const string& url) {
+    if(!_upper || !_lower) return false;
+
+    bool upperInitialized = _upper->initializeCache(url);
+    bool lowerInitialized = _lower->initializeCache(url);
+    return upperInitialized && lowerInitialized;
+}
+
+void CompositeCache::finalizeCache() {
+    if(!_upper || !_lower) return;
+
+    /* Lower tier must be finalized last, so it can take demoted data */
+    _upper->finalizeCache();
+    _lower->finalizeCache();
+
+    lock_guard<mutex> lock(dirtyMutex);
+    dirty.clear();
+}
+
+size_t CompositeCache::blockSize() const {
+    return _lower ? _lower->blockSize() : 0;
+}
+
+void CompositeCache::setBlockSize(size_t size) {
+    if(_lower) _lower->setBlockSize(size);
+}
+
+size_t CompositeCache::cacheSize() const {
+    return _lower ? _lower->cacheSize() : 0;
+}
+
+void CompositeCache::setCacheSize(size_t size) {
+    if(_lower) _lower->setCacheSize(size);
+}
+
+size_t CompositeCache::usedSize() const {
+    return _lower ? _lower->usedSize() : 0;
+}
+
+void CompositeCache::purge() {
+    if(!_upper || !_lower) return;
+
+    _upper->purge();
+    _lower->purge();
+
+    lock_guard<mutex> lock(dirtyMutex);
+    dirty.clear();
+}
+
+void CompositeCache::optimize() {
+    if(!_upper || !_lower) return;
+
+    _upper->optimize();
+    _lower->optimize();
+}
+
+void CompositeCache::schedulePurge() {
+    if(!_upper || !_lower) return;
+
+    _upper->schedulePurge();
+    _lower->schedulePurge();
+}
+
+void CompositeCache::scheduleOptimize() {
+    if(!_upper || !_lower) return;
+
+    _upper->scheduleOptimize();
+    _lower->scheduleOptimize();
+}
+
+bool CompositeCache::maintain(unsigned int budget) {
+    if(!_upper || !_lower) return false;
+
+    bool upperBusy = _upper->maintain(budget/2);
+    bool lowerBusy = _lower->maintain(budget-budget/2);
+    return upperBusy || lowerBusy;
+}
+
+TileData CompositeCache::get(const CacheKey& key) {
+    if(!_upper || !_lower) return TileData();
+
+    Stripe& s = stripe(key);
+    const unsigned int generation = s.generation;
+
+    TileData data = _upper->get(key);
+    if(!data.empty()) {
+        ++_upperHits;
+        return data;
+    }
+
+    data = _lower->get(key);
+    if(data.empty()) {
+        ++_misses;
+        return data;
+    }
+
+    /* Promote the data to upper tier, if they weren't changed in the
+       meantime */
+    ++_lowerHits;
+    lock_guard<mutex> lock(s.mutex);
+    if(s.generation == generation) _upper->set(key, data);
+    return data;
+}
+
+vector<TileData> CompositeCache::get(const vector<CacheKey>& keys) {
+    if(!_upper || !_lower) return vector<TileData>(keys.size());
+
+    vector<unsigned int> generations(keys.size());
+    for(size_t i = 0; i != keys.size(); ++i)
+        generations[i] = stripe(keys[i]).generation;
+
+    vector<TileData> data = _upper->get(keys);
+
+    /* Look up the rest in lower tier */
+    vector<size_t> indices;
+    vector<CacheKey> rest;
+    for(size_t i = 0; i != keys.size(); ++i) {
+        if(!data[i].empty()) ++_upperHits;
+        else {
+            indices.push_back(i);
+            rest.push_back(keys[i]);
+        }
+    }
+    if(rest.empty()) return data;
+
+    vector<TileData> lowerData = _lower->get(rest);
+
+    /* Promote found data to upper tier */
+    vector<size_t> found;
+    for(size_t i = 0; i != rest.size(); ++i) {
+        if(lowerData[i].empty()) {
+            ++_misses;
+            continue;
+        }
+
+        ++_lowerHits;
+        data[indices[i]] = lowerData[i];
+        found.push_back(i);
+    }
+    if(found.empty()) return data;
+
+    vector<CacheKey> foundKeys;
+    foundKeys.reserve(found.size());
+    for(vector<size_t>::const_iterator it = found.begin(); it != found.end(); ++it)
+        foundKeys.push_back(rest[*it]);
+    unsigned int locked = lockStripes(foundKeys);
+
+    /* Skip data which were changed in the meantime */
+    vector<CacheKey> promotedKeys;
+    vector<TileData> promotedData;
+    for(vector<size_t>::const_iterator it = found.begin(); it != found.end(); ++it) {
+        if(stripe(rest[*it]).generation != generations[indices[*it]]) continue;
+
+        promotedKeys.push_back(rest[*it]);
+        promotedData.push_back(lowerData[*it]);
+    }
+    if(!promotedKeys.empty()) _upper->set(promotedKeys, promotedData);
+
+    unlockStripes(locked);
+    return data;
+}
+
+vector<bool> CompositeCache::contains(const vector<CacheKey>& keys) {
+    if(!_upper || !_lower) return vector<bool>(keys.size());
+
+    vector<bool> found = _upper->contains(keys);
+
+    /* Look up the rest in lower tier */
+    vector<size_t> indices;
+    vector<CacheKey> rest;
+    for(size_t i = 0; i != keys.size(); ++i) if(!found[i]) {
+        indices.push_back(i);
+        rest.push_back(keys[i]);
+    }
+    if(rest.empty()) return found;
+
+    vector<bool> lowerFound = _lower->contains(rest);
+    for(size_t i = 0; i != rest.size(); ++i)
+        found[indices[i]] = lowerFound[i];
+
+    return found;
+}
+
+bool CompositeCache::set(const CacheKey& key, const TileData& data) {
+    if(!_upper || !_lower) return false;
+
+    Stripe& s = stripe(key);
+    lock_guard<mutex> lock(s.mutex);
+    ++s.generation;
+
+    /* The data must be marked before saving, as upper tier can evict them
+       right away */
+    setDirty(key, true);
+    if(_upper->set(key, data)) return true;
+
+    setDirty(key, false);
+    return _lower->set(key, data);
+}
+
+vector<bool> CompositeCache::set(const vector<CacheKey>& keys, const vector<TileData>& data) {
+    if(!_upper || !_lower || data.size() != keys.size()) return vector<bool>(keys.size());
+
+    unsigned int locked = lockStripes(keys);
+    for(unsigned int i = 0; i != StripeCount; ++i)
+        if(locked & (1 << i)) ++stripes[i].generation;
+
+    for(vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+        setDirty(*it, true);
+    vector<bool> stored = _upper->set(keys, data);
+
+    /* Save refused data to lower tier */
+    vector<size_t> indices;
+    vector<CacheKey> restKeys;
+    vector<TileData> restData;
+    for(size_t i = 0; i != keys.size(); ++i) if(!stored[i]) {
+        setDirty(keys[i], false);
+        indices.push_back(i);
+        restKeys.push_back(keys[i]);
+        restData.push_back(data[i]);
+    }
+
+    if(!restKeys.empty()) {
+        vector<bool> lowerStored = _lower->set(restKeys, restData);
+        for(size_t i = 0; i != restKeys.size(); ++i)
+            stored[indices[i]] = lowerStored[i];
+    }
+
+    unlockStripes(locked);
+    return stored;
+}
+
+void CompositeCache::resetStatistics() {
+    _upperHits = 0;
+    _lowerHits = 0;
+    _misses = 0;
+    _demotions = 0;
+}
+
+void CompositeCache::demote(const CacheKey& key, const TileData& data) {
+    bool changed;
+    {
+        lock_guard<mutex> lock(dirtyMutex);
+        changed = dirty.erase(key) != 0;
+    }
+
+    /* Promoted data which weren't changed are already in lower tier, unless
+       it removed them in the meantime */
+    if(!changed && _lower->contains(vector<CacheKey>(1, key)).front()) return;
+
+    /* Not taking the stripe lock, as this is called from inside set() on
+       upper tier, which can hold it already */
+    if(_lower->set(key, data)) ++_demotions;
+    ++stripe(key).generation;
+}
+
+unsigned int CompositeCache::lockStripes(const vector<CacheKey>& keys) {
+    unsigned int mask = 0;
+    for(vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+        mask |= 1 << (it->hash()%StripeCount);
+
+    for(unsigned int i = 0; i != StripeCount; ++i)
+        if(mask & (1 << i)) stripes[i].mutex.lock();
+
+    return mask;
+}
+
+void CompositeCache::unlockStripes(unsigned int mask) {
+    for(unsigned int i = 0; i != StripeCount; ++i)
+        if(mask & (1 << i)) stripes[i].mutex.unlock();
+}
+
+void CompositeCache::setDirty(const CacheKey& key, bool changed) {
+    lock_guard<mutex> lock(dirtyMutex);
+    if(changed) dirty.insert(key);
+    else dirty.erase(key);
+}
+
+}}
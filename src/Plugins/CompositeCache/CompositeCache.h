@@ -0,0 +1,225 @@
+#ifndef Kompas_Plugins_CompositeCache_h
+#define Kompas_Plugins_CompositeCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::CompositeCache
+ */
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+#include "AbstractCache.h"
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief Two-tier cache
+
+Stacks two caches, usually fast and small memory cache over big and slow disk
+cache. The caches are set with setTiers(), they are not owned by this cache
+and must exist as long as they are set.
+@code
+MemoryCache memory;
+DiskCache disk;
+CompositeCache cache;
+cache.setTiers(&memory, &disk);
+cache.initializeCache("/path/to/cache");
+@endcode
+
+- New data are saved to upper tier. If the upper tier refuses them, they are
+  saved directly to lower tier.
+- Data are looked up in upper tier first. Data found only in lower tier are
+  promoted, i.e. copied to upper tier.
+- Data evicted from upper tier (see
+  Core::AbstractCache::setEvictionListener()) are demoted, i.e. saved to lower
+  tier instead of being lost. That includes data which are dropped when the
+  upper tier is finalized, so no data are lost with memory cache over disk
+  cache. Keys of data saved to upper tier are remembered, so promoted data
+  which weren't changed aren't saved again, unless lower tier removed them in
+  the meantime.
+
+Cache size, block size and used size are those of lower tier, size of upper
+tier must be configured directly on it. Hits in each tier are counted, see
+upperHits(), lowerHits() and misses().
+
+The cache can be accessed from multiple threads at once, if both tiers can.
+setTiers() must not be called while the cache is being accessed.
+*/
+class CORE_EXPORT CompositeCache: public Core::AbstractCache {
+    public:
+        /** @copydoc Core::AbstractCache::AbstractCache */
+        CompositeCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        /**
+         * @brief Destructor
+         *
+         * Finalizes the cache and removes eviction listener from upper tier.
+         */
+        ~CompositeCache();
+
+        /** @brief Upper tier */
+        inline Core::AbstractCache* upper() const { return _upper; }
+
+        /** @brief Lower tier */
+        inline Core::AbstractCache* lower() const { return _lower; }
+
+        /**
+         * @brief Set cache tiers
+         * @param upper     Upper (fast) tier
+         * @param lower     Lower (big) tier
+         *
+         * Both tiers must be set, otherwise the cache doesn't store anything.
+         * Replaces eviction listener of upper tier, eviction listener of
+         * previous upper tier is removed.
+         */
+        void setTiers(Core::AbstractCache* upper, Core::AbstractCache* lower);
+
+        /**
+         * @brief Features
+         *
+         * Features of lower tier, @ref MultiUser only if both tiers support
+         * it.
+         */
+        int features() const;
+
+        /**
+         * @brief Initialize cache
+         *
+         * Initializes both tiers with given URL.
+         */
+        bool initializeCache(const std::string& url);
+
+        /**
+         * @brief Finalize cache
+         *
+         * Finalizes upper tier (so its data are demoted) and then lower tier.
+         */
+        void finalizeCache();
+
+        size_t blockSize() const;
+        void setBlockSize(size_t size);
+        size_t cacheSize() const;
+        void setCacheSize(size_t size);
+        size_t usedSize() const;
+
+        /**
+         * @brief Purge both tiers
+         *
+         * Also forgets which data in upper tier were changed.
+         */
+        void purge();
+
+        /** @brief Optimize both tiers */
+        void optimize();
+
+        /** @brief Schedule incremental purge of both tiers */
+        void schedulePurge();
+
+        /** @brief Schedule incremental optimization of both tiers */
+        void scheduleOptimize();
+
+        /**
+         * @brief Do part of maintenance of both tiers
+         *
+         * Each tier gets half of the budget.
+         */
+        bool maintain(unsigned int budget);
+
+        Core::TileData get(const Core::CacheKey& key);
+
+        /**
+         * @brief Get multiple data from cache
+         *
+         * Keys which aren't in upper tier are looked up in lower tier with
+         * one call, data found there are promoted with one call.
+         */
+        std::vector<Core::TileData> get(const std::vector<Core::CacheKey>& keys);
+
+        bool set(const Core::CacheKey& key, const Core::TileData& data);
+
+        /**
+         * @brief Save multiple data to cache
+         *
+         * Data which upper tier refused are saved to lower tier with one
+         * call.
+         */
+        std::vector<bool> set(const std::vector<Core::CacheKey>& keys, const std::vector<Core::TileData>& data);
+
+        /**
+         * @brief Check presence of multiple data
+         *
+         * Keys which aren't in upper tier are looked up in lower tier. The
+         * data are not promoted.
+         */
+        std::vector<bool> contains(const std::vector<Core::CacheKey>& keys);
+
+        /** @brief Count of data found in upper tier */
+        inline unsigned long long upperHits() const { return _upperHits; }
+
+        /** @brief Count of data found in lower tier */
+        inline unsigned long long lowerHits() const { return _lowerHits; }
+
+        /** @brief Count of data not found in any tier */
+        inline unsigned long long misses() const { return _misses; }
+
+        /** @brief Count of data demoted to lower tier */
+        inline unsigned long long demotions() const { return _demotions; }
+
+        /** @brief Reset hit counters */
+        void resetStatistics();
+
+    private:
+        /* Serializes saving and promotion of keys. Generation is increased
+           on every save and demotion, promotion is done only if it didn't
+           change since the lookup began, so older data from lower tier
+           never replace newer ones. */
+        struct Stripe {
+            inline Stripe(): generation(0) {}
+
+            std::mutex mutex;
+            std::atomic<unsigned int> generation;
+        };
+
+        static const unsigned int StripeCount = 16;
+
+        Core::AbstractCache *_upper, *_lower;
+        std::atomic<unsigned long long> _upperHits, _lowerHits, _misses, _demotions;
+        Stripe stripes[StripeCount];
+
+        /* Keys of data in upper tier which aren't saved to lower tier */
+        std::mutex dirtyMutex;
+        std::unordered_set<Core::CacheKey> dirty;
+
+        inline Stripe& stripe(const Core::CacheKey& key) {
+            return stripes[key.hash()%StripeCount];
+        }
+
+        /* Lock stripes of all keys in ascending order, so concurrent
+           batches can't deadlock. Returns mask of locked stripes. */
+        unsigned int lockStripes(const std::vector<Core::CacheKey>& keys);
+        void unlockStripes(unsigned int mask);
+
+        void setDirty(const Core::CacheKey& key, bool changed);
+
+        void demote(const Core::CacheKey& key, const Core::TileData& data);
+};
+
+}}
+
+#endif
@@ -0,0 +1,281 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CompositeCacheTest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <QtTest/QTest>
+
+#include "../CompositeCache.h"
+#include "MemoryCache/MemoryCache.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::CompositeCacheTest)
+
+using namespace std;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+namespace {
+    /* Saves new data through the composite cache while it is reading lower
+       tier, as if it was done by another thread */
+    class RacingCache: public MemoryCache {
+        public:
+            inline RacingCache(): cache(0) {}
+
+            CompositeCache* cache;
+
+            TileData get(const CacheKey& key) {
+                TileData data = MemoryCache::get(key);
+                if(cache) {
+                    CompositeCache* c = cache;
+                    cache = 0;
+                    c->set(key, "new");
+                }
+                return data;
+            }
+
+            /* Batch lookup is implemented through the above */
+            using MemoryCache::get;
+    };
+
+    void readWrite(CompositeCache* cache, unsigned int seed, atomic<int>* failures) {
+        for(unsigned int i = 0; i != 5000; ++i) {
+            seed = seed*1103515245 + 12345;
+            TileCoords coords((seed >> 8)%64, (seed >> 16)%64);
+            string data(coords.x*10+1, 'a'+coords.y%26);
+
+            if(i%4 == 0)
+                cache->setRasterTile("Model", "base", 8, coords, data);
+            else {
+                TileData tile = cache->rasterTile("Model", "base", 8, coords);
+                if(!tile.empty() && tile != data) ++*failures;
+            }
+        }
+    }
+}
+
+void CompositeCacheTest::noTiers() {
+    CompositeCache cache;
+    QVERIFY(!cache.initializeCache(""));
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.cacheSize() == 0);
+}
+
+void CompositeCacheTest::setGet() {
+    MemoryCache upper, lower;
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    QVERIFY(cache.initializeCache(""));
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 1)) == "");
+
+    /* New data are only in upper tier */
+    QVERIFY(upper.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(lower.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+
+    QVERIFY(cache.upperHits() == 1);
+    QVERIFY(cache.lowerHits() == 0);
+    QVERIFY(cache.misses() == 1);
+
+    cache.resetStatistics();
+    QVERIFY(cache.upperHits() == 0);
+    QVERIFY(cache.misses() == 0);
+}
+
+void CompositeCacheTest::promotion() {
+    MemoryCache upper, lower;
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Found in lower tier and copied to upper */
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.lowerHits() == 1);
+    QVERIFY(upper.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+
+    /* Next time it is found in upper tier */
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.upperHits() == 1);
+    QVERIFY(cache.lowerHits() == 1);
+}
+
+void CompositeCacheTest::promotionRace() {
+    MemoryCache upper;
+    RacingCache lower;
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    /* Old data found in lower tier don't replace the new ones */
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(1, 2), "old"));
+    lower.cache = &cache;
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "old");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "new");
+
+    /* The same for multiple data */
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(2, 1), "old"));
+    lower.cache = &cache;
+    vector<TileCoords> coords;
+    coords.push_back(TileCoords(2, 1));
+    QVERIFY(cache.rasterTiles("Model", "base", 3, coords).front() == "old");
+    QVERIFY(cache.rasterTiles("Model", "base", 3, coords).front() == "new");
+}
+
+void CompositeCacheTest::multiple() {
+    MemoryCache upper, lower;
+    upper.setCacheSize(16*1024);
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    QVERIFY(upper.setRasterTile("Model", "base", 3, TileCoords(0, 0), "upper"));
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(1, 0), "lower"));
+
+    vector<TileCoords> coords;
+    coords.push_back(TileCoords(0, 0));
+    coords.push_back(TileCoords(1, 0));
+    coords.push_back(TileCoords(2, 0));
+    vector<TileData> data = cache.rasterTiles("Model", "base", 3, coords);
+    QVERIFY(data.size() == 3);
+    QVERIFY(data[0] == "upper" && data[1] == "lower" && data[2] == "");
+    QVERIFY(cache.upperHits() == 1);
+    QVERIFY(cache.lowerHits() == 1);
+    QVERIFY(cache.misses() == 1);
+
+    /* Found data are promoted */
+    QVERIFY(upper.rasterTile("Model", "base", 3, TileCoords(1, 0)) == "lower");
+
+    /* Data too large for upper tier are saved to lower tier */
+    data.clear();
+    data.push_back(TileData("small"));
+    data.push_back(TileData(string(2048, 'x')));
+    data.push_back(TileData("small"));
+    QVERIFY(cache.setRasterTiles("Model", "overlay", 3, coords, data) == vector<bool>(3, true));
+    QVERIFY(upper.rasterTile("Model", "overlay", 3, TileCoords(1, 0)) == "");
+    QVERIFY(lower.rasterTile("Model", "overlay", 3, TileCoords(1, 0)) == data[1]);
+}
+
+void CompositeCacheTest::demotion() {
+    MemoryCache upper, lower;
+    upper.setCacheSize(64*1024);
+    lower.setCacheSize(16*1024*1024);
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    for(unsigned int i = 0; i != 1000; ++i)
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), string(1000, 'a'+i%26)));
+
+    /* Data evicted from upper tier are in lower tier */
+    QVERIFY(cache.demotions() > 0);
+    QVERIFY(lower.usedSize() == cache.demotions()*(sizeof(CacheKey)+1000));
+    for(unsigned int i = 0; i != 1000; ++i)
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(i, 0)) == string(1000, 'a'+i%26));
+    QVERIFY(cache.misses() == 0);
+    QVERIFY(cache.lowerHits() > 0);
+
+    /* Data which don't fit into upper tier are saved directly to lower */
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 1), string(8*1024, 'x')));
+    QVERIFY(upper.rasterTile("Model", "base", 5, TileCoords(0, 1)) == "");
+    QVERIFY(lower.rasterTile("Model", "base", 5, TileCoords(0, 1)) == string(8*1024, 'x'));
+}
+
+void CompositeCacheTest::cleanDemotion() {
+    MemoryCache upper, lower;
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    /* Promoted data */
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(0, 0), "clean"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(0, 0)) == "clean");
+
+    /* Promoted and then changed data */
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(1, 0), "old"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 0)) == "old");
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 0), "new"));
+
+    /* New data */
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(2, 0), "new"));
+
+    /* Promoted data which lower tier removed in the meantime */
+    QVERIFY(lower.setRasterTile("Model", "base", 3, TileCoords(3, 0), "removed"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(3, 0)) == "removed");
+    QVERIFY(!lower.setRasterTile("Model", "base", 3, TileCoords(3, 0), string(lower.cacheSize(), 'x')));
+    QVERIFY(lower.rasterTile("Model", "base", 3, TileCoords(3, 0)) == "");
+
+    /* Unchanged data aren't saved again */
+    upper.finalizeCache();
+    QVERIFY(cache.demotions() == 3);
+    QVERIFY(lower.rasterTile("Model", "base", 3, TileCoords(0, 0)) == "clean");
+    QVERIFY(lower.rasterTile("Model", "base", 3, TileCoords(1, 0)) == "new");
+    QVERIFY(lower.rasterTile("Model", "base", 3, TileCoords(2, 0)) == "new");
+    QVERIFY(lower.rasterTile("Model", "base", 3, TileCoords(3, 0)) == "removed");
+}
+
+void CompositeCacheTest::finalize() {
+    MemoryCache upper, lower;
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    size_t lowerEvicted = 0;
+    lower.setEvictionListener([&](const CacheKey&, const TileData&) { ++lowerEvicted; });
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(2, 1), "other tile"));
+
+    /* Upper tier data are demoted before lower tier is finalized */
+    cache.finalizeCache();
+    QVERIFY(cache.demotions() == 2);
+    QVERIFY(lowerEvicted == 2);
+
+    /* Removing the tiers removes eviction listener */
+    cache.setTiers(0, 0);
+    upper.initializeCache("");
+    QVERIFY(upper.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    upper.finalizeCache();
+    QVERIFY(cache.demotions() == 2);
+}
+
+void CompositeCacheTest::threaded() {
+    MemoryCache upper, lower;
+    upper.setCacheSize(32*1024);
+    CompositeCache cache;
+    cache.setTiers(&upper, &lower);
+    cache.initializeCache("");
+
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 4; ++i)
+        threads.push_back(thread(readWrite, &cache, i, &failures));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    QVERIFY(failures == 0);
+    QVERIFY(cache.upperHits() > 0);
+    QVERIFY(cache.lowerHits() > 0);
+    QVERIFY(cache.demotions() > 0);
+}
+
+}}}
@@ -0,0 +1,579 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "DiskCache.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <chrono>
+
+#include "Utility/Directory.h"
+#include "Utility/Debug.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(DiskCache, Kompas::Plugins::DiskCache,
+                "cz.mosra.Kompas.Core.AbstractCache/0.2")
+
+namespace Kompas { namespace Plugins {
+
+namespace {
+    const char Magic[] = "KOMPASDC";
+    const uint32_t Version = 4;
+}
+
+DiskCache::DiskCache(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractCache(manager, plugin), _blockSize(4096), _cacheSize(64*1024*1024), indexFile(0), dataFile(0), header(0), table(0), next(0), cursor(0), evictThreshold(0), purging(false), optimizing(false), evicting(false) {}
+
+bool DiskCache::initializeCache(const string& url) {
+    lock_guard<std::mutex> lock(mutex);
+    close();
+    path = url;
+    return open(false);
+}
+
+void DiskCache::finalizeCache() {
+    lock_guard<std::mutex> lock(mutex);
+    close();
+    path.clear();
+}
+
+void DiskCache::setBlockSize(size_t size) {
+    lock_guard<std::mutex> lock(mutex);
+    if(size == 0 || size == _blockSize) return;
+
+    _blockSize = size;
+    if(header) {
+        close();
+        open(true);
+    }
+}
+
+void DiskCache::setCacheSize(size_t size) {
+    lock_guard<std::mutex> lock(mutex);
+    if(size == _cacheSize) return;
+
+    _cacheSize = size;
+    if(header) {
+        close();
+        open(true);
+    }
+}
+
+size_t DiskCache::usedSize() const {
+    lock_guard<std::mutex> lock(mutex);
+    if(!header) return 0;
+
+    return size_t(header->blockCount-header->freeCount)*header->blockSize;
+}
+
+void DiskCache::purge() {
+    lock_guard<std::mutex> lock(mutex);
+    if(header) reset();
+}
+
+void DiskCache::optimize() {
+    lock_guard<std::mutex> lock(mutex);
+    if(!header) return;
+
+    rehash();
+
+    /* Mark all blocks used by entries, the rest is free */
+    vector<bool> used(header->blockCount);
+    for(uint32_t i = 0; i != header->slotCount; ++i) {
+        if(table[i].hash == Empty || table[i].hash == Removed) continue;
+        for(uint32_t b = table[i].block; b != NoBlock; b = next[b])
+            used[b] = true;
+    }
+
+    /* Chain free blocks in ascending order */
+    header->freeBlock = NoBlock;
+    header->freeCount = 0;
+    for(uint32_t b = header->blockCount; b != 0; --b) {
+        if(used[b-1]) continue;
+        next[b-1] = header->freeBlock;
+        header->freeBlock = b-1;
+        ++header->freeCount;
+    }
+}
+
+void DiskCache::schedulePurge() {
+    lock_guard<std::mutex> lock(mutex);
+    if(!header || header->entryCount == 0) return;
+
+    header->purged = header->clock;
+    purging = true;
+    cursor = 0;
+}
+
+void DiskCache::scheduleOptimize() {
+    lock_guard<std::mutex> lock(mutex);
+    if(!header) return;
+
+    optimizing = true;
+    cursor = 0;
+}
+
+bool DiskCache::maintain(unsigned int budget) {
+    Evicted evicted;
+    bool more;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if(!header) return false;
+
+        const chrono::steady_clock::time_point end = chrono::steady_clock::now() + chrono::microseconds(budget);
+
+        /* Free space before it is needed */
+        if(!evicting && header->freeCount < header->blockCount/16) {
+            evictThreshold = sampleThreshold();
+            evicting = evictThreshold != 0;
+        }
+
+        for(uint32_t i = 1; purging || optimizing || evicting; ++i) {
+            /* Check the time only sometimes, it's not free */
+            if(i%256 == 0 && chrono::steady_clock::now() >= end) break;
+
+            Slot& slot = table[cursor];
+            if(slot.hash == Empty)
+                cleanRemoved(cursor);
+            else if(slot.hash != Removed) {
+                if(isPurged(slot)) remove(&slot);
+                else if(evicting && slot.used <= evictThreshold) {
+                    gather(slot, &evicted);
+                    remove(&slot);
+                    if(header->freeCount >= header->blockCount/8) evicting = false;
+                }
+            }
+
+            if(++cursor != header->slotCount) continue;
+
+            /* Whole table was checked */
+            cursor = 0;
+            header->purged = 0;
+            purging = optimizing = false;
+            if(evicting) {
+                evictThreshold = sampleThreshold();
+                evicting = evictThreshold != 0;
+            }
+        }
+
+        more = purging || optimizing || evicting;
+    }
+
+    /* Report the evicted data outside the lock */
+    report(evicted);
+
+    return more;
+}
+
+TileData DiskCache::get(const CacheKey& key) {
+    lock_guard<std::mutex> lock(mutex);
+    if(!header) return TileData();
+
+    Slot* slot = find(key, hash(key));
+    if(!slot) return TileData();
+
+    slot->used = ++header->clock;
+
+    string data(slot->dataSize, '\0');
+    if(slot->dataSize) read(slot->block, slot->dataSize, &data[0]);
+    return TileData(std::move(data));
+}
+
+vector<TileData> DiskCache::get(const vector<CacheKey>& keys) {
+    vector<TileData> data(keys.size());
+
+    lock_guard<std::mutex> lock(mutex);
+    if(!header) return data;
+
+    vector<pair<uint32_t, size_t> > order;
+    vector<Slot*> slots(keys.size());
+    order.reserve(keys.size());
+    for(size_t i = 0; i != keys.size(); ++i) {
+        slots[i] = find(keys[i], hash(keys[i]));
+        if(!slots[i]) continue;
+
+        slots[i]->used = ++header->clock;
+        order.push_back(make_pair(slots[i]->block, i));
+    }
+
+    /* Read the data ordered by their first block */
+    sort(order.begin(), order.end());
+    for(vector<pair<uint32_t, size_t> >::const_iterator it = order.begin(); it != order.end(); ++it) {
+        const Slot* slot = slots[it->second];
+        string d(slot->dataSize, '\0');
+        if(slot->dataSize) read(slot->block, slot->dataSize, &d[0]);
+        data[it->second] = TileData(std::move(d));
+    }
+
+    return data;
+}
+
+vector<bool> DiskCache::contains(const vector<CacheKey>& keys) {
+    vector<bool> found(keys.size());
+
+    lock_guard<std::mutex> lock(mutex);
+    if(!header) return found;
+
+    for(size_t i = 0; i != keys.size(); ++i)
+        found[i] = find(keys[i], hash(keys[i])) != 0;
+
+    return found;
+}
+
+bool DiskCache::set(const CacheKey& key, const TileData& data) {
+    Evicted evicted;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if(!header) return false;
+
+        /* The names must be known to be compared on next initialization */
+        if(!saveName(key.model()) || !saveName(key.layer())) return false;
+
+        /* Remove previous version. If the data would never fit, the
+           previous version isn't returned instead of them. */
+        uint64_t h = hash(key);
+        Slot* existing = find(key, h);
+        if(existing) remove(existing);
+
+        uint32_t count = blockCount(data.size());
+        if(count > header->blockCount) return false;
+
+        if(header->freeCount < count)
+            evict(count, &evicted);
+
+        /* Take the blocks from beginning of free list */
+        uint32_t first = header->freeBlock, last = first;
+        for(uint32_t i = 1; i != count; ++i)
+            last = next[last];
+        header->freeBlock = next[last];
+        header->freeCount -= count;
+        next[last] = NoBlock;
+
+        write(first, data.data(), data.size());
+
+        Slot slot;
+        slot.hash = h;
+        slot.kind = key.kind();
+        slot.model = key.model();
+        slot.layer = key.layer();
+        slot.z = key.z();
+        slot.x = key.coords().x;
+        slot.y = key.coords().y;
+        slot.block = first;
+        slot.dataSize = data.size();
+        slot.used = ++header->clock;
+        insert(slot);
+    }
+
+    /* Report the evicted data outside the lock */
+    report(evicted);
+
+    return true;
+}
+
+bool DiskCache::open(bool reset) {
+    uint32_t blockCount = _cacheSize/_blockSize;
+    if(blockCount == 0) {
+        Error() << "DiskCache: cache size" << _cacheSize << "is smaller than block size" << _blockSize;
+        return false;
+    }
+
+    /* Hash table is at most half full */
+    uint32_t slotCount = 1;
+    while(slotCount < 2*blockCount) slotCount <<= 1;
+
+    indexFile = new MappedFile(Directory::join(path, "DiskCache.index"), MappedFile::ReadWrite, sizeof(Header) + slotCount*sizeof(Slot) + blockCount*sizeof(uint32_t));
+    dataFile = new MappedFile(Directory::join(path, "DiskCache.data"), MappedFile::ReadWrite, size_t(blockCount)*_blockSize);
+    if(!indexFile->isValid() || !dataFile->isValid()) {
+        close();
+        return false;
+    }
+
+    header = reinterpret_cast<Header*>(indexFile->data());
+    table = reinterpret_cast<Slot*>(indexFile->data()+sizeof(Header));
+    next = reinterpret_cast<uint32_t*>(table+slotCount);
+
+    /* The cache wasn't closed properly, the index can be inconsistent */
+    if(!reset && header->dirty && memcmp(header->magic, Magic, sizeof(header->magic)) == 0) {
+        Warning() << "DiskCache: index in" << path << "was not closed properly, resetting it";
+        reset = true;
+    }
+
+    /* Create new index, if it doesn't exist, has different parameters, is
+       inconsistent or the names have different IDs now */
+    if(reset || memcmp(header->magic, Magic, sizeof(header->magic)) != 0 ||
+       header->version != Version || header->blockSize != _blockSize ||
+       header->blockCount != blockCount || header->slotCount != slotCount ||
+       !hasValidNames()) {
+        memcpy(header->magic, Magic, sizeof(header->magic));
+        header->version = Version;
+        header->blockSize = _blockSize;
+        header->blockCount = blockCount;
+        header->slotCount = slotCount;
+        header->purged = 0;
+        this->reset();
+    }
+
+    names.clear();
+    for(uint32_t i = 0; i != header->nameCount; ++i)
+        names.insert(header->names[i].id);
+
+    /* Mark the index as being changed before any change is made */
+    header->dirty = 1;
+    indexFile->flush();
+
+    /* Continue incremental purge */
+    cursor = 0;
+    purging = header->purged != 0;
+    optimizing = evicting = false;
+
+    return true;
+}
+
+void DiskCache::close() {
+    if(!indexFile) return;
+
+    /* The index is consistent only after all data and the index itself are
+       written */
+    if(header && dataFile->flush() && indexFile->flush()) {
+        header->dirty = 0;
+        indexFile->flush();
+    }
+
+    delete indexFile;
+    delete dataFile;
+    indexFile = dataFile = 0;
+    header = 0;
+    table = 0;
+    next = 0;
+    names.clear();
+}
+
+bool DiskCache::hasValidNames() const {
+    if(header->nameCount > NameCount) return false;
+
+    for(uint32_t i = 0; i != header->nameCount; ++i) {
+        const Name& name = header->names[i];
+        if(name.size > sizeof(name.name) ||
+           CacheKey::id(string(name.name, name.size)) != name.id)
+            return false;
+    }
+
+    return true;
+}
+
+void DiskCache::reset() {
+    memset(table, 0, header->slotCount*sizeof(Slot));
+    header->entryCount = 0;
+    header->removedCount = 0;
+    header->clock = 0;
+    header->purged = 0;
+    header->nameCount = 0;
+    names.clear();
+    purging = false;
+
+    for(uint32_t i = 0; i != header->blockCount; ++i)
+        next[i] = i+1;
+    next[header->blockCount-1] = NoBlock;
+    header->freeBlock = 0;
+    header->freeCount = header->blockCount;
+}
+
+bool DiskCache::saveName(uint32_t id) {
+    if(names.find(id) != names.end()) return true;
+
+    /* IDs which weren't given by CacheKey::id() can't be saved */
+    const string name = CacheKey::name(id);
+    if(name.empty() || name.size() > sizeof(Name().name) || header->nameCount == NameCount)
+        return false;
+
+    Name& saved = header->names[header->nameCount++];
+    saved.id = id;
+    saved.size = name.size();
+    memcpy(saved.name, name.data(), name.size());
+    names.insert(id);
+    return true;
+}
+
+DiskCache::Slot* DiskCache::find(const CacheKey& key, uint64_t h) {
+    const uint32_t mask = header->slotCount-1;
+    for(uint32_t i = h & mask; table[i].hash != Empty; i = (i+1) & mask) {
+        const Slot& s = table[i];
+        if(s.hash == h && !isPurged(s) && s.x == key.coords().x && s.y == key.coords().y &&
+           s.z == key.z() && s.layer == key.layer() && s.model == key.model() &&
+           s.kind == static_cast<uint32_t>(key.kind()))
+            return table+i;
+    }
+
+    return 0;
+}
+
+void DiskCache::insert(const Slot& slot) {
+    /* Remove deleted entries if the table is getting full */
+    if(4*(header->entryCount+header->removedCount+1) > 3*header->slotCount)
+        rehash();
+
+    const uint32_t mask = header->slotCount-1;
+    uint32_t i = slot.hash & mask;
+    while(table[i].hash != Empty && table[i].hash != Removed)
+        i = (i+1) & mask;
+
+    if(table[i].hash == Removed) --header->removedCount;
+    table[i] = slot;
+    ++header->entryCount;
+}
+
+void DiskCache::remove(Slot* slot) {
+    /* Put the blocks to beginning of free list */
+    uint32_t last = slot->block, count = 1;
+    while(next[last] != NoBlock) {
+        last = next[last];
+        ++count;
+    }
+    next[last] = header->freeBlock;
+    header->freeBlock = slot->block;
+    header->freeCount += count;
+
+    slot->hash = Removed;
+    --header->entryCount;
+    ++header->removedCount;
+}
+
+void DiskCache::evict(uint32_t blocks, Evicted* evicted) {
+    /* Free a bit more than needed, so the entries aren't sorted on every
+       insertion into full cache */
+    uint32_t target = min(header->blockCount, blocks + header->blockCount/16);
+
+    vector<pair<uint64_t, uint32_t> > entries;
+    entries.reserve(header->entryCount);
+    for(uint32_t i = 0; i != header->slotCount; ++i)
+        if(table[i].hash != Empty && table[i].hash != Removed)
+            entries.push_back(make_pair(table[i].used, i));
+    sort(entries.begin(), entries.end());
+
+    for(vector<pair<uint64_t, uint32_t> >::const_iterator it = entries.begin(); it != entries.end() && header->freeCount < target; ++it) {
+        Slot* slot = table+it->second;
+
+        /* Read the data before their blocks are reused, purged data aren't
+           reported */
+        if(evicted && !isPurged(*slot)) gather(*slot, evicted);
+
+        remove(slot);
+    }
+}
+
+void DiskCache::gather(const Slot& slot, Evicted* evicted) {
+    /* Statistics need only key and size, don't read the data for them */
+    if(!hasEvictionListener() && !hasStatistics()) return;
+
+    EvictedEntry e;
+    e.key = CacheKey(slot.kind, slot.model, slot.layer, slot.z, TileCoords(slot.x, slot.y));
+    e.size = slot.dataSize;
+    if(hasEvictionListener()) {
+        string data(slot.dataSize, '\0');
+        if(slot.dataSize) read(slot.block, slot.dataSize, &data[0]);
+        e.data = TileData(std::move(data));
+    }
+    evicted->push_back(e);
+}
+
+void DiskCache::report(const Evicted& evicted) {
+    for(Evicted::const_iterator it = evicted.begin(); it != evicted.end(); ++it) {
+        if(hasEvictionListener()) this->evicted(it->key, it->data);
+        else this->evicted(it->key, it->size);
+    }
+}
+
+void DiskCache::rehash() {
+    /* Finish incremental purge, as the purged entries could be moved to
+       slots which were already checked */
+    for(uint32_t i = 0; i != header->slotCount; ++i)
+        if(table[i].hash != Empty && table[i].hash != Removed && isPurged(table[i]))
+            remove(table+i);
+    header->purged = 0;
+    purging = false;
+
+    vector<Slot> entries;
+    entries.reserve(header->entryCount);
+    for(uint32_t i = 0; i != header->slotCount; ++i)
+        if(table[i].hash != Empty && table[i].hash != Removed)
+            entries.push_back(table[i]);
+
+    memset(table, 0, header->slotCount*sizeof(Slot));
+    header->entryCount = 0;
+    header->removedCount = 0;
+
+    const uint32_t mask = header->slotCount-1;
+    for(vector<Slot>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        uint32_t i = it->hash & mask;
+        while(table[i].hash != Empty)
+            i = (i+1) & mask;
+        table[i] = *it;
+        ++header->entryCount;
+    }
+}
+
+void DiskCache::cleanRemoved(uint32_t emptySlot) {
+    /* No entry can be found after empty slot, so removed entries before it
+       are not needed to continue the search */
+    const uint32_t mask = header->slotCount-1;
+    for(uint32_t i = (emptySlot-1) & mask; table[i].hash == Removed; i = (i-1) & mask) {
+        table[i].hash = Empty;
+        --header->removedCount;
+    }
+}
+
+uint64_t DiskCache::sampleThreshold() const {
+    /* Last use of evenly distributed sample of entries */
+    vector<uint64_t> used;
+    const uint32_t step = max(header->slotCount/1024, uint32_t(1));
+    for(uint32_t i = 0; i < header->slotCount; i += step)
+        if(table[i].hash != Empty && table[i].hash != Removed && !isPurged(table[i]))
+            used.push_back(table[i].used);
+    if(used.empty()) return 0;
+
+    /* Estimate which part of the entries must be removed to free enough
+       blocks */
+    const uint32_t usedBlocks = header->blockCount-header->freeCount;
+    if(usedBlocks == 0) return 0;
+    const double part = min(1.0, max(1.0/64, double(header->blockCount/8-min(header->freeCount, header->blockCount/8))/usedBlocks));
+
+    vector<uint64_t>::iterator nth = used.begin() + size_t(part*(used.size()-1));
+    nth_element(used.begin(), nth, used.end());
+    return *nth;
+}
+
+void DiskCache::read(uint32_t first, size_t size, char* out) {
+    for(uint32_t b = first; size; b = next[b]) {
+        size_t n = min(size, size_t(header->blockSize));
+        memcpy(out, block(b), n);
+        out += n;
+        size -= n;
+    }
+}
+
+void DiskCache::write(uint32_t first, const char* data, size_t size) {
+    for(uint32_t b = first; size; b = next[b]) {
+        size_t n = min(size, size_t(header->blockSize));
+        memcpy(block(b), data, n);
+        data += n;
+        size -= n;
+    }
+}
+
+}}
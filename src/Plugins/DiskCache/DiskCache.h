@@ -0,0 +1,261 @@
+#ifndef Kompas_Plugins_DiskCache_h
+#define Kompas_Plugins_DiskCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::DiskCache
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "AbstractCache.h"
+#include "MappedFile.h"
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief Block-based disk cache
+
+Stores the data in directory passed to initializeCache() in two files:
+
+- @c DiskCache.data is preallocated file divided into blocks of blockSize().
+  Data of each entry occupy one or more blocks, blocks of one entry and unused
+  blocks are chained together in the index.
+- @c DiskCache.index is memory-mapped index with header, open-addressing hash
+  table of entries and table of next blocks. The entries contain whole
+  Core::CacheKey, so the keys can be compared without touching the data.
+  The header contains also table of model and layer names with their IDs.
+  When the IDs given by Core::CacheKey::id() to the names differ on next
+  initialization, the index is reset.
+
+Looking up an entry is thus one probe into the mapped hash table and one read
+of the mapped data. When there aren't enough free blocks for new entry, least
+recently used entries are removed and passed to eviction listener.
+
+The cache supports incremental maintenance. schedulePurge() only marks
+existing entries as removed and maintain() then frees their blocks and cleans
+removed entries from the hash table in small steps. When free space drops
+below 1/16 of the cache size, maintain() also removes old entries until 1/8
+of the cache is free, so saving new data doesn't have to sort all entries to
+find least recently used ones. The entries are removed when their last use
+is older than estimate computed from sample of the entries, so it is only
+approximately least recently used order.
+
+Incremental optimization with scheduleOptimize() only cleans removed entries
+from the hash table. Rebuilding the list of free blocks in ascending order,
+so new data are stored in continuous blocks again, needs to know all used
+blocks at once and is done only in synchronous optimize(), which blocks the
+cache for time proportional to its size. Caches which are fragmented after
+many evictions should thus be optimized with optimize() when they aren't in
+use, e.g. on application start.
+
+Default block size is 4 kB, default cache size is 64 MB. Changing block size
+or cache size of initialized cache removes all its data. The files are in
+native endianness, so the cache can't be moved between platforms with
+different endianness.
+
+The index is marked as dirty while the cache is initialized and the mark is
+removed after all changes are written on finalizeCache(). If the application
+crashes, the index can be inconsistent, so the dirty index is thrown away on
+next initialization.
+
+Data with model or layer names longer than 56 bytes or with more than 256
+different names can't be saved.
+
+The cache can be accessed from multiple threads at once, but not from
+multiple processes.
+*/
+class CORE_EXPORT DiskCache: public Core::AbstractCache {
+    public:
+        /** @copydoc Core::AbstractCache::AbstractCache */
+        DiskCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        inline ~DiskCache() { finalizeCache(); }
+
+        inline int features() const { return BlockBased; }
+
+        bool initializeCache(const std::string& url);
+        void finalizeCache();
+
+        inline size_t blockSize() const { return _blockSize; }
+        void setBlockSize(size_t size);
+        inline size_t cacheSize() const { return _cacheSize; }
+        void setCacheSize(size_t size);
+        size_t usedSize() const;
+
+        /**
+         * @brief Purge cache
+         *
+         * Empties the index, the data file is left untouched.
+         */
+        void purge();
+
+        /**
+         * @brief Optimize cache
+         *
+         * Rebuilds the hash table without removed entries and sorts the
+         * list of free blocks, so new entries are stored in continuous blocks.
+         * The data file is left untouched.
+         */
+        void optimize();
+
+        /**
+         * @brief Schedule incremental purge
+         *
+         * Existing entries are immediately hidden, but their blocks are
+         * freed gradually in maintain() or when space for new data is
+         * needed, until then they are counted in usedSize().
+         */
+        void schedulePurge();
+
+        /**
+         * @brief Schedule incremental optimization
+         *
+         * Removed entries are cleaned from the hash table in maintain(). The
+         * list of free blocks is not rebuilt, see class documentation.
+         */
+        void scheduleOptimize();
+
+        bool maintain(unsigned int budget);
+
+        Core::TileData get(const Core::CacheKey& key);
+
+        /**
+         * @brief Get multiple data from cache
+         *
+         * All keys are looked up in the index at once and the data are then
+         * read in order of their position in the data file, so the disk
+         * seeks less.
+         */
+        std::vector<Core::TileData> get(const std::vector<Core::CacheKey>& keys);
+
+        bool set(const Core::CacheKey& key, const Core::TileData& data);
+
+        /**
+         * @brief Check presence of multiple data
+         *
+         * All keys are looked up in the index at once, no data are read and
+         * the check is not counted as use of the data.
+         */
+        std::vector<bool> contains(const std::vector<Core::CacheKey>& keys);
+
+    private:
+        static const std::uint32_t NameCount = 256;
+
+        struct Name {
+            std::uint32_t id,
+                size;
+            char name[56];
+        };
+
+        struct Header {
+            char magic[8];
+            std::uint32_t version,
+                dirty,              /* Nonzero while the index is opened */
+                blockSize,
+                blockCount,
+                slotCount,
+                entryCount,
+                removedCount,
+                freeBlock,
+                freeCount,
+                nameCount;
+            std::uint64_t clock,
+                purged;             /* Clock value of incremental purge */
+            Name names[NameCount];
+        };
+
+        struct Slot {
+            std::uint64_t hash;     /* Empty or Removed or key hash */
+            std::uint32_t kind,
+                model,
+                layer,
+                z,
+                x,
+                y,
+                block,              /* First block */
+                dataSize;
+            std::uint64_t used;     /* Clock value of last use */
+        };
+
+        /* Evicted entry, data are present only for eviction listener */
+        struct EvictedEntry {
+            Core::CacheKey key;
+            Core::TileData data;
+            size_t size;
+        };
+
+        typedef std::vector<EvictedEntry> Evicted;
+
+        static const std::uint64_t Empty = 0;
+        static const std::uint64_t Removed = 1;
+        static const std::uint32_t NoBlock = 0xFFFFFFFF;
+
+        mutable std::mutex mutex;
+        std::string path;
+        size_t _blockSize, _cacheSize;
+        Core::MappedFile *indexFile, *dataFile;
+        Header* header;
+        Slot* table;
+        std::uint32_t* next;
+        std::set<std::uint32_t> names;      /* IDs in the name table */
+
+        /* Incremental maintenance state */
+        std::uint32_t cursor;               /* Next slot to check */
+        std::uint64_t evictThreshold;       /* Entries used before are evicted */
+        bool purging, optimizing, evicting;
+
+        static inline std::uint64_t hash(const Core::CacheKey& key) {
+            /* Don't collide with special values */
+            return key.hash() < 2 ? key.hash() + 2 : key.hash();
+        }
+        inline char* block(std::uint32_t i) { return dataFile->data()+size_t(i)*header->blockSize; }
+        inline std::uint32_t blockCount(size_t size) const { return size ? (size+header->blockSize-1)/header->blockSize : 1; }
+        /* Entry hidden by incremental purge */
+        inline bool isPurged(const Slot& slot) const { return slot.used <= header->purged; }
+
+        bool open(bool reset);
+        /* Whether name IDs saved in the index are the same as current */
+        bool hasValidNames() const;
+        void close();
+        void reset();
+
+        /* Save name of given ID to the index, if it is not there yet */
+        bool saveName(std::uint32_t id);
+        Slot* find(const Core::CacheKey& key, std::uint64_t h);
+        void insert(const Slot& slot);
+        void remove(Slot* slot);
+        /* Remove least recently used entries, optionally gathering them */
+        void evict(std::uint32_t blocks, Evicted* evicted);
+        /* Gather the entry, its data are read only for eviction listener */
+        void gather(const Slot& slot, Evicted* evicted);
+        /* Report gathered entries, to be called outside of the lock */
+        void report(const Evicted& evicted);
+        void rehash();
+        /* Turn removed entries before empty slot to empty */
+        void cleanRemoved(std::uint32_t emptySlot);
+        std::uint64_t sampleThreshold() const;
+
+        void read(std::uint32_t first, size_t size, char* out);
+        void write(std::uint32_t first, const char* data, size_t size);
+};
+
+}}
+
+#endif
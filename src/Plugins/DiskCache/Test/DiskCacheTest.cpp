@@ -0,0 +1,446 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "DiskCacheTest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <QtCore/QDir>
+#include <QtTest/QTest>
+
+#include "Utility/Directory.h"
+#include "MappedFile.h"
+#include "../DiskCache.h"
+#include "testConfigure.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::DiskCacheTest)
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+namespace {
+    void readWrite(DiskCache* cache, unsigned int seed, atomic<int>* failures) {
+        for(unsigned int i = 0; i != 2000; ++i) {
+            seed = seed*1103515245 + 12345;
+            TileCoords coords((seed >> 8)%32, (seed >> 16)%32);
+
+            /* Data size and content depends on coordinates, so they can be
+               verified */
+            string data(coords.x*100+1, 'a'+coords.y%26);
+            if(i%4 == 0)
+                cache->setRasterTile("Model", "base", 8, coords, data);
+            else {
+                TileData tile = cache->rasterTile("Model", "base", 8, coords);
+                if(!tile.empty() && tile != data) ++*failures;
+            }
+        }
+    }
+}
+
+DiskCacheTest::DiskCacheTest(QObject* parent): QObject(parent) {
+    QDir dir;
+    dir.mkpath(DISKCACHE_WRITE_TEST_DIR);
+}
+
+void DiskCacheTest::init() {
+    QFile::remove(QString::fromStdString(Directory::join(DISKCACHE_WRITE_TEST_DIR, "DiskCache.index")));
+    QFile::remove(QString::fromStdString(Directory::join(DISKCACHE_WRITE_TEST_DIR, "DiskCache.data")));
+}
+
+void DiskCacheTest::uninitialized() {
+    DiskCache cache;
+    QVERIFY(!cache.setRasterTile("Model", "base", 0, TileCoords(0, 0), "data"));
+    QVERIFY(cache.rasterTile("Model", "base", 0, TileCoords(0, 0)) == "");
+    QVERIFY(cache.usedSize() == 0);
+
+    /* Nonexistent directory */
+    QVERIFY(!cache.initializeCache(Directory::join(DISKCACHE_WRITE_TEST_DIR, "nonexistent/")));
+}
+
+void DiskCacheTest::setGet() {
+    DiskCache cache;
+    QVERIFY(cache.features() & AbstractCache::BlockBased);
+    QVERIFY(cache.initializeCache(DISKCACHE_WRITE_TEST_DIR));
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "overlay", 3, TileCoords(1, 2), "overlay tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "overlay", 3, TileCoords(1, 2)) == "overlay tile");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 1)) == "");
+    QVERIFY(cache.rasterTile("Other", "base", 3, TileCoords(1, 2)) == "");
+
+    /* Every tile occupies one block */
+    QVERIFY(cache.usedSize() == 2*cache.blockSize());
+}
+
+void DiskCacheTest::contains() {
+    DiskCache cache;
+    QVERIFY(cache.contains(vector<CacheKey>(1)) == vector<bool>(1, false));
+    QVERIFY(cache.initializeCache(DISKCACHE_WRITE_TEST_DIR));
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(3, 4), "tile"));
+
+    vector<CacheKey> keys;
+    keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 3, TileCoords(1, 2)));
+    keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 3, TileCoords(2, 1)));
+    keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 3, TileCoords(3, 4)));
+    vector<bool> found = cache.contains(keys);
+    QVERIFY(found.size() == 3);
+    QVERIFY(found[0] && !found[1] && found[2]);
+}
+
+void DiskCacheTest::multiple() {
+    DiskCache cache;
+    QVERIFY(cache.initializeCache(DISKCACHE_WRITE_TEST_DIR));
+
+    /* Data over more blocks are saved in reverse order */
+    vector<TileCoords> coords;
+    vector<TileData> data;
+    for(unsigned int x = 0; x != 20; ++x) {
+        coords.push_back(TileCoords(19-x, 0));
+        data.push_back(string((19-x)*100+1, 'a'+x));
+    }
+    QVERIFY(cache.setRasterTiles("Model", "base", 5, coords, data) == vector<bool>(20, true));
+
+    /* Every other tile is missing */
+    vector<TileCoords> lookup;
+    for(unsigned int x = 0; x != 40; ++x)
+        lookup.push_back(TileCoords(x/2 + (x%2)*100, 0));
+    vector<TileData> found = cache.rasterTiles("Model", "base", 5, lookup);
+    QVERIFY(found.size() == 40);
+    for(unsigned int x = 0; x != 40; ++x)
+        QVERIFY(found[x] == (x%2 ? TileData() : data[19-x/2]));
+
+    QVERIFY(cache.rasterTiles("Model", "base", 5, vector<TileCoords>()).empty());
+
+    /* Less data than coordinates are not saved at all */
+    vector<TileCoords> more(3, TileCoords(200, 0));
+    more[1].x = 201;
+    more[2].x = 202;
+    QVERIFY(cache.setRasterTiles("Model", "base", 5, more, vector<TileData>(2, TileData("tile"))) == vector<bool>(3, false));
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(200, 0)) == "");
+}
+
+void DiskCacheTest::persistence() {
+    {
+        DiskCache cache;
+        cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+        QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    } {
+        DiskCache cache;
+        cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+        QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+        QVERIFY(cache.usedSize() == cache.blockSize());
+    }
+
+    /* Different parameters throw the data away */
+    DiskCache cache;
+    cache.setCacheSize(1024*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void DiskCacheTest::dirtyIndex() {
+    {
+        DiskCache cache;
+        cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+        QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    }
+
+    /* Properly closed index has the dirty flag (after magic and version)
+       cleared, simulate a crash by setting it */
+    {
+        MappedFile index(Directory::join(DISKCACHE_WRITE_TEST_DIR, "DiskCache.index"), MappedFile::ReadWrite);
+        QVERIFY(index.isValid());
+        QVERIFY(index.data()[12] == 0);
+        index.data()[12] = 1;
+    }
+
+    /* The index is thrown away */
+    DiskCache cache;
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void DiskCacheTest::names() {
+    {
+        DiskCache cache;
+        cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+        QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+        /* IDs without name can't be saved */
+        QVERIFY(!cache.set(CacheKey(AbstractCache::RasterTile, 0xdeadbeef, CacheKey::id("base"), 3, TileCoords(1, 2)), TileData("tile")));
+    }
+
+    /* Simulate process which gave the ID of "Model" to another name by
+       changing the first name in the table after 64-byte header */
+    {
+        MappedFile index(Directory::join(DISKCACHE_WRITE_TEST_DIR, "DiskCache.index"), MappedFile::ReadWrite);
+        QVERIFY(index.isValid());
+        QVERIFY(string(index.data()+72, 5) == "Model");
+        index.data()[76] = 'm';
+    }
+
+    /* The IDs don't match, the index is thrown away */
+    DiskCache cache;
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void DiskCacheTest::multipleBlocks() {
+    DiskCache cache;
+    cache.setBlockSize(64);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    string data;
+    for(int i = 0; i != 1000; ++i)
+        data += char(i%256);
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), data));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(2, 2), "small"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == data);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 2)) == "small");
+}
+
+void DiskCacheTest::replace() {
+    DiskCache cache;
+    cache.setBlockSize(64);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.usedSize() == 64);
+
+    /* The old blocks are freed */
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), string(200, 'x')));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == string(200, 'x'));
+    QVERIFY(cache.usedSize() == 4*64);
+}
+
+void DiskCacheTest::eviction() {
+    DiskCache cache;
+    cache.setBlockSize(1024);
+    cache.setCacheSize(64*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    /* Tile which is used all the time is not evicted */
+    const string data(1000, 'x');
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), data));
+    for(unsigned int i = 1; i != 1000; ++i) {
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == data);
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), data));
+        QVERIFY(cache.usedSize() <= cache.cacheSize());
+    }
+
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == data);
+
+    /* Old tiles are evicted */
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(1, 0)) == "");
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(999, 0)) == data);
+}
+
+void DiskCacheTest::evictionListener() {
+    DiskCache cache;
+    cache.setBlockSize(1024);
+    cache.setCacheSize(64*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    size_t evictedCount = 0;
+    bool evictedValid = true;
+    cache.setEvictionListener([&](const CacheKey& key, const TileData& data) {
+        if(key.kind() != AbstractCache::RasterTile || key.model() != CacheKey::id("Model") || data != string(1000, 'a'+key.coords().x%26))
+            evictedValid = false;
+        ++evictedCount;
+    });
+
+    for(unsigned int i = 0; i != 1000; ++i)
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), string(1000, 'a'+i%26)));
+
+    /* All tiles which don't fit are evicted */
+    QVERIFY(evictedCount == 1000-cache.usedSize()/1024);
+    QVERIFY(evictedValid);
+}
+
+void DiskCacheTest::evictionStatistics() {
+    DiskCache cache;
+    cache.setBlockSize(1024);
+    cache.setCacheSize(64*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    /* Evictions are counted also without eviction listener */
+    CacheStatistics statistics;
+    cache.setStatistics(&statistics);
+    for(unsigned int i = 0; i != 1000; ++i)
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), string(1000, 'x')));
+
+    CacheStatistics::Counters total = statistics.total();
+    QVERIFY(total.evictions == 1000-cache.usedSize()/1024);
+    QVERIFY(total.bytesEvicted == total.evictions*1000);
+}
+
+void DiskCacheTest::tooLarge() {
+    DiskCache cache;
+    cache.setBlockSize(1024);
+    cache.setCacheSize(16*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    QVERIFY(!cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), string(16*1024+1, 'x')));
+    QVERIFY(cache.usedSize() == 0);
+
+    /* Previous version is removed */
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), "tile"));
+    QVERIFY(!cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), string(16*1024+1, 'x')));
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void DiskCacheTest::blockSize() {
+    DiskCache cache;
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Changing block size removes the data */
+    cache.setBlockSize(512);
+    QVERIFY(cache.blockSize() == 512);
+    QVERIFY(cache.usedSize() == 0);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.usedSize() == 512);
+}
+
+void DiskCacheTest::purge() {
+    DiskCache cache;
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile");
+    cache.purge();
+    QVERIFY(cache.usedSize() == 0);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+
+    /* The cache is still usable */
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+}
+
+void DiskCacheTest::optimize() {
+    DiskCache cache;
+    cache.setBlockSize(64);
+    cache.setCacheSize(64*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    /* Replace tiles many times to fragment the free list and fill the hash
+       table with removed entries */
+    for(unsigned int i = 0; i != 10; ++i)
+        for(unsigned int x = 0; x != 100; ++x)
+            QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(x, 0), string(x*i%300+1, 'a'+i)));
+    size_t used = cache.usedSize();
+
+    cache.optimize();
+    QVERIFY(cache.usedSize() == used);
+    for(unsigned int x = 0; x != 100; ++x)
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(x, 0)) == string(x*9%300+1, 'a'+9));
+}
+
+void DiskCacheTest::schedulePurge() {
+    {
+        DiskCache cache;
+        cache.setBlockSize(64);
+        cache.setCacheSize(64*1024);
+        cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+        for(unsigned int x = 0; x != 100; ++x)
+            QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(x, 0), string(x+1, 'a')));
+
+        /* Purged data are not available even before maintenance */
+        cache.schedulePurge();
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(7, 0)) == "");
+
+        /* New data are not purged */
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(7, 0), "tile"));
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(7, 0)) == "tile");
+
+        /* Do only part of the work and continue after reopening */
+        QVERIFY(cache.maintain(0));
+    }
+
+    DiskCache cache;
+    cache.setBlockSize(64);
+    cache.setCacheSize(64*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(8, 0)) == "");
+
+    while(cache.maintain(0));
+    QVERIFY(cache.usedSize() == 64);
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(7, 0)) == "tile");
+}
+
+void DiskCacheTest::maintain() {
+    DiskCache cache;
+    cache.setBlockSize(1024);
+    cache.setCacheSize(64*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    /* Nothing to do */
+    QVERIFY(!cache.maintain(1000));
+
+    size_t evictedCount = 0;
+    cache.setEvictionListener([&](const CacheKey& key, const TileData& data) {
+        ++evictedCount;
+    });
+
+    /* Fill the cache, use the first tile all the time */
+    const string data(1000, 'x');
+    for(unsigned int i = 0; i != 64; ++i) {
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), data));
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == data);
+    }
+    QVERIFY(cache.usedSize() == cache.cacheSize());
+    QVERIFY(evictedCount == 0);
+
+    /* Maintenance frees eighth of the cache in advance */
+    while(cache.maintain(1000));
+    QVERIFY(cache.usedSize() <= cache.cacheSize()*7/8);
+    QVERIFY(evictedCount == 64-cache.usedSize()/1024);
+
+    /* Recently used tiles are kept */
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == data);
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(63, 0)) == data);
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(1, 0)) == "");
+}
+
+void DiskCacheTest::threaded() {
+    DiskCache cache;
+    cache.setBlockSize(512);
+    cache.setCacheSize(256*1024);
+    cache.initializeCache(DISKCACHE_WRITE_TEST_DIR);
+
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 8; ++i)
+        threads.push_back(thread(readWrite, &cache, i, &failures));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    QVERIFY(failures == 0);
+    QVERIFY(cache.usedSize() <= cache.cacheSize());
+}
+
+}}}
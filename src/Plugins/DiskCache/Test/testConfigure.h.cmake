@@ -0,0 +1 @@
+#define DISKCACHE_WRITE_TEST_DIR "${CMAKE_CURRENT_BINARY_DIR}/DiskCacheTestFiles/"
@@ -15,6 +15,17 @@
 
 #include "KompasRasterArchiveMaker.h"
 
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "Utility/Endianness.h"
 
 using namespace std;
@@ -22,28 +33,71 @@ using namespace Corrade::Utility;
 
 namespace Kompas { namespace Plugins {
 
+namespace {
+    bool truncateFile(const string& filename, unsigned int size) {
+        #ifdef _WIN32
+        int fd = _open(filename.c_str(), _O_RDWR|_O_BINARY);
+        if(fd == -1) return false;
+        bool ok = _chsize(fd, size) == 0;
+        _close(fd);
+        return ok;
+        #else
+        return truncate(filename.c_str(), size) == 0;
+        #endif
+    }
+
+    /* Flush the file from operating system buffers to disk. Streams can be
+       flushed only to the operating system, so it must be opened again. */
+    bool syncFile(const string& filename) {
+        #ifdef _WIN32
+        int fd = _open(filename.c_str(), _O_RDWR|_O_BINARY);
+        if(fd == -1) return false;
+        bool ok = _commit(fd) == 0;
+        _close(fd);
+        return ok;
+        #else
+        int fd = open(filename.c_str(), O_WRONLY);
+        if(fd == -1) return false;
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+        #endif
+    }
+
+    unsigned int number(const char* data) {
+        unsigned int buffer;
+        memcpy(&buffer, data, 4);
+        return Endianness::littleEndian(buffer);
+    }
+}
+
 KompasRasterArchiveMaker::State KompasRasterArchiveMaker::append(const std::string& data) {
     if(version != 3) return VersionError;
     if(currentEnd == total) return TotalMismatch;
 
     /* Package is already finished, return WriteError */
-    if(currentNumber != -1 && file.tellp() == -1) return WriteError;
+    if(finished || (file.is_open() && file.tellp() == -1)) return WriteError;
 
     unsigned int buffer;
     State state = Ok;
 
-    /* Open first file or next file, if size limit has been reached */
-    if(currentNumber == -1 || static_cast<unsigned int>(file.tellp()) + data.size() + (currentEnd-currentBegin+1)*4 >= sizeLimit) {
-        if(currentNumber++ != -1) finishCurrentFile();
+    /* Open first file or next file, if size limit has been reached. After
+       resuming finished file no file is opened. */
+    if(!file.is_open() || static_cast<unsigned int>(file.tellp()) + data.size() + (currentEnd-currentBegin+1)*4 >= sizeLimit) {
+        if(file.is_open() && !finishCurrentFile()) {
+            finished = true;
+            return WriteError;
+        }
 
         /* Open next file */
-        ostringstream filename;
-        filename << filePrefix;
-        if(currentNumber != 0) filename << "-" << currentNumber;
-        filename << ".kps";
-        file.open(filename.str().c_str(), ofstream::out|ofstream::trunc|ofstream::binary);
+        string name = filename(++currentNumber);
+        file.open(name.c_str(), ofstream::out|ofstream::trunc|ofstream::binary);
+        journal.open((name + ".journal").c_str(), ofstream::out|ofstream::trunc|ofstream::binary);
 
-        if(!file.good()) return FileError;
+        if(!file.good() || !journal.good()) {
+            finished = true;
+            return FileError;
+        }
 
         /* Write header */
         file.write("MAP", 3);
@@ -69,10 +123,122 @@ KompasRasterArchiveMaker::State KompasRasterArchiveMaker::append(const std::stri
 
     if(!file.good()) return WriteError;
 
+    unsynced.push_back(static_cast<unsigned int>(file.tellp()));
+    if(unsynced.size() >= _syncInterval && !sync()) return WriteError;
+
     return state;
 }
 
+KompasRasterArchiveMaker::State KompasRasterArchiveMaker::resume() {
+    if(version != 3) return VersionError;
+    if(currentNumber != -1 || finished) return WriteError;
+
+    /* Find last existing file */
+    int last = -1;
+    while(ifstream(filename(last+1).c_str()).good()) ++last;
+
+    char header[16];
+    for(; last != -1; --last) {
+        ifstream in(filename(last).c_str(), ifstream::in|ifstream::binary);
+        if(in.read(header, 16) && string(header, 4) == "MAP\3") break;
+
+        /* Saving was interrupted before the header was flushed, so there
+           are no tiles in the file */
+        remove(filename(last).c_str());
+        remove((filename(last) + ".journal").c_str());
+    }
+
+    /* Nothing to resume */
+    if(last == -1) return Ok;
+
+    if(number(header+4) != total) return TotalMismatch;
+
+    currentNumber = last;
+    string name = filename(last);
+    ifstream in((name + ".journal").c_str(), ifstream::in|ifstream::binary);
+
+    /* The file was finished, next tiles will be saved to next file */
+    if(!in.good()) {
+        currentBegin = currentEnd = number(header+12);
+        return Ok;
+    }
+
+    /* Tiles which are in the journal, incomplete entry at the end is
+       ignored */
+    vector<unsigned int> ends;
+    char buffer[4];
+    while(in.read(buffer, 4)) ends.push_back(number(buffer));
+    in.close();
+
+    currentBegin = number(header+8);
+    currentEnd = currentBegin + ends.size();
+
+    /* Positions of the tiles, the first tile is right after the header */
+    unsigned int position = Endianness::littleEndian(16u);
+    positions.write(reinterpret_cast<const char*>(&position), 4);
+    for(size_t i = 0; i+1 < ends.size(); ++i) {
+        position = Endianness::littleEndian(ends[i]);
+        positions.write(reinterpret_cast<const char*>(&position), 4);
+    }
+
+    /* Discard unsynced data */
+    const unsigned int size = ends.empty() ? 16 : ends.back();
+    if(!truncateFile(name, size) || !truncateFile(name + ".journal", ends.size()*4)) {
+        finished = true;
+        return FileError;
+    }
+
+    file.open(name.c_str(), ofstream::in|ofstream::out|ofstream::binary);
+    file.seekp(size);
+    journal.open((name + ".journal").c_str(), ofstream::out|ofstream::app|ofstream::binary);
+    if(!file.good() || !journal.good()) {
+        finished = true;
+        return FileError;
+    }
+
+    return Ok;
+}
+
+string KompasRasterArchiveMaker::filename(int number) const {
+    ostringstream filename;
+    filename << filePrefix;
+    if(number != 0) filename << "-" << number;
+    filename << ".kps";
+    return filename.str();
+}
+
+bool KompasRasterArchiveMaker::sync() {
+    if(unsynced.empty()) return true;
+
+    /* Data must be on disk before the journal refers to them, otherwise
+       the journal could survive power loss while the data don't. If
+       anything fails, the file is marked as bad, so no more tiles are
+       appended and the archive can be resumed from the last synced tile. */
+    const string name = filename(currentNumber);
+    file.flush();
+    if(!file.good() || !syncFile(name)) {
+        file.setstate(ofstream::badbit);
+        return false;
+    }
+
+    for(vector<unsigned int>::const_iterator it = unsynced.begin(); it != unsynced.end(); ++it) {
+        unsigned int buffer = Endianness::littleEndian(*it);
+        journal.write(reinterpret_cast<const char*>(&buffer), 4);
+    }
+    journal.flush();
+    if(!journal.good() || !syncFile(name + ".journal")) {
+        file.setstate(ofstream::badbit);
+        return false;
+    }
+
+    unsynced.clear();
+    return true;
+}
+
 bool KompasRasterArchiveMaker::finishCurrentFile() {
+    /* If the finishing is interrupted, the file can be resumed */
+    const bool synced = sync();
+
     unsigned int buffer = Endianness::littleEndian(static_cast<unsigned int>(file.tellp()));
 
     /* Add position after last tile to positions array */
@@ -86,13 +252,19 @@ bool KompasRasterArchiveMaker::finishCurrentFile() {
     buffer = Endianness::littleEndian(currentEnd);
     file.write(reinterpret_cast<const char*>(&buffer), 4);
 
-    bool ok = true;
+    bool ok = synced;
     if(!file.good()) ok = false;
 
     /* Close file and clear positions array */
     file.close();
     positions.str("");
 
+    /* Journal is not needed anymore, but only after the finished file is on
+       disk */
+    journal.close();
+    if(ok && !syncFile(filename(currentNumber))) ok = false;
+    if(ok) remove((filename(currentNumber) + ".journal").c_str());
+
     /* Set current begin to end of now closed file */
     currentBegin = currentEnd;
 
@@ -103,11 +275,12 @@ KompasRasterArchiveMaker::State KompasRasterArchiveMaker::finish() {
     if(version != 3) return VersionError;
 
     /* Package is already finished, return WriteError */
-    if(currentNumber != -1 && file.tellp() == -1) return WriteError;
+    if(finished || (file.is_open() && file.tellp() == -1)) return WriteError;
+    finished = true;
 
     State state = Ok;
     if(total != currentEnd) state = TotalMismatch;
-    if(currentNumber != -1 && !finishCurrentFile())
+    if(file.is_open() && !finishCurrentFile())
         state = WriteError;
 
     return state;
@@ -21,11 +21,20 @@
 
 #include <fstream>
 #include <sstream>
+#include <vector>
 
 namespace Kompas { namespace Plugins {
 
 /**
  * @brief Class for creating %Kompas raster archives
+ *
+ * While an archive file is being written, end positions of its tiles are
+ * saved also into journal file next to it (e.g. @c package/base/17.kps.journal)
+ * after every syncInterval() tiles. Both the tile data and the journal are
+ * flushed to disk, the data always first, so the journal never refers to
+ * data lost on crash of the system. The journal is removed after the file is
+ * finished and flushed to disk. If the saving is interrupted, resume() uses
+ * the journal to continue after the last synced tile.
  */
 class KompasRasterArchiveMaker {
     public:
@@ -83,7 +92,7 @@ class KompasRasterArchiveMaker {
          * @param _total        Total count of all tiles in all archive parts
          * @param _sizeLimit    Size limit of the archive (default is 2 GB).
          */
-        inline KompasRasterArchiveMaker(const std::string& _filePrefix, unsigned int _version, unsigned int _total, unsigned int _sizeLimit = 0x7FFFFFFF): version(_version), total(_total), sizeLimit(_sizeLimit), currentBegin(0), currentEnd(0), currentNumber(-1), filePrefix(_filePrefix) {}
+        inline KompasRasterArchiveMaker(const std::string& _filePrefix, unsigned int _version, unsigned int _total, unsigned int _sizeLimit = 0x7FFFFFFF): version(_version), total(_total), sizeLimit(_sizeLimit), currentBegin(0), currentEnd(0), _syncInterval(64), currentNumber(-1), finished(false), filePrefix(_filePrefix) {}
 
         /**
          * @brief Destructor
@@ -92,6 +101,31 @@ class KompasRasterArchiveMaker {
          */
         ~KompasRasterArchiveMaker() { finish(); }
 
+        /** @brief Count of tiles after which the journal is synced */
+        inline unsigned int syncInterval() const { return _syncInterval; }
+
+        /**
+         * @brief Set count of tiles after which the journal is synced
+         *
+         * Default is 64. Lower values mean less tiles to save again after
+         * interruption, but more frequent flushing.
+         */
+        inline void setSyncInterval(unsigned int interval) { _syncInterval = interval ? interval : 1; }
+
+        /**
+         * @brief Resume interrupted archive
+         * @return Saving state. Returns Ok also if there is nothing to
+         *      resume, TotalMismatch if the archive was created with different
+         *      total count of tiles.
+         *
+         * Must be called before first append(). Opens last existing archive
+         * file. If it wasn't finished, tiles in its journal are kept, data
+         * after them are discarded and next tiles are appended to the file.
+         * If it was finished, next tiles are saved to new file. Count of
+         * already saved tiles is then in tileCount().
+         */
+        State resume();
+
         /**
          * @brief Append tile to archive
          * @param data          Tile data
@@ -136,13 +170,18 @@ class KompasRasterArchiveMaker {
             total,
             sizeLimit,
             currentBegin,
-            currentEnd;
+            currentEnd,
+            _syncInterval;
         int currentNumber;
+        bool finished;              /* Finished or the file can't be opened */
         std::string filePrefix;
 
-        std::ofstream file;
+        std::ofstream file, journal;
         std::ostringstream positions;
+        std::vector<unsigned int> unsynced; /* Tile ends not in journal yet */
 
+        std::string filename(int number) const;
+        bool sync();
         bool finishCurrentFile();
 };
 
@@ -15,35 +15,37 @@
 
 #include "KompasRasterArchiveReader.h"
 
+#include <cstring>
+
 #include "Utility/Endianness.h"
 #include "Utility/Debug.h"
 
 using namespace std;
 using namespace Corrade::Utility;
+using namespace Kompas::Core;
 
 namespace Kompas { namespace Plugins {
 
-KompasRasterArchiveReader::KompasRasterArchiveReader(const string& _file): _version(0), _total(0), _begin(0), _end(0), _isValid(false) {
-    file.open(_file.c_str(), fstream::binary);
-    if(!file.is_open()) {
+KompasRasterArchiveReader::KompasRasterArchiveReader(const string& _file): _version(0), _total(0), _begin(0), _end(0), _isValid(false), file(new MappedFile(_file)) {
+    if(!file->isValid()) {
         Error() << "Cannot open Kompas archive file" << _file;
         return;
     }
 
-    /* Four bytes - enough for all integers even for signature MAP with null
-        terminator at the end */
-    char* buffer = new char[4];
+    /* Signature, version, total count, begin and end tile */
+    if(file->size() < 16) {
+        Error() << "Kompas archive" << _file << "is too short";
+        return;
+    }
 
-    /* Check file signature (\0 is automagically appended at the end) */
-    file.get(buffer, 4);
-    if(string(buffer) != "MAP") {
-        Error() << "Unknown Kompas archive signature" << buffer << "in" << _file;
+    /* Check file signature */
+    if(string(file->data(), 3) != "MAP") {
+        Error() << "Unknown Kompas archive signature" << string(file->data(), 3) << "in" << _file;
         return;
     }
 
-    /* Check file version (only version 2 is currently supported) */
-    file.read(buffer, 1);
-    _version = buffer[0];
+    /* Check file version */
+    _version = file->data()[3];
 
     if(_version != 2 && _version != 3) {
         Error() << "Unsupported Kompas archive version" << _version << "in" << _file;
@@ -56,17 +58,10 @@ KompasRasterArchiveReader::KompasRasterArchiveReader(const string& _file): _vers
     else if(_version == 3)
         endianator = Endianness::littleEndian<unsigned int>;
 
-    /* Total count of tiles */
-    file.read(buffer, 4);
-    _total = endianator(*reinterpret_cast<unsigned int*>(buffer));
-
-    /* Beginning tile */
-    file.read(buffer, 4);
-    _begin = endianator(*reinterpret_cast<unsigned int*>(buffer));
-
-    /* (One item after) ending tile */
-    file.read(buffer, 4);
-    _end = endianator(*reinterpret_cast<unsigned int*>(buffer));
+    /* Total count of tiles, beginning tile, (one item after) ending tile */
+    _total = number(4);
+    _begin = number(8);
+    _end = number(12);
 
     /* Check whether begin < end <= total */
     if(_begin >= _end || _end > _total) {
@@ -75,18 +70,21 @@ KompasRasterArchiveReader::KompasRasterArchiveReader(const string& _file): _vers
     }
 
     /* Version 2 has positions array after header */
-    if(_version == 2)
+    if(_version == 2) {
         positions = 16;
 
+        if(positions+(_end-_begin+1)*4 > file->size()) {
+            Error() << "Kompas archive tile positions array has unexpected size, expected" << (_end-_begin+1)*4 << "found" << static_cast<unsigned int>(file->size()) - positions << "in" << _file;
+            return;
+        }
+
     /* Version 3 has it at the end of the file */
-    else if(_version == 3) {
+    } else if(_version == 3) {
         /* Beginning of positions array is saved in last 4 bytes of the file */
-        file.seekg(-4, ios::end);
-        file.read(buffer, 4);
-        positions = Endianness::littleEndian(*reinterpret_cast<unsigned int*>(buffer));
+        positions = number(file->size()-4);
 
-        if(positions+(_end-_begin+1)*4 != file.tellg()) {
-            Error() << "Kompas archive tile positions array has unexpected size, expected" << (_end-_begin+1)*4 << "found" << static_cast<unsigned int>(file.tellg()) - positions << "in" << _file;
+        if(positions+(_end-_begin+1)*4 != file->size()) {
+            Error() << "Kompas archive tile positions array has unexpected size, expected" << (_end-_begin+1)*4 << "found" << static_cast<unsigned int>(file->size()) - positions << "in" << _file;
             return;
         }
     }
@@ -94,42 +92,27 @@ KompasRasterArchiveReader::KompasRasterArchiveReader(const string& _file): _vers
     _isValid = true;
 }
 
-KompasRasterArchiveReader::~KompasRasterArchiveReader() {
-    if(file.is_open()) file.close();
-}
-
-string KompasRasterArchiveReader::get(unsigned int tileNumber) {
-    /* If the archive is invalid, file is not ready or tileNumber is out of bounds, return empty data */
-    if(!isValid() || !file.good() || tileNumber < begin() || tileNumber >= end()) return "";
+KompasRasterArchiveReader::~KompasRasterArchiveReader() {}
 
-    char* buffer = new char[4];
-    unsigned int position, size;
+TileData KompasRasterArchiveReader::get(unsigned int tileNumber) const {
+    /* If the archive is invalid or tileNumber is out of bounds, return empty data */
+    if(!isValid() || tileNumber < begin() || tileNumber >= end()) return TileData();
 
-    /* Seek to information about position of the tile. Tile number is passed
+    /* Position and (one byte after) end of tile data. Tile number is passed
         as absolute, so we must make it relative to this file. */
-    file.seekg(positions+4*(tileNumber-begin()));
-
-    /* Position of tile data */
-    file.read(buffer, 4);
-    position = endianator(*reinterpret_cast<unsigned int*>(buffer));
+    unsigned int position = number(positions+4*(tileNumber-begin()));
+    unsigned int end = number(positions+4*(tileNumber-begin()+1));
 
-    /* Size of tile data */
-    file.read(buffer, 4);
-    size = endianator(*reinterpret_cast<unsigned int*>(buffer))-position;
+    /* Corrupted positions array */
+    if(position > end || end > file->size()) return TileData();
 
-    /* Prepare buffer for tile size */
-    delete[] buffer;
-    buffer = new char[size];
-
-    /* Seek to tile position and get the data */
-    file.seekg(position);
-    file.read(buffer, size);
-
-    string ret(buffer, size);
-    delete[] buffer;
-    return ret;
+    return TileData(file, file->data()+position, end-position);
+}
 
-    return "";
+unsigned int KompasRasterArchiveReader::number(size_t position) const {
+    unsigned int buffer;
+    memcpy(&buffer, file->data()+position, 4);
+    return endianator(buffer);
 }
 
 }}
@@ -19,7 +19,11 @@
  * @brief Class Kompas::Plugins::KompasRasterArchiveReader
  */
 
-#include <fstream>
+#include <string>
+#include <memory>
+
+#include "MappedFile.h"
+#include "TileData.h"
 
 namespace Kompas { namespace Plugins {
 
@@ -27,6 +31,9 @@ namespace Kompas { namespace Plugins {
  * @brief Reader for tile archives
  *
  * Supports tile archive version 2 and 3. See also @ref KompasRasterArchive.
+ * The archive is memory-mapped, so get() can be called from multiple threads
+ * at once. Returned tile data point directly into the mapped file, which is
+ * unmapped after the reader and all returned data are destroyed.
  * @todo Support for files > 4GB
  * @todo Creating from istream
  */
@@ -55,7 +62,7 @@ class KompasRasterArchiveReader {
          * @brief Constructor
          * @param _file         Archive file
          *
-         * Opens the archive file, checks file signature and version and gets
+         * Maps the archive file, checks file signature and version and gets
          * tile counts for the file. Success of this operation can be verified
          * with KompasRasterArchiveReader::isValid().
          */
@@ -64,7 +71,7 @@ class KompasRasterArchiveReader {
         /**
          * @brief Destructor
          *
-         * Closes the archive file.
+         * Unmaps the archive file, if no tile data are referencing it.
          */
         ~KompasRasterArchiveReader();
 
@@ -76,7 +83,7 @@ class KompasRasterArchiveReader {
          * Checks whether tile with that number exists in actual archive, if
          * yes, returns its data.
          */
-        std::string get(unsigned int tileNumber);
+        Core::TileData get(unsigned int tileNumber) const;
 
     private:
         int _version;
@@ -85,9 +92,11 @@ class KompasRasterArchiveReader {
             _end,
             positions;
         bool _isValid;
-        std::ifstream file;
+        std::shared_ptr<Core::MappedFile> file;
 
         unsigned int (*endianator)(unsigned int);
+
+        unsigned int number(size_t position) const;
 };
 
 }}
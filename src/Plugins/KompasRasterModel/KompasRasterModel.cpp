@@ -81,7 +81,7 @@ int KompasRasterModel::addPackage(const string& filename) {
        are not supported */
     if(!packages.empty() && !(features() & MultiplePackages)) return -1;
 
-    Configuration conf(filename);
+    Configuration conf(filename, Configuration::ReadOnly);
     if(!conf.isValid()) return -1;
     Package* p = parsePackage(&conf);
     if(!p) return -1;
@@ -157,16 +157,22 @@ int KompasRasterModel::addPackage(const string& filename) {
         _zoomLevels.insert(p->zoomLevels.begin(), p->zoomLevels.end());
     }
 
+    /* Prepare empty archive slots for all layers and overlays in all zoom
+        levels, the archives will be opened on first access */
+    for(set<Zoom>::const_iterator z = p->zoomLevels.begin(); z != p->zoomLevels.end(); ++z) {
+        for(vector<string>::const_iterator layer = p->layers.begin(); layer != p->layers.end(); ++layer)
+            p->archives[make_pair(*layer, *z)];
+        for(vector<string>::const_iterator overlay = p->overlays.begin(); overlay != p->overlays.end(); ++overlay)
+            p->archives[make_pair(*overlay, *z)];
+    }
+
     packages.push_back(p);
 
     return packages.size()-1;
 }
 
-string KompasRasterModel::tileFromPackage(const string& layer, Zoom z, const TileCoords& coords) {
-    /* Getting tiles from another zoom level, close all opened archives */
-    if(z != currentPackageZoom) closeArchives();
-
-    for(vector<Package*>::iterator package = packages.begin(); package != packages.end(); ++package) {
+TileData KompasRasterModel::tileFromPackage(const string& layer, Zoom z, const TileCoords& coords) const {
+    for(vector<Package*>::const_iterator package = packages.begin(); package != packages.end(); ++package) {
         /* If the zoom level is not in current package, go to next package */
         set<Zoom>::const_iterator foundZoom = (*package)->zoomLevels.find(z);
         if(foundZoom == (*package)->zoomLevels.end()) continue;
@@ -180,26 +186,78 @@ string KompasRasterModel::tileFromPackage(const string& layer, Zoom z, const Til
             continue;
 
         /* If the layer is not in current package, go to next package */
-        vector<string>::const_iterator foundLayer = find((*package)->layers.begin(), (*package)->layers.end(), layer);
-        if(foundLayer == (*package)->layers.end()) {
-            foundLayer = find((*package)->overlays.begin(), (*package)->overlays.end(), layer);
-            if(foundLayer == (*package)->overlays.end()) continue;
-        }
+        map<pair<string, Zoom>, ArchiveSlot>::iterator slot = (*package)->archives.find(make_pair(layer, z));
+        if(slot == (*package)->archives.end()) continue;
+
+        /* Recursively find the tile in archives */
+        return tileFromArchive(Directory::path((*package)->filename), layer, z, &slot->second.first, 0, (*package)->version, area.w*(coords.y-area.y)+(coords.x-area.x));
+    }
+
+    /* Not found in any package, return empty data */
+    return TileData();
+}
+
+vector<TileData> KompasRasterModel::tilesFromPackage(const string& layer, Zoom z, const TileArea& area) const {
+    vector<TileData> tiles(area.w*area.h);
+
+    /* Tiles which were already assigned to some package */
+    vector<bool> assigned(area.w*area.h, false);
+
+    /* Tile IDs in the package and their indices in output vector */
+    vector<pair<unsigned int, size_t> > requests;
+    requests.reserve(area.w*area.h);
+
+    for(vector<Package*>::const_iterator package = packages.begin(); package != packages.end(); ++package) {
+        /* If the zoom level is not in current package, go to next package */
+        set<Zoom>::const_iterator foundZoom = (*package)->zoomLevels.find(z);
+        if(foundZoom == (*package)->zoomLevels.end()) continue;
 
-        /* Get archive with given layer or open new */
-        map<string, vector<KompasRasterArchiveReader*> >::iterator archives = (*package)->archives.find(layer);
-        if(archives == (*package)->archives.end()) {
-            (*package)->archives.insert(make_pair(layer, vector<KompasRasterArchiveReader*>()));
+        /* If the layer is not in current package, go to next package */
+        map<pair<string, Zoom>, ArchiveSlot>::iterator slot = (*package)->archives.find(make_pair(layer, z));
+        if(slot == (*package)->archives.end()) continue;
 
-            archives = (*package)->archives.find(layer);
+        /* Multiply tile area for current zoom level */
+        TileArea packageArea = (*package)->area*pow2(z-*(*package)->zoomLevels.begin());
+
+        /* Intersection of requested area and package area */
+        unsigned int x1 = max(area.x, packageArea.x);
+        unsigned int y1 = max(area.y, packageArea.y);
+        unsigned int x2 = min(area.x+area.w, packageArea.x+packageArea.w);
+        unsigned int y2 = min(area.y+area.h, packageArea.y+packageArea.h);
+        if(x1 >= x2 || y1 >= y2) continue;
+
+        /* Assign all tiles which aren't in any previous package to this
+            package. Tile IDs are row-major in the package too, so they are
+            in ascending order, which is also the order of archives and
+            order of tile positions in each archive. */
+        requests.clear();
+        for(unsigned int y = y1; y != y2; ++y) for(unsigned int x = x1; x != x2; ++x) {
+            size_t index = (y-area.y)*area.w+(x-area.x);
+            if(assigned[index]) continue;
+
+            assigned[index] = true;
+            requests.push_back(make_pair(packageArea.w*(y-packageArea.y)+(x-packageArea.x), index));
         }
 
-        /* Recursively find the tile in archives */
-        return tileFromArchive(Directory::path((*package)->filename), layer, z, &archives->second, 0, (*package)->version, area.w*(coords.y-area.y)+(coords.x-area.x));
+        if(requests.empty()) continue;
+
+        /* Read the tiles archive after archive */
+        string path = Directory::path((*package)->filename);
+        unsigned int archiveId = 0;
+        Archive* a = openArchive(path, layer, z, &slot->second.first, archiveId, (*package)->version);
+        for(vector<pair<unsigned int, size_t> >::const_iterator it = requests.begin(); it != requests.end(); ++it) {
+            /* Go to archive containing the tile, if there is any */
+            while(a->reader->isValid() && it->first >= a->reader->end() && a->reader->end() < a->reader->total())
+                a = openArchive(path, layer, z, &a->next, ++archiveId, (*package)->version);
+
+            /* The archive is invalid, no other tile can be found */
+            if(!a->reader->isValid()) break;
+
+            tiles[it->second] = a->reader->get(it->first);
+        }
     }
 
-    /* Not found in any package, return empty string */
-    return "";
+    return tiles;
 }
 
 KompasRasterModel::Package* KompasRasterModel::parsePackage(const Configuration* conf) {
@@ -297,39 +355,39 @@ bool KompasRasterModel::setPackageAttribute(KompasRasterModel::PackageAttribute
     return true;
 }
 
+bool KompasRasterModel::resumePackage(const string& filename, const TileSize& tileSize, const vector<Zoom>& zoomLevels, const TileArea& area, const vector<string>& layers, const vector<string>& overlays) {
+    if(!initializePackage(filename, tileSize, zoomLevels, area, layers, overlays))
+        return false;
+
+    /* Archives are resumed when they are first used */
+    currentlyCreatedPackage->resume = true;
+    return true;
+}
+
+unsigned int KompasRasterModel::packagedTileCount(const string& layer, Zoom z) {
+    if(!currentlyCreatedPackage) return 0;
+
+    KompasRasterArchiveMaker* maker = archiveMaker(layer, z);
+    return maker ? maker->tileCount() : 0;
+}
+
 bool KompasRasterModel::tileToPackage(const string& layer, Zoom z, const TileCoords& coords, const string& data) {
     if(!currentlyCreatedPackage) return false;
 
-    /* Archive prefix */
-    ostringstream prefix;
-    prefix << layer << '/' << z;
-
     /* Compute total count of tiles in current zoom level */
     TileArea area = currentlyCreatedPackage->area*pow2(z-currentlyCreatedPackage->minZoom);
 
-    /* Try to find archive with that prefix, otherwise create new */
-    map<string, KompasRasterArchiveMaker*>::iterator found = currentlyCreatedPackage->archives.find(prefix.str());
-    if(found == currentlyCreatedPackage->archives.end()) {
-        /* Make directory for given layer, if not exists */
-        if(!Directory::mkpath(Directory::join(currentlyCreatedPackage->path, layer))) {
-            Error() << "Cannot create zoom level directory" << Directory::join(currentlyCreatedPackage->path, layer);
-            return false;
-        }
-
-        unsigned int total = area.w*area.h;
-        KompasRasterArchiveMaker* maker = new KompasRasterArchiveMaker(Directory::join(currentlyCreatedPackage->path, prefix.str()), 3, total);
-
-        found = currentlyCreatedPackage->archives.insert(make_pair(prefix.str(), maker)).first;
-    }
+    KompasRasterArchiveMaker* maker = archiveMaker(layer, z);
+    if(!maker) return false;
 
     /* Tile came out of order */
-    if((coords.y-area.y)*area.w+(coords.x-area.x) != found->second->tileCount()) {
-        Error() << "Tile came out of order, expected" << TileCoords(found->second->tileCount()%area.w, found->second->tileCount()/area.w) << "got" << coords-TileCoords(area.x, area.y);
+    if((coords.y-area.y)*area.w+(coords.x-area.x) != maker->tileCount()) {
+        Error() << "Tile came out of order, expected" << TileCoords(maker->tileCount()%area.w, maker->tileCount()/area.w) << "got" << coords-TileCoords(area.x, area.y);
         return false;
     }
 
     /* Append tile */
-    int ret = found->second->append(data);
+    int ret = maker->append(data);
     if(ret == KompasRasterArchiveMaker::Ok || ret == KompasRasterArchiveMaker::NextFile) return true;
 
     Debug d;
@@ -342,7 +400,7 @@ bool KompasRasterModel::tileToPackage(const string& layer, Zoom z, const TileCoo
         case KompasRasterArchiveMaker::WriteError:
             d << "Cannot write to the file."; break;
         case KompasRasterArchiveMaker::TotalMismatch:
-            d << "Tile count mismatch, file created for" << found->second->tileCount() << "and adding tile " << coords.y*area.w+coords.y; break;
+            d << "Tile count mismatch, file created for" << maker->tileCount() << "and adding tile " << coords.y*area.w+coords.y; break;
     }
 
     return false;
@@ -362,64 +420,85 @@ bool KompasRasterModel::finalizePackage() {
     return true;
 }
 
-string KompasRasterModel::tileFromArchive(const string& path, const string& layer, Zoom z, vector<KompasRasterArchiveReader*>* archives, unsigned int archiveId, int packageVersion, unsigned int tileId) {
-    /* In the archive vector could be only one invalid archive, placed at the end */
-
-    /* Try to open next archive if available, if not, return empty string */
-    if(archiveId == archives->size()) {
+KompasRasterArchiveMaker* KompasRasterModel::archiveMaker(const string& layer, Zoom z) {
+    /* Archive prefix */
+    ostringstream prefix;
+    prefix << layer << '/' << z;
 
-        /* Opening first archive or there could be another archive */
-        if(archiveId == 0 || archives->front()->total() > archives->back()->end()) {
+    /* Try to find archive with that prefix, otherwise create new */
+    map<string, KompasRasterArchiveMaker*>::iterator found = currentlyCreatedPackage->archives.find(prefix.str());
+    if(found != currentlyCreatedPackage->archives.end()) return found->second;
 
-            /* Filename is in format zoom-archiveId.map */
-            ostringstream filename;
-            filename << z;
-            if(archiveId > 0) filename << '-' << archiveId;
-            if(packageVersion < 3) filename << ".map";
-            else filename << ".kps";
+    /* Make directory for given layer, if not exists */
+    if(!Directory::mkpath(Directory::join(currentlyCreatedPackage->path, layer))) {
+        Error() << "Cannot create zoom level directory" << Directory::join(currentlyCreatedPackage->path, layer);
+        return 0;
+    }
 
-            /* If the archive is invalid, exit */
-            archives->push_back(new KompasRasterArchiveReader(Directory::join(Directory::join(path, layer), filename.str())));
-            if(!archives->back()->isValid()) return "";
+    /* Compute total count of tiles in current zoom level */
+    TileArea area = currentlyCreatedPackage->area*pow2(z-currentlyCreatedPackage->minZoom);
+    unsigned int total = area.w*area.h;
+    KompasRasterArchiveMaker* maker = new KompasRasterArchiveMaker(Directory::join(currentlyCreatedPackage->path, prefix.str()), 3, total);
 
-        } else return "";
+    if(currentlyCreatedPackage->resume && maker->resume() != KompasRasterArchiveMaker::Ok) {
+        Error() << "Cannot resume archive" << prefix.str();
+        delete maker;
+        return 0;
     }
 
-    KompasRasterArchiveReader* archive = (*archives)[archiveId];
+    currentlyCreatedPackage->archives.insert(make_pair(prefix.str(), maker));
+    return maker;
+}
+
+TileData KompasRasterModel::tileFromArchive(const string& path, const string& layer, Zoom z, atomic<Archive*>* archive, unsigned int archiveId, int packageVersion, unsigned int tileId) const {
+    Archive* a = openArchive(path, layer, z, archive, archiveId, packageVersion);
 
     /* Archive is invalid or tile is not in the package at all */
-    if(!archive->isValid() || tileId >= archive->total())
-        return "";
+    if(!a->reader->isValid() || tileId >= a->reader->total())
+        return TileData();
 
     /* Tile is in current archive, return it */
-    if(tileId >= archive->begin() && tileId < archive->end())
-        return archive->get(tileId);
+    if(tileId >= a->reader->begin() && tileId < a->reader->end())
+        return a->reader->get(tileId);
+
+    /* There isn't any next archive which could contain the tile */
+    if(tileId < a->reader->begin() || a->reader->end() >= a->reader->total())
+        return TileData();
 
     /* The tile is not in current archive, search for it in the next archive */
-    return KompasRasterModel::tileFromArchive(path, layer, z, archives, ++archiveId, packageVersion, tileId);
+    return KompasRasterModel::tileFromArchive(path, layer, z, &a->next, ++archiveId, packageVersion, tileId);
 }
 
-void KompasRasterModel::closeArchives() {
-    for(vector<Package*>::iterator package = packages.begin(); package != packages.end(); ++package) {
-        for(map<string, vector<KompasRasterArchiveReader*> >::iterator layer = (*package)->archives.begin(); layer != (*package)->archives.end(); ++layer) {
-            for(vector<KompasRasterArchiveReader*>::iterator archive = layer->second.begin(); archive != layer->second.end(); ++archive)
-                delete *archive;
-        }
+KompasRasterModel::Archive* KompasRasterModel::openArchive(const string& path, const string& layer, Zoom z, atomic<Archive*>* archive, unsigned int archiveId, int packageVersion) const {
+    Archive* a = archive->load(memory_order_acquire);
+    if(a) return a;
 
-        (*package)->archives.clear();
-    }
+    /* The archive is not opened yet. Another thread could open it in the
+        meantime, so check again after locking. Invalid archives are kept too,
+        so they aren't opened again on every access. */
+    lock_guard<mutex> lock(archiveMutex);
+
+    a = archive->load(memory_order_relaxed);
+    if(a) return a;
+
+    /* Filename is in format zoom-archiveId.map */
+    ostringstream filename;
+    filename << z;
+    if(archiveId > 0) filename << '-' << archiveId;
+    if(packageVersion < 3) filename << ".map";
+    else filename << ".kps";
+
+    a = new Archive(new KompasRasterArchiveReader(Directory::join(Directory::join(path, layer), filename.str())));
+    archive->store(a, memory_order_release);
+    return a;
 }
 
 void KompasRasterModel::closePackages() {
-    for(vector<Package*>::iterator package = packages.begin(); package != packages.end(); ++package) {
-        for(map<string, vector<KompasRasterArchiveReader*> >::iterator layer = (*package)->archives.begin(); layer != (*package)->archives.end(); ++layer) {
-            for(vector<KompasRasterArchiveReader*>::iterator archive = layer->second.begin(); archive != layer->second.end(); ++archive)
-                delete *archive;
-        }
-
-        (*package)->archives.clear();
+    /* Archives are closed in package destructor */
+    for(vector<Package*>::iterator package = packages.begin(); package != packages.end(); ++package)
         delete *package;
-    }
+
+    packages.clear();
 }
 
 }}
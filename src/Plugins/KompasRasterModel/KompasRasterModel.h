@@ -19,6 +19,10 @@
  * @brief Class Kompas::Plugins::KompasRasterModel
  */
 
+#include <map>
+#include <atomic>
+#include <mutex>
+
 #include "AbstractRasterModel.h"
 
 #include "KompasRasterArchiveReader.h"
@@ -30,18 +34,22 @@ namespace Kompas { namespace Plugins {
  * @brief %Kompas raster model
  *
  * Built-in format for storing offline maps.
+ *
+ * Tile archives are opened on first access and kept opened until the model is
+ * destroyed. Opening is the only operation guarded by a lock, so tiles can be
+ * read from multiple threads at once without any locking overhead.
  * @todo Document subclassing
  */
 class CORE_EXPORT KompasRasterModel: public Core::AbstractRasterModel {
     public:
         /** @copydoc Core::AbstractRasterModel::AbstractRasterModel */
-        inline KompasRasterModel(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = ""): AbstractRasterModel(manager, plugin), currentPackageZoom(0), currentlyCreatedPackage(0) {
+        inline KompasRasterModel(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = ""): AbstractRasterModel(manager, plugin), currentlyCreatedPackage(0) {
             extensions.push_back("*.conf");
         }
 
         virtual ~KompasRasterModel();
 
-        inline int features() const { return WriteableFormat|SequentialFormat|MultipleFileFormat|SelfRecognizable; }
+        inline int features() const { return WriteableFormat|SequentialFormat|ResumableFormat|MultipleFileFormat|SelfRecognizable; }
         inline std::vector<std::string> fileExtensions() const { return extensions; }
         SupportLevel recognizeFile(const std::string& filename, std::istream& file) const;
         inline Core::TileSize tileSize() const { return _tileSize; }
@@ -60,18 +68,74 @@ class CORE_EXPORT KompasRasterModel: public Core::AbstractRasterModel {
         int addPackage(const std::string& filename);
         inline int packageCount() const { return packages.size(); }
         std::string packageAttribute(int package, PackageAttribute type) const;
-        std::string tileFromPackage(const std::string& layer, Core::Zoom z, const Core::TileCoords& coords);
+        Core::TileData tileFromPackage(const std::string& layer, Core::Zoom z, const Core::TileCoords& coords) const;
+
+        /**
+         * @copydoc Core::AbstractRasterModel::tilesFromPackage()
+         *
+         * Tiles are assigned to packages in one pass and then read from every
+         * package sequentially, archive after archive in order of tile
+         * positions in the archive.
+         */
+        std::vector<Core::TileData> tilesFromPackage(const std::string& layer, Core::Zoom z, const Core::TileArea& area) const;
 
         bool initializePackage(const std::string& filename, const Core::TileSize& tileSize, const std::vector<Core::Zoom>& zoomLevels, const Core::TileArea& area, const std::vector< std::string>& layers, const std::vector<std::string>& overlays);
+
+        /**
+         * @copydoc Core::AbstractRasterModel::resumePackage()
+         *
+         * Package configuration file is written again in finalizePackage(),
+         * archives are resumed with KompasRasterArchiveMaker::resume().
+         */
+        bool resumePackage(const std::string& filename, const Core::TileSize& tileSize, const std::vector<Core::Zoom>& zoomLevels, const Core::TileArea& area, const std::vector< std::string>& layers, const std::vector<std::string>& overlays);
+
+        unsigned int packagedTileCount(const std::string& layer, Core::Zoom z);
         bool setPackageAttribute(PackageAttribute type, const std::string& data);
         bool tileToPackage(const std::string& layer, Core::Zoom z, const Core::TileCoords& coords, const std::string& data);
         bool finalizePackage();
 
     protected:
+        /**
+         * @brief Opened archive
+         *
+         * Archives for given layer and zoom level form a singly-linked list,
+         * which is extended when searching for a tile past the end of last
+         * opened archive.
+         */
+        struct Archive {
+            /** @brief Constructor */
+            inline Archive(KompasRasterArchiveReader* _reader): reader(_reader), next(0) {}
+
+            /** @brief Destructor */
+            inline ~Archive() {
+                delete reader;
+                delete next.load();
+            }
+
+            KompasRasterArchiveReader* reader;  /**< @brief Archive reader */
+            std::atomic<Archive*> next;         /**< @brief Next archive or zero, if not opened yet */
+        };
+
+        /** @brief First archive for given layer and zoom level */
+        struct ArchiveSlot {
+            /** @brief Constructor */
+            inline ArchiveSlot(): first(0) {}
+
+            /** @brief Destructor */
+            inline ~ArchiveSlot() { delete first.load(); }
+
+            std::atomic<Archive*> first;        /**< @brief First archive or zero, if not opened yet */
+        };
+
         /** @brief Opened package */
         struct Package {
-            /** @brief Opened archives for layers in current zoom */
-            std::map<std::string, std::vector<KompasRasterArchiveReader*> > archives;
+            /**
+             * @brief Archives for all layers, overlays and zoom levels
+             *
+             * Filled with empty slots when the package is added and not
+             * modified afterwards, so it can be searched without locking.
+             */
+            std::map<std::pair<std::string, Core::Zoom>, ArchiveSlot> archives;
 
             Core::TileArea area;        /**< @brief Package area */
             std::set<Core::Zoom>
@@ -101,30 +165,51 @@ class CORE_EXPORT KompasRasterModel: public Core::AbstractRasterModel {
          * @param path              Path to package root
          * @param layer             Map layer
          * @param z                 Zoom
-         * @param archives          Pointer to vector of archives for given map layer
-         * @param archiveId         ID of archive where the tile should be
+         * @param archive           Pointer to place where the archive is
+         *      (or will be) stored
+         * @param archiveId         ID of the archive
          * @param packageVersion    Package version (from Package::version).
          *      If the version is lower than 3, opens @c *.map extension instead
          *      of @c *.kps extension.
          * @param tileId            Tile ID
-         * @return Tile data or empty string if archive with given ID is not
+         * @return Tile data or empty data if archive with given ID is not
          *      valid.
          *
          * Tries to get an tile from archive specified with archiveId (the
-         * archive is opened if given id doesn't exist in archives vector). If
-         * the archive doesn't contain the tile, calls itself with next
-         * archiveId.
+         * archive is opened if it is not opened yet). If the archive doesn't
+         * contain the tile, calls itself with next archiveId. Can be called
+         * from multiple threads at once, only opening of the archive is
+         * guarded by a lock.
+         */
+        virtual Core::TileData tileFromArchive(const std::string& path, const std::string& layer, Core::Zoom z, std::atomic<Archive*>* archive, unsigned int archiveId, int packageVersion, unsigned int tileId) const;
+
+        /**
+         * @brief Get or open given archive
+         * @param path              Path to package root
+         * @param layer             Map layer
+         * @param z                 Zoom
+         * @param archive           Pointer to place where the archive is
+         *      (or will be) stored
+         * @param archiveId         ID of the archive
+         * @param packageVersion    Package version (from Package::version)
+         * @return The archive. If it cannot be opened, returned archive
+         *      has invalid reader.
+         *
+         * If the archive is not opened yet, opens it. Can be called from
+         * multiple threads at once, only opening of the archive is guarded by
+         * a lock.
          */
-        virtual std::string tileFromArchive(const std::string& path, const std::string& layer, Core::Zoom z, std::vector<KompasRasterArchiveReader*>* archives, unsigned int archiveId, int packageVersion, unsigned int tileId);
+        Archive* openArchive(const std::string& path, const std::string& layer, Core::Zoom z, std::atomic<Archive*>* archive, unsigned int archiveId, int packageVersion) const;
 
     private:
         struct CurrentlyCreatedPackage {
-            CurrentlyCreatedPackage(const std::string& filename): conf(filename, Corrade::Utility::Configuration::Truncate), minZoom(0) {}
+            CurrentlyCreatedPackage(const std::string& filename): conf(filename, Corrade::Utility::Configuration::Truncate), minZoom(0), resume(false) {}
             Corrade::Utility::Configuration conf;
             std::string path;
             std::map<std::string, KompasRasterArchiveMaker*> archives;
             Core::TileArea area;
             Core::Zoom minZoom;
+            bool resume;
         };
 
         std::vector<std::string> extensions;
@@ -132,13 +217,16 @@ class CORE_EXPORT KompasRasterModel: public Core::AbstractRasterModel {
         std::set<Core::Zoom> _zoomLevels;
         Core::TileArea _area;
         std::vector<std::string> _layers, _overlays;
-        Core::Zoom currentPackageZoom;
         std::vector<Package*> packages;
+        mutable std::mutex archiveMutex;
 
         CurrentlyCreatedPackage* currentlyCreatedPackage;
 
-        void closeArchives();
         void closePackages();
+
+        /* Archive maker for currently created package, created on first
+           use, 0 on failure */
+        KompasRasterArchiveMaker* archiveMaker(const std::string& layer, Core::Zoom z);
 };
 
 }}
@@ -81,4 +81,19 @@ void KompasMultiRasterModelTest::get() {
     QVERIFY(model.tileFromPackage("base", 2, TileCoords(7, 7)) == "2");
 }
 
+void KompasMultiRasterModelTest::getArea() {
+    /* Area spanning over all packages, first package has precedency */
+    TileArea area(4, 5, 4, 4);
+    vector<TileData> tiles = model.tilesFromPackage("base", 2, area);
+    QVERIFY(tiles.size() == 16);
+
+    for(unsigned int y = 0; y != area.h; ++y) for(unsigned int x = 0; x != area.w; ++x)
+        QVERIFY(tiles[y*area.w+x] == model.tileFromPackage("base", 2, TileCoords(area.x+x, area.y+y)));
+
+    QVERIFY(tiles[1*4+1] == "p");
+    QVERIFY(tiles[2*4+3] == "2");
+    QVERIFY(tiles[3*4+1] == "");
+    QVERIFY(tiles[3*4+2] == "3");
+}
+
 }}}
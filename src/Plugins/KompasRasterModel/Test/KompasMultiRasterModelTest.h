@@ -37,6 +37,7 @@ class KompasMultiRasterModelTest: public QObject {
         void initialization();
         void expansion();
         void get();
+        void getArea();
 
     private:
         KompasMultiRasterModel model;
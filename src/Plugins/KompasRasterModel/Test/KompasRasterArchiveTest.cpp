@@ -189,4 +189,74 @@ void KompasRasterArchiveTest::makerSizeLimit() {
         "\x14\x00\x00\x00", 28));
 }
 
+void KompasRasterArchiveTest::makerResume() {
+    QFile::remove(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume.kps")));
+
+    /* Interrupted archive, only two tiles are in the journal */
+    {
+        QFile f(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume.kps")));
+        f.open(QFile::WriteOnly|QFile::Truncate);
+        f.write("MAP\x03"           "\x04\x00\x00\x00"  "\x00\x00\x00\x00"
+                "\x00\x00\x00\x00"  "1111"              "2222"
+                "33", 26);
+        QFile journal(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume.kps.journal")));
+        journal.open(QFile::WriteOnly|QFile::Truncate);
+        journal.write("\x14\x00\x00\x00"  "\x18\x00\x00\x00"  "\x1c\x00", 10);
+    }
+
+    KompasRasterArchiveMaker m(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume"), 3, 4);
+    QVERIFY(m.resume() == KompasRasterArchiveMaker::Ok);
+    QCOMPARE(m.tileCount(), 2u);
+    QCOMPARE(m.currentFileNumber(), 0);
+
+    QVERIFY(m.append("3333") == KompasRasterArchiveMaker::Ok);
+    QVERIFY(m.append("4444") == KompasRasterArchiveMaker::Ok);
+    QVERIFY(m.finish() == KompasRasterArchiveMaker::Ok);
+
+    QVERIFY(!QFile::exists(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume.kps.journal"))));
+
+    QFile f(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume.kps")));
+    f.open(QFile::ReadOnly);
+    QCOMPARE(f.readAll(), QByteArray(
+        "MAP\x03"           "\x04\x00\x00\x00"  "\x00\x00\x00\x00"
+        "\x04\x00\x00\x00"  "1111"              "2222"
+        "3333"              "4444"              "\x10\x00\x00\x00"
+        "\x14\x00\x00\x00"  "\x18\x00\x00\x00"  "\x1c\x00\x00\x00"
+        "\x20\x00\x00\x00", 52));
+
+    /* Archive with different total count can't be resumed */
+    KompasRasterArchiveMaker m2(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResume"), 3, 5);
+    QVERIFY(m2.resume() == KompasRasterArchiveMaker::TotalMismatch);
+}
+
+void KompasRasterArchiveTest::makerResumeFinished() {
+    QFile::remove(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResumeFinished.kps")));
+    QFile::remove(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResumeFinished-1.kps")));
+
+    /* Nothing to resume */
+    {
+        KompasRasterArchiveMaker m(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResumeFinished"), 3, 3);
+        QVERIFY(m.resume() == KompasRasterArchiveMaker::Ok);
+        QCOMPARE(m.tileCount(), 0u);
+        QVERIFY(m.append("1111") == KompasRasterArchiveMaker::NextFile);
+        QVERIFY(m.append("2222") == KompasRasterArchiveMaker::Ok);
+        QVERIFY(m.finish() == KompasRasterArchiveMaker::TotalMismatch);
+    }
+
+    /* Next tiles are saved to next file */
+    KompasRasterArchiveMaker m(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResumeFinished"), 3, 3);
+    QVERIFY(m.resume() == KompasRasterArchiveMaker::Ok);
+    QCOMPARE(m.tileCount(), 2u);
+    QVERIFY(m.append("3333") == KompasRasterArchiveMaker::NextFile);
+    QCOMPARE(m.currentFileNumber(), 1);
+    QVERIFY(m.finish() == KompasRasterArchiveMaker::Ok);
+
+    QFile f1(QString::fromStdString(Directory::join(RASTERARCHIVE_WRITE_TEST_DIR, "makeResumeFinished-1.kps")));
+    f1.open(QFile::ReadOnly);
+    QCOMPARE(f1.readAll(), QByteArray(
+        "MAP\x03"           "\x03\x00\x00\x00"  "\x02\x00\x00\x00"
+        "\x03\x00\x00\x00"  "3333"              "\x10\x00\x00\x00"
+        "\x14\x00\x00\x00", 28));
+}
+
 }}}
@@ -35,6 +35,8 @@ class KompasRasterArchiveTest: public QObject {
         void makerUnderrun();
         void makerOverflow();
         void makerSizeLimit();
+        void makerResume();
+        void makerResumeFinished();
 };
 
 }}}
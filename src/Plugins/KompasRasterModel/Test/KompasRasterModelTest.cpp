@@ -15,11 +15,13 @@
 
 #include "KompasRasterModelTest.h"
 
+#include <thread>
 #include <QtCore/QFile>
 #include <QtCore/QDir>
 #include <QtTest/QTest>
 
 #include "Utility/Directory.h"
+#include "KompasRasterModel/KompasRasterArchiveReader.h"
 #include "testConfigure.h"
 
 QTEST_APPLESS_MAIN(Kompas::Plugins::Test::KompasRasterModelTest)
@@ -30,6 +32,18 @@ using namespace Kompas::Core;
 
 namespace Kompas { namespace Plugins { namespace Test {
 
+namespace {
+    void readTiles(const KompasRasterModel* model, atomic<int>* failures) {
+        for(int i = 0; i != 1000; ++i) {
+            if(model->tileFromPackage("base", 2, TileCoords(6, 8)) != "3" ||
+               model->tileFromPackage("relief", 2, TileCoords(7, 7)) != "p" ||
+               model->tileFromPackage("base", 3, TileCoords(14, 16)) != "a" ||
+               model->tileFromPackage("base", 3, TileCoords(13, 15)) != "6")
+                ++*failures;
+        }
+    }
+}
+
 void KompasRasterModelTest::metadata() {
     QVERIFY(model.addPackage(Directory::join(RASTERMODEL_TEST_DIR, "small/map.conf")) == 0);
 
@@ -65,6 +79,47 @@ void KompasRasterModelTest::tiles() {
     QVERIFY(model.tileFromPackage("base", 3, TileCoords(13, 15)) == "6");
 }
 
+void KompasRasterModelTest::tilesThreaded() {
+    /* Fresh model, so the archives are opened concurrently from all threads */
+    KompasRasterModel m;
+    QVERIFY(m.addPackage(Directory::join(RASTERMODEL_TEST_DIR, "small/map.conf")) == 0);
+
+    atomic<int> failures(0);
+    vector<thread*> threads;
+    for(int i = 0; i != 8; ++i)
+        threads.push_back(new thread(readTiles, &m, &failures));
+
+    for(vector<thread*>::iterator it = threads.begin(); it != threads.end(); ++it) {
+        (*it)->join();
+        delete *it;
+    }
+
+    QCOMPARE(failures.load(), 0);
+}
+
+void KompasRasterModelTest::tilesArea() {
+    /* Area partially outside the package, zoom level with two archives */
+    TileArea area(11, 14, 4, 4);
+    vector<TileData> tiles = model.tilesFromPackage("base", 3, area);
+    QVERIFY(tiles.size() == 16);
+
+    for(unsigned int y = 0; y != area.h; ++y) for(unsigned int x = 0; x != area.w; ++x)
+        QVERIFY(tiles[y*area.w+x] == model.tileFromPackage("base", 3, TileCoords(area.x+x, area.y+y)));
+
+    QVERIFY(tiles[0] == "");
+    QVERIFY(tiles[6] == "6");
+    QVERIFY(tiles[11] == "a");
+
+    /* Overlay */
+    tiles = model.tilesFromPackage("relief", 2, TileArea(6, 7, 2, 1));
+    QVERIFY(tiles.size() == 2);
+    QVERIFY(tiles[1] == "p");
+
+    /* Nonexistent layer */
+    tiles = model.tilesFromPackage("photo", 2, TileArea(6, 7, 2, 2));
+    QVERIFY(tiles == vector<TileData>(4));
+}
+
 void KompasRasterModelTest::create() {
     QDir dir;
     dir.remove(RASTERMODEL_WRITE_TEST_DIR);
@@ -131,6 +186,42 @@ void KompasRasterModelTest::create() {
     QVERIFY(relief2.readAll() == relief2Expected.readAll());
 }
 
+void KompasRasterModelTest::resume() {
+    QFile::remove(QString::fromStdString(Directory::join(RASTERMODEL_WRITE_TEST_DIR, "resume/base/2.kps")));
+    QFile::remove(QString::fromStdString(Directory::join(RASTERMODEL_WRITE_TEST_DIR, "resume/base/2-1.kps")));
+
+    vector<Zoom> zoomLevels(1, 2);
+    vector<string> layers(1, "base");
+    const string filename = Directory::join(RASTERMODEL_WRITE_TEST_DIR, "resume/map.conf");
+
+    /* Package with only half of the tiles */
+    KompasRasterModel m;
+    QVERIFY(m.features() & AbstractRasterModel::ResumableFormat);
+    QVERIFY(m.initializePackage(filename, TileSize(256, 256), zoomLevels, TileArea(6, 7, 2, 2), layers, vector<string>()));
+    QVERIFY(m.tileToPackage("base", 2, TileCoords(6, 7), "1"));
+    QVERIFY(m.tileToPackage("base", 2, TileCoords(7, 7), "2"));
+    QVERIFY(m.finalizePackage());
+
+    /* The rest is saved into next archive */
+    QVERIFY(m.resumePackage(filename, TileSize(256, 256), zoomLevels, TileArea(6, 7, 2, 2), layers, vector<string>()));
+    QCOMPARE(m.packagedTileCount("base", 2), 2u);
+    QVERIFY(!m.tileToPackage("base", 2, TileCoords(6, 7), "1"));
+    QVERIFY(m.tileToPackage("base", 2, TileCoords(6, 8), "3"));
+    QVERIFY(m.tileToPackage("base", 2, TileCoords(7, 8), "4"));
+    QVERIFY(m.finalizePackage());
+
+    KompasRasterArchiveReader first(Directory::join(RASTERMODEL_WRITE_TEST_DIR, "resume/base/2.kps"));
+    QVERIFY(first.isValid());
+    QCOMPARE(first.end(), 2u);
+    QVERIFY(first.get(1) == "2");
+
+    KompasRasterArchiveReader second(Directory::join(RASTERMODEL_WRITE_TEST_DIR, "resume/base/2-1.kps"));
+    QVERIFY(second.isValid());
+    QCOMPARE(second.begin(), 2u);
+    QCOMPARE(second.end(), 4u);
+    QVERIFY(second.get(3) == "4");
+}
+
 void KompasRasterModelTest::recognizeFile_data() {
     QTest::addColumn<QString>("filename");
     QTest::addColumn<QString>("file");
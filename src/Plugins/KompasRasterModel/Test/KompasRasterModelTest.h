@@ -27,8 +27,11 @@ class KompasRasterModelTest: public QObject {
     private slots:
         void metadata();
         void tiles();
+        void tilesThreaded();
+        void tilesArea();
 
         void create();
+        void resume();
 
         void recognizeFile_data();
         void recognizeFile();
@@ -0,0 +1,329 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "MemcachedCache.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Socket.h"
+
+using namespace std;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(MemcachedCache, Kompas::Plugins::MemcachedCache,
+                "cz.mosra.Kompas.Core.AbstractCache/0.2")
+
+namespace Kompas { namespace Plugins {
+
+/* Socket with buffered reading of responses */
+class MemcachedCache::Connection {
+    public:
+        inline Connection(): position(0) {}
+
+        Socket socket;
+
+        /* Read line without trailing CRLF */
+        bool readLine(string* line) {
+            size_t end;
+            while((end = buffer.find("\r\n", position)) == string::npos)
+                if(!fill()) return false;
+
+            line->assign(buffer, position, end-position);
+            position = end+2;
+            return true;
+        }
+
+        /* Read data followed by CRLF */
+        bool readData(size_t size, string* data) {
+            while(buffer.size()-position < size+2)
+                if(!fill()) return false;
+
+            if(buffer.compare(position+size, 2, "\r\n") != 0) return false;
+
+            data->assign(buffer, position, size);
+            position += size+2;
+            return true;
+        }
+
+    private:
+        string buffer;
+        size_t position;
+
+        bool fill() {
+            /* Drop already read data */
+            buffer.erase(0, position);
+            position = 0;
+
+            char data[16384];
+            long size = socket.receive(data, sizeof(data));
+            if(size <= 0) return false;
+
+            buffer.append(data, size);
+            return true;
+        }
+};
+
+namespace {
+    /* Longest key memcached accepts */
+    const size_t MaxKeySize = 250;
+}
+
+MemcachedCache::MemcachedCache(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractNetworkCache(manager, plugin), _poolSize(4), _batchSize(64), _timeout(1000), _expiration(0), port(0), initialized(false), _connections(0) {}
+
+bool MemcachedCache::initializeCache(const string& url) {
+    finalizeCache();
+
+    /* host[:port] */
+    size_t colon = url.rfind(':');
+    {
+        lock_guard<std::mutex> lock(mutex);
+        host = url.substr(0, colon);
+        port = colon == string::npos ? 11211 : atoi(url.c_str()+colon+1);
+        if(host.empty() || port == 0) return false;
+    }
+
+    /* Check that the server is reachable */
+    initialized = true;
+    bool reused;
+    Connection* connection = acquire(&reused);
+    if(!connection) {
+        initialized = false;
+        return false;
+    }
+
+    release(connection);
+    return true;
+}
+
+void MemcachedCache::finalizeCache() {
+    lock_guard<std::mutex> lock(mutex);
+    for(vector<Connection*>::const_iterator it = idle.begin(); it != idle.end(); ++it)
+        delete *it;
+    idle.clear();
+    initialized = false;
+}
+
+TileData MemcachedCache::get(const CacheKey& key) {
+    return get(vector<CacheKey>(1, key)).front();
+}
+
+vector<TileData> MemcachedCache::get(const vector<CacheKey>& keys) {
+    vector<TileData> data(keys.size());
+    if(!initialized || keys.empty()) return data;
+
+    /* Retry on new connection if reused one failed */
+    for(;;) {
+        bool reused;
+        Connection* connection = acquire(&reused);
+        if(!connection) break;
+
+        if(fetch(connection, keys, &data)) {
+            release(connection);
+            break;
+        }
+
+        delete connection;
+        if(!reused) break;
+    }
+
+    return data;
+}
+
+vector<bool> MemcachedCache::contains(const vector<CacheKey>& keys) {
+    vector<TileData> data = get(keys);
+
+    vector<bool> found(keys.size());
+    for(size_t i = 0; i != keys.size(); ++i)
+        found[i] = !data[i].empty();
+    return found;
+}
+
+bool MemcachedCache::set(const CacheKey& key, const TileData& data) {
+    return set(vector<CacheKey>(1, key), vector<TileData>(1, data)).front();
+}
+
+vector<bool> MemcachedCache::set(const vector<CacheKey>& keys, const vector<TileData>& data) {
+    vector<bool> stored(keys.size());
+    if(!initialized || keys.empty() || data.size() != keys.size()) return stored;
+
+    /* Saving the data again after failure doesn't matter */
+    for(;;) {
+        bool reused;
+        Connection* connection = acquire(&reused);
+        if(!connection) break;
+
+        if(store(connection, keys, data, &stored)) {
+            release(connection);
+            break;
+        }
+
+        delete connection;
+        if(!reused) break;
+    }
+
+    return stored;
+}
+
+MemcachedCache::Connection* MemcachedCache::acquire(bool* reused) {
+    /* Connect outside the lock, it can take long */
+    string host;
+    unsigned short port;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if(!idle.empty()) {
+            Connection* connection = idle.back();
+            idle.pop_back();
+            *reused = true;
+            return connection;
+        }
+
+        host = this->host;
+        port = this->port;
+    }
+
+    *reused = false;
+    Connection* connection = new Connection;
+    if(!connection->socket.connect(host, port, _timeout)) {
+        delete connection;
+        return 0;
+    }
+
+    ++_connections;
+    return connection;
+}
+
+void MemcachedCache::release(Connection* connection) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if(initialized && idle.size() < _poolSize) {
+            idle.push_back(connection);
+            return;
+        }
+    }
+
+    delete connection;
+}
+
+bool MemcachedCache::fetch(Connection* connection, const vector<CacheKey>& keys, vector<TileData>* data) {
+    /* Send all commands at once, skip keys which can't be in the cache */
+    vector<string> names;
+    names.reserve(keys.size());
+    ostringstream request;
+    size_t commands = 0, requested = 0;
+    for(size_t i = 0; i != keys.size(); ++i) {
+        names.push_back(name(keys[i]));
+        if(names.back().empty()) continue;
+
+        if(requested++%_batchSize == 0) {
+            if(commands) request << "\r\n";
+            request << "get";
+            ++commands;
+        }
+        request << ' ' << names.back();
+    }
+    if(!commands) return true;
+
+    request << "\r\n";
+    if(!connection->socket.send(request.str())) return false;
+
+    /* Responses are VALUE <name> <flags> <size>, data and END after each
+       command */
+    unordered_map<string, string> values;
+    string line, value;
+    while(commands) {
+        if(!connection->readLine(&line)) return false;
+
+        if(line == "END") {
+            --commands;
+            continue;
+        }
+
+        if(line.compare(0, 6, "VALUE ") != 0) return false;
+
+        istringstream in(line.substr(6));
+        string name;
+        unsigned int flags;
+        size_t size;
+        if(!(in >> name >> flags >> size) || !connection->readData(size, &value))
+            return false;
+
+        values[name] = value;
+    }
+
+    for(size_t i = 0; i != keys.size(); ++i) {
+        if(names[i].empty()) continue;
+
+        unordered_map<string, string>::const_iterator found = values.find(names[i]);
+        if(found != values.end()) (*data)[i] = TileData(found->second);
+    }
+
+    return true;
+}
+
+bool MemcachedCache::store(Connection* connection, const vector<CacheKey>& keys, const vector<TileData>& data, vector<bool>* stored) {
+    string line;
+    for(size_t begin = 0; begin < keys.size(); begin += _batchSize) {
+        /* Send the whole group at once, then read all responses. Keys which
+           are too long aren't sent and are reported as not stored. */
+        const size_t end = min(begin + _batchSize, keys.size());
+        vector<bool> sent(end-begin);
+        ostringstream request;
+        for(size_t i = begin; i != end; ++i) {
+            const string name = this->name(keys[i]);
+            if(name.empty()) continue;
+
+            request << "set " << name << " 0 " << _expiration << ' ' << data[i].size() << "\r\n";
+            request.write(data[i].data(), data[i].size());
+            request << "\r\n";
+            sent[i-begin] = true;
+        }
+        if(request.tellp() == 0) continue;
+        if(!connection->socket.send(request.str())) return false;
+
+        for(size_t i = begin; i != end; ++i) {
+            if(!sent[i-begin]) continue;
+            if(!connection->readLine(&line)) return false;
+
+            /* Data which the server refused (e.g. too large) don't break
+               the connection */
+            (*stored)[i] = line == "STORED";
+            if(!(*stored)[i] && line != "NOT_STORED" && line.compare(0, 13, "SERVER_ERROR ") != 0)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+string MemcachedCache::name(const CacheKey& key) {
+    static const char digits[] = "0123456789abcdef";
+
+    string serialized = key.toString();
+    string out("kompas:");
+    if(out.size() + serialized.size()*2 > MaxKeySize) return string();
+
+    out.reserve(out.size() + serialized.size()*2);
+    for(string::const_iterator it = serialized.begin(); it != serialized.end(); ++it) {
+        out += digits[static_cast<unsigned char>(*it) >> 4];
+        out += digits[static_cast<unsigned char>(*it) & 0x0F];
+    }
+
+    return out;
+}
+
+}}
@@ -0,0 +1,192 @@
+#ifndef Kompas_Plugins_MemcachedCache_h
+#define Kompas_Plugins_MemcachedCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::MemcachedCache
+ */
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "AbstractNetworkCache.h"
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief Memcached cache
+
+Saves data to memcached server (or any other server speaking its text
+protocol), so the cache can be shared by many computers. URL passed to
+initializeCache() is host name and optional port, e.g.
+<tt>cache.example.org:11211</tt>.
+@code
+MemcachedCache cache;
+cache.initializeCache("127.0.0.1:11211");
+@endcode
+
+- Connections are reused. Each request takes idle connection or opens new
+  one, after the request the connection is returned to the pool. At most
+  poolSize() idle connections are kept open.
+- Multiple data can be retrieved with get(const std::vector<Core::CacheKey>&).
+  The keys are sent in <tt>get</tt> commands of batchSize() keys, all commands
+  are sent at once and then all responses are read, so the whole batch
+  costs one round trip.
+- Multiple data saved with
+  set(const std::vector<Core::CacheKey>&, const std::vector<Core::TileData>&)
+  are sent in groups of batchSize() <tt>set</tt> commands, so each group
+  costs one round trip.
+- If request on reused connection fails (e.g. the server closed idle
+  connection), the connection is dropped and the request is repeated on
+  another one. Request on new connection is not repeated.
+
+Keys are hex-encoded serialized keys with <tt>kompas:</tt> prefix. Memcached
+keys can have at most 250 bytes, so model and layer names together can have
+at most 106 bytes, data with longer names are never saved nor found. Data are
+saved
+with expiration time set with setExpiration(). The server evicts data itself,
+so purge() and optimize() do nothing and neither cache size nor used size is
+known.
+
+The cache can be accessed from multiple threads at once. Parameters must not
+be changed while the cache is initialized.
+*/
+class CORE_EXPORT MemcachedCache: public Core::AbstractNetworkCache {
+    public:
+        /** @copydoc Core::AbstractCache::AbstractCache */
+        MemcachedCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        /**
+         * @brief Destructor
+         *
+         * Finalizes the cache.
+         */
+        inline ~MemcachedCache() { finalizeCache(); }
+
+        /** @brief Maximal count of idle connections */
+        inline size_t poolSize() const { return _poolSize; }
+
+        /**
+         * @brief Set maximal count of idle connections
+         *
+         * Default is 4.
+         */
+        inline void setPoolSize(size_t size) { _poolSize = size; }
+
+        /** @brief Maximal count of keys in one <tt>get</tt> command */
+        inline size_t batchSize() const { return _batchSize; }
+
+        /**
+         * @brief Set maximal count of keys in one <tt>get</tt> command
+         *
+         * Default is 64.
+         */
+        inline void setBatchSize(size_t size) { _batchSize = size ? size : 1; }
+
+        /** @brief Network timeout in milliseconds */
+        inline unsigned int timeout() const { return _timeout; }
+
+        /**
+         * @brief Set network timeout in milliseconds
+         *
+         * Default is 1000.
+         */
+        inline void setTimeout(unsigned int timeout) { _timeout = timeout; }
+
+        /** @brief Expiration time of saved data in seconds */
+        inline unsigned int expiration() const { return _expiration; }
+
+        /**
+         * @brief Set expiration time of saved data in seconds
+         *
+         * Default is 0, which means the data don't expire.
+         */
+        inline void setExpiration(unsigned int seconds) { _expiration = seconds; }
+
+        /**
+         * @brief Initialize cache
+         *
+         * Opens first connection to given server. Returns false if the
+         * connection failed.
+         */
+        bool initializeCache(const std::string& url);
+
+        /**
+         * @brief Finalize cache
+         *
+         * Closes all idle connections.
+         */
+        void finalizeCache();
+
+        Core::TileData get(const Core::CacheKey& key);
+
+        /**
+         * @brief Get multiple data from cache
+         * @param keys      Keys
+         * @return Data for all keys, empty data for keys which weren't found
+         *
+         * All keys are requested in one round trip.
+         */
+        std::vector<Core::TileData> get(const std::vector<Core::CacheKey>& keys);
+
+        bool set(const Core::CacheKey& key, const Core::TileData& data);
+
+        /**
+         * @brief Save multiple data to cache
+         *
+         * The commands are sent in groups of batchSize(), each group costs
+         * one round trip.
+         */
+        std::vector<bool> set(const std::vector<Core::CacheKey>& keys, const std::vector<Core::TileData>& data);
+
+        /**
+         * @brief Check presence of multiple data
+         *
+         * Retrieves the data with get(const std::vector<Core::CacheKey>&), so
+         * all keys are checked in one round trip.
+         */
+        std::vector<bool> contains(const std::vector<Core::CacheKey>& keys);
+
+        /** @brief Count of opened connections */
+        inline unsigned long long connections() const { return _connections; }
+
+    private:
+        class Connection;
+
+        size_t _poolSize, _batchSize;
+        unsigned int _timeout, _expiration;
+
+        std::mutex mutex;
+        std::string host;                   /* Guarded by the mutex */
+        unsigned short port;                /* Guarded by the mutex */
+        std::vector<Connection*> idle;      /* Guarded by the mutex */
+        std::atomic<bool> initialized;
+        std::atomic<unsigned long long> _connections;
+
+        Connection* acquire(bool* reused);
+        void release(Connection* connection);
+
+        bool fetch(Connection* connection, const std::vector<Core::CacheKey>& keys, std::vector<Core::TileData>* data);
+        bool store(Connection* connection, const std::vector<Core::CacheKey>& keys, const std::vector<Core::TileData>& data, std::vector<bool>* stored);
+
+        /* Empty for keys which are too long for memcached */
+        static std::string name(const Core::CacheKey& key);
+};
+
+}}
+
+#endif
@@ -0,0 +1,263 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "MemcachedCacheTest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <QtTest/QTest>
+
+#include "../MemcachedCache.h"
+#include "MemcachedServerStub.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::MemcachedCacheTest)
+
+using namespace std;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+namespace {
+    void readWrite(MemcachedCache* cache, unsigned int seed, atomic<int>* failures) {
+        for(unsigned int i = 0; i != 500; ++i) {
+            seed = seed*1103515245 + 12345;
+            TileCoords coords((seed >> 8)%32, (seed >> 16)%32);
+
+            /* Data depend on coordinates, so they can be verified */
+            string data(coords.x*10+1, 'a'+coords.y%26);
+            if(i%4 == 0) {
+                if(!cache->setRasterTile("Model", "base", 8, coords, data)) ++*failures;
+            } else {
+                TileData tile = cache->rasterTile("Model", "base", 8, coords);
+                if(!tile.empty() && tile != data) ++*failures;
+            }
+        }
+    }
+}
+
+void MemcachedCacheTest::uninitialized() {
+    MemcachedCache cache;
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+
+    /* Nobody listens there */
+    unsigned short port;
+    {
+        MemcachedServerStub server;
+        port = server.port();
+    }
+    ostringstream url;
+    url << "127.0.0.1:" << port;
+    QVERIFY(!cache.initializeCache(url.str()));
+    QVERIFY(!cache.initializeCache(""));
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+}
+
+void MemcachedCacheTest::features() {
+    MemcachedCache cache;
+    AbstractCache* abstract = &cache;
+    QVERIFY(abstract->features() == (AbstractCache::MultiUser|AbstractCache::Network));
+    QVERIFY(abstract->cacheSize() == 0);
+    QVERIFY(abstract->usedSize() == 0);
+}
+
+void MemcachedCacheTest::setGet() {
+    MemcachedServerStub server;
+    MemcachedCache cache;
+    QVERIFY(cache.initializeCache(server.url()));
+
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "other", 3, TileCoords(1, 2)) == "");
+
+    /* Binary data with line breaks */
+    const string data("\r\nEND\r\n\0x", 9);
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), data));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == data);
+    QVERIFY(server.count() == 1);
+
+    /* Data are shared with other caches */
+    MemcachedCache other;
+    QVERIFY(other.initializeCache(server.url()));
+    QVERIFY(other.rasterTile("Model", "base", 3, TileCoords(1, 2)) == data);
+
+    /* Everything went through one connection */
+    QVERIFY(cache.connections() == 1);
+}
+
+void MemcachedCacheTest::batch() {
+    MemcachedServerStub server;
+    MemcachedCache cache;
+    cache.setBatchSize(64);
+    QVERIFY(cache.initializeCache(server.url()));
+
+    for(unsigned int x = 0; x != 100; ++x)
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(x, 0), string(x+1, 'a')));
+
+    /* Every third key is missing, one key is twice */
+    vector<CacheKey> keys;
+    for(unsigned int x = 0; x != 150; ++x)
+        keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 5, TileCoords(x%3 ? x : x+1000, 0)));
+    keys.push_back(keys.front());
+
+    vector<TileData> data = cache.get(keys);
+    QVERIFY(data.size() == keys.size());
+    for(unsigned int x = 0; x != 150; ++x)
+        QVERIFY(data[x] == (x%3 && x < 100 ? string(x+1, 'a') : string()));
+    QVERIFY(data.back() == data.front());
+
+    /* Three commands sent at once over one connection */
+    QVERIFY(server.getCommands() == 3);
+    QVERIFY(cache.connections() == 1);
+    QVERIFY(cache.get(vector<CacheKey>()).empty());
+}
+
+void MemcachedCacheTest::batchSet() {
+    MemcachedServerStub server;
+    server.setMaxSize(1000);
+    MemcachedCache cache;
+    cache.setBatchSize(64);
+    QVERIFY(cache.initializeCache(server.url()));
+
+    /* One tile is too large */
+    vector<TileCoords> coords;
+    vector<TileData> data;
+    for(unsigned int x = 0; x != 100; ++x) {
+        coords.push_back(TileCoords(x, 0));
+        data.push_back(string(x == 42 ? 1001 : x+1, 'a'));
+    }
+
+    vector<bool> stored = cache.setRasterTiles("Model", "base", 5, coords, data);
+    QVERIFY(stored.size() == 100);
+    for(unsigned int x = 0; x != 100; ++x)
+        QVERIFY(stored[x] == (x != 42));
+
+    /* Two groups of commands over one connection */
+    QVERIFY(server.setCommands() == 100);
+    QVERIFY(cache.connections() == 1);
+
+    vector<TileData> retrieved = cache.rasterTiles("Model", "base", 5, coords);
+    QVERIFY(retrieved.size() == 100);
+    for(unsigned int x = 0; x != 100; ++x)
+        QVERIFY(retrieved[x] == (x != 42 ? data[x] : TileData()));
+    QVERIFY(cache.connections() == 1);
+}
+
+void MemcachedCacheTest::tooLarge() {
+    MemcachedServerStub server;
+    server.setMaxSize(1000);
+    MemcachedCache cache;
+    QVERIFY(cache.initializeCache(server.url()));
+
+    /* Refused data don't break the connection */
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), string(1001, 'x')));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), string(1000, 'x')));
+    QVERIFY(cache.connections() == 1);
+}
+
+void MemcachedCacheTest::longNames() {
+    MemcachedServerStub server;
+    MemcachedCache cache;
+    QVERIFY(cache.initializeCache(server.url()));
+
+    /* Names together have 106 bytes, the key has 249 bytes, one more byte
+       would make it longer than 250 bytes */
+    const string model(53, 'm'), layer(53, 'l');
+    QVERIFY(cache.setRasterTile(model, layer, 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile(model, layer, 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(server.setCommands() == 1);
+    QVERIFY(server.getCommands() == 1);
+
+    /* Longer keys aren't sent at all */
+    QVERIFY(!cache.setRasterTile(model, layer + 'l', 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile(model, layer + 'l', 3, TileCoords(1, 2)) == "");
+    QVERIFY(server.setCommands() == 1);
+    QVERIFY(server.getCommands() == 1);
+
+    /* Other keys in the same batch are not affected */
+    vector<CacheKey> keys;
+    keys.push_back(CacheKey(AbstractCache::RasterTile, model, layer + 'l', 3, TileCoords(1, 2)));
+    keys.push_back(CacheKey(AbstractCache::RasterTile, model, layer, 3, TileCoords(1, 2)));
+    vector<bool> stored = cache.set(keys, vector<TileData>(2, TileData("other")));
+    QVERIFY(!stored[0]);
+    QVERIFY(stored[1]);
+    vector<TileData> data = cache.get(keys);
+    QVERIFY(data[0] == "");
+    QVERIFY(data[1] == "other");
+    QVERIFY(cache.connections() == 1);
+}
+
+void MemcachedCacheTest::reconnect() {
+    MemcachedServerStub server;
+    MemcachedCache cache;
+    QVERIFY(cache.initializeCache(server.url()));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Request on closed connection is repeated on new one */
+    server.dropConnections();
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.connections() == 2);
+
+    server.dropConnections();
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "other"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "other");
+    QVERIFY(cache.connections() == 3);
+}
+
+void MemcachedCacheTest::threaded() {
+    MemcachedServerStub server;
+    MemcachedCache cache;
+    cache.setPoolSize(2);
+    QVERIFY(cache.initializeCache(server.url()));
+
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 8; ++i)
+        threads.push_back(thread(readWrite, &cache, i, &failures));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    QVERIFY(failures == 0);
+
+    /* Connections are reused */
+    QVERIFY(cache.connections() < 8*500/4);
+}
+
+void MemcachedCacheTest::benchmark() {
+    MemcachedServerStub server;
+    MemcachedCache cache;
+    QVERIFY(cache.initializeCache(server.url()));
+
+    vector<TileCoords> coords;
+    vector<TileData> data;
+    for(unsigned int x = 0; x != 256; ++x) {
+        coords.push_back(TileCoords(x, 0));
+        data.push_back(string(4096, 'a'+x%26));
+    }
+    QVERIFY(cache.setRasterTiles("Model", "base", 5, coords, data) == vector<bool>(256, true));
+
+    /* Pipelined batch of four get commands, one round trip */
+    vector<TileData> retrieved;
+    QBENCHMARK {
+        retrieved = cache.rasterTiles("Model", "base", 5, coords);
+    }
+
+    QVERIFY(retrieved == data);
+    QVERIFY(cache.connections() == 1);
+}
+
+}}}
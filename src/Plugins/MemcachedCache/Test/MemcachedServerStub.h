@@ -0,0 +1,227 @@
+#ifndef Kompas_Plugins_Test_MemcachedServerStub_h
+#define Kompas_Plugins_Test_MemcachedServerStub_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include <string>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+/**
+ * @brief Local memcached server for testing
+ *
+ * Listens on random port on localhost and understands <tt>get</tt>,
+ * <tt>set</tt> and <tt>delete</tt> commands of memcached text protocol. Data
+ * are kept in memory and never expire. Can be used also for benchmarks, as it
+ * has no latency of real network.
+ */
+class MemcachedServerStub {
+    public:
+        inline MemcachedServerStub(): _port(0), _maxSize(1024*1024), _getCommands(0), _setCommands(0), _connections(0), stopping(false) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            int flag = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+            sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+            socklen_t size = sizeof(address);
+            if(bind(fd, reinterpret_cast<sockaddr*>(&address), size) != 0 ||
+               listen(fd, 64) != 0 ||
+               getsockname(fd, reinterpret_cast<sockaddr*>(&address), &size) != 0) return;
+
+            _port = ntohs(address.sin_port);
+            listener = std::thread(&MemcachedServerStub::acceptConnections, this);
+        }
+
+        inline ~MemcachedServerStub() {
+            stopping = true;
+            shutdown(fd, SHUT_RDWR);
+            close(fd);
+            if(listener.joinable()) listener.join();
+
+            dropConnections();
+            for(std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+                it->join();
+        }
+
+        /** @brief Port, or 0 if the server couldn't be started */
+        inline unsigned short port() const { return _port; }
+
+        /** @brief Address for MemcachedCache::initializeCache() */
+        inline std::string url() const {
+            std::ostringstream out;
+            out << "127.0.0.1:" << _port;
+            return out.str();
+        }
+
+        /**
+         * @brief Set max data size
+         *
+         * Larger data are refused with <tt>SERVER_ERROR</tt>.
+         */
+        inline void setMaxSize(size_t size) { _maxSize = size; }
+
+        /** @brief Count of stored data */
+        inline size_t count() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return data.size();
+        }
+
+        /** @brief Count of received <tt>get</tt> commands */
+        inline unsigned int getCommands() const { return _getCommands; }
+
+        /** @brief Count of received <tt>set</tt> commands */
+        inline unsigned int setCommands() const { return _setCommands; }
+
+        /** @brief Count of accepted connections */
+        inline unsigned int connections() const { return _connections; }
+
+        /** @brief Close all open connections */
+        inline void dropConnections() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(std::vector<int>::const_iterator it = open.begin(); it != open.end(); ++it)
+                shutdown(*it, SHUT_RDWR);
+        }
+
+    private:
+        int fd;
+        unsigned short _port;
+        size_t _maxSize;
+        std::atomic<unsigned int> _getCommands, _setCommands, _connections;
+        std::atomic<bool> stopping;
+        std::thread listener;
+        std::vector<std::thread> threads;
+
+        mutable std::mutex mutex;
+        std::vector<int> open;
+        std::map<std::string, std::string> data;
+
+        void acceptConnections() {
+            int connection;
+            while((connection = accept(fd, 0, 0)) != -1 && !stopping) {
+                ++_connections;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    open.push_back(connection);
+                }
+                threads.push_back(std::thread(&MemcachedServerStub::serve, this, connection));
+            }
+        }
+
+        void serve(int connection) {
+            std::string buffer;
+            while(!stopping) {
+                /* Wait for whole command line */
+                size_t end = buffer.find("\r\n");
+                if(end == std::string::npos) {
+                    if(!receive(connection, &buffer)) break;
+                    continue;
+                }
+
+                std::istringstream in(buffer.substr(0, end));
+                std::string command;
+                in >> command;
+
+                std::string response;
+                if(command == "get") {
+                    ++_getCommands;
+                    buffer.erase(0, end+2);
+
+                    std::ostringstream out;
+                    std::string name;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    while(in >> name) {
+                        std::map<std::string, std::string>::const_iterator found = data.find(name);
+                        if(found != data.end())
+                            out << "VALUE " << name << " 0 " << found->second.size() << "\r\n" << found->second << "\r\n";
+                    }
+                    out << "END\r\n";
+                    response = out.str();
+
+                } else if(command == "set") {
+                    std::string name;
+                    unsigned int flags, expiration;
+                    size_t size;
+                    if(!(in >> name >> flags >> expiration >> size)) break;
+
+                    /* Wait for the data */
+                    if(buffer.size() < end+2+size+2) {
+                        if(!receive(connection, &buffer)) break;
+                        continue;
+                    }
+
+                    ++_setCommands;
+                    if(size > _maxSize)
+                        response = "SERVER_ERROR object too large for cache\r\n";
+                    else {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        data[name] = buffer.substr(end+2, size);
+                        response = "STORED\r\n";
+                    }
+                    buffer.erase(0, end+2+size+2);
+
+                } else if(command == "delete") {
+                    std::string name;
+                    in >> name;
+                    buffer.erase(0, end+2);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    response = data.erase(name) ? "DELETED\r\n" : "NOT_FOUND\r\n";
+
+                } else {
+                    buffer.erase(0, end+2);
+                    response = "ERROR\r\n";
+                }
+
+                if(send(connection, response.data(), response.size(), MSG_NOSIGNAL) != long(response.size())) break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                open.erase(std::find(open.begin(), open.end(), connection));
+            }
+            close(connection);
+        }
+
+        static bool receive(int connection, std::string* buffer) {
+            char data[16384];
+            long size = recv(connection, data, sizeof(data), 0);
+            if(size <= 0) return false;
+
+            buffer->append(data, size);
+            return true;
+        }
+};
+
+}}}
+
+#endif
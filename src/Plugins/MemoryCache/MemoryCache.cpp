@@ -0,0 +1,347 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "MemoryCache.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <fstream>
+#include <map>
+
+#include "Utility/Debug.h"
+#include "MappedFile.h"
+#include "LruEvictionPolicy.h"
+#include "ArcEvictionPolicy.h"
+#include "TinyLfuEvictionPolicy.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(MemoryCache, Kompas::Plugins::MemoryCache,
+                "cz.mosra.Kompas.Core.AbstractCache/0.2")
+
+namespace Kompas { namespace Plugins {
+
+namespace {
+    /* Snapshot starts with signature, entry count and name count. Each name
+       is ID and size as 32bit values followed by the name, each entry is
+       kind, model ID, layer ID, zoom, coordinates and data size as 32bit
+       values, followed by the data */
+    const char SnapshotSignature[] = "KMEMSNP2";
+    const size_t SignatureSize = 8;
+    const size_t SnapshotHeaderSize = SignatureSize + sizeof(uint64_t) + sizeof(uint32_t);
+    const size_t NameHeaderSize = 2*sizeof(uint32_t);
+    const size_t EntryHeaderSize = 7*sizeof(uint32_t);
+}
+
+MemoryCache::MemoryCache(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractCache(manager, plugin), initialized(false), _cacheSize(16*1024*1024), _evictionPolicy(Lru), activeEvictionPolicy(Lru) {
+    for(unsigned int i = 0; i != ShardCount; ++i)
+        shards[i].policy.reset(createPolicy());
+}
+
+bool MemoryCache::initializeCache(const string& url) {
+    if(_evictionPolicy != activeEvictionPolicy) {
+        initialized = false;
+        activeEvictionPolicy = _evictionPolicy;
+
+        for(unsigned int i = 0; i != ShardCount; ++i) {
+            lock_guard<mutex> lock(shards[i].mutex);
+            shards[i].entries.clear();
+            shards[i].policy.reset(createPolicy());
+        }
+    }
+
+    /* Restore the snapshot only into empty cache, repeated initialization
+       would otherwise replace newer data with the restored ones */
+    if(!_snapshotFile.empty() && usedSize() == 0) restoreSnapshot();
+
+    initialized = true;
+    return true;
+}
+
+void MemoryCache::finalizeCache() {
+    /* Don't overwrite the snapshot if the cache wasn't used at all */
+    const bool snapshot = initialized.exchange(false) && !_snapshotFile.empty();
+
+    /* Dropped data are evicted, for the snapshot they are in policy order */
+    Evicted snapshotEntries;
+    for(unsigned int i = 0; i != ShardCount; ++i) {
+        Evicted dropped;
+        {
+            lock_guard<mutex> lock(shards[i].mutex);
+            if(snapshot) {
+                vector<CacheKey> keys = shards[i].policy->keys();
+                dropped.reserve(keys.size());
+                for(vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+                    unordered_map<CacheKey, TileData>::const_iterator found = shards[i].entries.find(*it);
+                    if(found != shards[i].entries.end()) dropped.push_back(*found);
+                }
+            } else dropped.assign(shards[i].entries.begin(), shards[i].entries.end());
+            shards[i].entries.clear();
+            shards[i].policy->clear();
+        }
+
+        reportEvicted(dropped);
+        if(snapshot) snapshotEntries.insert(snapshotEntries.end(), dropped.begin(), dropped.end());
+    }
+
+    if(snapshot && !writeSnapshot(snapshotEntries))
+        Error() << "MemoryCache: cannot write snapshot" << _snapshotFile;
+}
+
+void MemoryCache::setCacheSize(size_t size) {
+    _cacheSize = size;
+
+    for(unsigned int i = 0; i != ShardCount; ++i) {
+        vector<CacheKey> keys;
+        Evicted evicted;
+        {
+            lock_guard<mutex> lock(shards[i].mutex);
+            shards[i].policy->setCapacity(shardSize(), &keys);
+            shards[i].remove(keys, &evicted);
+        }
+
+        reportEvicted(evicted);
+    }
+}
+
+size_t MemoryCache::usedSize() const {
+    size_t size = 0;
+    for(unsigned int i = 0; i != ShardCount; ++i) {
+        lock_guard<mutex> lock(shards[i].mutex);
+        size += shards[i].policy->usedSize();
+    }
+
+    return size;
+}
+
+void MemoryCache::purge() {
+    for(unsigned int i = 0; i != ShardCount; ++i) {
+        lock_guard<mutex> lock(shards[i].mutex);
+        shards[i].entries.clear();
+        shards[i].policy->clear();
+    }
+}
+
+TileData MemoryCache::get(const CacheKey& key) {
+    if(!initialized) return TileData();
+
+    Shard& s = shard(key);
+    lock_guard<mutex> lock(s.mutex);
+
+    unordered_map<CacheKey, TileData>::const_iterator found = s.entries.find(key);
+    if(found == s.entries.end()) {
+        s.policy->miss(key);
+        return TileData();
+    }
+
+    s.policy->hit(key);
+    return found->second;
+}
+
+vector<bool> MemoryCache::contains(const vector<CacheKey>& keys) {
+    vector<bool> found(keys.size());
+    if(!initialized) return found;
+
+    for(size_t i = 0; i != keys.size(); ++i) {
+        Shard& s = shard(keys[i]);
+        lock_guard<mutex> lock(s.mutex);
+        found[i] = s.entries.find(keys[i]) != s.entries.end();
+    }
+
+    return found;
+}
+
+bool MemoryCache::set(const CacheKey& key, const TileData& data) {
+    if(!initialized) return false;
+
+    Shard& s = shard(key);
+
+    /* The data would never fit, remove previous version, so it isn't
+       returned instead of the new one */
+    size_t size = sizeof(CacheKey) + data.size();
+    if(size > shardSize()) {
+        lock_guard<mutex> lock(s.mutex);
+        if(s.entries.erase(key)) s.policy->remove(key);
+        return false;
+    }
+
+    vector<CacheKey> keys;
+    Evicted evicted;
+    bool stored;
+    {
+        lock_guard<mutex> lock(s.mutex);
+        s.entries[key] = data;
+        s.policy->insert(key, size, &keys);
+        s.remove(keys, &evicted);
+
+        /* The policy might have rejected the new key right away */
+        stored = s.entries.find(key) != s.entries.end();
+    }
+
+    /* Report the evicted data outside the lock, the listener can take long */
+    reportEvicted(evicted);
+    return stored;
+}
+
+AbstractEvictionPolicy* MemoryCache::createPolicy() const {
+    switch(activeEvictionPolicy) {
+        case Arc:       return new ArcEvictionPolicy(shardSize());
+        case TinyLfu:   return new TinyLfuEvictionPolicy(shardSize());
+        default:        return new LruEvictionPolicy(shardSize());
+    }
+}
+
+void MemoryCache::reportEvicted(const Evicted& entries) {
+    if(!hasEvictionListener() && !hasStatistics()) return;
+
+    for(Evicted::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        evicted(it->first, it->second);
+}
+
+void MemoryCache::restoreSnapshot() {
+    shared_ptr<MappedFile> file(new MappedFile(_snapshotFile));
+    if(!file->isValid() || file->size() < SnapshotHeaderSize || memcmp(file->data(), SnapshotSignature, SignatureSize) != 0)
+        return;
+
+    uint64_t count;
+    uint32_t nameCount;
+    memcpy(&count, file->data()+SignatureSize, sizeof(count));
+    memcpy(&nameCount, file->data()+SignatureSize+sizeof(count), sizeof(nameCount));
+
+    /* IDs of the names can be different in this process */
+    const char* position = file->data()+SnapshotHeaderSize;
+    const char* end = file->data()+file->size();
+    map<uint32_t, uint32_t> ids;
+    for(uint32_t i = 0; i != nameCount; ++i) {
+        uint32_t header[2];
+        if(size_t(end-position) < NameHeaderSize) return;
+        memcpy(header, position, NameHeaderSize);
+        position += NameHeaderSize;
+        if(size_t(end-position) < header[1]) return;
+
+        ids[header[0]] = CacheKey::id(string(position, header[1]));
+        position += header[1];
+    }
+
+    /* Stop at first truncated entry */
+    for(uint64_t i = 0; i != count && size_t(end-position) >= EntryHeaderSize; ++i) {
+        uint32_t header[7];
+        memcpy(header, position, EntryHeaderSize);
+        position += EntryHeaderSize;
+        if(size_t(end-position) < header[6]) break;
+
+        /* Entries with unknown names are skipped */
+        map<uint32_t, uint32_t>::const_iterator model = ids.find(header[1]);
+        map<uint32_t, uint32_t>::const_iterator layer = ids.find(header[2]);
+        if(model == ids.end() || layer == ids.end()) {
+            position += header[6];
+            continue;
+        }
+
+        CacheKey key(static_cast<char>(header[0]), model->second, layer->second, header[3], TileCoords(header[4], header[5]));
+        TileData data(file, position, header[6]);
+        position += header[6];
+
+        /* Cache size could be made smaller since the snapshot was written */
+        size_t size = sizeof(CacheKey) + data.size();
+        if(size > shardSize()) continue;
+
+        Shard& s = shard(key);
+        vector<CacheKey> keys;
+        lock_guard<mutex> lock(s.mutex);
+        s.entries[key] = data;
+        s.policy->insert(key, size, &keys);
+        for(vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+            s.entries.erase(*it);
+    }
+}
+
+bool MemoryCache::writeSnapshot(const Evicted& entries) const {
+    const string temporary = _snapshotFile + ".new";
+    {
+        ofstream file(temporary.c_str(), ofstream::out|ofstream::trunc|ofstream::binary);
+        if(!file.good()) return false;
+
+        /* Entries with IDs which weren't given by CacheKey::id() can't be
+           restored */
+        map<uint32_t, string> names;
+        vector<bool> saved(entries.size());
+        uint64_t count = 0;
+        for(size_t i = 0; i != entries.size(); ++i) {
+            const string model = CacheKey::name(entries[i].first.model());
+            const string layer = CacheKey::name(entries[i].first.layer());
+            if(model.empty() || layer.empty()) continue;
+
+            names[entries[i].first.model()] = model;
+            names[entries[i].first.layer()] = layer;
+            saved[i] = true;
+            ++count;
+        }
+
+        const uint32_t nameCount = names.size();
+        file.write(SnapshotSignature, SignatureSize);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        file.write(reinterpret_cast<const char*>(&nameCount), sizeof(nameCount));
+
+        for(map<uint32_t, string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+            const uint32_t header[2] = { it->first, uint32_t(it->second.size()) };
+            file.write(reinterpret_cast<const char*>(header), NameHeaderSize);
+            file.write(it->second.data(), it->second.size());
+        }
+
+        for(Evicted::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+            if(!saved[it-entries.begin()]) continue;
+
+            const uint32_t header[7] = {
+                uint32_t(static_cast<unsigned char>(it->first.kind())),
+                it->first.model(), it->first.layer(), uint32_t(it->first.z()),
+                it->first.coords().x, it->first.coords().y, uint32_t(it->second.size())
+            };
+            file.write(reinterpret_cast<const char*>(header), EntryHeaderSize);
+            file.write(it->second.data(), it->second.size());
+        }
+
+        file.close();
+        if(!file.good()) {
+            remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    /* Windows can't rename over existing file */
+    #ifdef _WIN32
+    if(remove(_snapshotFile.c_str()) != 0 && errno != ENOENT) {
+        remove(temporary.c_str());
+        return false;
+    }
+    #endif
+    return rename(temporary.c_str(), _snapshotFile.c_str()) == 0;
+}
+
+void MemoryCache::Shard::remove(const vector<CacheKey>& keys, Evicted* evicted) {
+    for(vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+        unordered_map<CacheKey, TileData>::iterator found = entries.find(*it);
+
+        /* Policy could report key which is not (anymore) in the cache */
+        if(found == entries.end()) continue;
+
+        evicted->push_back(*found);
+        entries.erase(found);
+    }
+}
+
+}}
@@ -0,0 +1,179 @@
+#ifndef Kompas_Plugins_MemoryCache_h
+#define Kompas_Plugins_MemoryCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::MemoryCache
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
+#include "AbstractCache.h"
+#include "AbstractEvictionPolicy.h"
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief In-memory cache
+
+Keeps the data in memory, when the cache is full, data are removed according
+to evictionPolicy(). Used size is sum of sizes of all keys and data, the cache
+size is 16 MB by default. The data are indexed directly with Core::CacheKey,
+so no strings are built on lookup. The data are stored as Core::TileData, so
+neither saving nor retrieving them copies the data.
+
+The data are divided into shards by key hash, each shard has its own lock,
+its own part of the cache size and its own eviction policy, so the cache can
+be accessed from many threads at once without much waiting.
+
+The data are lost in finalizeCache(), parameter of initializeCache() is
+ignored. Data removed to make space and data dropped in finalizeCache() are
+passed to eviction listener.
+
+@section MemoryCache_Snapshot Snapshots
+If snapshot file is set with setSnapshotFile(), finalizeCache() writes all
+keys and data into it, ordered by the eviction policy from the least valuable
+entry. initializeCache() then maps the file into memory and inserts the
+entries in the same order, so the data aren't copied, the policy gets
+approximately the same state and the cache is warm right after restart. The
+snapshot is restored only into empty cache. The file stays mapped until all
+restored data are removed from the cache.
+
+The file contains table of model and layer names followed by flat array of
+entries in native byte order, so it can't be moved to machine with different
+architecture. The names get their IDs from Core::CacheKey::id() again on
+restore, as they can be different in new process. Missing or invalid
+snapshot is ignored and the cache starts empty.
+*/
+class CORE_EXPORT MemoryCache: public Core::AbstractCache {
+    public:
+        /** @brief Eviction policy */
+        enum EvictionPolicy {
+            Lru,        /**< @brief Core::LruEvictionPolicy, default */
+            Arc,        /**< @brief Core::ArcEvictionPolicy */
+            TinyLfu     /**< @brief Core::TinyLfuEvictionPolicy */
+        };
+
+        /** @copydoc Core::AbstractCache::AbstractCache */
+        MemoryCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        inline ~MemoryCache() { finalizeCache(); }
+
+        inline int features() const { return 0; }
+
+        /**
+         * @brief Initialize cache
+         *
+         * If eviction policy was changed with setEvictionPolicy(), all data
+         * are removed and new policy is used.
+         */
+        bool initializeCache(const std::string& url);
+
+        /**
+         * @brief Finalize cache
+         *
+         * If snapshot file is set, writes the data into it. The snapshot is
+         * written into temporary file, which then replaces the previous
+         * snapshot, so the data mapped from it stay valid.
+         */
+        void finalizeCache();
+
+        /** @brief Snapshot file */
+        inline std::string snapshotFile() const { return _snapshotFile; }
+
+        /**
+         * @brief Set snapshot file
+         *
+         * The snapshot is restored in next call to initializeCache(), if the
+         * cache is empty. If set to empty string (the default), no snapshot
+         * is written or restored.
+         */
+        inline void setSnapshotFile(const std::string& file) { _snapshotFile = file; }
+
+        /** @brief Eviction policy */
+        inline EvictionPolicy evictionPolicy() const { return _evictionPolicy; }
+
+        /**
+         * @brief Set eviction policy
+         *
+         * The policy is used after next call to initializeCache().
+         * Least recently used policy is fastest, but pre-seeding the cache
+         * or zooming out flushes frequently used data. Other policies keep
+         * them.
+         */
+        inline void setEvictionPolicy(EvictionPolicy policy) { _evictionPolicy = policy; }
+
+        inline size_t cacheSize() const { return _cacheSize; }
+        void setCacheSize(size_t size);
+        size_t usedSize() const;
+
+        void purge();
+
+        /** @brief Does nothing, the data are always in optimal state */
+        inline void optimize() {}
+
+        Core::TileData get(const Core::CacheKey& key);
+        bool set(const Core::CacheKey& key, const Core::TileData& data);
+
+        /**
+         * @brief Check presence of multiple data
+         *
+         * The check is not counted as use of the data by eviction policy.
+         */
+        std::vector<bool> contains(const std::vector<Core::CacheKey>& keys);
+
+    private:
+        static const unsigned int ShardCount = 16;
+
+        typedef std::vector<std::pair<Core::CacheKey, Core::TileData> > Evicted;
+
+        struct Shard {
+            mutable std::mutex mutex;
+            std::unordered_map<Core::CacheKey, Core::TileData> entries;
+            std::unique_ptr<Core::AbstractEvictionPolicy> policy;
+
+            /* Move entries removed by the policy to evicted */
+            void remove(const std::vector<Core::CacheKey>& keys, Evicted* evicted);
+        };
+
+        std::atomic<bool> initialized;
+        std::atomic<size_t> _cacheSize;
+        EvictionPolicy _evictionPolicy, activeEvictionPolicy;
+        std::string _snapshotFile;
+        Shard shards[ShardCount];
+
+        /* Upper bits of the hash, lower are used by the hash tables */
+        inline Shard& shard(const Core::CacheKey& key) {
+            return shards[(key.hash() >> 32)%ShardCount];
+        }
+
+        inline size_t shardSize() const { return _cacheSize/ShardCount; }
+
+        Core::AbstractEvictionPolicy* createPolicy() const;
+        void reportEvicted(const Evicted& entries);
+
+        void restoreSnapshot();
+        bool writeSnapshot(const Evicted& entries) const;
+};
+
+}}
+
+#endif
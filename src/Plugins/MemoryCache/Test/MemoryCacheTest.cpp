@@ -0,0 +1,350 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "MemoryCacheTest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtTest/QTest>
+
+#include "Utility/Directory.h"
+#include "../MemoryCache.h"
+#include "testConfigure.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::MemoryCacheTest)
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+namespace {
+    void readWrite(MemoryCache* cache, unsigned int seed, unsigned int count, atomic<int>* failures) {
+        const string data(1024, 'x');
+
+        /* Mostly reads, every tenth access is write */
+        for(unsigned int i = 0; i != count; ++i) {
+            seed = seed*1103515245 + 12345;
+            TileCoords coords((seed >> 8)%64, (seed >> 16)%64);
+
+            if(i%10 == 0)
+                cache->setRasterTile("Model", "base", 8, coords, data);
+            else {
+                TileData tile = cache->rasterTile("Model", "base", 8, coords);
+                if(!tile.empty() && tile != data) ++*failures;
+            }
+        }
+    }
+}
+
+MemoryCacheTest::MemoryCacheTest(QObject* parent): QObject(parent) {
+    QDir dir;
+    dir.mkpath(MEMORYCACHE_WRITE_TEST_DIR);
+}
+
+void MemoryCacheTest::uninitialized() {
+    MemoryCache cache;
+    QVERIFY(!cache.setRasterTile("Model", "base", 0, TileCoords(0, 0), "data"));
+    QVERIFY(cache.rasterTile("Model", "base", 0, TileCoords(0, 0)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void MemoryCacheTest::setGet() {
+    MemoryCache cache;
+    QVERIFY(cache.initializeCache(""));
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "overlay", 3, TileCoords(1, 2), "overlay tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "overlay", 3, TileCoords(1, 2)) == "overlay tile");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 1)) == "");
+    QVERIFY(cache.rasterTile("Other", "base", 3, TileCoords(1, 2)) == "");
+
+    /* Data are lost after finalization */
+    cache.finalizeCache();
+    QVERIFY(cache.usedSize() == 0);
+    QVERIFY(cache.initializeCache(""));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+}
+
+void MemoryCacheTest::contains() {
+    MemoryCache cache;
+    QVERIFY(cache.contains(vector<CacheKey>(1)) == vector<bool>(1, false));
+    QVERIFY(cache.initializeCache(""));
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(3, 4), "tile"));
+
+    vector<CacheKey> keys;
+    keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 3, TileCoords(1, 2)));
+    keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 3, TileCoords(2, 1)));
+    keys.push_back(CacheKey(AbstractCache::RasterTile, "Model", "base", 3, TileCoords(3, 4)));
+    vector<bool> found = cache.contains(keys);
+    QVERIFY(found.size() == 3);
+    QVERIFY(found[0] && !found[1] && found[2]);
+}
+
+void MemoryCacheTest::replace() {
+    MemoryCache cache;
+    cache.initializeCache("");
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    size_t used = cache.usedSize();
+    QVERIFY(used > 4);
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "bigger tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "bigger tile");
+    QVERIFY(cache.usedSize() == used+7);
+}
+
+void MemoryCacheTest::eviction() {
+    MemoryCache cache;
+    cache.setCacheSize(64*1024);
+    cache.initializeCache("");
+
+    /* Tile which is used all the time is not evicted */
+    const string data(1000, 'x');
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), data));
+    for(unsigned int i = 1; i != 1000; ++i) {
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == data);
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), data));
+        QVERIFY(cache.usedSize() <= cache.cacheSize());
+    }
+
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == data);
+
+    /* Old tiles are evicted */
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(1, 0)) == "");
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(999, 0)) == data);
+}
+
+void MemoryCacheTest::cacheSize() {
+    MemoryCache cache;
+    cache.initializeCache("");
+
+    const string data(1000, 'x');
+    for(unsigned int i = 0; i != 1000; ++i)
+        cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), data);
+    QVERIFY(cache.usedSize() > 1000*1000);
+
+    /* Shrinking the cache removes the data */
+    cache.setCacheSize(128*1024);
+    QVERIFY(cache.cacheSize() == 128*1024);
+    QVERIFY(cache.usedSize() <= 128*1024);
+    QVERIFY(cache.usedSize() > 0);
+}
+
+void MemoryCacheTest::tooLarge() {
+    MemoryCache cache;
+    cache.setCacheSize(16*1024);
+    cache.initializeCache("");
+
+    QVERIFY(!cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), string(2048, 'x')));
+    QVERIFY(cache.usedSize() == 0);
+
+    /* Previous version is removed */
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), "tile"));
+    QVERIFY(!cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), string(2048, 'x')));
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void MemoryCacheTest::evictionListener() {
+    MemoryCache cache;
+    cache.setCacheSize(64*1024);
+    cache.initializeCache("");
+
+    size_t evictedCount = 0;
+    bool evictedValid = true;
+    cache.setEvictionListener([&](const CacheKey& key, const TileData& data) {
+        if(key.kind() != AbstractCache::RasterTile || data != string(1000, 'a'+key.coords().x%26))
+            evictedValid = false;
+        ++evictedCount;
+    });
+
+    for(unsigned int i = 0; i != 1000; ++i)
+        QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), string(1000, 'a'+i%26)));
+
+    /* All tiles which don't fit are evicted */
+    size_t stored = cache.usedSize()/(sizeof(CacheKey)+1000);
+    QVERIFY(evictedCount == 1000-stored);
+    QVERIFY(evictedValid);
+
+    /* The rest is evicted on finalization */
+    cache.finalizeCache();
+    QVERIFY(evictedCount == 1000);
+    QVERIFY(evictedValid);
+}
+
+void MemoryCacheTest::evictionPolicy() {
+    MemoryCache cache;
+    cache.setCacheSize(16*64*1024);
+    QVERIFY(cache.evictionPolicy() == MemoryCache::Lru);
+    cache.initializeCache("");
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), "tile"));
+
+    /* Changing the policy removes all data */
+    cache.setEvictionPolicy(MemoryCache::TinyLfu);
+    cache.initializeCache("");
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == "");
+    QVERIFY(cache.usedSize() == 0);
+
+    /* Frequently used tiles */
+    const string data(1000, 'x');
+    for(unsigned int i = 0; i != 200; ++i) for(unsigned int j = 0; j != 5; ++j)
+        if(cache.rasterTile("Model", "base", 5, TileCoords(i, 0)).empty())
+            QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), data));
+
+    /* Seeding many tiles doesn't flush them */
+    for(unsigned int i = 0; i != 10000; ++i) {
+        cache.setRasterTile("Model", "base", 6, TileCoords(i, 0), data);
+        QVERIFY(cache.usedSize() <= cache.cacheSize());
+    }
+
+    /* Rarely used tile filling whole admission window is rejected right
+       away, which is reported */
+    const string large(cache.cacheSize()/32, 'y');
+    QVERIFY(!cache.setRasterTile("Model", "base", 7, TileCoords(0, 0), large));
+    QVERIFY(cache.rasterTile("Model", "base", 7, TileCoords(0, 0)) == "");
+
+    unsigned int found = 0;
+    for(unsigned int i = 0; i != 200; ++i)
+        if(cache.rasterTile("Model", "base", 5, TileCoords(i, 0)) == data) ++found;
+    QVERIFY(found > 150);
+}
+
+void MemoryCacheTest::purge() {
+    MemoryCache cache;
+    cache.initializeCache("");
+
+    cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile");
+    cache.purge();
+    QVERIFY(cache.usedSize() == 0);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+
+    /* The cache is still usable */
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+}
+
+void MemoryCacheTest::snapshot() {
+    const string file = Directory::join(MEMORYCACHE_WRITE_TEST_DIR, "MemoryCache.snapshot");
+    QFile::remove(QString::fromStdString(file));
+
+    {
+        MemoryCache cache;
+        cache.setSnapshotFile(file);
+
+        /* Missing snapshot is ignored */
+        QVERIFY(cache.initializeCache(""));
+        QVERIFY(cache.usedSize() == 0);
+
+        for(unsigned int i = 0; i != 100; ++i)
+            QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(i, 0), string(100+i, 'a'+i%26)));
+        QVERIFY(cache.setRasterTile("Model", "overlay", 5, TileCoords(0, 0), ""));
+
+        /* Data with IDs without name are not saved */
+        QVERIFY(cache.set(CacheKey(AbstractCache::RasterTile, 0xdeadbeef, CacheKey::id("base"), 5, TileCoords(0, 0)), TileData("unnamed")));
+    }
+    QVERIFY(QFile::exists(QString::fromStdString(file)));
+
+    /* Cache which wasn't initialized doesn't overwrite the snapshot */
+    {
+        MemoryCache cache;
+        cache.setSnapshotFile(file);
+    }
+
+    MemoryCache cache;
+    cache.setSnapshotFile(file);
+    QVERIFY(cache.initializeCache(""));
+    for(unsigned int i = 0; i != 100; ++i)
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(i, 0)) == string(100+i, 'a'+i%26));
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(100, 0)) == "");
+    vector<CacheKey> keys(1, CacheKey(AbstractCache::RasterTile, "Model", "overlay", 5, TileCoords(0, 0)));
+    QVERIFY(cache.contains(keys) == vector<bool>(1, true));
+    QVERIFY(cache.usedSize() == 101*sizeof(CacheKey) + 100*100 + 99*100/2);
+
+    /* Repeated initialization doesn't restore the snapshot over newer data */
+    QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(0, 0), "new"));
+    QVERIFY(cache.initializeCache(""));
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(0, 0)) == "new");
+
+    /* Restored data stay valid when the snapshot is replaced */
+    TileData tile = cache.rasterTile("Model", "base", 5, TileCoords(42, 0));
+    cache.finalizeCache();
+    QVERIFY(tile == string(142, 'a'+42%26));
+    QVERIFY(cache.initializeCache(""));
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(42, 0)) == tile);
+    cache.finalizeCache();
+
+    /* Invalid snapshot is ignored */
+    QFile invalid(QString::fromStdString(file));
+    QVERIFY(invalid.open(QIODevice::WriteOnly|QIODevice::Truncate));
+    invalid.write("KMEMSNP2 and some garbage");
+    invalid.close();
+    QVERIFY(cache.initializeCache(""));
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void MemoryCacheTest::threaded() {
+    MemoryCache cache;
+    cache.setCacheSize(1024*1024);
+    cache.initializeCache("");
+
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 8; ++i)
+        threads.push_back(thread(readWrite, &cache, i, 10000, &failures));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    QVERIFY(failures == 0);
+    QVERIFY(cache.usedSize() <= cache.cacheSize());
+}
+
+void MemoryCacheTest::benchmark_data() {
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("8 threads") << 8;
+}
+
+void MemoryCacheTest::benchmark() {
+    QFETCH(int, threadCount);
+
+    MemoryCache cache;
+    cache.setCacheSize(16*1024*1024);
+    cache.initializeCache("");
+
+    /* Every thread does the same amount of work, so with perfect scaling the
+       time stays the same for any thread count */
+    atomic<int> failures(0);
+    QBENCHMARK {
+        vector<thread> threads;
+        for(int i = 0; i != threadCount; ++i)
+            threads.push_back(thread(readWrite, &cache, i, 100000, &failures));
+        for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+            it->join();
+    }
+
+    QVERIFY(failures == 0);
+}
+
+}}}
@@ -0,0 +1 @@
+#define MEMORYCACHE_WRITE_TEST_DIR "${CMAKE_CURRENT_BINARY_DIR}/MemoryCacheTestFiles/"
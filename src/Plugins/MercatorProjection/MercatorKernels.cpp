@@ -0,0 +1,104 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+    Copyright © 2010 Jan Dupal <dupal.j@seznam.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+#include "MercatorKernels.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#endif
+
+#include "constants.h"
+
+using namespace std;
+
+namespace Kompas { namespace Plugins { namespace Implementation {
+
+namespace {
+    /* The same range checks as in LatLonCoords */
+    inline void normalize(double& latitude, double& longitude) {
+        if(!(longitude >= -180.0 && longitude <= 180.0 && latitude >= -90.0 && latitude <= 90.0))
+            latitude = longitude = 0;
+        else if(longitude == -180) longitude = 180;
+    }
+
+    void forward(const MercatorCoefficients& c, const double* latitude, const double* longitude, double* x, double* y, size_t count) {
+        for(size_t i = 0; i != count; ++i) {
+            double lat = latitude[i], lon = longitude[i];
+            normalize(lat, lon);
+
+            /* ln(tan + 1/cos) = ln((1 + sin)/cos), which is odd function, so
+               it's computed for positive latitude to avoid cancellation */
+            const double l = abs(lat)*PI/180;
+            const double m = log((1 + sin(l))/cos(l));
+            x[i] = lon*c.xScale + c.xOffset;
+            y[i] = (lat < 0 ? -m : m)*c.yScale + c.yOffset;
+        }
+    }
+
+    void inverse(const MercatorCoefficients& c, const double* x, const double* y, double* latitude, double* longitude, size_t count) {
+        for(size_t i = 0; i != count; ++i) {
+            /* e^-y = 1/e^y, so only one exponential is needed */
+            const double e = exp((1 - 2*(y[i]*c.yScale - c.yOffset))*PI);
+            latitude[i] = atan(0.5*(e - 1/e))*180/PI;
+            longitude[i] = (2*(x[i]*c.xScale - c.xOffset) - 1)*180;
+            normalize(latitude[i], longitude[i]);
+        }
+    }
+}
+
+int mercatorCpuFeatures() {
+    int features = 0;
+
+    #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+    if(ecx & bit_SSE4_1) features |= Sse41;
+
+    /* AVX registers must be enabled by OS, which is reported in XCR0 */
+    if((ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_max(0, 0) >= 7) {
+        unsigned int xcr0, xcr0High;
+        __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if((xcr0 & 6) == 6 && (ebx & bit_AVX2)) features |= Avx2;
+    }
+    #endif
+
+    return features;
+}
+
+MercatorKernels mercatorKernelsScalar() {
+    MercatorKernels kernels = {forward, inverse, "scalar"};
+    return kernels;
+}
+
+namespace {
+    MercatorKernels fastestKernels() {
+        const int features = mercatorCpuFeatures();
+        MercatorKernels kernels;
+        if((features & Avx2) && (kernels = mercatorKernelsAvx2()).forward) return kernels;
+        if((features & Sse41) && (kernels = mercatorKernelsSse41()).forward) return kernels;
+        return mercatorKernelsScalar();
+    }
+}
+
+const MercatorKernels& mercatorKernels() {
+    static const MercatorKernels kernels = fastestKernels();
+    return kernels;
+}
+
+}}}
@@ -0,0 +1,100 @@
+#ifndef Kompas_Plugins_MercatorKernels_h
+#define Kompas_Plugins_MercatorKernels_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Array kernels of Kompas::Plugins::MercatorProjection
+ */
+
+#include <cstddef>
+
+#include "utilities.h"
+
+namespace Kompas { namespace Plugins { namespace Implementation {
+
+/**
+@brief Coefficients of Mercator kernels
+
+Shift, stretch and range conversions of both coordinates combined into one
+multiplication and addition. Forward kernels compute
+<tt>x = longitude*xScale + xOffset</tt>, inverse kernels compute
+<tt>x*xScale - xOffset</tt> before the range conversion.
+*/
+struct MercatorCoefficients {
+    double xScale,      /**< @brief X scale */
+        xOffset,        /**< @brief X offset */
+        yScale,         /**< @brief Y scale */
+        yOffset;        /**< @brief Y offset */
+};
+
+/**
+@brief Mercator kernel
+
+Converts @p count points from arrays @p a and @p b (latitudes and longitudes
+for forward kernel, X and Y for inverse kernel) and saves them to arrays
+@p outA and @p outB. Lat/lon coordinates out of range are treated as zero.
+*/
+typedef void(*MercatorKernel)(const MercatorCoefficients& coefficients, const double* a, const double* b, double* outA, double* outB, size_t count);
+
+/** @brief Set of Mercator kernels for one instruction set */
+struct MercatorKernels {
+    MercatorKernel forward,     /**< @brief Forward projection */
+        inverse;                /**< @brief Inverse projection */
+    const char* name;           /**< @brief Instruction set name */
+};
+
+/** @brief CPU features usable by Mercator kernels */
+enum MercatorCpuFeature {
+    Sse41 = 1,                  /**< @brief SSE4.1 */
+    Avx2 = 2                    /**< @brief AVX2, including OS support */
+};
+
+/** @brief CPU features supported by current CPU */
+CORE_EXPORT int mercatorCpuFeatures();
+
+/**
+@brief Scalar kernels
+
+Available everywhere, use the standard math library.
+*/
+CORE_EXPORT MercatorKernels mercatorKernelsScalar();
+
+/**
+@brief SSE4.1 kernels
+
+If the kernels were not compiled in, the functions are null. They must be
+used only if mercatorCpuFeatures() contains @ref Sse41.
+*/
+CORE_EXPORT MercatorKernels mercatorKernelsSse41();
+
+/**
+@brief AVX2 kernels
+
+If the kernels were not compiled in, the functions are null. They must be
+used only if mercatorCpuFeatures() contains @ref Avx2.
+*/
+CORE_EXPORT MercatorKernels mercatorKernelsAvx2();
+
+/**
+@brief Fastest kernels for current CPU
+
+Chosen on first call.
+*/
+CORE_EXPORT const MercatorKernels& mercatorKernels();
+
+}}}
+
+#endif
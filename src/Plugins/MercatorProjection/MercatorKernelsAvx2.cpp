@@ -0,0 +1,84 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+    Copyright © 2010 Jan Dupal <dupal.j@seznam.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+#include "MercatorKernels.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+#include "MercatorKernelsSimd.h"
+#endif
+
+namespace Kompas { namespace Plugins { namespace Implementation {
+
+#ifdef __AVX2__
+namespace {
+    struct Avx2Vector {
+        typedef __m256d Type;
+        enum { Size = 4 };
+
+        static inline Type set(double value) { return _mm256_set1_pd(value); }
+        static inline Type load(const double* data) { return _mm256_loadu_pd(data); }
+        static inline void store(double* data, Type value) { _mm256_storeu_pd(data, value); }
+
+        static inline Type add(Type a, Type b) { return _mm256_add_pd(a, b); }
+        static inline Type sub(Type a, Type b) { return _mm256_sub_pd(a, b); }
+        static inline Type mul(Type a, Type b) { return _mm256_mul_pd(a, b); }
+        static inline Type div(Type a, Type b) { return _mm256_div_pd(a, b); }
+        static inline Type min(Type a, Type b) { return _mm256_min_pd(a, b); }
+        static inline Type max(Type a, Type b) { return _mm256_max_pd(a, b); }
+
+        static inline Type less(Type a, Type b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static inline Type lessEqual(Type a, Type b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static inline Type greaterEqual(Type a, Type b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+        static inline Type equal(Type a, Type b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+
+        static inline Type bitAnd(Type a, Type b) { return _mm256_and_pd(a, b); }
+        static inline Type bitOr(Type a, Type b) { return _mm256_or_pd(a, b); }
+        static inline Type bitXor(Type a, Type b) { return _mm256_xor_pd(a, b); }
+        static inline Type bitAndNot(Type a, Type b) { return _mm256_andnot_pd(a, b); }
+        static inline Type select(Type mask, Type a, Type b) { return _mm256_blendv_pd(b, a, mask); }
+
+        static inline Type round(Type a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC); }
+
+        static inline Type pow2(Type k) {
+            /* Adding 1.5*2^52 puts the integer into low bits of mantissa */
+            const __m256i magic = _mm256_castpd_si256(_mm256_set1_pd(6755399441055744.0));
+            const __m256i i = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(6755399441055744.0))), magic);
+            return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(i, _mm256_set1_epi64x(1023)), 52));
+        }
+
+        static inline Type split(Type x, Type& mantissa) {
+            const __m256i bits = _mm256_castpd_si256(x);
+            mantissa = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFll)), _mm256_set1_epi64x(0x3FF0000000000000ll)));
+
+            /* Biased exponent put into mantissa of 2^52 */
+            const Type e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000ll)));
+            return _mm256_sub_pd(e, _mm256_set1_pd(4503599627371519.0));
+        }
+    };
+}
+
+MercatorKernels mercatorKernelsAvx2() {
+    return kernels<Avx2Vector>("avx2");
+}
+#else
+MercatorKernels mercatorKernelsAvx2() {
+    MercatorKernels kernels = {0, 0, "avx2"};
+    return kernels;
+}
+#endif
+
+}}}
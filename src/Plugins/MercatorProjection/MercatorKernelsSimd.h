@@ -0,0 +1,254 @@
+#ifndef Kompas_Plugins_MercatorKernelsSimd_h
+#define Kompas_Plugins_MercatorKernelsSimd_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Generic SIMD implementation of Mercator kernels
+ *
+ * Included only by the files which instantiate the kernels for one
+ * instruction set. Everything is in anonymous namespace, so each instruction
+ * set has its own copy of the code and the linker can't mix them.
+ */
+
+#include "MercatorKernels.h"
+#include "constants.h"
+
+namespace Kompas { namespace Plugins { namespace Implementation { namespace {
+
+/*
+Vector type V must provide:
+
+ - typedef Type and enum value Size -- count of doubles in the vector
+ - set(), load(), store() -- broadcast, unaligned load and store
+ - add(), sub(), mul(), div(), min(), max()
+ - less(), lessEqual(), greaterEqual(), equal() -- comparisons returning
+   masks with all bits set or cleared
+ - bitAnd(), bitOr(), bitXor(), bitAndNot() -- bit operations, bitAndNot()
+   computes ~a & b
+ - select(mask, a, b) -- a where mask is set, b otherwise
+ - round() -- round to nearest integer
+ - pow2(k) -- 2^k for integral k in range [-1022, 1023]
+ - split(x, mantissa) -- returns exponent of positive normal x and saves
+   mantissa in range [1; 2)
+*/
+
+const double PiHalfHigh = 1.5707963267948966;      /* pi/2 in two parts */
+const double PiHalfLow = 6.123233995736766e-17;
+const double PiQuarter = 0.78539816339744831;
+const double Ln2High = 0.6931471803691238;          /* ln 2 in two parts */
+const double Ln2Low = 1.9082149292705877e-10;
+const double Log2E = 1.4426950408889634;
+const double Sqrt2 = 1.4142135623730951;
+
+/* sin(x) for |x| <= pi/4, Taylor polynomial to x^17 */
+template<class V> inline typename V::Type sinPolynomial(typename V::Type x) {
+    const typename V::Type x2 = V::mul(x, x);
+    typename V::Type p = V::set(1.0/355687428096000.0);
+    p = V::add(V::mul(p, x2), V::set(-1.0/1307674368000.0));
+    p = V::add(V::mul(p, x2), V::set(1.0/6227020800.0));
+    p = V::add(V::mul(p, x2), V::set(-1.0/39916800.0));
+    p = V::add(V::mul(p, x2), V::set(1.0/362880.0));
+    p = V::add(V::mul(p, x2), V::set(-1.0/5040.0));
+    p = V::add(V::mul(p, x2), V::set(1.0/120.0));
+    p = V::add(V::mul(p, x2), V::set(-1.0/6.0));
+    return V::add(x, V::mul(V::mul(x, x2), p));
+}
+
+/* cos(x) for |x| <= pi/4, Taylor polynomial to x^18 */
+template<class V> inline typename V::Type cosPolynomial(typename V::Type x) {
+    const typename V::Type x2 = V::mul(x, x);
+    typename V::Type p = V::set(-1.0/6402373705728000.0);
+    p = V::add(V::mul(p, x2), V::set(1.0/20922789888000.0));
+    p = V::add(V::mul(p, x2), V::set(-1.0/87178291200.0));
+    p = V::add(V::mul(p, x2), V::set(1.0/479001600.0));
+    p = V::add(V::mul(p, x2), V::set(-1.0/3628800.0));
+    p = V::add(V::mul(p, x2), V::set(1.0/40320.0));
+    p = V::add(V::mul(p, x2), V::set(-1.0/720.0));
+    p = V::add(V::mul(p, x2), V::set(1.0/24.0));
+    p = V::add(V::mul(p, x2), V::set(-0.5));
+    return V::add(V::set(1.0), V::mul(x2, p));
+}
+
+/* ln(x) for positive normal x. With mantissa m in [sqrt(1/2); sqrt(2)),
+   ln(m) = 2 atanh(z) for z = (m - 1)/(m + 1), |z| <= 0.1716 */
+template<class V> inline typename V::Type log(typename V::Type x) {
+    typename V::Type m;
+    typename V::Type e = V::split(x, m);
+    const typename V::Type above = V::less(V::set(Sqrt2), m);
+    m = V::select(above, V::mul(m, V::set(0.5)), m);
+    e = V::select(above, V::add(e, V::set(1.0)), e);
+
+    const typename V::Type z = V::div(V::sub(m, V::set(1.0)), V::add(m, V::set(1.0)));
+    const typename V::Type z2 = V::mul(z, z);
+    typename V::Type p = V::set(2.0/23.0);
+    p = V::add(V::mul(p, z2), V::set(2.0/21.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/19.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/17.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/15.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/13.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/11.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/9.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/7.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/5.0));
+    p = V::add(V::mul(p, z2), V::set(2.0/3.0));
+    const typename V::Type lnm = V::add(V::add(z, z), V::mul(V::mul(z, z2), p));
+
+    return V::add(V::mul(e, V::set(Ln2High)), V::add(lnm, V::mul(e, V::set(Ln2Low))));
+}
+
+/* e^x for |x| <= 708. With x = k ln 2 + r, |r| <= ln(2)/2, e^x = 2^k e^r */
+template<class V> inline typename V::Type exp(typename V::Type x) {
+    const typename V::Type k = V::round(V::mul(x, V::set(Log2E)));
+    const typename V::Type r = V::sub(V::sub(x, V::mul(k, V::set(Ln2High))), V::mul(k, V::set(Ln2Low)));
+
+    static const double factorials[] = {
+        1.0/87178291200.0, 1.0/6227020800.0, 1.0/479001600.0, 1.0/39916800.0,
+        1.0/3628800.0, 1.0/362880.0, 1.0/40320.0, 1.0/5040.0, 1.0/720.0,
+        1.0/120.0, 1.0/24.0, 1.0/6.0, 0.5, 1.0, 1.0
+    };
+    typename V::Type p = V::set(factorials[0]);
+    for(size_t i = 1; i != sizeof(factorials)/sizeof(double); ++i)
+        p = V::add(V::mul(p, r), V::set(factorials[i]));
+
+    return V::mul(p, V::pow2(k));
+}
+
+/* atan(x). Absolute value a is reduced to [0; 1] using atan(a) = pi/2 -
+   atan(1/a) and then to |w| <= tan(pi/24) around the nearest multiple of
+   pi/12, using atan(a) = atan(c) + atan((a - c)/(1 + a c)). For inverted
+   value it's (1 - a c)/(a + c), so only one division is needed. */
+template<class V> inline typename V::Type atan(typename V::Type x) {
+    const typename V::Type sign = V::bitAnd(x, V::set(-0.0));
+    const typename V::Type a = V::bitAndNot(V::set(-0.0), x);
+    const typename V::Type inverted = V::less(V::set(1.0), a);
+
+    /* Thresholds are tan(pi/24), tan(3pi/24) and tan(5pi/24), for inverted
+       value compared with their inverse */
+    const typename V::Type above1 = V::select(inverted, V::lessEqual(a, V::set(7.5957541127251513)), V::greaterEqual(a, V::set(0.13165249758739583)));
+    const typename V::Type above2 = V::select(inverted, V::lessEqual(a, V::set(2.4142135623730949)), V::greaterEqual(a, V::set(0.41421356237309503)));
+    const typename V::Type above3 = V::select(inverted, V::lessEqual(a, V::set(1.3032253728412058)), V::greaterEqual(a, V::set(0.76732698797896042)));
+    const typename V::Type c = V::select(above3, V::set(1.0),
+        V::select(above2, V::set(0.57735026918962573),
+        V::bitAnd(above1, V::set(0.26794919243112270))));
+    const typename V::Type base = V::select(above3, V::set(PiQuarter),
+        V::select(above2, V::set(0.52359877559829882),
+        V::bitAnd(above1, V::set(0.26179938779914941))));
+
+    const typename V::Type ac = V::mul(a, c);
+    const typename V::Type w = V::div(
+        V::select(inverted, V::sub(V::set(1.0), ac), V::sub(a, c)),
+        V::select(inverted, V::add(a, c), V::add(V::set(1.0), ac)));
+    const typename V::Type w2 = V::mul(w, w);
+    typename V::Type p = V::set(-1.0/19.0);
+    p = V::add(V::mul(p, w2), V::set(1.0/17.0));
+    p = V::add(V::mul(p, w2), V::set(-1.0/15.0));
+    p = V::add(V::mul(p, w2), V::set(1.0/13.0));
+    p = V::add(V::mul(p, w2), V::set(-1.0/11.0));
+    p = V::add(V::mul(p, w2), V::set(1.0/9.0));
+    p = V::add(V::mul(p, w2), V::set(-1.0/7.0));
+    p = V::add(V::mul(p, w2), V::set(1.0/5.0));
+    p = V::add(V::mul(p, w2), V::set(-1.0/3.0));
+    typename V::Type t = V::add(base, V::add(w, V::mul(V::mul(w, w2), p)));
+
+    t = V::select(inverted, V::add(V::sub(V::set(PiHalfHigh), t), V::set(PiHalfLow)), t);
+    return V::bitOr(t, sign);
+}
+
+/* The same range checks as in LatLonCoords, out of range coordinates are
+   zeroed, -180° longitude is converted to 180° */
+template<class V> inline void normalize(typename V::Type& latitude, typename V::Type& longitude) {
+    const typename V::Type valid = V::bitAnd(
+        V::bitAnd(V::greaterEqual(longitude, V::set(-180.0)), V::lessEqual(longitude, V::set(180.0))),
+        V::bitAnd(V::greaterEqual(latitude, V::set(-90.0)), V::lessEqual(latitude, V::set(90.0))));
+    latitude = V::bitAnd(valid, latitude);
+    longitude = V::bitAnd(valid, longitude);
+    longitude = V::select(V::equal(longitude, V::set(-180.0)), V::set(180.0), longitude);
+}
+
+template<class V> inline void forward(const MercatorCoefficients& c, typename V::Type latitude, typename V::Type longitude, typename V::Type& x, typename V::Type& y) {
+    normalize<V>(latitude, longitude);
+
+    /* ln((1 + sin)/cos) is computed for positive latitude to avoid
+       cancellation. The multiplication and division are done in the same
+       order as in the scalar version, so the angle is exactly the same. */
+    const typename V::Type l = V::div(V::mul(V::bitAndNot(V::set(-0.0), latitude), V::set(PI)), V::set(180.0));
+
+    /* Above pi/4 sin and cos are computed from pi/2 - l, with pi/2 in two
+       parts, so cos is precise also near the pole */
+    const typename V::Type small = V::lessEqual(l, V::set(PiQuarter));
+    const typename V::Type reduced = V::select(small, l, V::add(V::sub(V::set(PiHalfHigh), l), V::set(PiHalfLow)));
+    const typename V::Type s = sinPolynomial<V>(reduced);
+    const typename V::Type k = cosPolynomial<V>(reduced);
+    const typename V::Type sin = V::select(small, s, k);
+    const typename V::Type cos = V::select(small, k, s);
+
+    typename V::Type m = log<V>(V::div(V::add(V::set(1.0), sin), cos));
+    m = V::bitXor(m, V::bitAnd(latitude, V::set(-0.0)));
+
+    x = V::add(V::mul(longitude, V::set(c.xScale)), V::set(c.xOffset));
+    y = V::add(V::mul(m, V::set(c.yScale)), V::set(c.yOffset));
+}
+
+template<class V> inline void inverse(const MercatorCoefficients& c, typename V::Type x, typename V::Type y, typename V::Type& latitude, typename V::Type& longitude) {
+    /* Beyond the clamp the latitude is 90° anyway */
+    typename V::Type t = V::mul(V::sub(V::set(1.0), V::mul(V::set(2.0), V::sub(V::mul(y, V::set(c.yScale)), V::set(c.yOffset)))), V::set(PI));
+    t = V::min(V::max(t, V::set(-708.0)), V::set(708.0));
+
+    /* e^-y = 1/e^y, so only one exponential is needed */
+    const typename V::Type e = exp<V>(t);
+    const typename V::Type sinh = V::mul(V::set(0.5), V::sub(e, V::div(V::set(1.0), e)));
+    latitude = V::mul(atan<V>(sinh), V::set(180/PI));
+    longitude = V::mul(V::sub(V::mul(V::set(2.0), V::sub(V::mul(x, V::set(c.xScale)), V::set(c.xOffset))), V::set(1.0)), V::set(180.0));
+
+    normalize<V>(latitude, longitude);
+}
+
+/* Kernel processing whole vectors, the rest is padded with zeros */
+template<class V, void(*f)(const MercatorCoefficients&, typename V::Type, typename V::Type, typename V::Type&, typename V::Type&)> void kernel(const MercatorCoefficients& c, const double* a, const double* b, double* outA, double* outB, size_t count) {
+    typename V::Type resultA, resultB;
+
+    size_t i = 0;
+    for(; i + V::Size <= count; i += V::Size) {
+        f(c, V::load(a+i), V::load(b+i), resultA, resultB);
+        V::store(outA+i, resultA);
+        V::store(outB+i, resultB);
+    }
+
+    if(i == count) return;
+
+    double restA[V::Size] = {}, restB[V::Size] = {};
+    for(size_t j = i; j != count; ++j) {
+        restA[j-i] = a[j];
+        restB[j-i] = b[j];
+    }
+
+    f(c, V::load(restA), V::load(restB), resultA, resultB);
+    V::store(restA, resultA);
+    V::store(restB, resultB);
+    for(size_t j = i; j != count; ++j) {
+        outA[j] = restA[j-i];
+        outB[j] = restB[j-i];
+    }
+}
+
+template<class V> MercatorKernels kernels(const char* name) {
+    MercatorKernels k = {kernel<V, forward<V> >, kernel<V, inverse<V> >, name};
+    return k;
+}
+
+}}}}
+
+#endif
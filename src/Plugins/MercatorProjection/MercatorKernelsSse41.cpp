@@ -0,0 +1,84 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+    Copyright © 2010 Jan Dupal <dupal.j@seznam.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+#include "MercatorKernels.h"
+
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+
+#include "MercatorKernelsSimd.h"
+#endif
+
+namespace Kompas { namespace Plugins { namespace Implementation {
+
+#ifdef __SSE4_1__
+namespace {
+    struct Sse41Vector {
+        typedef __m128d Type;
+        enum { Size = 2 };
+
+        static inline Type set(double value) { return _mm_set1_pd(value); }
+        static inline Type load(const double* data) { return _mm_loadu_pd(data); }
+        static inline void store(double* data, Type value) { _mm_storeu_pd(data, value); }
+
+        static inline Type add(Type a, Type b) { return _mm_add_pd(a, b); }
+        static inline Type sub(Type a, Type b) { return _mm_sub_pd(a, b); }
+        static inline Type mul(Type a, Type b) { return _mm_mul_pd(a, b); }
+        static inline Type div(Type a, Type b) { return _mm_div_pd(a, b); }
+        static inline Type min(Type a, Type b) { return _mm_min_pd(a, b); }
+        static inline Type max(Type a, Type b) { return _mm_max_pd(a, b); }
+
+        static inline Type less(Type a, Type b) { return _mm_cmplt_pd(a, b); }
+        static inline Type lessEqual(Type a, Type b) { return _mm_cmple_pd(a, b); }
+        static inline Type greaterEqual(Type a, Type b) { return _mm_cmpge_pd(a, b); }
+        static inline Type equal(Type a, Type b) { return _mm_cmpeq_pd(a, b); }
+
+        static inline Type bitAnd(Type a, Type b) { return _mm_and_pd(a, b); }
+        static inline Type bitOr(Type a, Type b) { return _mm_or_pd(a, b); }
+        static inline Type bitXor(Type a, Type b) { return _mm_xor_pd(a, b); }
+        static inline Type bitAndNot(Type a, Type b) { return _mm_andnot_pd(a, b); }
+        static inline Type select(Type mask, Type a, Type b) { return _mm_blendv_pd(b, a, mask); }
+
+        static inline Type round(Type a) { return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC); }
+
+        static inline Type pow2(Type k) {
+            /* Adding 1.5*2^52 puts the integer into low bits of mantissa */
+            const __m128i magic = _mm_castpd_si128(_mm_set1_pd(6755399441055744.0));
+            const __m128i i = _mm_sub_epi64(_mm_castpd_si128(_mm_add_pd(k, _mm_set1_pd(6755399441055744.0))), magic);
+            return _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(i, _mm_set1_epi64x(1023)), 52));
+        }
+
+        static inline Type split(Type x, Type& mantissa) {
+            const __m128i bits = _mm_castpd_si128(x);
+            mantissa = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFll)), _mm_set1_epi64x(0x3FF0000000000000ll)));
+
+            /* Biased exponent put into mantissa of 2^52 */
+            const Type e = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), _mm_set1_epi64x(0x4330000000000000ll)));
+            return _mm_sub_pd(e, _mm_set1_pd(4503599627371519.0));
+        }
+    };
+}
+
+MercatorKernels mercatorKernelsSse41() {
+    return kernels<Sse41Vector>("sse4.1");
+}
+#else
+MercatorKernels mercatorKernelsSse41() {
+    MercatorKernels kernels = {0, 0, "sse4.1"};
+    return kernels;
+}
+#endif
+
+}}}
@@ -17,8 +17,10 @@
 #include "MercatorProjection.h"
 
 #include <cmath>
+#include <algorithm>
 
 #include "constants.h"
+#include "MercatorKernels.h"
 
 using namespace std;
 using namespace Kompas::Core;
@@ -28,6 +30,21 @@ PLUGIN_REGISTER(MercatorProjection, Kompas::Plugins::MercatorProjection,
 
 namespace Kompas { namespace Plugins {
 
+namespace {
+    /* Points of array variants are converted in chunks of this size */
+    const size_t ChunkSize = 256;
+
+    Implementation::MercatorCoefficients forwardCoefficients(const Coords<double>& stretch, const Coords<double>& shift) {
+        Implementation::MercatorCoefficients c = {stretch.x/360, stretch.x/2 + shift.x, -stretch.y/(2*PI), stretch.y/2 + shift.y};
+        return c;
+    }
+
+    Implementation::MercatorCoefficients inverseCoefficients(const Coords<double>& stretch, const Coords<double>& shift) {
+        Implementation::MercatorCoefficients c = {1/stretch.x, shift.x, 1/stretch.y, shift.y};
+        return c;
+    }
+}
+
 MercatorProjection::MercatorProjection(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractProjection(manager, plugin), stretch(Coords<double>(1, 1)), shift(Coords<double>(0, 0)) {
     _seams.reserve(3);
     _seams.push_back(LatLonCoords(60, 180));
@@ -73,6 +90,54 @@ LatLonCoords MercatorProjection::toLatLon(const Coords<double>& coords) const {
     return LatLonCoords(latitude, longitude);
 }
 
+void MercatorProjection::fromLatLon(const double* latitude, const double* longitude, double* x, double* y, size_t count) const {
+    Implementation::mercatorKernels().forward(forwardCoefficients(stretch, shift), latitude, longitude, x, y, count);
+}
+
+void MercatorProjection::toLatLon(const double* x, const double* y, double* latitude, double* longitude, size_t count) const {
+    Implementation::mercatorKernels().inverse(inverseCoefficients(stretch, shift), x, y, latitude, longitude, count);
+}
+
+void MercatorProjection::fromLatLon(const LatLonCoords* coords, Coords<double>* out, size_t count) const {
+    const Implementation::MercatorCoefficients c = forwardCoefficients(stretch, shift);
+    const Implementation::MercatorKernel forward = Implementation::mercatorKernels().forward;
+
+    /* Split the coordinates into separate arrays for the kernel */
+    double a[ChunkSize], b[ChunkSize], x[ChunkSize], y[ChunkSize];
+    for(size_t offset = 0; offset < count; offset += ChunkSize) {
+        const size_t size = min(ChunkSize, count-offset);
+        for(size_t i = 0; i != size; ++i) {
+            a[i] = coords[offset+i].latitude();
+            b[i] = coords[offset+i].longitude();
+        }
+
+        forward(c, a, b, x, y, size);
+        for(size_t i = 0; i != size; ++i)
+            out[offset+i] = Coords<double>(x[i], y[i]);
+    }
+}
+
+void MercatorProjection::toLatLon(const Coords<double>* coords, LatLonCoords* out, size_t count) const {
+    const Implementation::MercatorCoefficients c = inverseCoefficients(stretch, shift);
+    const Implementation::MercatorKernel inverse = Implementation::mercatorKernels().inverse;
+
+    double a[ChunkSize], b[ChunkSize], latitude[ChunkSize], longitude[ChunkSize];
+    for(size_t offset = 0; offset < count; offset += ChunkSize) {
+        const size_t size = min(ChunkSize, count-offset);
+        for(size_t i = 0; i != size; ++i) {
+            a[i] = coords[offset+i].x;
+            b[i] = coords[offset+i].y;
+        }
+
+        /* The kernel zeroes coordinates out of range, these are converted
+           again to get invalid coordinates */
+        inverse(c, a, b, latitude, longitude, size);
+        for(size_t i = 0; i != size; ++i)
+            out[offset+i] = latitude[i] == 0 && longitude[i] == 0 ?
+                toLatLon(coords[offset+i]) : LatLonCoords(latitude[i], longitude[i]);
+    }
+}
+
 vector<LatLonCoords> MercatorProjection::seams() const {
     if(stretch == Coords<double>(1, 1) && shift == Coords<double>(0, 0))
         return _seams;
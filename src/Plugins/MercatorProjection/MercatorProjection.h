@@ -48,6 +48,16 @@ Longtitude is reprojected to Y coordinate and converted to range
     \right)
 @f]
 Coordinate calculation based on http://wiki.openstreetmap.org/wiki/Slippy_map_tilenames
+@section MercatorProjection_arrays Converting arrays of coordinates
+Variants for arrays of coordinates compute shift, stretch and range
+conversions only once for all points and use equivalent formulas with less
+transcendental functions -- @f$ \ln \frac{1 + \sin latitude}{\cos latitude} @f$
+for the forward projection and only one exponential for the inverse
+projection. On x86 processors with SSE4.1 or AVX2 the points are converted
+with SIMD instructions, using polynomial approximations of the transcendental
+functions. The instruction set is chosen at runtime, other processors use
+the standard math library. The results differ from the single point variants
+by less than @f$ 10^{-9} @f$.
  */
 class CORE_EXPORT MercatorProjection: public Core::AbstractProjection {
     public:
@@ -56,6 +66,10 @@ class CORE_EXPORT MercatorProjection: public Core::AbstractProjection {
 
         Core::Coords<double> fromLatLon(const Core::LatLonCoords& coords) const;
         Core::LatLonCoords toLatLon(const Core::Coords<double>& coords) const;
+        void fromLatLon(const double* latitude, const double* longitude, double* x, double* y, size_t count) const;
+        void toLatLon(const double* x, const double* y, double* latitude, double* longitude, size_t count) const;
+        void fromLatLon(const Core::LatLonCoords* coords, Core::Coords<double>* out, size_t count) const;
+        void toLatLon(const Core::Coords<double>* coords, Core::LatLonCoords* out, size_t count) const;
         std::vector<Core::LatLonCoords> seams() const;
 
         /**
@@ -16,14 +16,18 @@
 
 #include "MercatorProjectionTest.h"
 
+#include <cmath>
+#include <vector>
 #include <QtTest/QTest>
 #include <QtCore/QDebug>
 
 #include "LatLonCoords.h"
+#include "../MercatorKernels.h"
 
 Q_DECLARE_METATYPE(Kompas::Core::LatLonCoords)
 QTEST_APPLESS_MAIN(Kompas::Plugins::Test::MercatorProjectionTest)
 
+using namespace std;
 using namespace Kompas::Core;
 
 namespace Kompas { namespace Plugins { namespace Test {
@@ -46,4 +50,186 @@ void MercatorProjectionTest::coords() {
     QVERIFY(projection.toLatLon(projection.fromLatLon(coords)) == coords);
 }
 
+namespace {
+    /* Points all over the world, including seams and out of range, poles
+       are projected to infinity */
+    void points(vector<double>& latitude, vector<double>& longitude) {
+        for(int lat = -95; lat <= 95; lat += 5) if(lat != -90 && lat != 90)
+            for(int lon = -185; lon <= 185; lon += 5) {
+                latitude.push_back(lat + 0.123456789);
+                longitude.push_back(lon - 0.987654321);
+                latitude.push_back(lat);
+                longitude.push_back(lon);
+            }
+    }
+
+    bool equal(double a, double b) {
+        return abs(a - b) < 1.0e-9;
+    }
+
+    bool equal(const LatLonCoords& a, const LatLonCoords& b) {
+        return a.isValid() == b.isValid() && equal(a.latitude(), b.latitude()) && equal(a.longitude(), b.longitude());
+    }
+}
+
+void MercatorProjectionTest::arrays() {
+    MercatorProjection p;
+    p.setStretch(Coords<double>(0.5, 0.25));
+    p.setShift(Coords<double>(0.125, 0.5));
+
+    vector<double> latitude, longitude;
+    points(latitude, longitude);
+    const size_t count = latitude.size();
+
+    /* Forward, separate arrays */
+    vector<double> x(count), y(count);
+    p.fromLatLon(&latitude[0], &longitude[0], &x[0], &y[0], count);
+    for(size_t i = 0; i != count; ++i) {
+        const Coords<double> expected = p.fromLatLon(LatLonCoords(latitude[i], longitude[i]));
+        QVERIFY(equal(x[i], expected.x));
+        QVERIFY(equal(y[i], expected.y));
+    }
+
+    /* Forward, array of coordinates */
+    vector<LatLonCoords> coords;
+    for(size_t i = 0; i != count; ++i)
+        coords.push_back(LatLonCoords(latitude[i], longitude[i]));
+    vector<Coords<double> > projected(count);
+    p.fromLatLon(&coords[0], &projected[0], count);
+    for(size_t i = 0; i != count; ++i) {
+        QVERIFY(projected[i].x == x[i]);
+        QVERIFY(projected[i].y == y[i]);
+    }
+
+    /* Inverse, including coordinates out of the map */
+    x.push_back(-0.5);
+    y.push_back(0.5);
+    x.push_back(0.5);
+    y.push_back(-100);
+    vector<double> lat(x.size()), lon(x.size());
+    p.toLatLon(&x[0], &y[0], &lat[0], &lon[0], x.size());
+    for(size_t i = 0; i != x.size(); ++i) {
+        const LatLonCoords expected = p.toLatLon(Coords<double>(x[i], y[i]));
+        QVERIFY(equal(lat[i], expected.latitude()));
+        QVERIFY(equal(lon[i], expected.longitude()));
+    }
+
+    /* Inverse, array of coordinates */
+    vector<LatLonCoords> back(count);
+    p.toLatLon(&projected[0], &back[0], count);
+    for(size_t i = 0; i != count; ++i)
+        QVERIFY(equal(back[i], p.toLatLon(projected[i])));
+}
+
+void MercatorProjectionTest::arraysFallback() {
+    vector<double> latitude, longitude;
+    points(latitude, longitude);
+    const size_t count = latitude.size();
+
+    /* Default implementation is the same as single points */
+    vector<double> x(count), y(count);
+    projection.AbstractProjection::fromLatLon(&latitude[0], &longitude[0], &x[0], &y[0], count);
+    for(size_t i = 0; i != count; ++i) {
+        const Coords<double> expected = projection.fromLatLon(LatLonCoords(latitude[i], longitude[i]));
+        QVERIFY(x[i] == expected.x);
+        QVERIFY(y[i] == expected.y);
+    }
+
+    vector<double> lat(count), lon(count);
+    projection.AbstractProjection::toLatLon(&x[0], &y[0], &lat[0], &lon[0], count);
+    for(size_t i = 0; i != count; ++i) {
+        const LatLonCoords expected = projection.toLatLon(Coords<double>(x[i], y[i]));
+        QVERIFY(lat[i] == expected.latitude());
+        QVERIFY(lon[i] == expected.longitude());
+    }
+
+    /* Array variants are consistent with each other */
+    vector<double> fastX(count), fastY(count);
+    projection.fromLatLon(&latitude[0], &longitude[0], &fastX[0], &fastY[0], count);
+    for(size_t i = 0; i != count; ++i) {
+        QVERIFY(equal(fastX[i], x[i]));
+        QVERIFY(equal(fastY[i], y[i]));
+    }
+}
+
+void MercatorProjectionTest::kernels() {
+    using namespace Implementation;
+
+    /* Dense sweep over all latitudes including poles and out of range
+       values, stretched and shifted */
+    vector<double> latitude, longitude;
+    for(int i = -9100; i <= 9100; ++i) {
+        latitude.push_back(i*0.01);
+        longitude.push_back(i*0.0199 - 1.0);
+    }
+    latitude.push_back(89.99999999);
+    longitude.push_back(-180.0);
+    latitude.push_back(-89.99999999);
+    longitude.push_back(180.0);
+    const size_t count = latitude.size();
+    const MercatorCoefficients forward = {0.5/360, 0.25 + 0.125, -0.25/(2*3.1415926535), 0.125 + 0.5};
+    const MercatorCoefficients inverse = {1/0.5, 0.125, 1/0.25, 0.5};
+
+    vector<double> expectedX(count), expectedY(count), expectedLat(count), expectedLon(count);
+    const MercatorKernels scalar = mercatorKernelsScalar();
+    scalar.forward(forward, &latitude[0], &longitude[0], &expectedX[0], &expectedY[0], count);
+    scalar.inverse(inverse, &expectedX[0], &expectedY[0], &expectedLat[0], &expectedLon[0], count);
+
+    const int features = mercatorCpuFeatures();
+    vector<MercatorKernels> available;
+    if(features & Sse41) available.push_back(mercatorKernelsSse41());
+    if(features & Avx2) available.push_back(mercatorKernelsAvx2());
+    for(vector<MercatorKernels>::const_iterator k = available.begin(); k != available.end(); ++k) {
+        if(!k->forward) {
+            qDebug() << k->name << "kernels not compiled in";
+            continue;
+        }
+
+        /* All sizes of the rest after whole vectors */
+        for(size_t size = count-4; size != count+1; ++size) {
+            vector<double> x(count, -1.0), y(count, -1.0), lat(count, -1.0), lon(count, -1.0);
+            k->forward(forward, &latitude[0], &longitude[0], &x[0], &y[0], size);
+            k->inverse(inverse, &expectedX[0], &expectedY[0], &lat[0], &lon[0], size);
+            for(size_t i = 0; i != size; ++i) {
+                QVERIFY(equal(x[i], expectedX[i]));
+                QVERIFY(equal(y[i], expectedY[i]));
+                QVERIFY(equal(lat[i], expectedLat[i]));
+                QVERIFY(equal(lon[i], expectedLon[i]));
+            }
+
+            /* Nothing is written after the end */
+            for(size_t i = size; i != count; ++i)
+                QVERIFY(x[i] == -1.0 && y[i] == -1.0 && lat[i] == -1.0 && lon[i] == -1.0);
+        }
+    }
+}
+
+void MercatorProjectionTest::benchmarkSingle() {
+    /* Track of 100k points */
+    vector<LatLonCoords> track;
+    for(size_t i = 0; i != 100000; ++i)
+        track.push_back(LatLonCoords(50 + (i%1000)*0.001, 14 + (i/1000)*0.01));
+    vector<Coords<double> > projected(track.size());
+
+    const AbstractProjection* p = &projection;
+    QBENCHMARK {
+        for(size_t i = 0; i != track.size(); ++i)
+            projected[i] = p->fromLatLon(track[i]);
+    }
+}
+
+void MercatorProjectionTest::benchmarkArrays() {
+    vector<double> latitude, longitude;
+    for(size_t i = 0; i != 100000; ++i) {
+        latitude.push_back(50 + (i%1000)*0.001);
+        longitude.push_back(14 + (i/1000)*0.01);
+    }
+    vector<double> x(latitude.size()), y(latitude.size());
+
+    const AbstractProjection* p = &projection;
+    QBENCHMARK {
+        p->fromLatLon(&latitude[0], &longitude[0], &x[0], &y[0], latitude.size());
+    }
+}
+
 }}}
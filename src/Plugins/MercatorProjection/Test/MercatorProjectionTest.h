@@ -30,6 +30,11 @@ class MercatorProjectionTest: public QObject {
     private slots:
         void coords_data();
         void coords();
+        void arrays();
+        void arraysFallback();
+        void kernels();
+        void benchmarkSingle();
+        void benchmarkArrays();
 };
 
 }}}
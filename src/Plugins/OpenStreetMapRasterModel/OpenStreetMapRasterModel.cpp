@@ -15,9 +15,6 @@
 
 #include "OpenStreetMapRasterModel.h"
 
-#include <cstdlib>
-#include <sstream>
-
 using namespace std;
 using namespace Kompas::Core;
 
@@ -35,26 +32,23 @@ OpenStreetMapRasterModel::OpenStreetMapRasterModel(Corrade::PluginManager::Abstr
     layersOnline.push_back("mapnik");
     layersOnline.push_back("osmarender");
     layersOnline.push_back("cycle");
+
+    vector<string> servers;
+    servers.push_back("a");
+    servers.push_back("b");
+    servers.push_back("c");
+    urls.insert(make_pair("mapnik", UrlTemplate("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", servers)));
+    urls.insert(make_pair("osmarender", UrlTemplate("http://{s}.tah.openstreetmap.org/Tiles/tile/{z}/{x}/{y}.png", servers)));
+    urls.insert(make_pair("cycle", UrlTemplate("http://{s}.tile.opencyclemap.org/cycle/{z}/{x}/{y}.png", servers)));
 }
 
 string OpenStreetMapRasterModel::tileUrl(const std::string& layer, Zoom z, const TileCoords& coords) const {
     if(z > 18) return "";
 
-    char server = 'a' + rand()%3;
-
-    ostringstream url;
-    url << "http://" << server;
-    if(layer == "mapnik")
-        url << ".tile.openstreetmap.org/";
-    else if(layer == "osmarender")
-        url << ".tah.openstreetmap.org/Tiles/tile/";
-    else if(layer == "cycle")
-        url << ".tile.opencyclemap.org/cycle/";
-    else return "";
-
-    url << z << "/" << coords.x << "/" << coords.y << ".png";
+    map<string, UrlTemplate>::const_iterator found = urls.find(layer);
+    if(found == urls.end()) return "";
 
-    return url.str();
+    return found->second.format(z, coords);
 }
 
 }}
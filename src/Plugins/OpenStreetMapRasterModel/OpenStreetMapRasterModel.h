@@ -19,8 +19,11 @@
  * @brief Class Kompas::Plugins::OpenStreetMapRasterModel
  */
 
+#include <map>
+
 #include "KompasRasterModel/KompasRasterModel.h"
 #include "MercatorProjection/MercatorProjection.h"
+#include "UrlTemplate.h"
 
 namespace Kompas { namespace Plugins {
 
@@ -28,6 +31,9 @@ namespace Kompas { namespace Plugins {
  * @brief OpenStreetMap raster model
  *
  * Based on: http://wiki.openstreetmap.org/wiki/Slippy_map_tilenames
+ *
+ * Tiles are spread over @c a, @c b and @c c servers, each tile has always the
+ * same server, see Core::UrlTemplate::subdomain().
  */
 class CORE_EXPORT OpenStreetMapRasterModel: public KompasRasterModel {
     public:
@@ -64,6 +70,7 @@ class CORE_EXPORT OpenStreetMapRasterModel: public KompasRasterModel {
         std::set<Core::Zoom> zoomLevelsOnline;
         Core::TileArea areaOnline;
         std::vector<std::string> layersOnline;
+        std::map<std::string, Core::UrlTemplate> urls;
 };
 
 }}
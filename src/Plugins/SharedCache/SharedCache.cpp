@@ -0,0 +1,491 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "SharedCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <limits>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "Utility/Directory.h"
+#include "Utility/Debug.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(SharedCache, Kompas::Plugins::SharedCache,
+                "cz.mosra.Kompas.Core.AbstractCache/0.2")
+
+namespace Kompas { namespace Plugins {
+
+namespace {
+    const char Magic[] = "KOMPASSC";
+    const uint32_t Version = 3;
+
+    /* Header state, anything else is uninitialized file */
+    const uint32_t Ready = 0x52454459;
+
+    uint32_t processId() {
+        #ifdef _WIN32
+        return GetCurrentProcessId();
+        #else
+        return getpid();
+        #endif
+    }
+
+    /* Whether process with given ID still exists */
+    bool isRunning(uint32_t pid) {
+        #ifdef _WIN32
+        HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+        if(!process) return GetLastError() != ERROR_INVALID_PARAMETER;
+        const bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+        CloseHandle(process);
+        return running;
+        #else
+        /* Negative PIDs would address process groups */
+        if(pid > uint32_t(numeric_limits<pid_t>::max())) return false;
+        return kill(pid_t(pid), 0) == 0 || errno != ESRCH;
+        #endif
+    }
+}
+
+SharedCache::SharedCache(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractCache(manager, plugin), _blockSize(256*1024), _cacheSize(64*1024*1024), file(0), header(0), pid(processId()), cursor(0) {}
+
+bool SharedCache::initializeCache(const string& url) {
+    close();
+    return open(Directory::join(url, "SharedCache.data"));
+}
+
+void SharedCache::finalizeCache() {
+    close();
+}
+
+void SharedCache::setBlockSize(size_t size) {
+    /* Keep the sets aligned */
+    if(size) _blockSize = (size+7)/8*8;
+}
+
+void SharedCache::setCacheSize(size_t size) {
+    _cacheSize = size;
+}
+
+size_t SharedCache::usedSize() const {
+    if(!header) return 0;
+
+    size_t size = 0;
+    for(uint32_t i = 0; i != header->setCount; ++i)
+        size += setAt(i)->liveSize.load(memory_order_relaxed);
+    return size;
+}
+
+void SharedCache::purge() {
+    if(!header) return;
+
+    for(uint32_t i = 0; i != header->setCount; ++i) {
+        Set* s = setAt(i);
+        lock(s);
+        clear(s);
+        unlock(s);
+    }
+}
+
+void SharedCache::optimize() {
+    if(!header) return;
+
+    for(uint32_t i = 0; i != header->setCount; ++i)
+        compactIfWasted(i);
+}
+
+bool SharedCache::maintain(unsigned int budget) {
+    if(!header) return false;
+
+    const chrono::steady_clock::time_point end = chrono::steady_clock::now() + chrono::microseconds(budget);
+    while(cursor != header->setCount) {
+        compactIfWasted(cursor++);
+        if(chrono::steady_clock::now() >= end) break;
+    }
+
+    /* All sets were checked, start again in next call */
+    if(cursor != header->setCount) return true;
+    cursor = 0;
+    return false;
+}
+
+TileData SharedCache::get(const CacheKey& key) {
+    if(!header || !verifyNames(key, false)) return TileData();
+
+    uint64_t h = hash(key);
+    Set* s = setOf(h);
+    lock(s);
+
+    Entry* e = find(s, key, h);
+    if(!e) {
+        unlock(s);
+        return TileData();
+    }
+
+    if(!isInside(e->offset, e->size)) {
+        clearCorrupted(s);
+        unlock(s);
+        return TileData();
+    }
+
+    /* Other processes can overwrite the data, so they must be copied */
+    e->used = header->clock.fetch_add(1)+1;
+    string copy(dataOf(s)+e->offset, e->size);
+    unlock(s);
+
+    return TileData(std::move(copy));
+}
+
+bool SharedCache::set(const CacheKey& key, const TileData& data) {
+    if(!header || !verifyNames(key, true)) return false;
+
+    uint64_t h = hash(key);
+    Set* s = setOf(h);
+    Evicted evicted;
+    {
+        lock(s);
+
+        /* Remove previous version. If the data would never fit, the
+           previous version isn't returned instead of them. */
+        Entry* e = find(s, key, h);
+        if(e) remove(s, e, 0);
+
+        if(data.size() > header->blockSize) {
+            unlock(s);
+            return false;
+        }
+
+        for(;;) {
+            e = 0;
+            for(uint32_t i = 0; i != Ways && !e; ++i)
+                if(s->entries[i].hash == Empty) e = s->entries+i;
+
+            /* Enough space at the end */
+            if(e && header->blockSize-s->end >= data.size()) break;
+
+            /* Enough space after compaction */
+            if(e && header->blockSize-s->liveSize >= data.size()) {
+                compact(s);
+                continue;
+            }
+
+            /* Remove least recently used entry */
+            const uint32_t clock = header->clock.load();
+            Entry* lru = 0;
+            for(uint32_t i = 0; i != Ways; ++i) {
+                if(s->entries[i].hash == Empty) continue;
+                if(!lru || clock-s->entries[i].used > clock-lru->used)
+                    lru = s->entries+i;
+            }
+            remove(s, lru, hasEvictionListener() || hasStatistics() ? &evicted : 0);
+        }
+
+        memcpy(dataOf(s)+s->end, data.data(), data.size());
+
+        e->hash = h;
+        e->kind = key.kind();
+        e->model = key.model();
+        e->layer = key.layer();
+        e->z = key.z();
+        e->x = key.coords().x;
+        e->y = key.coords().y;
+        e->offset = s->end;
+        e->size = data.size();
+        e->used = header->clock.fetch_add(1)+1;
+        e->reserved = 0;
+
+        s->end += data.size();
+        s->liveSize += data.size();
+        unlock(s);
+    }
+
+    /* Report the evicted data outside the lock */
+    for(Evicted::const_iterator it = evicted.begin(); it != evicted.end(); ++it) {
+        if(hasEvictionListener()) this->evicted(it->key, it->data);
+        else this->evicted(it->key, it->size);
+    }
+
+    return true;
+}
+
+bool SharedCache::open(const string& filename) {
+    /* Map existing file, if there is any */
+    file = new MappedFile(filename, MappedFile::ReadWrite);
+    if(file->isValid() && file->size() == 0) {
+        delete file;
+        uint32_t setCount = max(_cacheSize/_blockSize, size_t(1));
+        file = new MappedFile(filename, MappedFile::ReadWrite, sizeof(Header) + setCount*(sizeof(Set)+_blockSize));
+    }
+
+    if(!file->isValid() || file->size() < sizeof(Header)) {
+        Error() << "SharedCache: cannot map file" << filename;
+        close();
+        return false;
+    }
+
+    header = reinterpret_cast<Header*>(file->data());
+
+    /* Initialize the file, if it is not initialized yet. Other processes
+       mapping the file at the same time wait on the lock until it is
+       initialized, if the initializing process crashed, the next one
+       initializes the file again. */
+    if(header->state.load(memory_order_acquire) != Ready) {
+        lock(&header->initLock);
+        if(header->state.load(memory_order_acquire) != Ready) {
+            /* Use whole existing file with own block size */
+            uint32_t setCount = (file->size()-sizeof(Header))/(sizeof(Set)+_blockSize);
+            if(setCount == 0) {
+                Error() << "SharedCache: file" << filename << "is too small for block size" << _blockSize;
+                unlock(&header->initLock);
+                close();
+                return false;
+            }
+
+            create(_blockSize, setCount);
+        }
+        unlock(&header->initLock);
+    }
+
+    /* Initialized file can't be initialized again, as other processes may
+       have it mapped */
+    if(!isValid()) {
+        Error() << "SharedCache: file" << filename << "has different version or layout, remove it when it's not used";
+        close();
+        return false;
+    }
+
+    _blockSize = header->blockSize;
+    _cacheSize = size_t(header->setCount)*header->blockSize;
+    return true;
+}
+
+void SharedCache::close() {
+    if(!file) return;
+
+    file->flush();
+    delete file;
+    file = 0;
+    header = 0;
+
+    lock_guard<std::mutex> lock(namesMutex);
+    verifiedNames.clear();
+}
+
+bool SharedCache::isValid() const {
+    return memcmp(header->magic, Magic, sizeof(header->magic)) == 0 &&
+        header->version == Version && header->blockSize != 0 &&
+        header->blockSize%8 == 0 && header->setCount != 0 &&
+        sizeof(Header)+header->setCount*(sizeof(Set)+header->blockSize) <= file->size();
+}
+
+void SharedCache::create(uint32_t blockSize, uint32_t setCount) {
+    memcpy(header->magic, Magic, sizeof(header->magic));
+    header->version = Version;
+    header->blockSize = blockSize;
+    header->setCount = setCount;
+    header->clock = 0;
+    header->namesLock = Unlocked;
+    header->nameCount = 0;
+    memset(header->reserved, 0, sizeof(header->reserved));
+
+    for(uint32_t i = 0; i != setCount; ++i) {
+        Set* s = setAt(i);
+        s->lock = Unlocked;
+        s->reserved = 0;
+        clear(s);
+    }
+
+    header->state.store(Ready, memory_order_release);
+}
+
+bool SharedCache::lock(atomic<uint32_t>* lock) {
+    /* Threads of one process share the owner ID, which is enough for
+       mutual exclusion */
+    for(unsigned int i = 0; ; ++i) {
+        uint32_t owner = Unlocked;
+        if(lock->compare_exchange_weak(owner, pid, memory_order_acquire))
+            return false;
+
+        if(i%64 != 63) continue;
+        this_thread::yield();
+
+        /* Owner process crashed, take the lock. Only one waiting process
+           succeeds in replacing the ID. */
+        if(owner != Unlocked && owner != pid && !isRunning(owner) && lock->compare_exchange_strong(owner, pid, memory_order_acquire)) {
+            Warning() << "SharedCache: breaking lock of crashed process" << owner;
+            return true;
+        }
+    }
+}
+
+void SharedCache::lock(Set* s) {
+    /* Data of crashed process might be inconsistent, sizes are checked so
+       the computations with them can't overflow */
+    if(lock(&s->lock)) clear(s);
+    else if(s->end > header->blockSize || s->liveSize > s->end) clearCorrupted(s);
+}
+
+bool SharedCache::verifyName(uint32_t id, bool publish) {
+    {
+        lock_guard<std::mutex> lock(namesMutex);
+        if(verifiedNames.find(id) != verifiedNames.end()) return true;
+    }
+
+    /* IDs which weren't given by CacheKey::id() can't be verified */
+    const string name = CacheKey::name(id);
+    if(name.empty() || name.size() > sizeof(Name().name)) return false;
+
+    /* Published names are never changed, so they can be read without the
+       lock. Unfinished name of crashed process is not counted. */
+    uint32_t count = header->nameCount.load(memory_order_acquire);
+    if(count > NameCount) count = NameCount;
+    uint32_t i = 0;
+    while(i != count && header->names[i].id != id) ++i;
+
+    /* Publish the name, check again with the lock as other process could
+       publish it in the meantime */
+    if(i == count) {
+        if(!publish) return false;
+
+        lock(&header->namesLock);
+        count = header->nameCount.load(memory_order_relaxed);
+        if(count > NameCount) count = NameCount;
+        while(i != count && header->names[i].id != id) ++i;
+        if(i == count) {
+            if(count == NameCount) {
+                unlock(&header->namesLock);
+                return false;
+            }
+
+            Name& published = header->names[count];
+            published.id = id;
+            published.size = name.size();
+            memcpy(published.name, name.data(), name.size());
+            header->nameCount.store(count+1, memory_order_release);
+        }
+        unlock(&header->namesLock);
+    }
+
+    /* Another process has different name with the same ID */
+    const Name& published = header->names[i];
+    if(published.size != name.size() || memcmp(published.name, name.data(), name.size()) != 0)
+        return false;
+
+    lock_guard<std::mutex> lock(namesMutex);
+    verifiedNames.insert(id);
+    return true;
+}
+
+SharedCache::Entry* SharedCache::find(Set* s, const CacheKey& key, uint64_t h) {
+    for(uint32_t i = 0; i != Ways; ++i) {
+        Entry& e = s->entries[i];
+        if(e.hash == h && e.x == key.coords().x && e.y == key.coords().y &&
+           e.z == key.z() && e.layer == key.layer() && e.model == key.model() &&
+           e.kind == static_cast<uint32_t>(key.kind()))
+            return &e;
+    }
+
+    return 0;
+}
+
+void SharedCache::remove(Set* s, Entry* e, Evicted* evicted) {
+    if(!isInside(e->offset, e->size) || e->size > s->liveSize) {
+        clearCorrupted(s);
+        return;
+    }
+
+    /* Statistics need only key and size, don't copy the data for them */
+    if(evicted) {
+        EvictedEntry evictedEntry;
+        evictedEntry.key = CacheKey(e->kind, e->model, e->layer, e->z, TileCoords(e->x, e->y));
+        evictedEntry.size = e->size;
+        if(hasEvictionListener())
+            evictedEntry.data = TileData(string(dataOf(s)+e->offset, e->size));
+        evicted->push_back(evictedEntry);
+    }
+
+    s->liveSize -= e->size;
+    e->hash = Empty;
+}
+
+void SharedCache::compact(Set* s) {
+    /* Move data of all entries to the beginning, in order of their offsets */
+    vector<pair<uint32_t, uint32_t> > entries;
+    for(uint32_t i = 0; i != Ways; ++i) {
+        if(s->entries[i].hash == Empty) continue;
+        if(!isInside(s->entries[i].offset, s->entries[i].size)) {
+            clearCorrupted(s);
+            return;
+        }
+        entries.push_back(make_pair(s->entries[i].offset, i));
+    }
+    sort(entries.begin(), entries.end());
+
+    s->end = 0;
+    for(vector<pair<uint32_t, uint32_t> >::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        Entry& e = s->entries[it->second];
+
+        /* Overlapping entries wouldn't fit */
+        if(e.size > header->blockSize-s->end) {
+            clearCorrupted(s);
+            return;
+        }
+
+        memmove(dataOf(s)+s->end, dataOf(s)+e.offset, e.size);
+        e.offset = s->end;
+        s->end += e.size;
+    }
+
+    s->liveSize = s->end;
+}
+
+bool SharedCache::compactIfWasted(uint32_t i) {
+    Set* s = setAt(i);
+    lock(s);
+
+    const bool wasted = s->end-s->liveSize > header->blockSize/4;
+    if(wasted) compact(s);
+
+    unlock(s);
+    return wasted;
+}
+
+void SharedCache::clear(Set* s) {
+    for(uint32_t i = 0; i != Ways; ++i)
+        s->entries[i].hash = Empty;
+    s->liveSize = 0;
+    s->end = 0;
+}
+
+void SharedCache::clearCorrupted(Set* s) {
+    Warning() << "SharedCache: clearing corrupted set";
+    clear(s);
+}
+
+}}
@@ -0,0 +1,253 @@
+#ifndef Kompas_Plugins_SharedCache_h
+#define Kompas_Plugins_SharedCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::SharedCache
+ */
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "AbstractCache.h"
+#include "MappedFile.h"
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief Cache shared by multiple processes
+
+Stores the data in memory-mapped file @c SharedCache.data in directory passed
+to initializeCache(). All processes which initialize the cache with the same
+directory map the same file, so they share the data and the cache size. The
+data stay in the file when the processes exit, so restarted process finds its
+tiles there.
+
+The file is divided into sets of blockSize() bytes. Each key belongs to one
+set by its hash, the set contains index of up to 32 entries and data of these
+entries. Each set has its own lock in the mapped file, so the processes wait
+for each other only when accessing the same set. When the set is full, least
+recently used entries of the set are removed and passed to eviction listener.
+Data larger than the set can't be saved.
+
+The file contains also table of model and layer names with their IDs. The IDs
+given by Core::CacheKey::id() can differ between processes, so data with
+names which have different ID in the table than in current process can't be
+retrieved nor saved. Data with names longer than 56 bytes or with more than
+64 different names can't be saved either.
+
+Default block size is 256 kB, default cache size is 64 MB. The sizes are used
+only when the file is created, if it already exists, cacheSize() and
+blockSize() return sizes of the existing file after initialization. To change
+the sizes, the file must be removed while no process uses the cache. Processes
+which initialize the cache simultaneously for the first time should use the
+same sizes.
+
+Locks in the file contain ID of the owner process. If a process crashes
+while holding lock of a set, the lock is broken by process waiting for it
+after the owner is found to be no longer running and the set is emptied, as
+its data might be inconsistent. Because of that all processes sharing the
+cache must see each other's IDs, i.e. run in the same PID namespace. Entries
+pointing outside of their set are not trusted either, the set is emptied
+when they are found.
+
+File which is already initialized is never initialized again, as other
+processes may have it mapped. If it has different version or layout,
+initialization fails and the file must be removed while no process uses it.
+The file is in native endianness, so it can't be shared between platforms
+with different endianness.
+
+The cache can be accessed from multiple threads at once, but finalizeCache()
+must not be called while the cache is being accessed.
+*/
+class CORE_EXPORT SharedCache: public Core::AbstractCache {
+    public:
+        /** @copydoc Core::AbstractCache::AbstractCache */
+        SharedCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        inline ~SharedCache() { finalizeCache(); }
+
+        inline int features() const { return MultiUser|BlockBased; }
+
+        bool initializeCache(const std::string& url);
+        void finalizeCache();
+
+        inline size_t blockSize() const { return _blockSize; }
+
+        /**
+         * @brief Set block size
+         *
+         * Used only when the file is created, i.e. in next initialization if
+         * the file doesn't exist yet.
+         */
+        void setBlockSize(size_t size);
+
+        inline size_t cacheSize() const { return _cacheSize; }
+
+        /**
+         * @brief Set cache size
+         *
+         * Used only when the file is created, i.e. in next initialization if
+         * the file doesn't exist yet.
+         */
+        void setCacheSize(size_t size);
+
+        size_t usedSize() const;
+
+        /**
+         * @brief Purge cache
+         *
+         * Removes data of all processes.
+         */
+        void purge();
+
+        /**
+         * @brief Optimize cache
+         *
+         * Compacts data in all sets with more than quarter of the space
+         * wasted by removed data. The sets are compacted also when needed
+         * for new data.
+         */
+        void optimize();
+
+        /**
+         * @brief Do part of maintenance
+         *
+         * Compacts the sets as optimize(), but only until the budget is
+         * spent. The next call continues with following set. Returns false
+         * after all sets were checked.
+         */
+        bool maintain(unsigned int budget);
+
+        Core::TileData get(const Core::CacheKey& key);
+        bool set(const Core::CacheKey& key, const Core::TileData& data);
+
+    private:
+        static const std::uint32_t Ways = 32;
+        static const std::uint32_t NameCount = 64;
+
+        struct Name {
+            std::uint32_t id,
+                size;
+            char name[56];
+        };
+
+        struct Header {
+            std::atomic<std::uint32_t> state,   /* Ready or uninitialized */
+                initLock;                       /* Unlocked or initializing process ID */
+            char magic[8];
+            std::uint32_t version,
+                blockSize,
+                setCount;
+            std::atomic<std::uint32_t> clock,   /* Time of last use */
+                namesLock,                      /* Unlocked or owner process ID */
+                nameCount;                      /* Count of published names */
+            std::uint32_t reserved[6];
+            Name names[NameCount];
+        };
+
+        struct Entry {
+            std::uint64_t hash;                 /* Empty or key hash */
+            std::uint32_t kind,
+                model,
+                layer,
+                z,
+                x,
+                y,
+                offset,                         /* Offset in set data */
+                size,
+                used,                           /* Clock value of last use */
+                reserved;
+        };
+
+        struct Set {
+            std::atomic<std::uint32_t> lock;    /* Unlocked or owner process ID */
+            std::atomic<std::uint32_t> liveSize;
+            std::uint32_t end,                  /* End of used data */
+                reserved;
+            Entry entries[Ways];
+        };
+
+        /* Evicted entry, data are present only for eviction listener */
+        struct EvictedEntry {
+            Core::CacheKey key;
+            Core::TileData data;
+            size_t size;
+        };
+
+        typedef std::vector<EvictedEntry> Evicted;
+
+        static const std::uint64_t Empty = 0;
+        static const std::uint32_t Unlocked = 0;
+
+        size_t _blockSize, _cacheSize;
+        Core::MappedFile* file;
+        Header* header;
+        std::uint32_t pid,                  /* ID of this process */
+            cursor;                         /* Next set to compact */
+
+        std::mutex namesMutex;
+        std::set<std::uint32_t> verifiedNames;  /* IDs with the same name in the file */
+
+        static inline std::uint64_t hash(const Core::CacheKey& key) {
+            /* Don't collide with special value */
+            return key.hash() == Empty ? 1 : key.hash();
+        }
+        inline size_t setStride() const { return sizeof(Set) + header->blockSize; }
+        inline Set* setAt(std::uint32_t i) const {
+            return reinterpret_cast<Set*>(file->data()+sizeof(Header)+i*setStride());
+        }
+        inline Set* setOf(std::uint64_t h) const { return setAt((h >> 32)%header->setCount); }
+        inline static char* dataOf(Set* s) { return reinterpret_cast<char*>(s+1); }
+
+        /* Whether the data are inside of the set, other process could
+           corrupt the entries */
+        inline bool isInside(std::uint32_t offset, std::uint32_t size) const {
+            return offset <= header->blockSize && size <= header->blockSize-offset;
+        }
+
+        bool open(const std::string& filename);
+        void close();
+        bool isValid() const;
+        void create(std::uint32_t blockSize, std::uint32_t setCount);
+
+        /* Returns true if lock of crashed process was broken */
+        bool lock(std::atomic<std::uint32_t>* lock);
+        void lock(Set* s);
+        inline static void unlock(std::atomic<std::uint32_t>* lock) { lock->store(Unlocked, std::memory_order_release); }
+        inline static void unlock(Set* s) { unlock(&s->lock); }
+
+        /* Whether the ID has the same name in the file as in this process,
+           optionally publishing the name if it isn't there */
+        bool verifyName(std::uint32_t id, bool publish);
+        inline bool verifyNames(const Core::CacheKey& key, bool publish) {
+            return verifyName(key.model(), publish) && verifyName(key.layer(), publish);
+        }
+
+        Entry* find(Set* s, const Core::CacheKey& key, std::uint64_t h);
+        void remove(Set* s, Entry* e, Evicted* evicted);
+        void compact(Set* s);
+        bool compactIfWasted(std::uint32_t i);
+        static void clear(Set* s);
+        static void clearCorrupted(Set* s);
+};
+
+}}
+
+#endif
@@ -0,0 +1,364 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "SharedCacheTest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstring>
+#include <QtCore/QDir>
+#include <QtTest/QTest>
+
+#include "Utility/Directory.h"
+#include "MappedFile.h"
+#include "../SharedCache.h"
+#include "testConfigure.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::SharedCacheTest)
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+namespace {
+    void readWrite(SharedCache* cache, unsigned int seed, atomic<int>* failures) {
+        for(unsigned int i = 0; i != 2000; ++i) {
+            seed = seed*1103515245 + 12345;
+            TileCoords coords((seed >> 8)%32, (seed >> 16)%32);
+
+            /* Data size and content depends on coordinates, so they can be
+               verified */
+            string data(coords.x*100+1, 'a'+coords.y%26);
+            if(i%4 == 0)
+                cache->setRasterTile("Model", "base", 8, coords, data);
+            else {
+                TileData tile = cache->rasterTile("Model", "base", 8, coords);
+                if(!tile.empty() && tile != data) ++*failures;
+            }
+        }
+    }
+}
+
+SharedCacheTest::SharedCacheTest(QObject* parent): QObject(parent) {
+    QDir dir;
+    dir.mkpath(SHAREDCACHE_WRITE_TEST_DIR);
+}
+
+void SharedCacheTest::init() {
+    QFile::remove(QString::fromStdString(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "SharedCache.data")));
+}
+
+void SharedCacheTest::uninitialized() {
+    SharedCache cache;
+    QVERIFY(!cache.setRasterTile("Model", "base", 0, TileCoords(0, 0), "data"));
+    QVERIFY(cache.rasterTile("Model", "base", 0, TileCoords(0, 0)) == "");
+    QVERIFY(cache.usedSize() == 0);
+
+    /* Nonexistent directory */
+    QVERIFY(!cache.initializeCache(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "nonexistent/")));
+}
+
+void SharedCacheTest::setGet() {
+    SharedCache cache;
+    cache.setCacheSize(1024*1024);
+    QVERIFY(cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(cache.features() & AbstractCache::MultiUser);
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(2, 1), ""));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 3)) == "");
+    QVERIFY(cache.rasterTile("Model", "overlay", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.usedSize() == 4);
+
+    /* Replace */
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "new tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "new tile");
+    QVERIFY(cache.usedSize() == 8);
+}
+
+void SharedCacheTest::shared() {
+    /* Each instance has its own mapping of the file, the same as separate
+       processes */
+    SharedCache first, second;
+    QVERIFY(first.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+
+    QVERIFY(first.setRasterTile("Model", "base", 3, TileCoords(1, 2), "first"));
+    QVERIFY(second.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "first");
+
+    QVERIFY(second.setRasterTile("Model", "base", 3, TileCoords(1, 2), "second"));
+    QVERIFY(first.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "second");
+    QVERIFY(first.usedSize() == second.usedSize());
+
+    /* Data survive finalization of one process */
+    second.finalizeCache();
+    QVERIFY(first.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "second");
+}
+
+void SharedCacheTest::names() {
+    SharedCache first;
+    QVERIFY(first.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(first.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* IDs without name can't be saved */
+    QVERIFY(!first.set(CacheKey(AbstractCache::RasterTile, 0xdeadbeef, CacheKey::id("base"), 3, TileCoords(1, 2)), TileData("tile")));
+
+    /* Simulate process which gave the ID of "Model" to another name by
+       changing the first name in the table after 64-byte header */
+    {
+        MappedFile file(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "SharedCache.data"), MappedFile::ReadWrite);
+        QVERIFY(file.isValid());
+        QVERIFY(string(file.data()+72, 5) == "Model");
+        file.data()[76] = 'm';
+    }
+
+    /* Another process doesn't get the data nor overwrites them */
+    SharedCache second;
+    QVERIFY(second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(second.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(!second.setRasterTile("Model", "base", 3, TileCoords(1, 2), "other"));
+
+    /* Other names still work */
+    QVERIFY(second.setRasterTile("Other", "base", 3, TileCoords(1, 2), "other"));
+    QVERIFY(first.rasterTile("Other", "base", 3, TileCoords(1, 2)) == "other");
+}
+
+void SharedCacheTest::persistence() {
+    {
+        SharedCache cache;
+        cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+        QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    }
+
+    SharedCache cache;
+    QVERIFY(cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+}
+
+void SharedCacheTest::existingFile() {
+    SharedCache first;
+    first.setBlockSize(4096);
+    first.setCacheSize(8*4096);
+    QVERIFY(first.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(first.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Sizes of existing file are used */
+    SharedCache second;
+    QVERIFY(second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(second.blockSize() == 4096);
+    QVERIFY(second.cacheSize() == 8*4096);
+    QVERIFY(second.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+
+    /* Invalid file is initialized again */
+    first.finalizeCache();
+    second.finalizeCache();
+    {
+        fstream file(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "SharedCache.data").c_str(), ios::in|ios::out|ios::binary);
+        file << string(64, 'x');
+    }
+    QVERIFY(second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(second.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(second.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(second.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+}
+
+void SharedCacheTest::differentVersion() {
+    SharedCache first;
+    QVERIFY(first.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(first.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Change version in the header */
+    {
+        MappedFile file(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "SharedCache.data"), MappedFile::ReadWrite);
+        QVERIFY(file.isValid());
+        QVERIFY(file.data()[16] == 3);
+        file.data()[16] = 2;
+    }
+
+    /* The file is not initialized again under the process using it */
+    SharedCache second;
+    QVERIFY(!second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(first.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+}
+
+void SharedCacheTest::staleLock() {
+    /* Only one set, starting after the header */
+    SharedCache cache;
+    cache.setBlockSize(4096);
+    cache.setCacheSize(4096);
+    QVERIFY(cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Lock the set by process which doesn't exist */
+    {
+        MappedFile file(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "SharedCache.data"), MappedFile::ReadWrite);
+        QVERIFY(file.isValid());
+        const uint32_t pid = 0x7ffffffe;
+        memcpy(file.data()+4160, &pid, 4);
+    }
+
+    /* The lock is broken and possibly inconsistent set is emptied */
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+}
+
+void SharedCacheTest::corruptedEntry() {
+    SharedCache cache;
+    cache.setBlockSize(4096);
+    cache.setCacheSize(4096);
+    QVERIFY(cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Point offset of the first entry outside of the set */
+    {
+        MappedFile file(Directory::join(SHAREDCACHE_WRITE_TEST_DIR, "SharedCache.data"), MappedFile::ReadWrite);
+        QVERIFY(file.isValid());
+        const uint32_t offset = 0xffff0000;
+        memcpy(file.data()+4160+16+32, &offset, 4);
+    }
+
+    /* The data aren't read and the set is emptied */
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.usedSize() == 0);
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+}
+
+void SharedCacheTest::eviction() {
+    /* Only one set */
+    SharedCache cache;
+    cache.setBlockSize(4096);
+    cache.setCacheSize(4096);
+    cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+
+    vector<TileCoords> evicted;
+    cache.setEvictionListener([&evicted](const CacheKey& key, const TileData& data) {
+        if(data.size() == 1000) evicted.push_back(key.coords());
+    });
+
+    const string data(1000, 'x');
+    for(unsigned int i = 0; i != 4; ++i)
+        QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(i, 0), data));
+    QVERIFY(cache.usedSize() == 4000);
+
+    /* Least recently used tile is removed */
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(0, 0)) == data);
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(4, 0), data));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(0, 0)) == data);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 0)) == "");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(4, 0)) == data);
+    QVERIFY(evicted.size() == 1);
+    QVERIFY(evicted[0] == TileCoords(1, 0));
+
+    /* Smaller data fill the gap after compaction */
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(2, 0), "small"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(5, 0), string(1500, 'y')));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(5, 0)) == string(1500, 'y'));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 0)) == "small");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(4, 0)) == data);
+    QVERIFY(cache.usedSize() <= cache.cacheSize());
+}
+
+void SharedCacheTest::entryCount() {
+    SharedCache cache;
+    cache.setBlockSize(4096);
+    cache.setCacheSize(4096);
+    cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+
+    /* Set has limited count of entries */
+    for(unsigned int i = 0; i != 40; ++i)
+        QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(i, 0), "tile"));
+
+    unsigned int found = 0;
+    for(unsigned int i = 0; i != 40; ++i)
+        if(cache.rasterTile("Model", "base", 3, TileCoords(i, 0)) == "tile") ++found;
+    QVERIFY(found == 32);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(39, 0)) == "tile");
+}
+
+void SharedCacheTest::tooLarge() {
+    SharedCache cache;
+    cache.setBlockSize(4096);
+    cache.setCacheSize(4*4096);
+    cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), string(4096, 'x')));
+
+    /* Previous version is removed */
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), string(4097, 'x')));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.usedSize() == 0);
+}
+
+void SharedCacheTest::purge() {
+    SharedCache first, second;
+    first.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+    second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+
+    QVERIFY(first.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    second.purge();
+    QVERIFY(first.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(first.usedSize() == 0);
+}
+
+void SharedCacheTest::maintain() {
+    SharedCache cache;
+    cache.setBlockSize(16*1024);
+    cache.setCacheSize(128*1024);
+    cache.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+
+    /* Replaced data leave garbage in the sets */
+    for(unsigned int i = 0; i != 4; ++i)
+        for(unsigned int x = 0; x != 16; ++x)
+            QVERIFY(cache.setRasterTile("Model", "base", 5, TileCoords(x, 0), string(1000+i, 'a'+i)));
+    const size_t used = cache.usedSize();
+
+    /* Compaction doesn't lose any data */
+    while(cache.maintain(0));
+    QVERIFY(cache.usedSize() == used);
+    for(unsigned int x = 0; x != 16; ++x)
+        QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(x, 0)) == string(1003, 'd'));
+
+    cache.optimize();
+    QVERIFY(cache.usedSize() == used);
+    QVERIFY(cache.rasterTile("Model", "base", 5, TileCoords(15, 0)) == string(1003, 'd'));
+}
+
+void SharedCacheTest::threaded() {
+    SharedCache first, second;
+    first.setBlockSize(16*1024);
+    first.setCacheSize(128*1024);
+    first.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+    second.initializeCache(SHAREDCACHE_WRITE_TEST_DIR);
+
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 4; ++i)
+        threads.push_back(thread(readWrite, i%2 ? &first : &second, i, &failures));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    QVERIFY(failures == 0);
+    QVERIFY(first.usedSize() > 0);
+    QVERIFY(first.usedSize() <= first.cacheSize());
+}
+
+}}}
@@ -0,0 +1 @@
+#define SHAREDCACHE_WRITE_TEST_DIR "${CMAKE_CURRENT_BINARY_DIR}/SharedCacheTestFiles/"
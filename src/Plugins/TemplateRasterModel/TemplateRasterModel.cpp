@@ -0,0 +1,82 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TemplateRasterModel.h"
+
+#include "Utility/Configuration.h"
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(TemplateRasterModel, Kompas::Plugins::TemplateRasterModel,
+                "cz.mosra.Kompas.Core.AbstractRasterModel/0.2")
+
+namespace Kompas { namespace Plugins {
+
+TemplateRasterModel::TemplateRasterModel(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): KompasRasterModel(manager, plugin), _tileSize(256, 256) {
+    if(configuration()) configure(configuration());
+}
+
+void TemplateRasterModel::configure(const ConfigurationGroup* configuration) {
+    templates.clear();
+    zoomLevelsOnline.clear();
+    layersOnline.clear();
+    areaOnline = TileArea();
+
+    _tileSize = configuration->keyExists("tileSize") ? configuration->value<TileSize>("tileSize") : TileSize(256, 256);
+    _copyright = configuration->value<string>("copyright");
+
+    for(unsigned int i = 0; i != configuration->groupCount("layer"); ++i) {
+        const ConfigurationGroup* group = configuration->group("layer", i);
+
+        const string name = group->value<string>("name");
+        Layer layer;
+        layer.url = UrlTemplate(group->value<string>("url"), group->values<string>("subdomain"), group->values<unsigned int>("weight"));
+        layer.minZoom = group->value<Zoom>("minZoom");
+        layer.maxZoom = group->keyExists("maxZoom") ? group->value<Zoom>("maxZoom") : 18;
+        if(name.empty() || !layer.url.isValid() || layer.minZoom > layer.maxZoom || templates.find(name) != templates.end())
+            continue;
+
+        templates.insert(make_pair(name, layer));
+        layersOnline.push_back(name);
+        for(Zoom z = layer.minZoom; z <= layer.maxZoom; ++z)
+            zoomLevelsOnline.insert(z);
+    }
+
+    /* Whole world in the lowest zoom level */
+    if(!zoomLevelsOnline.empty()) {
+        const unsigned int size = pow2(*zoomLevelsOnline.begin());
+        areaOnline = TileArea(0, 0, size, size);
+    }
+}
+
+const UrlTemplate* TemplateRasterModel::urlTemplate(const std::string& layer) const {
+    map<string, Layer>::const_iterator found = templates.find(layer);
+    return found == templates.end() ? 0 : &found->second.url;
+}
+
+string TemplateRasterModel::tileUrl(const std::string& layer, Zoom z, const TileCoords& coords) const {
+    map<string, Layer>::const_iterator found = templates.find(layer);
+    if(found == templates.end() || z < found->second.minZoom || z > found->second.maxZoom)
+        return "";
+
+    const unsigned int size = pow2(z);
+    if(coords.x >= size || coords.y >= size) return "";
+
+    return found->second.url.format(z, coords);
+}
+
+}}
@@ -0,0 +1,135 @@
+#ifndef Kompas_Plugins_TemplateRasterModel_h
+#define Kompas_Plugins_TemplateRasterModel_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::TemplateRasterModel
+ */
+
+#include <map>
+
+#include "KompasRasterModel/KompasRasterModel.h"
+#include "MercatorProjection/MercatorProjection.h"
+#include "UrlTemplate.h"
+
+namespace Corrade { namespace Utility {
+    class ConfigurationGroup;
+}}
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief Template-based online raster model
+
+Online layers are defined in plugin configuration file, so adding new tile
+source with Mercator projection needs no new plugin. Each layer is in its own
+group:
+@code
+tileSize=256 256
+copyright=© OpenStreetMap and contributors, CC-BY-SA.
+
+[layer]
+name=mapnik
+url=http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png
+subdomain=a
+subdomain=b
+subdomain=c
+minZoom=0
+maxZoom=18
+@endcode
+Optional @c weight values, one for each subdomain, make some servers get
+more tiles than others, e.g. for the subdomains above with weights 2, 1 and 1
+server @c a gets half of the tiles. Each tile has always the same server.
+URL templates are parsed only once when the configuration is loaded, see
+Core::UrlTemplate for supported placeholders. Layers with invalid template
+are ignored. Offline the model works the same as KompasRasterModel.
+*/
+class CORE_EXPORT TemplateRasterModel: public KompasRasterModel {
+    public:
+        /**
+         * @copydoc Plugins::KompasRasterModel::KompasRasterModel
+         *
+         * Loads the layers from plugin configuration, if any.
+         */
+        TemplateRasterModel(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        inline int features() const {
+            return KompasRasterModel::features()|MultipleFileFormat|LoadableFromUrl|NonConvertableFormat|ConvertableCoords;
+        }
+        inline const Core::AbstractProjection* projection() const
+            { return &_projection; }
+        inline std::string celestialBody() const
+            { return "EarthCelestialBody"; }
+        inline Core::TileSize tileSize() const
+            { return _tileSize; }
+        inline std::string copyright() const
+            { return _copyright; }
+
+        inline std::set<Core::Zoom> zoomLevels() const {
+            return online() ? zoomLevelsOnline : KompasRasterModel::zoomLevels();
+        }
+        inline Core::TileArea area() const {
+            return online() ? areaOnline : KompasRasterModel::area();
+        }
+        std::vector<std::string> layers() const {
+            return online() ? layersOnline : KompasRasterModel::layers();
+        }
+
+        /**
+         * @brief Configure online layers
+         * @param configuration     Group with tile size, copyright and
+         *      @c layer subgroups
+         *
+         * Replaces all previously configured layers, tile size defaults to
+         * 256x256 and layer zoom range to 0-18. Called from constructor
+         * with plugin configuration.
+         */
+        void configure(const Corrade::Utility::ConfigurationGroup* configuration);
+
+        /**
+         * @brief URL template for given online layer
+         *
+         * Returns zero if the layer doesn't exist.
+         */
+        const Core::UrlTemplate* urlTemplate(const std::string& layer) const;
+
+        /**
+         * @copydoc Core::AbstractRasterModel::tileUrl()
+         *
+         * Returns empty string if the layer doesn't exist or if the zoom or
+         * coordinates are out of its range.
+         */
+        std::string tileUrl(const std::string& layer, Core::Zoom z, const Kompas::Core::TileCoords& coords) const;
+
+    private:
+        struct Layer {
+            Core::UrlTemplate url;
+            Core::Zoom minZoom, maxZoom;
+        };
+
+        MercatorProjection _projection;
+        Core::TileSize _tileSize;
+        std::string _copyright;
+
+        std::map<std::string, Layer> templates;
+        std::set<Core::Zoom> zoomLevelsOnline;
+        Core::TileArea areaOnline;
+        std::vector<std::string> layersOnline;
+};
+
+}}
+
+#endif
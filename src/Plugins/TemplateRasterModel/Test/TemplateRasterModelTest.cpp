@@ -0,0 +1,158 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TemplateRasterModelTest.h"
+
+#include <sstream>
+#include <QtTest/QTest>
+
+#include "Utility/Configuration.h"
+#include "../TemplateRasterModel.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::TemplateRasterModelTest)
+
+using namespace std;
+using namespace Corrade::Utility;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+void TemplateRasterModelTest::configure() {
+    istringstream in(
+        "tileSize=512 512\n"
+        "copyright=© Somebody\n"
+        "[layer]\n"
+        "name=base\n"
+        "url=http://{s}.example.com/base/{z}/{x}/{y}.png\n"
+        "subdomain=a\n"
+        "subdomain=b\n"
+        "weight=3\n"
+        "weight=1\n"
+        "minZoom=2\n"
+        "maxZoom=10\n"
+        "[layer]\n"
+        "name=aerial\n"
+        "url=http://example.com/aerial/{quadkey}.jpg\n"
+        "minZoom=1\n"
+        "maxZoom=5\n");
+    Configuration configuration(in, Configuration::ReadOnly);
+
+    TemplateRasterModel model;
+    model.configure(&configuration);
+    QVERIFY(model.tileSize() == TileSize(512, 512));
+    QVERIFY(model.copyright() == "© Somebody");
+
+    QVERIFY(model.setOnline(true));
+    vector<string> layers;
+    layers.push_back("base");
+    layers.push_back("aerial");
+    QVERIFY(model.layers() == layers);
+
+    /* Zoom levels are union of all layers, area is whole world in the
+       lowest zoom level */
+    set<Zoom> zoomLevels;
+    for(Zoom z = 1; z <= 10; ++z) zoomLevels.insert(z);
+    QVERIFY(model.zoomLevels() == zoomLevels);
+    QVERIFY(model.area() == TileArea(0, 0, 2, 2));
+
+    QVERIFY(model.urlTemplate("base"));
+    QVERIFY(model.urlTemplate("base")->subdomains().size() == 2);
+    vector<unsigned int> weights;
+    weights.push_back(3);
+    weights.push_back(1);
+    QVERIFY(model.urlTemplate("base")->weights() == weights);
+    QVERIFY(!model.urlTemplate("cycle"));
+
+    /* Reconfiguring replaces the layers */
+    istringstream otherIn(
+        "[layer]\n"
+        "name=cycle\n"
+        "url=http://example.com/cycle/{z}/{x}/{y}.png\n");
+    Configuration other(otherIn, Configuration::ReadOnly);
+    model.configure(&other);
+    QVERIFY(model.layers() == vector<string>(1, "cycle"));
+    QVERIFY(!model.urlTemplate("base"));
+    QVERIFY(model.tileSize() == TileSize(256, 256));
+    QVERIFY(model.zoomLevels().size() == 19);
+}
+
+void TemplateRasterModelTest::invalid() {
+    istringstream in(
+        "[layer]\n"
+        "url=http://example.com/{z}/{x}/{y}.png\n"
+        "[layer]\n"
+        "name=unknown\n"
+        "url=http://example.com/{zoom}/{x}/{y}.png\n"
+        "[layer]\n"
+        "name=subdomains\n"
+        "url=http://{s}.example.com/{z}/{x}/{y}.png\n"
+        "[layer]\n"
+        "name=weights\n"
+        "url=http://{s}.example.com/{z}/{x}/{y}.png\n"
+        "subdomain=a\n"
+        "subdomain=b\n"
+        "weight=1\n"
+        "[layer]\n"
+        "name=zoom\n"
+        "url=http://example.com/{z}/{x}/{y}.png\n"
+        "minZoom=10\n"
+        "maxZoom=5\n"
+        "[layer]\n"
+        "name=valid\n"
+        "url=http://example.com/{z}/{x}/{y}.png\n"
+        "[layer]\n"
+        "name=valid\n"
+        "url=http://example.com/duplicate/{z}/{x}/{y}.png\n");
+    Configuration configuration(in, Configuration::ReadOnly);
+
+    TemplateRasterModel model;
+    model.configure(&configuration);
+    model.setOnline(true);
+    QVERIFY(model.layers() == vector<string>(1, "valid"));
+    QVERIFY(model.tileUrl("valid", 0, TileCoords(0, 0)) == "http://example.com/0/0/0.png");
+}
+
+void TemplateRasterModelTest::tileUrl() {
+    istringstream in(
+        "[layer]\n"
+        "name=base\n"
+        "url=http://{s}.example.com/{z}/{x}/{y}.png\n"
+        "subdomain=a\n"
+        "subdomain=b\n"
+        "minZoom=2\n"
+        "maxZoom=10\n"
+        "[layer]\n"
+        "name=aerial\n"
+        "url=http://example.com/a{quadkey}.jpg\n"
+        "minZoom=1\n"
+        "maxZoom=5\n");
+    Configuration configuration(in, Configuration::ReadOnly);
+
+    TemplateRasterModel model;
+    model.configure(&configuration);
+
+    const string subdomain = model.urlTemplate("base")->subdomain(3, TileCoords(4, 7)) ? "b" : "a";
+    QVERIFY(model.tileUrl("base", 3, TileCoords(4, 7)) == "http://" + subdomain + ".example.com/3/4/7.png");
+    QVERIFY(model.tileHost("base", 3, TileCoords(4, 7)) == subdomain + ".example.com");
+    QVERIFY(model.tileUrl("aerial", 3, TileCoords(3, 5)) == "http://example.com/a213.jpg");
+
+    /* Out of zoom range, out of area, unknown layer */
+    QVERIFY(model.tileUrl("base", 1, TileCoords(0, 0)) == "");
+    QVERIFY(model.tileUrl("aerial", 6, TileCoords(0, 0)) == "");
+    QVERIFY(model.tileUrl("base", 3, TileCoords(8, 0)) == "");
+    QVERIFY(model.tileUrl("cycle", 3, TileCoords(0, 0)) == "");
+}
+
+}}}
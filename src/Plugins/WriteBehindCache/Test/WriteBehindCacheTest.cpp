@@ -0,0 +1,242 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "WriteBehindCacheTest.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <QtTest/QTest>
+
+#include "../WriteBehindCache.h"
+#include "MemoryCache/MemoryCache.h"
+
+QTEST_APPLESS_MAIN(Kompas::Plugins::Test::WriteBehindCacheTest)
+
+using namespace std;
+using namespace Kompas::Core;
+
+namespace Kompas { namespace Plugins { namespace Test {
+
+namespace {
+    /* Memory cache which doesn't save anything until it is opened */
+    class GatedCache: public MemoryCache {
+        public:
+            GatedCache(): sets(0), open(true) {}
+
+            void close() {
+                lock_guard<mutex> lock(gateMutex);
+                open = false;
+            }
+
+            void release() {
+                {
+                    lock_guard<mutex> lock(gateMutex);
+                    open = true;
+                }
+                gate.notify_all();
+            }
+
+            bool set(const CacheKey& key, const TileData& data) {
+                {
+                    unique_lock<mutex> lock(gateMutex);
+                    while(!open) gate.wait(lock);
+                }
+
+                ++sets;
+                return MemoryCache::set(key, data);
+            }
+
+            /* Keep the data after finalization, so they can be checked */
+            void finalizeCache() {}
+
+            atomic<unsigned int> sets;
+
+        private:
+            mutex gateMutex;
+            condition_variable gate;
+            bool open;
+    };
+
+    void write(WriteBehindCache* cache, unsigned int first, unsigned int count) {
+        for(unsigned int i = first; i != first+count; ++i)
+            cache->setRasterTile("Model", "base", 8, TileCoords(i, 0), "tile");
+    }
+
+    void readWrite(WriteBehindCache* cache, unsigned int seed, atomic<int>* failures) {
+        for(unsigned int i = 0; i != 5000; ++i) {
+            seed = seed*1103515245 + 12345;
+            TileCoords coords((seed >> 8)%64, (seed >> 16)%64);
+            string data(coords.x*10+1, 'a'+coords.y%26);
+
+            if(i%4 == 0)
+                cache->setRasterTile("Model", "base", 8, coords, data);
+            else {
+                TileData tile = cache->rasterTile("Model", "base", 8, coords);
+                if(!tile.empty() && tile != data) ++*failures;
+            }
+        }
+    }
+}
+
+void WriteBehindCacheTest::noBackend() {
+    WriteBehindCache cache;
+    QVERIFY(!cache.initializeCache(""));
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.cacheSize() == 0);
+    cache.flush();
+}
+
+void WriteBehindCacheTest::setGet() {
+    GatedCache backend;
+    WriteBehindCache cache;
+    cache.setBackend(&backend);
+    QVERIFY(cache.initializeCache(""));
+
+    /* Saving doesn't wait for the backend */
+    backend.close();
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+
+    /* Queued data are available */
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 1)) == "");
+    QVERIFY(backend.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.queuedCount() == 1);
+
+    backend.release();
+    cache.flush();
+    QVERIFY(cache.queuedCount() == 0);
+    QVERIFY(backend.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "tile");
+    QVERIFY(cache.writes() == 1);
+    QVERIFY(cache.usedSize() == backend.usedSize());
+}
+
+void WriteBehindCacheTest::coalescing() {
+    GatedCache backend;
+    WriteBehindCache cache;
+    cache.setBackend(&backend);
+    cache.initializeCache("");
+
+    /* Block the thread on first batch */
+    backend.close();
+    cache.setRasterTile("Model", "base", 3, TileCoords(0, 0), "first");
+
+    /* Saving the same tile many times only replaces it in the queue */
+    for(unsigned int i = 0; i != 100; ++i)
+        cache.setRasterTile("Model", "base", 3, TileCoords(1, 1), string(i+1, 'x'));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 1)) == string(100, 'x'));
+
+    backend.release();
+    cache.flush();
+    QVERIFY(backend.sets <= 3);
+    QVERIFY(cache.coalesced() >= 98);
+    QVERIFY(backend.rasterTile("Model", "base", 3, TileCoords(1, 1)) == string(100, 'x'));
+}
+
+void WriteBehindCacheTest::backpressure() {
+    GatedCache backend;
+    WriteBehindCache cache;
+    cache.setBackend(&backend);
+    cache.setQueueSize(4);
+    cache.initializeCache("");
+
+    /* Writer thread fills the queue and waits for the backend */
+    backend.close();
+    thread writer(write, &cache, 0, 20);
+    while(cache.stalls() == 0) this_thread::yield();
+    QVERIFY(cache.queuedCount() <= 8);
+    QVERIFY(backend.sets == 0);
+
+    backend.release();
+    writer.join();
+    cache.flush();
+    QVERIFY(backend.sets == 20);
+    QVERIFY(cache.writes() == 20);
+    QVERIFY(cache.queuedCount() == 0);
+}
+
+void WriteBehindCacheTest::finalize() {
+    GatedCache backend;
+    {
+        WriteBehindCache cache;
+        cache.setBackend(&backend);
+        cache.initializeCache("");
+        write(&cache, 0, 500);
+    }
+
+    /* All queued data are written on destruction */
+    QVERIFY(backend.sets == 500);
+    QVERIFY(backend.rasterTile("Model", "base", 8, TileCoords(499, 0)) == "tile");
+
+    /* The cache can't be used after finalization */
+    WriteBehindCache cache;
+    cache.setBackend(&backend);
+    cache.initializeCache("");
+    cache.finalizeCache();
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile"));
+}
+
+void WriteBehindCacheTest::purge() {
+    GatedCache backend;
+    WriteBehindCache cache;
+    cache.setBackend(&backend);
+    cache.initializeCache("");
+
+    cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile");
+    cache.flush();
+    backend.close();
+    cache.setRasterTile("Model", "base", 3, TileCoords(2, 1), "tile");
+    QVERIFY(cache.queuedCount() == 1);
+
+    /* Purge waits for batch being written */
+    thread releaser([&backend]() {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        backend.release();
+    });
+    cache.purge();
+    releaser.join();
+
+    QVERIFY(cache.queuedCount() == 0);
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(1, 2)) == "");
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 1)) == "");
+}
+
+void WriteBehindCacheTest::threaded() {
+    MemoryCache backend;
+    WriteBehindCache cache;
+    cache.setBackend(&backend);
+    cache.setQueueSize(16);
+    cache.initializeCache("");
+
+    atomic<int> failures(0);
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 4; ++i)
+        threads.push_back(thread(readWrite, &cache, i, &failures));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    cache.flush();
+    QVERIFY(failures == 0);
+    QVERIFY(cache.queuedCount() == 0);
+    QVERIFY(cache.writes() > 0);
+    QVERIFY(cache.failedWrites() == 0);
+}
+
+}}}
@@ -0,0 +1,310 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "WriteBehindCache.h"
+
+using namespace std;
+using namespace Kompas::Core;
+
+PLUGIN_REGISTER(WriteBehindCache, Kompas::Plugins::WriteBehindCache,
+                "cz.mosra.Kompas.Core.AbstractCache/0.2")
+
+namespace Kompas { namespace Plugins {
+
+WriteBehindCache::WriteBehindCache(Corrade::PluginManager::AbstractPluginManager* manager, const std::string& plugin): AbstractCache(manager, plugin), _backend(0), _queueSize(256), taken(0), done(0), running(false), stopping(false), _writes(0), _failedWrites(0), _coalesced(0), _stalls(0) {}
+
+WriteBehindCache::~WriteBehindCache() {
+    finalizeCache();
+    setBackend(0);
+}
+
+void WriteBehindCache::setBackend(AbstractCache* backend) {
+    if(_backend) _backend->setEvictionListener(EvictionListener());
+
+    _backend = backend;
+
+    if(_backend) _backend->setEvictionListener([this](const CacheKey& key, const TileData& data) {
+        evicted(key, data);
+    });
+}
+
+int WriteBehindCache::features() const {
+    return _backend ? _backend->features() : 0;
+}
+
+bool WriteBehindCache::initializeCache(const string& url) {
+    if(!_backend) return false;
+
+    stop();
+    if(!_backend->initializeCache(url)) return false;
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        running = true;
+    }
+
+    worker = thread(&WriteBehindCache::run, this);
+    return true;
+}
+
+void WriteBehindCache::finalizeCache() {
+    if(!_backend) return;
+
+    /* Backend must be finalized last, so it gets all queued data */
+    stop();
+    _backend->finalizeCache();
+}
+
+size_t WriteBehindCache::blockSize() const {
+    return _backend ? _backend->blockSize() : 0;
+}
+
+void WriteBehindCache::setBlockSize(size_t size) {
+    if(_backend) _backend->setBlockSize(size);
+}
+
+size_t WriteBehindCache::cacheSize() const {
+    return _backend ? _backend->cacheSize() : 0;
+}
+
+void WriteBehindCache::setCacheSize(size_t size) {
+    if(_backend) _backend->setCacheSize(size);
+}
+
+size_t WriteBehindCache::usedSize() const {
+    return _backend ? _backend->usedSize() : 0;
+}
+
+void WriteBehindCache::purge() {
+    if(!_backend) return;
+
+    dropQueued();
+    _backend->purge();
+}
+
+void WriteBehindCache::optimize() {
+    if(!_backend) return;
+
+    flush();
+    _backend->optimize();
+}
+
+void WriteBehindCache::schedulePurge() {
+    if(!_backend) return;
+
+    dropQueued();
+    _backend->schedulePurge();
+}
+
+void WriteBehindCache::scheduleOptimize() {
+    if(_backend) _backend->scheduleOptimize();
+}
+
+bool WriteBehindCache::maintain(unsigned int budget) {
+    return _backend ? _backend->maintain(budget) : false;
+}
+
+void WriteBehindCache::flush() {
+    unique_lock<std::mutex> lock(mutex);
+
+    /* Pending data will be written in next batch */
+    const unsigned long long target = taken + (pending.empty() ? 0 : 1);
+    while(done < target) written.wait(lock);
+}
+
+TileData WriteBehindCache::get(const CacheKey& key) {
+    if(!_backend) return TileData();
+
+    /* Newest data are in the queue */
+    {
+        lock_guard<std::mutex> lock(mutex);
+        Batch::const_iterator found = pending.find(key);
+        if(found != pending.end()) return found->second;
+        found = writing.find(key);
+        if(found != writing.end()) return found->second;
+    }
+
+    return _backend->get(key);
+}
+
+vector<TileData> WriteBehindCache::get(const vector<CacheKey>& keys) {
+    vector<TileData> data(keys.size());
+    if(!_backend) return data;
+
+    vector<size_t> indices;
+    vector<CacheKey> rest;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i != keys.size(); ++i) {
+            Batch::const_iterator found = pending.find(keys[i]);
+            if(found != pending.end()) {
+                data[i] = found->second;
+                continue;
+            }
+
+            found = writing.find(keys[i]);
+            if(found != writing.end()) data[i] = found->second;
+            else {
+                indices.push_back(i);
+                rest.push_back(keys[i]);
+            }
+        }
+    }
+    if(rest.empty()) return data;
+
+    vector<TileData> backendData = _backend->get(rest);
+    for(size_t i = 0; i != rest.size(); ++i)
+        data[indices[i]] = backendData[i];
+
+    return data;
+}
+
+bool WriteBehindCache::set(const CacheKey& key, const TileData& data) {
+    unique_lock<std::mutex> lock(mutex);
+    if(!running || stopping) return false;
+
+    /* Replace queued data */
+    Batch::iterator found = pending.find(key);
+    if(found != pending.end()) {
+        found->second = data;
+        ++_coalesced;
+        return true;
+    }
+
+    /* Wait for space in the queue */
+    if(pending.size() >= _queueSize) {
+        ++_stalls;
+        while(pending.size() >= _queueSize && running && !stopping)
+            written.wait(lock);
+        if(!running || stopping) return false;
+    }
+
+    pending.insert(make_pair(key, data));
+    lock.unlock();
+
+    queued.notify_one();
+    return true;
+}
+
+vector<bool> WriteBehindCache::contains(const vector<CacheKey>& keys) {
+    vector<bool> found(keys.size());
+    if(!_backend) return found;
+
+    vector<size_t> indices;
+    vector<CacheKey> rest;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i != keys.size(); ++i) {
+            if(pending.find(keys[i]) != pending.end() || writing.find(keys[i]) != writing.end())
+                found[i] = true;
+            else {
+                indices.push_back(i);
+                rest.push_back(keys[i]);
+            }
+        }
+    }
+    if(rest.empty()) return found;
+
+    vector<bool> backendFound = _backend->contains(rest);
+    for(size_t i = 0; i != rest.size(); ++i)
+        found[indices[i]] = backendFound[i];
+
+    return found;
+}
+
+size_t WriteBehindCache::queuedCount() const {
+    lock_guard<std::mutex> lock(mutex);
+    return pending.size() + writing.size();
+}
+
+void WriteBehindCache::resetStatistics() {
+    _writes = 0;
+    _failedWrites = 0;
+    _coalesced = 0;
+    _stalls = 0;
+}
+
+void WriteBehindCache::run() {
+    unique_lock<std::mutex> lock(mutex);
+    for(;;) {
+        while(pending.empty() && !stopping) queued.wait(lock);
+
+        /* All data are written, stopping */
+        if(pending.empty()) break;
+
+        /* Take all pending data as one batch, waiting saves now have space */
+        writing.swap(pending);
+        ++taken;
+        lock.unlock();
+        written.notify_all();
+
+        /* Only this thread modifies the batch, so it can be read without
+           the lock. Write it with one batched call, so the backend can
+           save it at once (e.g. under one lock or in one transaction). */
+        vector<CacheKey> keys;
+        vector<TileData> data;
+        keys.reserve(writing.size());
+        data.reserve(writing.size());
+        for(Batch::const_iterator it = writing.begin(); it != writing.end(); ++it) {
+            keys.push_back(it->first);
+            data.push_back(it->second);
+        }
+
+        vector<bool> saved = _backend->set(keys, data);
+        for(size_t i = 0; i != keys.size(); ++i) {
+            if(i < saved.size() && saved[i]) ++_writes;
+            else ++_failedWrites;
+        }
+
+        lock.lock();
+        writing.clear();
+        ++done;
+        written.notify_all();
+    }
+}
+
+void WriteBehindCache::dropQueued() {
+    /* Drop queued data and wait until the batch being written is done, so
+       it isn't written after the purge */
+    {
+        unique_lock<std::mutex> lock(mutex);
+        pending.clear();
+        const unsigned long long target = taken;
+        while(done < target) written.wait(lock);
+    }
+
+    /* Saves waiting for space can continue */
+    written.notify_all();
+}
+
+void WriteBehindCache::stop() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if(!running) return;
+        stopping = true;
+    }
+
+    /* Wake the thread and saves waiting for space, the thread then writes
+       everything what's left */
+    queued.notify_all();
+    written.notify_all();
+    worker.join();
+
+    lock_guard<std::mutex> lock(mutex);
+    running = false;
+    stopping = false;
+}
+
+}}
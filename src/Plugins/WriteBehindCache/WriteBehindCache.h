@@ -0,0 +1,227 @@
+#ifndef Kompas_Plugins_WriteBehindCache_h
+#define Kompas_Plugins_WriteBehindCache_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Plugins::WriteBehindCache
+ */
+
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "AbstractCache.h"
+
+namespace Kompas { namespace Plugins {
+
+/**
+@brief Write-behind cache
+
+Saves data to another cache asynchronously, so saving downloaded tile to slow
+disk or network cache doesn't delay its rendering. The cache is set with
+setBackend(), it is not owned by this cache and must exist as long as it is
+set.
+@code
+DiskCache disk;
+WriteBehindCache cache;
+cache.setBackend(&disk);
+cache.initializeCache("/path/to/cache");
+@endcode
+
+- New data are put into queue and saved to the backend in batches from
+  background thread, each batch with one batched Core::AbstractCache::set()
+  call. Saving data which are already queued only replaces them
+  in the queue, so each key is written at most once per batch.
+- If the queue is full, saving waits until the background thread makes space
+  for the data, so the queue can't grow without limit when the backend is
+  slower than the downloads. Maximal queue size is set with setQueueSize().
+- Data are looked up in the queue first, so data which were saved, but not
+  yet written, are already available.
+- All queued data are written in flush() and finalizeCache().
+
+Cache size, block size, used size and features are those of the backend.
+Data evicted from the backend are passed to eviction listener of this cache,
+they are reported from the background thread.
+
+The cache can be accessed from multiple threads at once, if the backend can.
+setBackend() and setQueueSize() must not be called while the cache is
+initialized.
+*/
+class CORE_EXPORT WriteBehindCache: public Core::AbstractCache {
+    public:
+        /** @copydoc Core::AbstractCache::AbstractCache */
+        WriteBehindCache(Corrade::PluginManager::AbstractPluginManager* manager = 0, const std::string& plugin = "");
+
+        /**
+         * @brief Destructor
+         *
+         * Finalizes the cache and removes eviction listener from the backend.
+         */
+        ~WriteBehindCache();
+
+        /** @brief Backend */
+        inline Core::AbstractCache* backend() const { return _backend; }
+
+        /**
+         * @brief Set backend
+         *
+         * The backend must be set, otherwise the cache doesn't store
+         * anything. Replaces eviction listener of the backend, eviction
+         * listener of previous backend is removed.
+         */
+        void setBackend(Core::AbstractCache* backend);
+
+        /** @brief Maximal count of queued data */
+        inline size_t queueSize() const { return _queueSize; }
+
+        /**
+         * @brief Set maximal count of queued data
+         *
+         * Default is 256.
+         */
+        inline void setQueueSize(size_t size) { _queueSize = size ? size : 1; }
+
+        /** @brief Features of the backend */
+        int features() const;
+
+        /**
+         * @brief Initialize cache
+         *
+         * Initializes the backend with given URL and starts background
+         * thread.
+         */
+        bool initializeCache(const std::string& url);
+
+        /**
+         * @brief Finalize cache
+         *
+         * Writes all queued data, stops background thread and finalizes the
+         * backend.
+         */
+        void finalizeCache();
+
+        size_t blockSize() const;
+        void setBlockSize(size_t size);
+        size_t cacheSize() const;
+        void setCacheSize(size_t size);
+        size_t usedSize() const;
+
+        /**
+         * @brief Purge cache
+         *
+         * Drops queued data and purges the backend.
+         */
+        void purge();
+
+        /**
+         * @brief Optimize cache
+         *
+         * Writes all queued data and optimizes the backend.
+         */
+        void optimize();
+
+        /**
+         * @brief Schedule incremental purge
+         *
+         * Drops queued data and schedules incremental purge of the backend.
+         */
+        void schedulePurge();
+
+        /** @brief Schedule incremental optimization of the backend */
+        void scheduleOptimize();
+
+        /** @brief Do part of maintenance of the backend */
+        bool maintain(unsigned int budget);
+
+        /**
+         * @brief Write all queued data
+         *
+         * Waits until all data saved before this call are written to the
+         * backend.
+         */
+        void flush();
+
+        Core::TileData get(const Core::CacheKey& key);
+
+        /**
+         * @brief Get multiple data from cache
+         *
+         * Data which aren't queued are retrieved from the backend with one
+         * call.
+         */
+        std::vector<Core::TileData> get(const std::vector<Core::CacheKey>& keys);
+
+        /**
+         * @brief Save data to cache
+         *
+         * Puts the data into queue, waits if the queue is full. Returns false
+         * only if the cache isn't initialized, data refused by the backend
+         * are counted in failedWrites().
+         */
+        bool set(const Core::CacheKey& key, const Core::TileData& data);
+
+        /**
+         * @brief Check presence of multiple data
+         *
+         * Queued data are present, the rest is looked up in the backend.
+         */
+        std::vector<bool> contains(const std::vector<Core::CacheKey>& keys);
+
+        /** @brief Count of queued data */
+        size_t queuedCount() const;
+
+        /** @brief Count of data written to the backend */
+        inline unsigned long long writes() const { return _writes; }
+
+        /** @brief Count of data refused by the backend */
+        inline unsigned long long failedWrites() const { return _failedWrites; }
+
+        /** @brief Count of data which replaced queued data */
+        inline unsigned long long coalesced() const { return _coalesced; }
+
+        /** @brief Count of saves which waited for space in the queue */
+        inline unsigned long long stalls() const { return _stalls; }
+
+        /** @brief Reset counters */
+        void resetStatistics();
+
+    private:
+        typedef std::unordered_map<Core::CacheKey, Core::TileData> Batch;
+
+        Core::AbstractCache* _backend;
+        size_t _queueSize;
+
+        mutable std::mutex mutex;
+        std::condition_variable queued,     /* Data were queued or stopping */
+            written;                        /* Batch was taken or written */
+        Batch pending,                      /* Waiting for next batch */
+            writing;                        /* Being written */
+        unsigned long long taken, done;     /* Count of taken and written batches */
+        bool running, stopping;
+        std::thread worker;
+
+        std::atomic<unsigned long long> _writes, _failedWrites, _coalesced, _stalls;
+
+        void run();
+        void stop();
+        void dropQueued();
+};
+
+}}
+
+#endif
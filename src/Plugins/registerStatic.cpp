@@ -2,9 +2,16 @@
 #include "Utility/utilities.h"
 
 int registerCoreStaticPlugins() {
+    PLUGIN_IMPORT(CompositeCache)
+    PLUGIN_IMPORT(DiskCache)
     PLUGIN_IMPORT(EarthCelestialBody)
     PLUGIN_IMPORT(KompasRasterModel)
+    PLUGIN_IMPORT(MemcachedCache)
+    PLUGIN_IMPORT(MemoryCache)
     PLUGIN_IMPORT(OpenStreetMapRasterModel)
+    PLUGIN_IMPORT(SharedCache)
+    PLUGIN_IMPORT(TemplateRasterModel)
+    PLUGIN_IMPORT(WriteBehindCache)
     PLUGIN_IMPORT(MercatorProjection)
     return 1;
 } AUTOMATIC_INITIALIZER(registerCoreStaticPlugins)
@@ -0,0 +1,193 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "RegionPackager.h"
+
+#include <algorithm>
+
+#include "DownloadScheduler.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+RegionPackager::RegionPackager(const AbstractRasterModel* source, AbstractRasterModel* destination, AbstractDownloader* downloader, unsigned int threadCount, unsigned int hostConnections): source(source), destination(destination), downloader(downloader), threadCount(threadCount), hostConnections(hostConnections), _windowSize(256), _retryCount(2), total(0), done(0), resumed(0), downloaded(0), missing(0), failed(0), cancelled(false) {}
+
+bool RegionPackager::create(const string& filename, const vector<Zoom>& zoomLevels, const TileArea& area, const vector<string>& layers, const vector<string>& overlays, bool resume) {
+    total = done = resumed = downloaded = missing = failed = 0;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        cancelled = false;
+    }
+
+    if(!(source->features() & AbstractRasterModel::LoadableFromUrl) || !source->online() ||
+       !(destination->features() & AbstractRasterModel::WriteableFormat) ||
+       (resume && !(destination->features() & AbstractRasterModel::ResumableFormat)) ||
+       zoomLevels.empty() || layers.empty())
+        return false;
+
+    if(resume) {
+        if(!destination->resumePackage(filename, source->tileSize(), zoomLevels, area, layers, overlays))
+            return false;
+    } else if(!destination->initializePackage(filename, source->tileSize(), zoomLevels, area, layers, overlays))
+        return false;
+
+    /* Layers and overlays are saved the same way */
+    vector<string> allLayers = layers;
+    allLayers.insert(allLayers.end(), overlays.begin(), overlays.end());
+    vector<Zoom> sortedZoomLevels = zoomLevels;
+    sort(sortedZoomLevels.begin(), sortedZoomLevels.end());
+
+    vector<Sequence> sequences;
+    unsigned long long count = 0;
+    for(vector<string>::const_iterator layer = allLayers.begin(); layer != allLayers.end(); ++layer) {
+        for(vector<Zoom>::const_iterator z = sortedZoomLevels.begin(); z != sortedZoomLevels.end(); ++z) {
+            Sequence s;
+            s.layer = *layer;
+            s.z = *z;
+            s.area = area*pow2(*z-sortedZoomLevels[0]);
+            s.begin = resume ? min(destination->packagedTileCount(*layer, *z), s.area.w*s.area.h) : 0;
+            s.offset = count;
+            sequences.push_back(s);
+
+            count += s.area.w*s.area.h - s.begin;
+            total += s.area.w*s.area.h;
+            resumed += s.begin;
+        }
+    }
+    done = resumed.load();
+
+    bool ok = run(sequences, count);
+    if(!destination->finalizePackage()) ok = false;
+
+    return ok && done == total;
+}
+
+void RegionPackager::cancel() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+    }
+    condition.notify_all();
+}
+
+RegionPackager::Progress RegionPackager::progress() const {
+    Progress p;
+    p.total = total;
+    p.done = done;
+    p.resumed = resumed;
+    p.downloaded = downloaded;
+    p.missing = missing;
+    p.failed = failed;
+    return p;
+}
+
+bool RegionPackager::run(const vector<Sequence>& sequences, unsigned long long count) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        tiles.assign(min<unsigned long long>(_windowSize, count), Slot());
+    }
+
+    /* The scheduler is destroyed before the function ends, so no callback
+       can change the tiles after that */
+    DownloadScheduler scheduler(source, downloader, threadCount, hostConnections);
+
+    unsigned long long issued = 0, saved = 0;
+    while(saved != count) {
+        while(issued != count && issued - saved < tiles.size())
+            request(&scheduler, sequences, issued++);
+
+        /* Wait for the first unsaved tile */
+        Slot slot;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            Slot& s = tiles[saved%tiles.size()];
+            while(!s.ready && !cancelled) condition.wait(lock);
+            if(cancelled) return false;
+
+            slot = s;
+            s = Slot();
+        }
+
+        if(slot.status == 200) ++downloaded;
+        else if(slot.status == 404) ++missing;
+
+        /* Retry failed download in the same slot */
+        else if(slot.attempts < _retryCount) {
+            {
+                lock_guard<std::mutex> lock(mutex);
+                tiles[saved%tiles.size()].attempts = slot.attempts+1;
+            }
+            request(&scheduler, sequences, saved);
+            continue;
+
+        } else {
+            ++failed;
+            return false;
+        }
+
+        TileCoords coords;
+        const Sequence& sequence = tile(sequences, saved, &coords);
+        if(!destination->tileToPackage(sequence.layer, sequence.z, coords, slot.data.toString())) {
+            ++failed;
+            return false;
+        }
+
+        ++saved;
+        ++done;
+        if(_progressCallback) _progressCallback(progress());
+    }
+
+    return true;
+}
+
+void RegionPackager::request(DownloadScheduler* scheduler, const vector<Sequence>& sequences, unsigned long long index) {
+    TileCoords coords;
+    const Sequence& sequence = tile(sequences, index, &coords);
+
+    const bool requested = scheduler->request(sequence.layer, sequence.z, coords, [this, index](const string&, Zoom, const TileCoords&, int status, const TileData& data) {
+        if(status == DownloadScheduler::Cancelled) return;
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            Slot& slot = tiles[index%tiles.size()];
+            slot.ready = true;
+            slot.status = status;
+            slot.data = data;
+        }
+        condition.notify_all();
+    });
+
+    /* Tile without URL doesn't exist */
+    if(!requested) {
+        lock_guard<std::mutex> lock(mutex);
+        Slot& slot = tiles[index%tiles.size()];
+        slot.ready = true;
+        slot.status = 404;
+    }
+}
+
+const RegionPackager::Sequence& RegionPackager::tile(const vector<Sequence>& sequences, unsigned long long index, TileCoords* coords) {
+    /* Last sequence which begins before the index. Empty sequences have the
+       same offset as the next one, so they are skipped. */
+    vector<Sequence>::const_iterator s = sequences.end();
+    while((--s)->offset > index) {}
+
+    const unsigned int position = index - s->offset + s->begin;
+    *coords = TileCoords(s->area.x + position%s->area.w, s->area.y + position/s->area.w);
+    return *s;
+}
+
+}}
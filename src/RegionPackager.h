@@ -0,0 +1,200 @@
+#ifndef Kompas_Core_RegionPackager_h
+#define Kompas_Core_RegionPackager_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::RegionPackager
+ */
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "AbstractRasterModel.h"
+
+namespace Kompas { namespace Core {
+
+class AbstractDownloader;
+class DownloadScheduler;
+
+/**
+@brief Creating offline packages from online models
+
+Downloads all tiles of given area and zoom levels from online model and saves
+them into new package of writeable model, e.g. KompasRasterModel.
+@code
+OpenStreetMapRasterModel source;
+source.setOnline(true);
+KompasRasterModel destination;
+HttpDownloader downloader;
+
+RegionPackager packager(&source, &destination, &downloader, 8);
+packager.setProgressCallback([](const RegionPackager::Progress& p) {
+    std::cout << p.done << '/' << p.total << std::endl;
+});
+packager.create("/path/to/package/map.conf", zoomLevels, area, layers);
+@endcode
+
+The tiles are downloaded in parallel with DownloadScheduler, but saved with
+AbstractRasterModel::tileToPackage() in row-major order for each layer and
+zoom level, as required by models with @ref AbstractRasterModel::SequentialFormat.
+At most windowSize() tiles after the first unsaved one are downloaded at
+once, tiles which are downloaded sooner than the tiles before them wait in
+memory, so the memory usage is bounded and no intermediate files are needed.
+Tiles which don't exist on the server are saved as empty, other failed
+downloads are retried retryCount() times and then the packaging stops.
+
+If the destination model supports @ref AbstractRasterModel::ResumableFormat,
+interrupted or failed packaging can be continued by calling create() with the
+same parameters and @p resume set to true. Tiles which are already in the
+package are then not downloaded again.
+*/
+class CORE_EXPORT RegionPackager {
+    public:
+        /** @brief Progress */
+        struct Progress {
+            inline Progress(): total(0), done(0), resumed(0), downloaded(0), missing(0), failed(0) {}
+
+            unsigned long long total,   /**< @brief Count of all tiles */
+                done,                   /**< @brief Count of tiles in the package */
+                resumed,                /**< @brief Tiles kept from interrupted package */
+                downloaded,             /**< @brief Downloaded tiles */
+                missing,                /**< @brief Tiles which don't exist */
+                failed;                 /**< @brief Tiles which couldn't be downloaded or saved */
+        };
+
+        /**
+         * @brief Progress callback
+         *
+         * @see setProgressCallback()
+         */
+        typedef std::function<void(const Progress&)> ProgressCallback;
+
+        /**
+         * @brief Constructor
+         * @param source            Online source model
+         * @param destination       Writeable destination model
+         * @param downloader        Downloader
+         * @param threadCount       Count of download threads
+         * @param hostConnections   Max count of concurrent downloads from
+         *      one host
+         */
+        RegionPackager(const AbstractRasterModel* source, AbstractRasterModel* destination, AbstractDownloader* downloader, unsigned int threadCount = 4, unsigned int hostConnections = 2);
+
+        /** @brief Max count of tiles being downloaded or waiting for saving */
+        inline size_t windowSize() const { return _windowSize; }
+
+        /**
+         * @brief Set max count of tiles being downloaded or waiting for saving
+         *
+         * Default is 256. The window should be large enough to keep all
+         * download threads busy while waiting for slow tile.
+         */
+        inline void setWindowSize(size_t size) { _windowSize = size ? size : 1; }
+
+        /** @brief Count of retries of failed download */
+        inline unsigned int retryCount() const { return _retryCount; }
+
+        /**
+         * @brief Set count of retries of failed download
+         *
+         * Default is 2.
+         */
+        inline void setRetryCount(unsigned int count) { _retryCount = count; }
+
+        /**
+         * @brief Set progress callback
+         *
+         * The callback is called after each saved tile from the thread
+         * which called create().
+         */
+        inline void setProgressCallback(const ProgressCallback& callback) { _progressCallback = callback; }
+
+        /**
+         * @brief Create package
+         * @param filename      Package filename
+         * @param zoomLevels    Zoom levels
+         * @param area          Tile area for lowest zoom
+         * @param layers        Map layers
+         * @param overlays      Map overlays
+         * @param resume        Whether to resume interrupted package
+         * @return Whether all tiles were saved and the package finalized.
+         *
+         * Blocks until all tiles are saved, some tile fails or cancel() is
+         * called. The package is finalized also on failure, so it can be
+         * resumed later.
+         */
+        bool create(const std::string& filename, const std::vector<Zoom>& zoomLevels, const TileArea& area, const std::vector<std::string>& layers, const std::vector<std::string>& overlays = std::vector<std::string>(), bool resume = false);
+
+        /**
+         * @brief Cancel packaging
+         *
+         * Can be called from any thread, including the progress callback.
+         * Downloads which already started are finished, but not saved.
+         */
+        void cancel();
+
+        /** @brief Current progress */
+        Progress progress() const;
+
+    private:
+        /* Tiles of one layer and zoom level */
+        struct Sequence {
+            std::string layer;
+            Zoom z;
+            TileArea area;
+            unsigned int begin;     /* Tiles already in the package */
+            unsigned long long offset;  /* Index of first unsaved tile */
+        };
+
+        /* Tile in the window */
+        struct Slot {
+            inline Slot(): ready(false), status(0), attempts(0) {}
+
+            bool ready;
+            int status;
+            unsigned int attempts;
+            TileData data;
+        };
+
+        const AbstractRasterModel* source;
+        AbstractRasterModel* destination;
+        AbstractDownloader* downloader;
+        unsigned int threadCount, hostConnections;
+        size_t _windowSize;
+        unsigned int _retryCount;
+        ProgressCallback _progressCallback;
+
+        std::atomic<unsigned long long> total, done, resumed, downloaded, missing, failed;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool cancelled;
+        std::vector<Slot> tiles;        /* Window, tile i is at i%size */
+
+        bool run(const std::vector<Sequence>& sequences, unsigned long long count);
+        void request(DownloadScheduler* scheduler, const std::vector<Sequence>& sequences, unsigned long long index);
+
+        /* Unsaved tile with given index */
+        static const Sequence& tile(const std::vector<Sequence>& sequences, unsigned long long index, TileCoords* coords);
+};
+
+}}
+
+#endif
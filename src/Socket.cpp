@@ -0,0 +1,143 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "Socket.h"
+
+#include <sstream>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+#ifdef _WIN32
+namespace {
+    /* Winsock has to be initialized before any socket is created */
+    struct WinsockInitializer {
+        WinsockInitializer() {
+            WSADATA data;
+            WSAStartup(MAKEWORD(2, 2), &data);
+        }
+        ~WinsockInitializer() { WSACleanup(); }
+    } winsockInitializer;
+}
+
+#define closesocket_ closesocket
+#else
+#define closesocket_ ::close
+#endif
+
+Socket::Socket(): fd(-1) {}
+
+bool Socket::connect(const string& host, unsigned short port, unsigned int timeout) {
+    close();
+
+    ostringstream service;
+    service << port;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addresses;
+    if(getaddrinfo(host.c_str(), service.str().c_str(), &hints, &addresses) != 0)
+        return false;
+
+    /* Try all addresses until one of them succeeds */
+    for(addrinfo* address = addresses; address; address = address->ai_next) {
+        long s = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if(s == -1) continue;
+
+        if(::connect(s, address->ai_addr, address->ai_addrlen) == 0) {
+            fd = s;
+            break;
+        }
+
+        closesocket_(s);
+    }
+
+    freeaddrinfo(addresses);
+    if(fd == -1) return false;
+
+    /* Small requests shouldn't wait for more data */
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&flag), sizeof(flag));
+
+    if(timeout) {
+        #ifdef _WIN32
+        DWORD t = timeout;
+        #else
+        timeval t;
+        t.tv_sec = timeout/1000;
+        t.tv_usec = (timeout%1000)*1000;
+        #endif
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&t), sizeof(t));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&t), sizeof(t));
+    }
+
+    return true;
+}
+
+bool Socket::send(const string& data) {
+    if(fd == -1) return false;
+
+    size_t sent = 0;
+    while(sent != data.size()) {
+        #ifdef MSG_NOSIGNAL
+        long ret = ::send(fd, data.data()+sent, data.size()-sent, MSG_NOSIGNAL);
+        #else
+        long ret = ::send(fd, data.data()+sent, data.size()-sent, 0);
+        #endif
+        if(ret <= 0) {
+            close();
+            return false;
+        }
+
+        sent += ret;
+    }
+
+    return true;
+}
+
+long Socket::receive(char* buffer, size_t size) {
+    if(fd == -1) return -1;
+
+    long ret = recv(fd, buffer, size, 0);
+    if(ret < 0) close();
+    return ret;
+}
+
+void Socket::close() {
+    if(fd == -1) return;
+
+    closesocket_(fd);
+    fd = -1;
+}
+
+}}
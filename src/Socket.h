@@ -0,0 +1,92 @@
+#ifndef Kompas_Core_Socket_h
+#define Kompas_Core_Socket_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::Socket
+ */
+
+#include <string>
+
+#include "utilities.h"
+
+namespace Kompas { namespace Core {
+
+/**
+ * @brief Blocking TCP client socket
+ *
+ * Minimal wrapper around platform sockets, used by downloaders and network
+ * caches.
+ */
+class CORE_EXPORT Socket {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * Creates unconnected socket.
+         */
+        Socket();
+
+        /**
+         * @brief Destructor
+         *
+         * Closes the connection.
+         */
+        inline ~Socket() { close(); }
+
+        /**
+         * @brief Connect to given host
+         * @param host      Host name or IP address
+         * @param port      Port
+         * @param timeout   Timeout for sending and receiving data, in
+         *      milliseconds. If set to 0, the operations don't time out.
+         * @return Whether the connection succeeded. If the socket was already
+         *      connected, the previous connection is closed first.
+         */
+        bool connect(const std::string& host, unsigned short port, unsigned int timeout = 0);
+
+        /** @brief Whether the socket is connected */
+        inline bool isConnected() const { return fd != -1; }
+
+        /**
+         * @brief Send data
+         * @return Whether all data were sent. On failure the connection is
+         *      closed.
+         */
+        bool send(const std::string& data);
+
+        /**
+         * @brief Receive data
+         * @param buffer    Buffer to receive data into
+         * @param size      Buffer size
+         * @return Count of received bytes, 0 if the other side closed the
+         *      connection, -1 on error (and the connection is closed).
+         */
+        long receive(char* buffer, size_t size);
+
+        /** @brief Close the connection */
+        void close();
+
+    private:
+        long fd;
+
+        Socket(const Socket& other);
+        Socket& operator=(const Socket& other);
+};
+
+}}
+
+#endif
@@ -43,4 +43,12 @@ void AbstractRasterModelTest::tilesInArea() {
     QVERIFY(model.tilesInArea(tileArea) == expected);
 }
 
+void AbstractRasterModelTest::tileHost() {
+    /* Layer name is returned as tile URL */
+    QVERIFY(model.tileHost("http://tile.openstreetmap.org/1/0/0.png", 1, TileCoords()) == "tile.openstreetmap.org");
+    QVERIFY(model.tileHost("http://127.0.0.1:8080", 1, TileCoords()) == "127.0.0.1:8080");
+    QVERIFY(model.tileHost("tile.openstreetmap.org/1/0/0.png", 1, TileCoords()) == "");
+    QVERIFY(model.tileHost("", 1, TileCoords()) == "");
+}
+
 }}}
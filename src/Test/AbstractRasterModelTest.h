@@ -27,6 +27,7 @@ class AbstractRasterModelTest: public QObject {
     private slots:
         void tilesInArea_data();
         void tilesInArea();
+        void tileHost();
 
     private:
         class TestRasterModel: public AbstractRasterModel {
@@ -37,8 +38,9 @@ class AbstractRasterModelTest: public QObject {
                 virtual std::set<Zoom> zoomLevels() const { return std::set<Zoom>(); }
                 virtual std::vector<std::string> layers() const { return std::vector<std::string>(); }
                 virtual int packageCount() const { return 0; }
-                virtual std::string tileFromPackage(const std::string &layer, Zoom z, const TileCoords &coords) { return ""; }
+                virtual TileData tileFromPackage(const std::string &layer, Zoom z, const TileCoords &coords) const { return TileData(); }
                 virtual TileSize tileSize() const { return TileSize(256,128); }
+                virtual std::string tileUrl(const std::string& layer, Zoom z, const TileCoords& coords) const { return layer; }
         };
 
         TestRasterModel model;
@@ -0,0 +1,90 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheKeyTest.h"
+
+#include <QtTest/QTest>
+
+#include "CacheKey.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::CacheKeyTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+void CacheKeyTest::construct() {
+    CacheKey a('T', "OpenStreetMapRasterModel", "mapnik", 5, TileCoords(3, 7));
+    QVERIFY(a.kind() == 'T');
+    QVERIFY(a.model() == CacheKey::id("OpenStreetMapRasterModel"));
+    QVERIFY(a.layer() == CacheKey::id("mapnik"));
+    QVERIFY(a.z() == 5);
+    QVERIFY(a.coords() == TileCoords(3, 7));
+
+    /* Constructing from IDs gives the same key */
+    CacheKey b('T', CacheKey::id("OpenStreetMapRasterModel"), CacheKey::id("mapnik"), 5, TileCoords(3, 7));
+    QVERIFY(a == b);
+    QVERIFY(a.hash() == b.hash());
+}
+
+void CacheKeyTest::compare() {
+    CacheKey a('T', "Model", "base", 5, TileCoords(3, 7));
+
+    QVERIFY(a != CacheKey('M', "Model", "base", 5, TileCoords(3, 7)));
+    QVERIFY(a != CacheKey('T', "Other", "base", 5, TileCoords(3, 7)));
+    QVERIFY(a != CacheKey('T', "Model", "overlay", 5, TileCoords(3, 7)));
+    QVERIFY(a != CacheKey('T', "Model", "base", 6, TileCoords(3, 7)));
+    QVERIFY(a != CacheKey('T', "Model", "base", 5, TileCoords(7, 3)));
+
+    /* Swapped coordinates don't have the same hash */
+    QVERIFY(a.hash() != CacheKey('T', "Model", "base", 5, TileCoords(7, 3)).hash());
+}
+
+void CacheKeyTest::collision() {
+    /* Names with the same FNV-1a hash get different IDs */
+    uint32_t a = CacheKey::id("glbvs");
+    uint32_t b = CacheKey::id("yacxa");
+    QVERIFY(a == 0xa1bc9a4f);
+    QVERIFY(a != b);
+
+    /* The IDs stay the same */
+    QVERIFY(CacheKey::id("yacxa") == b);
+    QVERIFY(CacheKey::id("glbvs") == a);
+
+    QVERIFY(CacheKey::name(a) == "glbvs");
+    QVERIFY(CacheKey::name(b) == "yacxa");
+    QVERIFY(CacheKey('T', "glbvs", "base", 5, TileCoords(3, 7)) != CacheKey('T', "yacxa", "base", 5, TileCoords(3, 7)));
+}
+
+void CacheKeyTest::toString() {
+    string s = CacheKey('T', "Model", "base", 0x0c0b0a09, TileCoords(0x11, 0x22)).toString();
+    QVERIFY(s == string("T"
+        "\x09\x0a\x0b\x0c"
+        "\x11\0\0\0"
+        "\x22\0\0\0"
+        "Model\0"
+        "base\0", 24));
+
+    /* Unknown IDs */
+    s = CacheKey('T', 0x04030201, 0x08070605, 0x0c0b0a09, TileCoords(0x11, 0x22)).toString();
+    QVERIFY(s == string("T"
+        "\x09\x0a\x0b\x0c"
+        "\x11\0\0\0"
+        "\x22\0\0\0"
+        "#4030201\0"
+        "#8070605\0", 31));
+}
+
+}}}
@@ -0,0 +1,126 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheMaintainerTest.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <QtTest/QTest>
+
+#include "CacheMaintainer.h"
+#include "AbstractCache.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::CacheMaintainerTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    /* Cache which has given count of maintenance steps to do */
+    class Cache: public AbstractCache {
+        public:
+            inline Cache(): work(0), calls(0), budget(0) {}
+
+            inline int features() const { return 0; }
+            inline bool initializeCache(const string& url) { return true; }
+            inline void finalizeCache() {}
+            inline size_t cacheSize() const { return 0; }
+            inline void setCacheSize(size_t size) {}
+            inline size_t usedSize() const { return 0; }
+            inline void purge() {}
+            inline void optimize() {}
+            inline void schedulePurge() { work = 10; }
+
+            bool maintain(unsigned int budget) {
+                ++calls;
+                this->budget = budget;
+                if(work) --work;
+                return work != 0;
+            }
+
+            atomic<unsigned int> work, calls, budget;
+    };
+
+    /* Wait until the condition is true or timeout expires */
+    template<class T> bool waitFor(T condition) {
+        for(unsigned int i = 0; i != 500; ++i) {
+            if(condition()) return true;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+
+        return false;
+    }
+}
+
+void CacheMaintainerTest::idle() {
+    Cache cache;
+    CacheMaintainer maintainer(&cache, 1500, 0, 10);
+
+    /* The cache is checked periodically with given budget */
+    QVERIFY(waitFor([&]() { return cache.calls >= 3; }));
+    QVERIFY(cache.budget == 1500);
+    QVERIFY(!maintainer.isBusy());
+}
+
+void CacheMaintainerTest::wake() {
+    Cache cache;
+    CacheMaintainer maintainer(&cache, 1000, 0, 100000);
+    QVERIFY(waitFor([&]() { return maintainer.steps() == 1; }));
+
+    /* All work is done after waking, without waiting for the interval */
+    cache.schedulePurge();
+    maintainer.wake();
+    QVERIFY(waitFor([&]() { return cache.work == 0; }));
+    QVERIFY(cache.calls == 11);
+}
+
+void CacheMaintainerTest::throttle() {
+    Cache cache;
+    cache.work = 1000;
+    CacheMaintainer maintainer(&cache, 1000, 20000, 100000);
+
+    /* There is pause after each step */
+    this_thread::sleep_for(chrono::milliseconds(100));
+    QVERIFY(maintainer.isBusy());
+    QVERIFY(cache.calls <= 6);
+
+    /* Without pause the work is done quickly */
+    maintainer.setPause(0);
+    QVERIFY(waitFor([&]() { return cache.work == 0; }));
+    QVERIFY(!maintainer.isBusy());
+}
+
+void CacheMaintainerTest::stop() {
+    Cache cache;
+    cache.work = 1000;
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    /* Neither long pause nor idle interval delays the destruction */
+    {
+        CacheMaintainer maintainer(&cache, 1000, 100000000, 100000);
+        QVERIFY(waitFor([&]() { return maintainer.steps() == 1; }));
+    }
+    {
+        Cache idle;
+        CacheMaintainer maintainer(&idle, 1000, 0, 100000);
+        QVERIFY(waitFor([&]() { return maintainer.steps() == 1; }));
+    }
+
+    QVERIFY(chrono::steady_clock::now()-start < chrono::seconds(10));
+}
+
+}}}
@@ -0,0 +1,215 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheSeederTest.h"
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <QtTest/QTest>
+
+#include "CacheSeeder.h"
+#include "AbstractCache.h"
+#include "AbstractDownloader.h"
+#include "AbstractProjection.h"
+#include "RasterModelStub.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::CacheSeederTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    /* Longitude and latitude mapped linearly to 0 - 1 */
+    class Projection: public AbstractProjection {
+        public:
+            Coords<double> fromLatLon(const LatLonCoords& coords) const {
+                return Coords<double>((coords.longitude()+180)/360, (90-coords.latitude())/180);
+            }
+
+            LatLonCoords toLatLon(const Coords<double>& coords) const {
+                return LatLonCoords(90-coords.y*180, coords.x*360-180);
+            }
+    };
+
+    /* Model with zoom levels 1 - 4 and one tile in package */
+    class Model: public RasterModelStub {
+        public:
+            inline Model(const TileArea& area = TileArea(0, 0, 2, 2)) {
+                setProjection(&_projection);
+                setArea(area);
+                setZoomLevels(1, 4);
+                setPackageTile(1, TileCoords(0, 0));
+            }
+
+        private:
+            Projection _projection;
+    };
+
+    /* Tiles in the first column don't exist */
+    class Downloader: public AbstractDownloader {
+        public:
+            inline Downloader(): count(0) {}
+
+            int download(const string& url, string* data) {
+                ++count;
+                if(url.find("/0/") != string::npos) return 404;
+                *data = url;
+                return 200;
+            }
+
+            atomic<unsigned int> count;
+    };
+
+    class Cache: public AbstractCache {
+        public:
+            inline Cache(): checks(0) {}
+            inline int features() const { return 0; }
+            inline bool initializeCache(const string& url) { return true; }
+            inline void finalizeCache() {}
+            inline size_t cacheSize() const { return 0; }
+            inline void setCacheSize(size_t size) {}
+            inline size_t usedSize() const { return 0; }
+            inline void purge() {}
+            inline void optimize() {}
+
+            inline size_t count() const {
+                lock_guard<mutex> lock(dataMutex);
+                return data.size();
+            }
+
+            TileData get(const CacheKey& key) {
+                lock_guard<mutex> lock(dataMutex);
+                map<string, TileData>::const_iterator found = data.find(key.toString());
+                return found == data.end() ? TileData() : found->second;
+            }
+
+            bool set(const CacheKey& key, const TileData& tile) {
+                lock_guard<mutex> lock(dataMutex);
+                data[key.toString()] = tile;
+                return true;
+            }
+
+            vector<bool> contains(const vector<CacheKey>& keys) {
+                ++checks;
+                return AbstractCache::contains(keys);
+            }
+
+            atomic<unsigned int> checks;
+
+        private:
+            mutable mutex dataMutex;
+            map<string, TileData> data;
+    };
+}
+
+void CacheSeederTest::tileArea() {
+    Model model;
+
+    /* Whole world */
+    QVERIFY(CacheSeeder::tileArea(&model, LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 2) == TileArea(0, 0, 4, 4));
+
+    /* Corners can be in any order, tiles on the border are included */
+    QVERIFY(CacheSeeder::tileArea(&model, LatLonCoords(-10, 10), LatLonCoords(10, -10), 3) == TileArea(3, 3, 2, 2));
+    QVERIFY(CacheSeeder::tileArea(&model, LatLonCoords(50, 10), LatLonCoords(45, 20), 4) == TileArea(8, 3, 1, 2));
+
+    /* Clipped to model area */
+    Model small(TileArea(1, 0, 1, 1));
+    QVERIFY(CacheSeeder::tileArea(&small, LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 2) == TileArea(2, 0, 2, 2));
+    QVERIFY(CacheSeeder::tileArea(&small, LatLonCoords(-10, -170), LatLonCoords(-20, -160), 2) == TileArea());
+
+    /* Invalid region, zoom below the lowest */
+    QVERIFY(CacheSeeder::tileArea(&model, LatLonCoords(), LatLonCoords(-90, 179.9), 2) == TileArea());
+    QVERIFY(CacheSeeder::tileArea(&model, LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 0) == TileArea());
+}
+
+void CacheSeederTest::seed() {
+    Model model;
+    model.setOnline(true);
+    Cache cache;
+    Downloader downloader;
+    CacheSeeder seeder(&model, &cache, &downloader, 4);
+    seeder.setBatchSize(5);
+
+    /* Zoom 0 and 5 aren't provided by the model */
+    CacheSeeder::Progress p = seeder.seed("base", LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 0, 5);
+    QVERIFY(p.total == 4+16+64+256);
+    QVERIFY(p.done == p.total);
+    QVERIFY(p.present == 0);
+    QVERIFY(p.failed == 0);
+
+    /* First column is missing, except tile from package */
+    QVERIFY(p.missing == 2+4+8+16-1);
+    QVERIFY(p.seeded == p.total-p.missing);
+    QVERIFY(downloader.count == p.total-1);
+    QVERIFY(cache.count() == p.seeded);
+    QVERIFY(model.tileFromCache(&cache, "base", 1, TileCoords(0, 0)) == "package");
+    QVERIFY(model.tileFromCache(&cache, "base", 3, TileCoords(5, 6)) == "http://host1/base/3/5/6");
+
+    /* Presence is checked in batches, which don't span zoom levels */
+    QVERIFY(cache.checks == 1+4+13+52);
+
+    /* Nothing is downloaded again */
+    p = seeder.seed("base", LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 1, 4);
+    QVERIFY(p.present == cache.count());
+    QVERIFY(p.missing == 2+4+8+16-1);
+    QVERIFY(p.seeded == 0);
+    QVERIFY(p.done == p.total);
+    QVERIFY(downloader.count == p.total-1);
+}
+
+void CacheSeederTest::offline() {
+    Model model;
+    Cache cache;
+    Downloader downloader;
+    CacheSeeder seeder(&model, &cache, &downloader);
+
+    /* Only the tile from package is available */
+    CacheSeeder::Progress p = seeder.seed("base", LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 1, 2);
+    QVERIFY(p.total == 20);
+    QVERIFY(p.seeded == 1);
+    QVERIFY(p.failed == 19);
+    QVERIFY(downloader.count == 0);
+}
+
+void CacheSeederTest::cancel() {
+    Model model;
+    model.setOnline(true);
+    Cache cache;
+    Downloader downloader;
+    CacheSeeder seeder(&model, &cache, &downloader, 2);
+    seeder.setBatchSize(4);
+
+    unsigned int calls = 0;
+    unsigned long long lastDone = 0;
+    bool ordered = true;
+    seeder.setProgressCallback([&](const CacheSeeder::Progress& p) {
+        if(p.done < lastDone) ordered = false;
+        lastDone = p.done;
+        if(++calls == 3) seeder.cancel();
+    });
+
+    CacheSeeder::Progress p = seeder.seed("base", LatLonCoords(90, -179.9), LatLonCoords(-90, 179.9), 4, 4);
+    QVERIFY(p.total == 256);
+
+    /* Batches being processed are finished */
+    QVERIFY(p.done >= 12 && p.done <= 16);
+    QVERIFY(p.done%4 == 0);
+    QVERIFY(calls >= 3 && calls <= 4);
+    QVERIFY(ordered);
+}
+
+}}}
@@ -0,0 +1,233 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "CacheStatisticsTest.h"
+
+#include <vector>
+#include <thread>
+#include <unordered_map>
+#include <QtTest/QTest>
+
+#include "CacheStatistics.h"
+#include "AbstractCache.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::CacheStatisticsTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    inline CacheKey key(const string& layer, Zoom z, unsigned int x = 0) {
+        return CacheKey(AbstractCache::RasterTile, "Model", layer, z, TileCoords(x, 0));
+    }
+
+    /* Cache which keeps at most two data */
+    class Cache: public AbstractCache {
+        public:
+            inline int features() const { return 0; }
+            inline bool initializeCache(const string& url) { return true; }
+            inline void finalizeCache() {}
+            inline size_t cacheSize() const { return 0; }
+            inline void setCacheSize(size_t size) {}
+            inline size_t usedSize() const { return 0; }
+            inline void purge() {}
+            inline void optimize() {}
+
+            TileData get(const CacheKey& key) {
+                unordered_map<CacheKey, TileData>::const_iterator found = data.find(key);
+                return found == data.end() ? TileData() : found->second;
+            }
+
+            bool set(const CacheKey& key, const TileData& tile) {
+                if(tile.size() > 100) return false;
+
+                if(data.size() == 2) {
+                    if(hasEvictionListener() || hasStatistics()) evicted(data.begin()->first, data.begin()->second);
+                    data.erase(data.begin());
+                }
+
+                data[key] = tile;
+                return true;
+            }
+
+        private:
+            unordered_map<CacheKey, TileData> data;
+    };
+
+    void record(CacheStatistics* statistics, unsigned int i) {
+        for(unsigned int j = 0; j != 1000; ++j) {
+            statistics->recordGet(key("base", i), j%4 ? 10 : 0, 100);
+            if(j%10 == 0) statistics->recordSet(key("base", i), 10, 1000);
+        }
+    }
+}
+
+void CacheStatisticsTest::histogram() {
+    CacheStatistics::Histogram h;
+    QVERIFY(h.count() == 0);
+    QVERIFY(h.percentile(0.5) == 0);
+
+    h.add(0);
+    h.add(1);
+    h.add(1000);
+    h.add(1023);
+    h.add(1024);
+    QVERIFY(h.count() == 5);
+    QVERIFY(h.bucket(0) == 1);
+    QVERIFY(h.bucket(1) == 1);
+    QVERIFY(h.bucket(10) == 2);
+    QVERIFY(h.bucket(11) == 1);
+
+    /* Upper bounds of buckets */
+    QVERIFY(h.percentile(0.0) == 1);
+    QVERIFY(h.percentile(0.5) == 1024);
+    QVERIFY(h.percentile(1.0) == 2048);
+
+    /* Very long latencies end in the last bucket */
+    h.add(~0ull);
+    QVERIFY(h.bucket(CacheStatistics::Histogram::BucketCount-1) == 1);
+
+    CacheStatistics::Histogram other;
+    other.add(1);
+    other += h;
+    QVERIFY(other.count() == 7);
+    QVERIFY(other.bucket(1) == 2);
+}
+
+void CacheStatisticsTest::counters() {
+    CacheStatistics statistics;
+    QVERIFY(statistics.total().hitRatio() == 0.0);
+
+    statistics.recordGet(key("base", 3), 100, 10);
+    statistics.recordGet(key("base", 3), 0, 10);
+    statistics.recordGet(key("base", 3), 50, 10);
+    statistics.recordGet(key("base", 3), 0, 10);
+    statistics.recordSet(key("base", 3), 70, 2000);
+    statistics.recordSet(key("base", 3), 1000, 2000, false);
+    statistics.recordEviction(key("base", 3), 70);
+
+    CacheStatistics::Counters total = statistics.total();
+    QVERIFY(total.hits == 2);
+    QVERIFY(total.misses == 2);
+    QVERIFY(total.hitRatio() == 0.5);
+    QVERIFY(total.inserts == 1);
+    QVERIFY(total.evictions == 1);
+    QVERIFY(total.bytesRead == 150);
+    QVERIFY(total.bytesWritten == 70);
+    QVERIFY(total.bytesEvicted == 70);
+    QVERIFY(total.getLatency.count() == 4);
+    QVERIFY(total.setLatency.count() == 2);
+    QVERIFY(total.setLatency.percentile(0.5) == 2048);
+
+    statistics.reset();
+    QVERIFY(statistics.total().hits == 0);
+    QVERIFY(statistics.snapshot().empty());
+}
+
+void CacheStatisticsTest::breakdown() {
+    CacheStatistics statistics;
+    statistics.recordGet(key("base", 3), 10, 0);
+    statistics.recordGet(key("base", 4), 10, 0);
+    statistics.recordGet(key("base", 4), 10, 0);
+    statistics.recordGet(key("overlay", 4), 0, 0);
+
+    QVERIFY(statistics.counters("Model").hits == 3);
+    QVERIFY(statistics.counters("Model").misses == 1);
+    QVERIFY(statistics.counters("Model", "base").hits == 3);
+    QVERIFY(statistics.counters("Model", "base", 4).hits == 2);
+    QVERIFY(statistics.counters("Model", "", 4).misses == 1);
+    QVERIFY(statistics.counters("Other").hits == 0);
+
+    vector<CacheStatistics::Entry> entries = statistics.snapshot();
+    QVERIFY(entries.size() == 3);
+    for(vector<CacheStatistics::Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        QVERIFY(it->model == CacheKey::id("Model"));
+        if(it->layer == CacheKey::id("overlay")) QVERIFY(it->counters.misses == 1);
+        else if(it->z == 4) QVERIFY(it->counters.hits == 2);
+        else QVERIFY(it->z == 3 && it->counters.hits == 1);
+    }
+}
+
+void CacheStatisticsTest::threaded() {
+    CacheStatistics statistics;
+
+    vector<thread> threads;
+    for(unsigned int i = 0; i != 8; ++i)
+        threads.push_back(thread(record, &statistics, i%4));
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    CacheStatistics::Counters total = statistics.total();
+    QVERIFY(total.hits == 8*750);
+    QVERIFY(total.misses == 8*250);
+    QVERIFY(total.inserts == 8*100);
+    QVERIFY(statistics.snapshot().size() == 4);
+    QVERIFY(statistics.counters("Model", "base", 2).hits == 2*750);
+}
+
+void CacheStatisticsTest::json() {
+    CacheStatistics statistics;
+    QVERIFY(statistics.toJson() == "{\"total\":{\"hits\":0,\"misses\":0,\"inserts\":0,\"evictions\":0,\"bytesRead\":0,\"bytesWritten\":0,\"bytesEvicted\":0,\"hitRatio\":0,"
+        "\"getLatency\":{\"count\":0,\"p50\":0,\"p90\":0,\"p99\":0,\"buckets\":[]},"
+        "\"setLatency\":{\"count\":0,\"p50\":0,\"p90\":0,\"p99\":0,\"buckets\":[]}},\"entries\":[]}");
+
+    /* Names are used if known */
+    statistics.addName("Model");
+    statistics.recordGet(CacheKey(AbstractCache::RasterTile, "Model", "ba\"se", 3, TileCoords()), 10, 3);
+    QVERIFY(statistics.name(CacheKey::id("Model")) == "Model");
+    QVERIFY(statistics.name(CacheKey::id("ba\"se")) == "");
+
+    ostringstream layer;
+    layer << '#' << hex << CacheKey::id("ba\"se");
+    const string json = statistics.toJson();
+    QVERIFY(json.find("\"entries\":[{\"model\":\"Model\",\"layer\":\"" + layer.str() + "\",\"zoom\":3,\"hits\":1,\"misses\":0,") != string::npos);
+    QVERIFY(json.find("\"getLatency\":{\"count\":1,\"p50\":4,\"p90\":4,\"p99\":4,\"buckets\":[[4,1]]}") != string::npos);
+}
+
+void CacheStatisticsTest::cache() {
+    Cache cache;
+    CacheStatistics statistics;
+    cache.setStatistics(&statistics);
+    QVERIFY(cache.statistics() == &statistics);
+
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(0, 0)) == "");
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(0, 0), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(1, 0), "tile"));
+    QVERIFY(cache.setRasterTile("Model", "base", 3, TileCoords(2, 0), "tile"));
+    QVERIFY(!cache.setRasterTile("Model", "base", 3, TileCoords(3, 0), string(101, 'x')));
+    QVERIFY(cache.rasterTile("Model", "base", 3, TileCoords(2, 0)) == "tile");
+
+    CacheStatistics::Counters total = statistics.total();
+    QVERIFY(total.hits == 1);
+    QVERIFY(total.misses == 1);
+    QVERIFY(total.inserts == 3);
+    QVERIFY(total.evictions == 1);
+    QVERIFY(total.bytesRead == 4);
+    QVERIFY(total.bytesWritten == 12);
+    QVERIFY(total.bytesEvicted == 4);
+    QVERIFY(total.setLatency.count() == 4);
+
+    /* Names were remembered from the calls */
+    QVERIFY(statistics.name(CacheKey::id("Model")) == "Model");
+    QVERIFY(statistics.name(CacheKey::id("base")) == "base");
+
+    /* Counting can be disabled */
+    cache.setStatistics(0);
+    cache.rasterTile("Model", "base", 3, TileCoords(2, 0));
+    QVERIFY(statistics.total().hits == 1);
+}
+
+}}}
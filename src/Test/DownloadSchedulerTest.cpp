@@ -0,0 +1,273 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "DownloadSchedulerTest.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <QtTest/QTest>
+
+#include "DownloadScheduler.h"
+#include "HttpDownloader.h"
+#include "HttpServerStub.h"
+#include "RasterModelStub.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::DownloadSchedulerTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+int DownloadSchedulerTest::GatedDownloader::download(const string& url, string* data) {
+    /* All test URLs begin with http:// */
+    const string host = url.substr(7, url.find('/', 7)-7);
+
+    unique_lock<std::mutex> lock(mutex);
+    _urls.push_back(url);
+    unsigned int& current = ++connections[host];
+    if(current > _maxConnections[host]) _maxConnections[host] = current;
+    condition.notify_all();
+
+    while(!opened) condition.wait(lock);
+    --connections[host];
+
+    *data = url;
+    return 200;
+}
+
+void DownloadSchedulerTest::GatedDownloader::open() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        opened = true;
+    }
+    condition.notify_all();
+}
+
+void DownloadSchedulerTest::GatedDownloader::waitForStarted(size_t count) {
+    unique_lock<std::mutex> lock(mutex);
+    while(_urls.size() < count) condition.wait(lock);
+}
+
+vector<string> DownloadSchedulerTest::GatedDownloader::urls() const {
+    lock_guard<std::mutex> lock(mutex);
+    return _urls;
+}
+
+unsigned int DownloadSchedulerTest::GatedDownloader::maxConnections(const string& host) const {
+    lock_guard<std::mutex> lock(mutex);
+    map<string, unsigned int>::const_iterator found = _maxConnections.find(host);
+    return found == _maxConnections.end() ? 0 : found->second;
+}
+
+void DownloadSchedulerTest::download() {
+    HttpServerStub server;
+    server.setResponse("/base/1/1/0", 200, "downloaded");
+
+    RasterModelStub model(server.url());
+    HttpDownloader downloader;
+    DownloadScheduler scheduler(&model, &downloader);
+
+    atomic<int> called(0), failures(0);
+    DownloadScheduler::Callback callback = [&](const string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+        if(layer != "base" || z != 1 || coords.y != 0) ++failures;
+        else if(coords.x == 1 && (status != 200 || data != "downloaded")) ++failures;
+        else if(coords.x == 0 && (status != 404 || data != "")) ++failures;
+        ++called;
+    };
+
+    /* Offline model doesn't download anything */
+    QVERIFY(!scheduler.request("base", 1, TileCoords(1, 0), callback));
+
+    model.setOnline(true);
+    QVERIFY(scheduler.request("base", 1, TileCoords(1, 0), callback));
+    QVERIFY(scheduler.request("base", 1, TileCoords(0, 0), callback));
+    while(called != 2) this_thread::yield();
+
+    QVERIFY(failures == 0);
+    QVERIFY(server.requestCount("/base/1/1/0") == 1);
+    QVERIFY(server.requestCount("/base/1/0/0") == 1);
+}
+
+void DownloadSchedulerTest::deduplicate() {
+    RasterModelStub model;
+    model.setOnline(true);
+    GatedDownloader downloader;
+    DownloadScheduler scheduler(&model, &downloader, 1);
+
+    atomic<int> called(0), failures(0);
+    DownloadScheduler::Callback callback = [&](const string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+        if(status != 200) ++failures;
+        ++called;
+    };
+
+    /* Requests for tile being downloaded */
+    scheduler.request("base", 1, TileCoords(0, 0), callback);
+    downloader.waitForStarted(1);
+    scheduler.request("base", 1, TileCoords(0, 0), callback);
+    scheduler.request("base", 1, TileCoords(0, 0), callback);
+
+    /* Requests for waiting tile */
+    scheduler.request("base", 1, TileCoords(1, 0), callback);
+    scheduler.request("base", 1, TileCoords(1, 0), callback);
+    QVERIFY(scheduler.queuedCount() == 1);
+    QVERIFY(scheduler.activeCount() == 1);
+
+    downloader.open();
+    while(called != 5) this_thread::yield();
+
+    QVERIFY(failures == 0);
+    QVERIFY(downloader.urls().size() == 2);
+}
+
+void DownloadSchedulerTest::priority() {
+    RasterModelStub model;
+    model.setOnline(true);
+    GatedDownloader downloader;
+    DownloadScheduler scheduler(&model, &downloader, 1);
+    scheduler.setViewport(2, TileArea(0, 0, 4, 4), 4);
+
+    atomic<int> called(0);
+    DownloadScheduler::Callback callback = [&](const string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+        ++called;
+    };
+
+    /* First request occupies the only thread, so the others wait in queue */
+    scheduler.request("base", 2, TileCoords(0, 0), callback);
+    downloader.waitForStarted(1);
+    scheduler.request("base", 1, TileCoords(1, 1), callback);
+    scheduler.request("base", 2, TileCoords(3, 3), callback);
+    scheduler.request("base", 3, TileCoords(4, 4), callback);
+    scheduler.request("base", 2, TileCoords(0, 2), callback);
+    scheduler.request("base", 2, TileCoords(2, 1), callback);
+
+    downloader.open();
+    while(called != 6) this_thread::yield();
+
+    /* Tiles of viewport zoom ordered by distance from center, then tiles of
+       other zoom levels */
+    vector<string> expected;
+    expected.push_back("http://host0/base/2/0/0");
+    expected.push_back("http://host0/base/2/2/1");
+    expected.push_back("http://host0/base/2/0/2");
+    expected.push_back("http://host1/base/2/3/3");
+    expected.push_back("http://host0/base/3/4/4");
+    expected.push_back("http://host1/base/1/1/1");
+    QVERIFY(downloader.urls() == expected);
+}
+
+void DownloadSchedulerTest::cancel() {
+    RasterModelStub model;
+    model.setOnline(true);
+    GatedDownloader downloader;
+    DownloadScheduler scheduler(&model, &downloader, 1);
+
+    atomic<int> downloaded(0), cancelled(0);
+    DownloadScheduler::Callback callback = [&](const string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+        if(status == DownloadScheduler::Cancelled) ++cancelled;
+        else ++downloaded;
+    };
+
+    scheduler.request("base", 1, TileCoords(0, 0), callback);
+    downloader.waitForStarted(1);
+    scheduler.request("base", 1, TileCoords(1, 0), callback);
+    scheduler.request("base", 1, TileCoords(1, 0), callback);
+    scheduler.request("base", 1, TileCoords(0, 1), callback);
+
+    /* Both callbacks of waiting request are called */
+    QVERIFY(scheduler.cancel("base", 1, TileCoords(1, 0)));
+    QVERIFY(cancelled == 2);
+
+    /* Running download and unknown tile can't be cancelled */
+    QVERIFY(!scheduler.cancel("base", 1, TileCoords(0, 0)));
+    QVERIFY(!scheduler.cancel("base", 1, TileCoords(1, 1)));
+
+    scheduler.cancelAll();
+    QVERIFY(cancelled == 3);
+    QVERIFY(scheduler.queuedCount() == 0);
+
+    /* Running download can't be cancelled after the queue was replaced */
+    scheduler.setViewport(1, TileArea(0, 0, 2, 2));
+    QVERIFY(!scheduler.cancel("base", 1, TileCoords(0, 0)));
+
+    downloader.open();
+    while(downloaded != 1) this_thread::yield();
+    QVERIFY(downloader.urls().size() == 1);
+}
+
+void DownloadSchedulerTest::viewport() {
+    RasterModelStub model;
+    model.setOnline(true);
+    GatedDownloader downloader;
+    DownloadScheduler scheduler(&model, &downloader, 1);
+
+    atomic<int> downloaded(0), cancelled(0);
+    DownloadScheduler::Callback callback = [&](const string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+        if(status == DownloadScheduler::Cancelled) ++cancelled;
+        else ++downloaded;
+    };
+
+    scheduler.request("base", 2, TileCoords(0, 0), callback);
+    downloader.waitForStarted(1);
+    scheduler.request("base", 2, TileCoords(2, 2), callback);
+    scheduler.request("base", 2, TileCoords(10, 10), callback);
+    scheduler.request("base", 0, TileCoords(0, 0), callback);
+    scheduler.request("base", 4, TileCoords(30, 2), callback);
+
+    /* Tiles which are out of the area and margin are cancelled, tiles of
+       other zoom levels are compared in viewport zoom */
+    scheduler.setViewport(2, TileArea(0, 0, 2, 2), 1);
+    QVERIFY(cancelled == 2);
+    QVERIFY(scheduler.queuedCount() == 2);
+
+    downloader.open();
+    while(downloaded != 3) this_thread::yield();
+
+    vector<string> expected;
+    expected.push_back("http://host0/base/2/0/0");
+    expected.push_back("http://host0/base/2/2/2");
+    expected.push_back("http://host0/base/0/0/0");
+    QVERIFY(downloader.urls() == expected);
+}
+
+void DownloadSchedulerTest::hostLimit() {
+    RasterModelStub model;
+    model.setOnline(true);
+    GatedDownloader downloader;
+
+    atomic<int> called(0);
+    DownloadScheduler::Callback callback = [&](const string& layer, Zoom z, const TileCoords& coords, int status, const TileData& data) {
+        ++called;
+    };
+
+    DownloadScheduler scheduler(&model, &downloader, 8, 2);
+    for(unsigned int x = 0; x != 10; ++x)
+        scheduler.request("base", 4, TileCoords(x, 0), callback);
+
+    /* Free threads don't take more requests for the same hosts */
+    downloader.waitForStarted(4);
+    this_thread::sleep_for(chrono::milliseconds(50));
+    QVERIFY(downloader.urls().size() == 4);
+    QVERIFY(scheduler.activeCount() == 4);
+    QVERIFY(scheduler.queuedCount() == 6);
+
+    downloader.open();
+    while(called != 10) this_thread::yield();
+
+    QVERIFY(downloader.maxConnections("host0") == 2);
+    QVERIFY(downloader.maxConnections("host1") == 2);
+}
+
+}}}
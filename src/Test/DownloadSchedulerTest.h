@@ -0,0 +1,64 @@
+#ifndef Kompas_Core_Test_DownloadSchedulerTest_h
+#define Kompas_Core_Test_DownloadSchedulerTest_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <QtCore/QObject>
+
+#include "AbstractDownloader.h"
+
+namespace Kompas { namespace Core { namespace Test {
+
+class DownloadSchedulerTest: public QObject {
+    Q_OBJECT
+
+    private slots:
+        void download();
+        void deduplicate();
+        void priority();
+        void cancel();
+        void viewport();
+        void hostLimit();
+
+    public:
+        /* Downloads block until the gate is opened */
+        class GatedDownloader: public AbstractDownloader {
+            public:
+                inline GatedDownloader(): opened(false) {}
+
+                int download(const std::string& url, std::string* data);
+
+                void open();
+                void waitForStarted(size_t count);
+                std::vector<std::string> urls() const;
+                unsigned int maxConnections(const std::string& host) const;
+
+            private:
+                mutable std::mutex mutex;
+                std::condition_variable condition;
+                bool opened;
+                std::vector<std::string> _urls;
+                std::map<std::string, unsigned int> connections, _maxConnections;
+        };
+};
+
+}}}
+
+#endif
@@ -0,0 +1,352 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "EvictionPolicyTest.h"
+
+#include <unordered_set>
+#include <algorithm>
+#include <QtTest/QTest>
+#include <QtCore/QDebug>
+
+#include "CountMinSketch.h"
+#include "LruEvictionPolicy.h"
+#include "ArcEvictionPolicy.h"
+#include "TinyLfuEvictionPolicy.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::EvictionPolicyTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    inline CacheKey key(unsigned int x, unsigned int y = 0, Zoom z = 10) {
+        return CacheKey('T', 1, 1, z, TileCoords(x, y));
+    }
+
+    /* Simulated cache, returns whether the key was found */
+    bool access(AbstractEvictionPolicy* policy, unordered_set<CacheKey>* cache, const CacheKey& k, size_t size) {
+        if(cache->find(k) != cache->end()) {
+            policy->hit(k);
+            return true;
+        }
+
+        policy->miss(k);
+
+        vector<CacheKey> evicted;
+        policy->insert(k, size, &evicted);
+        cache->insert(k);
+        for(vector<CacheKey>::const_iterator it = evicted.begin(); it != evicted.end(); ++it)
+            cache->erase(*it);
+
+        return false;
+    }
+
+    class Random {
+        public:
+            inline Random(unsigned int seed): seed(seed) {}
+
+            inline unsigned int operator()(unsigned int max) {
+                seed = seed*1103515245 + 12345;
+                return (seed >> 8)%max;
+            }
+
+        private:
+            unsigned int seed;
+    };
+
+    /* Recorded map session: user repeatedly visits a few places (some more
+       often than others) and pans around them in 5x4 tile viewport. If
+       seeding is enabled, every tenth visit is followed by pre-seeding of
+       1000 tiles which are never requested again, if zooming out is enabled,
+       every tenth visit is followed by zooming out and panning over far area
+       which is never visited again. */
+    vector<CacheKey> session(bool seeding, bool zoomingOut) {
+        Random random(42);
+        vector<CacheKey> trace;
+
+        unsigned int seeded = 0, far = 0;
+        for(unsigned int visit = 0; visit != 600; ++visit) {
+            /* Place 0 is visited most often, place 5 least often */
+            unsigned int place = 0;
+            while(place != 5 && random(2)) ++place;
+
+            for(unsigned int step = 0; step != 10; ++step) {
+                unsigned int x = place*100 + random(3), y = place*100 + random(3);
+                for(unsigned int j = 0; j != 4; ++j) for(unsigned int i = 0; i != 5; ++i)
+                    trace.push_back(key(x+i, y+j, 14));
+            }
+
+            if(seeding && visit%10 == 9) for(unsigned int i = 0; i != 1000; ++i, ++seeded)
+                trace.push_back(key(seeded%100, 1000 + seeded/100, 16));
+
+            if(zoomingOut && visit%10 == 9) for(unsigned int step = 0; step != 30; ++step, ++far)
+                for(unsigned int j = 0; j != 4; ++j) for(unsigned int i = 0; i != 5; ++i)
+                    trace.push_back(key(far+i, j, 10));
+        }
+
+        return trace;
+    }
+
+    double hitRatio(AbstractEvictionPolicy* policy, const vector<CacheKey>& trace) {
+        unordered_set<CacheKey> cache;
+        size_t hits = 0;
+        for(vector<CacheKey>::const_iterator it = trace.begin(); it != trace.end(); ++it)
+            if(access(policy, &cache, *it, 8192 + it->hash()%8192)) ++hits;
+
+        return double(hits)/trace.size();
+    }
+}
+
+void EvictionPolicyTest::sketch() {
+    CountMinSketch sketch(1000);
+    QVERIFY(sketch.width() == 1024);
+    QVERIFY(sketch.frequency(key(0).hash()) == 0);
+
+    for(unsigned int i = 0; i != 100; ++i)
+        for(unsigned int j = 0; j <= i%10; ++j)
+            sketch.increment(key(i).hash());
+
+    /* Frequency is never underestimated and saturates */
+    for(unsigned int i = 0; i != 100; ++i)
+        QVERIFY(sketch.frequency(key(i).hash()) >= i%10+1);
+    for(unsigned int i = 0; i != 20; ++i)
+        sketch.increment(key(0).hash());
+    QVERIFY(sketch.frequency(key(0).hash()) == CountMinSketch::MaxFrequency);
+
+    sketch.clear();
+    QVERIFY(sketch.frequency(key(0).hash()) == 0);
+}
+
+void EvictionPolicyTest::sketchAging() {
+    CountMinSketch sketch(64);
+    for(unsigned int i = 0; i != 8; ++i)
+        sketch.increment(key(0).hash());
+    QVERIFY(sketch.frequency(key(0).hash()) == 8);
+
+    /* After 10*width increments the frequencies are halved */
+    for(unsigned int i = 8; i != 640; ++i)
+        sketch.increment(key(i%300 + 1).hash());
+    QVERIFY(sketch.frequency(key(0).hash()) == 4);
+}
+
+void EvictionPolicyTest::lru() {
+    LruEvictionPolicy policy(30);
+    vector<CacheKey> evicted;
+
+    policy.insert(key(0), 10, &evicted);
+    policy.insert(key(1), 10, &evicted);
+    policy.insert(key(2), 10, &evicted);
+    QVERIFY(evicted.empty());
+    QVERIFY(policy.usedSize() == 30);
+
+    /* Least recently used is evicted */
+    policy.hit(key(0));
+    policy.insert(key(3), 10, &evicted);
+    QVERIFY(evicted == vector<CacheKey>(1, key(1)));
+
+    /* Larger entry evicts more entries */
+    evicted.clear();
+    policy.insert(key(4), 20, &evicted);
+    QVERIFY(evicted.size() == 2);
+    QVERIFY(evicted[0] == key(2));
+    QVERIFY(evicted[1] == key(0));
+
+    policy.remove(key(3));
+    QVERIFY(policy.usedSize() == 20);
+
+    evicted.clear();
+    policy.setCapacity(10, &evicted);
+    QVERIFY(evicted == vector<CacheKey>(1, key(4)));
+    QVERIFY(policy.usedSize() == 0);
+}
+
+void EvictionPolicyTest::arc() {
+    ArcEvictionPolicy policy(40);
+    vector<CacheKey> evicted;
+
+    /* Frequently used entries */
+    policy.insert(key(0), 10, &evicted);
+    policy.insert(key(1), 10, &evicted);
+    policy.hit(key(0));
+    policy.hit(key(1));
+
+    /* Scan evicts only entries used once */
+    for(unsigned int i = 100; i != 120; ++i)
+        policy.insert(key(i), 10, &evicted);
+    QVERIFY(evicted.size() == 18);
+    QVERIFY(find(evicted.begin(), evicted.end(), key(0)) == evicted.end());
+    QVERIFY(find(evicted.begin(), evicted.end(), key(1)) == evicted.end());
+    QVERIFY(policy.usedSize() == 40);
+
+    /* Entry evicted from recent queue too early enlarges it */
+    QVERIFY(policy.target() == 0);
+    evicted.clear();
+    policy.insert(key(117), 10, &evicted);
+    QVERIFY(policy.target() == 10);
+    QVERIFY(evicted.size() == 1);
+
+    policy.clear();
+    QVERIFY(policy.usedSize() == 0);
+    QVERIFY(policy.target() == 0);
+}
+
+void EvictionPolicyTest::tinyLfu() {
+    TinyLfuEvictionPolicy policy(100*1024);
+    vector<CacheKey> evicted;
+
+    /* Fill the cache with frequently used entries, last 20 of them stay in
+       the window */
+    for(unsigned int i = 0; i != 100; ++i) {
+        for(unsigned int j = 0; j != 5; ++j) policy.miss(key(i));
+        policy.insert(key(i), 1024, &evicted);
+    }
+    QVERIFY(evicted.empty());
+    QVERIFY(policy.usedSize() == 100*1024);
+
+    /* Scan flushes only the window */
+    for(unsigned int i = 100; i != 300; ++i) {
+        policy.miss(key(i));
+        policy.insert(key(i), 1024, &evicted);
+    }
+    QVERIFY(evicted.size() == 200);
+    for(vector<CacheKey>::const_iterator it = evicted.begin(); it != evicted.end(); ++it)
+        QVERIFY(it->coords().x >= 80);
+
+    /* Entry used more often gets into main part after leaving the window */
+    evicted.clear();
+    for(unsigned int j = 0; j != 10; ++j) policy.miss(key(500));
+    policy.insert(key(500), 1024, &evicted);
+    for(unsigned int i = 300; i != 320; ++i) {
+        policy.miss(key(i));
+        policy.insert(key(i), 1024, &evicted);
+    }
+    QVERIFY(evicted.size() == 21);
+    QVERIFY(find(evicted.begin(), evicted.end(), key(0)) != evicted.end());
+    QVERIFY(find(evicted.begin(), evicted.end(), key(500)) == evicted.end());
+    QVERIFY(policy.usedSize() == 100*1024);
+}
+
+void EvictionPolicyTest::capacity() {
+    LruEvictionPolicy lru(64*1024);
+    ArcEvictionPolicy arc(64*1024);
+    TinyLfuEvictionPolicy tinyLfu(64*1024);
+    AbstractEvictionPolicy* policies[] = { &lru, &arc, &tinyLfu };
+
+    vector<CacheKey> trace = session(true, true);
+    for(unsigned int p = 0; p != 3; ++p) {
+        unordered_set<CacheKey> cache;
+        size_t size = 0;
+        for(vector<CacheKey>::const_iterator it = trace.begin(); it != trace.begin()+20000; ++it) {
+            access(policies[p], &cache, *it, 1000 + it->hash()%3000);
+            QVERIFY(policies[p]->usedSize() <= policies[p]->capacity());
+        }
+
+        /* Policy tracks exactly the entries in the cache */
+        for(unordered_set<CacheKey>::const_iterator it = cache.begin(); it != cache.end(); ++it)
+            size += 1000 + it->hash()%3000;
+        QVERIFY(policies[p]->usedSize() == size);
+
+        /* Shrinking evicts only entries in the cache */
+        vector<CacheKey> evicted;
+        policies[p]->setCapacity(16*1024, &evicted);
+        QVERIFY(policies[p]->usedSize() <= 16*1024);
+        for(vector<CacheKey>::const_iterator it = evicted.begin(); it != evicted.end(); ++it) {
+            QVERIFY(cache.erase(*it) == 1);
+            size -= 1000 + it->hash()%3000;
+        }
+        QVERIFY(policies[p]->usedSize() == size);
+    }
+}
+
+void EvictionPolicyTest::keys() {
+    AbstractEvictionPolicy* policies[] = {
+        new LruEvictionPolicy(100), new ArcEvictionPolicy(100), new TinyLfuEvictionPolicy(100)
+    };
+    AbstractEvictionPolicy* restored[] = {
+        new LruEvictionPolicy(100), new ArcEvictionPolicy(100), new TinyLfuEvictionPolicy(100)
+    };
+
+    vector<CacheKey> expected;
+    expected.push_back(key(1));
+    expected.push_back(key(2));
+    expected.push_back(key(0));
+
+    for(int i = 0; i != 3; ++i) {
+        vector<CacheKey> evicted;
+        policies[i]->insert(key(0), 10, &evicted);
+        policies[i]->insert(key(1), 10, &evicted);
+        policies[i]->insert(key(2), 10, &evicted);
+        policies[i]->hit(key(0));
+        QVERIFY(evicted.empty());
+
+        /* Entry which would be evicted first is first */
+        vector<CacheKey> keys = policies[i]->keys();
+        QVERIFY(keys == expected);
+
+        /* Inserting the keys in that order restores the order, TinyLFU
+           doesn't restore the frequencies, so it has the same keys only */
+        for(vector<CacheKey>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+            restored[i]->insert(*it, 10, &evicted);
+        vector<CacheKey> restoredKeys = restored[i]->keys();
+        if(i != 2) QVERIFY(restoredKeys == keys);
+        else QVERIFY(is_permutation(restoredKeys.begin(), restoredKeys.end(), keys.begin()));
+
+        delete policies[i];
+        delete restored[i];
+    }
+
+    /* TinyLFU window entry used more often than the main part victim is
+       evicted after it */
+    TinyLfuEvictionPolicy tinyLfu(100);
+    vector<CacheKey> evicted;
+    tinyLfu.insert(key(0), 10, &evicted);
+    tinyLfu.insert(key(1), 10, &evicted);
+    tinyLfu.insert(key(2), 10, &evicted);
+    tinyLfu.hit(key(2));
+    tinyLfu.hit(key(2));
+    expected.clear();
+    expected.push_back(key(1));
+    expected.push_back(key(0));
+    expected.push_back(key(2));
+    QVERIFY(tinyLfu.keys() == expected);
+}
+
+void EvictionPolicyTest::replay() {
+    const char* names[] = { "panning", "panning with seeding", "panning with zooming out" };
+    double ratios[3][3];
+
+    for(unsigned int w = 0; w != 3; ++w) {
+        vector<CacheKey> trace = session(w == 1, w == 2);
+
+        /* Cache for ~200 tiles */
+        LruEvictionPolicy lru(2400*1024);
+        ArcEvictionPolicy arc(2400*1024);
+        TinyLfuEvictionPolicy tinyLfu(2400*1024);
+        ratios[w][0] = hitRatio(&lru, trace);
+        ratios[w][1] = hitRatio(&arc, trace);
+        ratios[w][2] = hitRatio(&tinyLfu, trace);
+
+        qDebug() << "Hit ratio for" << names[w] << "- LRU:" << ratios[w][0] << "ARC:" << ratios[w][1] << "W-TinyLFU:" << ratios[w][2];
+    }
+
+    /* Seeding doesn't flush the cache with ARC and W-TinyLFU, W-TinyLFU
+       keeps it also when zooming out */
+    QVERIFY(ratios[1][1] > ratios[1][0]);
+    QVERIFY(ratios[1][2] > ratios[1][0]);
+    QVERIFY(ratios[2][2] > ratios[2][0]);
+}
+
+}}}
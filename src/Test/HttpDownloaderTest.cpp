@@ -0,0 +1,121 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "HttpDownloaderTest.h"
+
+#include <QtTest/QTest>
+
+#include "HttpDownloader.h"
+#include "HttpServerStub.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::HttpDownloaderTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+void HttpDownloaderTest::parseUrl_data() {
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<int>("port");
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("full") << "http://tile.example.org:8080/5/3/2.png" << true << "tile.example.org" << 8080 << "/5/3/2.png";
+    QTest::newRow("no port") << "http://tile.example.org/5/3/2.png" << true << "tile.example.org" << 80 << "/5/3/2.png";
+    QTest::newRow("no path") << "http://127.0.0.1:81" << true << "127.0.0.1" << 81 << "/";
+    QTest::newRow("https") << "https://tile.example.org/" << false << "" << 0 << "";
+    QTest::newRow("no host") << "http://:80/" << false << "" << 0 << "";
+    QTest::newRow("bad port") << "http://tile.example.org:99999/" << false << "" << 0 << "";
+}
+
+void HttpDownloaderTest::parseUrl() {
+    QFETCH(QString, url);
+    QFETCH(bool, valid);
+    QFETCH(QString, host);
+    QFETCH(int, port);
+    QFETCH(QString, path);
+
+    string actualHost, actualPath;
+    unsigned short actualPort;
+    QCOMPARE(HttpDownloader::parseUrl(url.toStdString(), &actualHost, &actualPort, &actualPath), valid);
+    if(!valid) return;
+
+    QCOMPARE(QString::fromStdString(actualHost), host);
+    QCOMPARE(static_cast<int>(actualPort), port);
+    QCOMPARE(QString::fromStdString(actualPath), path);
+}
+
+void HttpDownloaderTest::download() {
+    HttpServerStub server;
+    server.setResponse("/tile.png", 200, string("PNG\0data", 8));
+
+    HttpDownloader downloader;
+    string data;
+    QVERIFY(downloader.download(server.url() + "/tile.png", &data) == 200);
+    QVERIFY(data == string("PNG\0data", 8));
+
+    /* Data are not touched on failure */
+    QVERIFY(downloader.download(server.url() + "/missing.png", &data) == 404);
+    QVERIFY(data == string("PNG\0data", 8));
+
+    /* Connection failure */
+    QVERIFY(downloader.download("http://127.0.0.1:1/tile.png", &data) == 0);
+}
+
+void HttpDownloaderTest::conditional() {
+    HttpServerStub server;
+    server.setResponse("/tile.png", 200, "data", "Cache-Control: public, max-age=3600\r\nLast-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+    server.setETag("/tile.png", "\"v1\"");
+
+    HttpDownloader downloader;
+    string data;
+    TileMetadata metadata;
+    QVERIFY(downloader.download(server.url() + "/tile.png", &data, &metadata) == 200);
+    QVERIFY(data == "data");
+    QVERIFY(metadata.etag == "\"v1\"");
+    QVERIFY(metadata.lastModified == "Sun, 06 Nov 1994 08:49:37 GMT");
+    QVERIFY(metadata.fetched >= TileMetadata::now()-60);
+    QVERIFY(metadata.expires == metadata.fetched+3600);
+    QVERIFY(!metadata.isExpired());
+
+    /* Not modified, only the metadata are updated */
+    data.clear();
+    metadata.fetched -= 7200;
+    metadata.expires -= 7200;
+    QVERIFY(metadata.isExpired());
+    QVERIFY(downloader.download(server.url() + "/tile.png", &data, &metadata) == 304);
+    QVERIFY(data.empty());
+    QVERIFY(!metadata.isExpired());
+    QVERIFY(server.lastRequest("/tile.png").find("\r\nIf-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n") != string::npos);
+
+    /* Changed data */
+    server.setETag("/tile.png", "\"v2\"");
+    QVERIFY(downloader.download(server.url() + "/tile.png", &data, &metadata) == 200);
+    QVERIFY(data == "data");
+    QVERIFY(metadata.etag == "\"v2\"");
+
+    /* Not modified without expiration keeps previous lifetime, invalid
+       Expires means already expired */
+    server.setResponse("/tile.png", 200, "data", "Expires: 0\r\n");
+    QVERIFY(downloader.download(server.url() + "/tile.png", &data, &metadata) == 304);
+    QVERIFY(metadata.isExpired());
+    server.setResponse("/tile.png", 200, "data");
+    metadata.expires = metadata.fetched+600;
+    QVERIFY(downloader.download(server.url() + "/tile.png", &data, &metadata) == 304);
+    QVERIFY(metadata.expires == metadata.fetched+600);
+}
+
+}}}
@@ -0,0 +1,191 @@
+#ifndef Kompas_Core_Test_HttpServerStub_h
+#define Kompas_Core_Test_HttpServerStub_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include <string>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace Kompas { namespace Core { namespace Test {
+
+/**
+ * @brief Local HTTP server for testing
+ *
+ * Listens on random port on localhost and serves responses set with
+ * setResponse(), returns 404 for everything else. Responses with ETag set
+ * with setETag() are answered with 304 to requests with matching
+ * @c If-None-Match header.
+ */
+class HttpServerStub {
+    public:
+        inline HttpServerStub(): _port(0), delay(0), stopping(false) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            int flag = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+
+            sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+            socklen_t size = sizeof(address);
+            if(bind(fd, reinterpret_cast<sockaddr*>(&address), size) != 0 ||
+               listen(fd, 64) != 0 ||
+               getsockname(fd, reinterpret_cast<sockaddr*>(&address), &size) != 0) return;
+
+            _port = ntohs(address.sin_port);
+            listener = std::thread(&HttpServerStub::acceptConnections, this);
+        }
+
+        inline ~HttpServerStub() {
+            stopping = true;
+            shutdown(fd, SHUT_RDWR);
+            close(fd);
+            if(listener.joinable()) listener.join();
+            for(std::vector<std::thread>::iterator it = connections.begin(); it != connections.end(); ++it)
+                it->join();
+        }
+
+        /** @brief Port, or 0 if the server couldn't be started */
+        inline unsigned short port() const { return _port; }
+
+        /** @brief URL prefix, e.g. <tt>http://127.0.0.1:12345</tt> */
+        inline std::string url() const {
+            std::ostringstream out;
+            out << "http://127.0.0.1:" << _port;
+            return out.str();
+        }
+
+        /**
+         * @brief Set response for given path
+         * @param path      Path
+         * @param status    Status code
+         * @param body      Response body
+         * @param headers   Additional headers, each terminated with CRLF
+         */
+        inline void setResponse(const std::string& path, int status, const std::string& body, const std::string& headers = "") {
+            std::lock_guard<std::mutex> lock(mutex);
+            Response& response = responses[path];
+            response.status = status;
+            response.body = body;
+            response.headers = headers;
+        }
+
+        /** @brief Set ETag of response for given path */
+        inline void setETag(const std::string& path, const std::string& etag) {
+            std::lock_guard<std::mutex> lock(mutex);
+            responses[path].etag = etag;
+        }
+
+        /** @brief Headers of last request for given path */
+        inline std::string lastRequest(const std::string& path) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::map<std::string, std::string>::const_iterator found = lastRequests.find(path);
+            return found == lastRequests.end() ? std::string() : found->second;
+        }
+
+        /** @brief Delay each response by given time */
+        inline void setDelay(unsigned int milliseconds) { delay = milliseconds; }
+
+        /** @brief Count of requests for given path */
+        inline unsigned int requestCount(const std::string& path) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::map<std::string, unsigned int>::const_iterator found = requests.find(path);
+            return found == requests.end() ? 0 : found->second;
+        }
+
+    private:
+        struct Response {
+            inline Response(): status(404) {}
+
+            int status;
+            std::string body, headers, etag;
+        };
+
+        int fd;
+        unsigned short _port;
+        unsigned int delay;
+        std::atomic<bool> stopping;
+        std::thread listener;
+        std::vector<std::thread> connections;
+
+        mutable std::mutex mutex;
+        std::map<std::string, Response> responses;
+        std::map<std::string, unsigned int> requests;
+        std::map<std::string, std::string> lastRequests;
+
+        void acceptConnections() {
+            int connection;
+            while((connection = accept(fd, 0, 0)) != -1 && !stopping)
+                connections.push_back(std::thread(&HttpServerStub::serve, this, connection));
+        }
+
+        void serve(int connection) {
+            /* Read request headers */
+            std::string request;
+            char buffer[1024];
+            long size;
+            while(request.find("\r\n\r\n") == std::string::npos && (size = recv(connection, buffer, sizeof(buffer), 0)) > 0)
+                request.append(buffer, size);
+
+            /* GET /path HTTP/1.0 */
+            size_t pathBegin = request.find(' ')+1;
+            std::string path = request.substr(pathBegin, request.find(' ', pathBegin)-pathBegin);
+
+            Response response;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++requests[path];
+                lastRequests[path] = request;
+                std::map<std::string, Response>::const_iterator found = responses.find(path);
+                if(found != responses.end()) response = found->second;
+            }
+
+            if(delay) std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+            /* Not modified response has Content-Length of the entity, as
+               some servers send it */
+            const size_t length = response.body.size();
+            if(!response.etag.empty()) {
+                response.headers += "ETag: " + response.etag + "\r\n";
+                if(request.find("\r\nIf-None-Match: " + response.etag + "\r\n") != std::string::npos) {
+                    response.status = 304;
+                    response.body.clear();
+                }
+            }
+
+            std::ostringstream out;
+            out << "HTTP/1.0 " << response.status << " Stub\r\nContent-Length: " << length << "\r\n" << response.headers << "\r\n" << response.body;
+            std::string data = out.str();
+            send(connection, data.data(), data.size(), 0);
+            close(connection);
+        }
+};
+
+}}}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "NegativeCacheTest.h"
+
+#include <thread>
+#include <chrono>
+#include <QtTest/QTest>
+
+#include "NegativeCache.h"
+#include "AbstractCache.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::NegativeCacheTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    inline CacheKey key(unsigned int x, unsigned int y = 0) {
+        return CacheKey(AbstractCache::RasterTile, "Model", "base", 12, TileCoords(x, y));
+    }
+
+    class Cache: public AbstractCache {
+        public:
+            inline int features() const { return 0; }
+            inline bool initializeCache(const string& url) { return true; }
+            inline void finalizeCache() {}
+            inline size_t cacheSize() const { return 0; }
+            inline void setCacheSize(size_t size) {}
+            inline size_t usedSize() const { return 0; }
+            inline void purge() {}
+            inline void optimize() {}
+            inline bool set(const CacheKey& key, const TileData& data) { return true; }
+    };
+}
+
+void NegativeCacheTest::insertRemove() {
+    NegativeCache cache;
+    QVERIFY(!cache.contains(key(1)));
+    QVERIFY(cache.count() == 0);
+
+    cache.insert(key(1));
+    cache.insert(key(2));
+    QVERIFY(cache.contains(key(1)));
+    QVERIFY(cache.contains(key(2)));
+    QVERIFY(!cache.contains(key(1, 1)));
+    QVERIFY(!cache.contains(CacheKey(AbstractCache::RasterTile, "Model", "overlay", 12, TileCoords(1, 0))));
+    QVERIFY(cache.count() == 2);
+
+    /* Inserting again doesn't create another entry */
+    cache.insert(key(1));
+    QVERIFY(cache.count() == 2);
+
+    cache.remove(key(1));
+    QVERIFY(!cache.contains(key(1)));
+    QVERIFY(cache.contains(key(2)));
+
+    cache.clear();
+    QVERIFY(!cache.contains(key(2)));
+    QVERIFY(cache.count() == 0);
+}
+
+void NegativeCacheTest::expiration() {
+    NegativeCache cache(64, 3600);
+    cache.insert(key(1), 1);
+    cache.insert(key(2));
+    QVERIFY(cache.contains(key(1)));
+
+    this_thread::sleep_for(chrono::milliseconds(2100));
+    QVERIFY(!cache.contains(key(1)));
+    QVERIFY(cache.contains(key(2)));
+    QVERIFY(cache.count() == 1);
+
+    /* Expired entry can be inserted again */
+    cache.insert(key(1));
+    QVERIFY(cache.contains(key(1)));
+}
+
+void NegativeCacheTest::fullBucket() {
+    /* Only one bucket */
+    NegativeCache cache(1);
+    QVERIFY(cache.capacity() == 8);
+
+    for(unsigned int i = 0; i != 8; ++i)
+        cache.insert(key(i), 100+i);
+    for(unsigned int i = 0; i != 8; ++i)
+        QVERIFY(cache.contains(key(i)));
+
+    /* Entry which expires first is replaced */
+    cache.insert(key(8), 1000);
+    QVERIFY(!cache.contains(key(0)));
+    QVERIFY(cache.contains(key(1)));
+    QVERIFY(cache.contains(key(8)));
+    QVERIFY(cache.count() == 8);
+}
+
+void NegativeCacheTest::capacity() {
+    NegativeCache cache(1000);
+    QVERIFY(cache.capacity() == 1024);
+
+    /* Most of the entries fit even if the buckets aren't filled evenly */
+    for(unsigned int i = 0; i != 512; ++i)
+        cache.insert(key(i%32, i/32));
+
+    unsigned int found = 0;
+    for(unsigned int i = 0; i != 512; ++i)
+        if(cache.contains(key(i%32, i/32))) ++found;
+    QVERIFY(found > 500);
+}
+
+void NegativeCacheTest::cache() {
+    Cache cache;
+    QVERIFY(!cache.isRasterTileMissing("Model", "base", 3, TileCoords(1, 2)));
+
+    cache.setRasterTileMissing("Model", "base", 3, TileCoords(1, 2));
+    QVERIFY(cache.isRasterTileMissing("Model", "base", 3, TileCoords(1, 2)));
+    QVERIFY(!cache.isRasterTileMissing("Model", "base", 3, TileCoords(2, 1)));
+    QVERIFY(cache.missing()->count() == 1);
+
+    /* Saving the tile removes the mark */
+    cache.setRasterTile("Model", "base", 3, TileCoords(1, 2), "tile");
+    QVERIFY(!cache.isRasterTileMissing("Model", "base", 3, TileCoords(1, 2)));
+}
+
+}}}
@@ -0,0 +1,90 @@
+#ifndef Kompas_Core_Test_RasterModelStub_h
+#define Kompas_Core_Test_RasterModelStub_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include <string>
+#include <sstream>
+
+#include "AbstractRasterModel.h"
+
+namespace Kompas { namespace Core { namespace Test {
+
+/**
+ * @brief Online raster model for testing
+ *
+ * Has layer @c base, no packages and tiles on URLs
+ * <tt>url/layer/z/x/y</tt>. Without URL the tiles are on two hosts by parity
+ * of X, <tt>http://host0</tt> and <tt>http://host1</tt>. Area, zoom levels
+ * and projection can be changed, one tile can be made available as if it was
+ * in a package.
+ */
+class RasterModelStub: public AbstractRasterModel {
+    public:
+        inline RasterModelStub(const std::string& url = ""): AbstractRasterModel(0, ""), url(url), _projection(0), _area(0, 0, 1, 1), hasPackageTile(false), packageZ(0) {}
+
+        inline int features() const { return LoadableFromUrl|(_projection ? ConvertableCoords : 0); }
+        inline const AbstractProjection* projection() const { return _projection; }
+        inline int addPackage(const std::string& filename) { return -1; }
+        inline TileArea area() const { return _area; }
+        inline std::set<Zoom> zoomLevels() const { return _zoomLevels; }
+        inline std::vector<std::string> layers() const { return std::vector<std::string>(1, "base"); }
+        inline int packageCount() const { return 0; }
+        inline TileSize tileSize() const { return TileSize(256, 256); }
+
+        /** @brief Set projection, which makes the coordinates convertable */
+        inline void setProjection(const AbstractProjection* projection) { _projection = projection; }
+
+        /** @brief Set area, default is one tile */
+        inline void setArea(const TileArea& area) { _area = area; }
+
+        /** @brief Set zoom levels, default is none */
+        inline void setZoomLevels(Zoom min, Zoom max) {
+            _zoomLevels.clear();
+            for(Zoom z = min; z <= max; ++z) _zoomLevels.insert(z);
+        }
+
+        /** @brief Make tile available as if it was in package, with data @c package */
+        inline void setPackageTile(Zoom z, const TileCoords& coords) {
+            hasPackageTile = true;
+            packageZ = z;
+            packageCoords = coords;
+        }
+
+        TileData tileFromPackage(const std::string& layer, Zoom z, const TileCoords& coords) const {
+            return hasPackageTile && z == packageZ && coords == packageCoords ? TileData("package") : TileData();
+        }
+
+        std::string tileUrl(const std::string& layer, Zoom z, const TileCoords& coords) const {
+            std::ostringstream out;
+            if(url.empty()) out << "http://host" << coords.x%2;
+            else out << url;
+            out << '/' << layer << '/' << z << '/' << coords.x << '/' << coords.y;
+            return out.str();
+        }
+
+    private:
+        std::string url;
+        const AbstractProjection* _projection;
+        TileArea _area;
+        std::set<Zoom> _zoomLevels;
+        bool hasPackageTile;
+        Zoom packageZ;
+        TileCoords packageCoords;
+};
+
+}}}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "RegionPackagerTest.h"
+
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <QtTest/QTest>
+
+#include "RegionPackager.h"
+#include "AbstractDownloader.h"
+#include "RasterModelStub.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::RegionPackagerTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    class SourceModel: public RasterModelStub {
+        public:
+            inline SourceModel() {
+                setArea(TileArea(0, 0, 2, 2));
+                setOnline(true);
+            }
+    };
+
+    /* Writes tiles into memory, checks that they come in row-major order */
+    class DestinationModel: public AbstractRasterModel {
+        public:
+            inline DestinationModel(): AbstractRasterModel(0, ""), saved(0), initialized(false), finalized(false) {}
+            inline int features() const { return WriteableFormat|SequentialFormat|ResumableFormat|WriteOnly; }
+            inline int addPackage(const string& filename) { return -1; }
+            inline TileArea area() const { return TileArea(); }
+            inline set<Zoom> zoomLevels() const { return set<Zoom>(); }
+            inline vector<string> layers() const { return vector<string>(); }
+            inline int packageCount() const { return 0; }
+            inline TileSize tileSize() const { return TileSize(); }
+            inline TileData tileFromPackage(const string& layer, Zoom z, const TileCoords& coords) const { return TileData(); }
+
+            bool initializePackage(const string& filename, const TileSize& tileSize, const vector<Zoom>& zoomLevels, const TileArea& area, const vector<string>& layers, const vector<string>& overlays) {
+                tiles.clear();
+                return resumePackage(filename, tileSize, zoomLevels, area, layers, overlays);
+            }
+
+            bool resumePackage(const string& filename, const TileSize& tileSize, const vector<Zoom>& zoomLevels, const TileArea& area, const vector<string>& layers, const vector<string>& overlays) {
+                _area = area;
+                minZoom = *min_element(zoomLevels.begin(), zoomLevels.end());
+                initialized = true;
+                finalized = false;
+                return true;
+            }
+
+            unsigned int packagedTileCount(const string& layer, Zoom z) {
+                return tiles[key(layer, z)].size();
+            }
+
+            bool tileToPackage(const string& layer, Zoom z, const TileCoords& coords, const string& data) {
+                if(!initialized) return false;
+
+                const TileArea area = _area*pow2(z-minZoom);
+                vector<string>& t = tiles[key(layer, z)];
+                if((coords.y-area.y)*area.w + coords.x-area.x != t.size()) return false;
+
+                t.push_back(data);
+                ++saved;
+                return true;
+            }
+
+            bool finalizePackage() {
+                if(!initialized) return false;
+                initialized = false;
+                finalized = true;
+                return true;
+            }
+
+            static string key(const string& layer, Zoom z) {
+                ostringstream out;
+                out << layer << '/' << z;
+                return out.str();
+            }
+
+            map<string, vector<string> > tiles;
+            atomic<unsigned int> saved;
+            bool initialized, finalized;
+
+        private:
+            TileArea _area;
+            Zoom minZoom;
+    };
+
+    /* Later tiles are downloaded faster, so they come out of order. Tiles in
+       the second row don't exist, given URL fails given count of times. */
+    class Downloader: public AbstractDownloader {
+        public:
+            inline Downloader(const DestinationModel* destination = 0, const string& failing = "", unsigned int failures = 0): destination(destination), failing(failing), failures(failures), count(0), maxAhead(0) {}
+
+            int download(const string& url, string* data) {
+                const unsigned int started = ++count;
+                if(destination) {
+                    unsigned int ahead = started - destination->saved;
+                    unsigned int max = maxAhead;
+                    while(ahead > max && !maxAhead.compare_exchange_weak(max, ahead)) {}
+                }
+
+                this_thread::sleep_for(chrono::milliseconds(3 - started%3));
+
+                if(url == failing) {
+                    lock_guard<mutex> lock(failuresMutex);
+                    if(failures) {
+                        --failures;
+                        return 500;
+                    }
+                }
+
+                if(url.substr(url.size()-2) == "/1") return 404;
+                *data = url;
+                return 200;
+            }
+
+            const DestinationModel* destination;
+            string failing;
+            mutex failuresMutex;
+            unsigned int failures;
+            atomic<unsigned int> count, maxAhead;
+    };
+}
+
+void RegionPackagerTest::create() {
+    SourceModel source;
+    DestinationModel destination;
+    Downloader downloader;
+    RegionPackager packager(&source, &destination, &downloader, 4);
+
+    unsigned long long lastDone = 0;
+    bool ordered = true;
+    packager.setProgressCallback([&](const RegionPackager::Progress& p) {
+        if(p.done != lastDone+1) ordered = false;
+        lastDone = p.done;
+    });
+
+    vector<Zoom> zoomLevels;
+    zoomLevels.push_back(2);
+    zoomLevels.push_back(1);
+    QVERIFY(packager.create("package", zoomLevels, TileArea(1, 0, 1, 2), vector<string>(1, "base"), vector<string>(1, "relief")));
+    QVERIFY(destination.finalized);
+    QVERIFY(ordered);
+
+    /* 2 tiles in zoom 1, 8 tiles in zoom 2, for each layer */
+    RegionPackager::Progress p = packager.progress();
+    QVERIFY(p.total == 20);
+    QVERIFY(p.done == 20);
+    QVERIFY(p.resumed == 0);
+    QVERIFY(p.downloaded == 14);
+    QVERIFY(p.missing == 6);
+    QVERIFY(downloader.count == 20);
+
+    QVERIFY(destination.tiles.size() == 4);
+    const vector<string>& tiles = destination.tiles["relief/2"];
+    QVERIFY(tiles.size() == 8);
+    QVERIFY(tiles[0] == "http://host0/relief/2/2/0");
+    QVERIFY(tiles[1] == "http://host1/relief/2/3/0");
+    QVERIFY(tiles[2] == "");
+    QVERIFY(tiles[7] == "http://host1/relief/2/3/3");
+}
+
+void RegionPackagerTest::missing() {
+    /* Model without URLs */
+    class Model: public SourceModel {
+        public:
+            string tileUrl(const string& layer, Zoom z, const TileCoords& coords) const { return ""; }
+    } source;
+    DestinationModel destination;
+    Downloader downloader;
+    RegionPackager packager(&source, &destination, &downloader);
+
+    QVERIFY(packager.create("package", vector<Zoom>(1, 1), TileArea(0, 0, 2, 2), vector<string>(1, "base")));
+    QVERIFY(packager.progress().missing == 4);
+    QVERIFY(destination.tiles["base/1"] == vector<string>(4, ""));
+    QVERIFY(downloader.count == 0);
+}
+
+void RegionPackagerTest::failed() {
+    SourceModel source;
+    DestinationModel destination;
+
+    /* Failure is retried */
+    Downloader downloader(0, "http://host1/base/1/1/0", 2);
+    RegionPackager packager(&source, &destination, &downloader);
+    QVERIFY(packager.create("package", vector<Zoom>(1, 1), TileArea(0, 0, 2, 1), vector<string>(1, "base")));
+    QVERIFY(destination.tiles["base/1"][1] == "http://host1/base/1/1/0");
+    QVERIFY(downloader.count == 4);
+
+    /* Tiles after failed tile are not saved, the package is finalized */
+    Downloader failingDownloader(0, "http://host1/base/1/1/0", 3);
+    RegionPackager failingPackager(&source, &destination, &failingDownloader);
+    QVERIFY(!failingPackager.create("package", vector<Zoom>(1, 1), TileArea(0, 0, 2, 1), vector<string>(1, "base")));
+    QVERIFY(failingPackager.progress().failed == 1);
+    QVERIFY(failingPackager.progress().done == 1);
+    QVERIFY(destination.tiles["base/1"].size() == 1);
+    QVERIFY(destination.finalized);
+}
+
+void RegionPackagerTest::window() {
+    SourceModel source;
+    DestinationModel destination;
+    Downloader downloader(&destination);
+    RegionPackager packager(&source, &destination, &downloader, 8, 8);
+    packager.setWindowSize(5);
+
+    QVERIFY(packager.create("package", vector<Zoom>(1, 3), TileArea(0, 0, 8, 8), vector<string>(1, "base")));
+    QVERIFY(destination.saved == 64);
+
+    /* No download is more than window size after first unsaved tile */
+    QVERIFY(downloader.maxAhead <= 5);
+}
+
+void RegionPackagerTest::resume() {
+    SourceModel source;
+    DestinationModel destination;
+    Downloader downloader;
+    RegionPackager packager(&source, &destination, &downloader);
+
+    /* Some tiles are already in the package */
+    destination.tiles["base/1"] = vector<string>(3, "saved");
+    destination.tiles["base/2"] = vector<string>(16, "saved");
+
+    vector<Zoom> zoomLevels;
+    zoomLevels.push_back(1);
+    zoomLevels.push_back(2);
+    QVERIFY(packager.create("package", zoomLevels, TileArea(0, 0, 2, 2), vector<string>(1, "base"), vector<string>(), true));
+
+    RegionPackager::Progress p = packager.progress();
+    QVERIFY(p.total == 20);
+    QVERIFY(p.done == 20);
+    QVERIFY(p.resumed == 19);
+    QVERIFY(downloader.count == 1);
+    QVERIFY(destination.tiles["base/1"][3] == "");
+    QVERIFY(destination.tiles["base/2"].size() == 16);
+}
+
+void RegionPackagerTest::cancel() {
+    SourceModel source;
+    DestinationModel destination;
+    Downloader downloader;
+    RegionPackager packager(&source, &destination, &downloader);
+    packager.setProgressCallback([&packager](const RegionPackager::Progress& p) {
+        if(p.done == 3) packager.cancel();
+    });
+
+    QVERIFY(!packager.create("package", vector<Zoom>(1, 2), TileArea(0, 0, 4, 4), vector<string>(1, "base")));
+    QVERIFY(packager.progress().done == 3);
+    QVERIFY(destination.tiles["base/2"].size() == 3);
+    QVERIFY(destination.finalized);
+}
+
+}}}
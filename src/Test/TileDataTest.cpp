@@ -0,0 +1,84 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TileDataTest.h"
+
+#include <QtTest/QTest>
+
+#include "TileData.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::TileDataTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+void TileDataTest::construct() {
+    TileData empty;
+    QVERIFY(empty.empty());
+    QVERIFY(empty.size() == 0);
+    QVERIFY(empty.toString() == "");
+
+    string s("tile");
+    TileData copied(s);
+    QVERIFY(copied.size() == 4);
+    QVERIFY(copied.data() != s.data());
+    QVERIFY(copied.toString() == "tile");
+
+    /* Moved string is taken without copying */
+    string moved(1000, 'x');
+    const char* data = moved.data();
+    TileData taken(std::move(moved));
+    QVERIFY(taken.data() == data);
+    QVERIFY(taken.size() == 1000);
+}
+
+void TileDataTest::share() {
+    weak_ptr<string> weak;
+    TileData copy;
+    {
+        shared_ptr<string> owner(new string("some data in a file"));
+        weak = owner;
+
+        TileData view(owner, owner->data()+5, 4);
+        QVERIFY(view == "data");
+
+        /* Copy points to the same memory */
+        copy = view;
+        QVERIFY(copy.data() == view.data());
+    }
+
+    /* The copy keeps the owner alive */
+    QVERIFY(!weak.expired());
+    QVERIFY(copy == "data");
+
+    copy = TileData();
+    QVERIFY(weak.expired());
+}
+
+void TileDataTest::compare() {
+    QVERIFY(TileData("tile") == TileData("tile"));
+    QVERIFY(TileData("tile") != TileData("tiles"));
+    QVERIFY(TileData("tile") != TileData("list"));
+    QVERIFY(TileData() == TileData(""));
+
+    QVERIFY(TileData("tile") == string("tile"));
+    QVERIFY(string("tile") == TileData("tile"));
+    QVERIFY(string("tile") != TileData());
+    QVERIFY(TileData(string("a\0b", 3)) == string("a\0b", 3));
+    QVERIFY(TileData(string("a\0b", 3)) != "a");
+}
+
+}}}
@@ -0,0 +1,254 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TileFetcherTest.h"
+
+#include <atomic>
+#include <QtTest/QTest>
+
+#include "TileFetcher.h"
+#include "HttpDownloader.h"
+#include "HttpServerStub.h"
+#include "RasterModelStub.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::TileFetcherTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+string TileFetcherTest::TestCache::get(const string& key) {
+    lock_guard<std::mutex> lock(mutex);
+    map<string, string>::const_iterator found = data.find(key);
+    return found == data.end() ? "" : found->second;
+}
+
+bool TileFetcherTest::TestCache::set(const string& key, const string& data) {
+    lock_guard<std::mutex> lock(mutex);
+    this->data[key] = data;
+    return true;
+}
+
+void TileFetcherTest::package() {
+    HttpServerStub server;
+    server.setResponse("/base/0/0/0", 200, "downloaded");
+
+    RasterModelStub model(server.url());
+    model.setPackageTile(0, TileCoords(0, 0));
+    model.setOnline(true);
+    TestCache cache;
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, &cache, &downloader);
+
+    /* Tile from package is not looked up anywhere else */
+    QVERIFY(fetcher.fetch("base", 0, TileCoords(0, 0)).get() == "package");
+    QVERIFY(server.requestCount("/base/0/0/0") == 0);
+    QVERIFY(cache.count() == 0);
+}
+
+void TileFetcherTest::cache() {
+    HttpServerStub server;
+    server.setResponse("/base/1/1/0", 200, "downloaded");
+
+    RasterModelStub model(server.url());
+    model.setOnline(true);
+    TestCache cache;
+    model.tileToCache(&cache, "base", 1, TileCoords(1, 0), "cached");
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, &cache, &downloader);
+
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "cached");
+    QVERIFY(server.requestCount("/base/1/1/0") == 0);
+}
+
+void TileFetcherTest::download() {
+    HttpServerStub server;
+    server.setResponse("/base/1/1/0", 200, "downloaded");
+
+    RasterModelStub model(server.url());
+    model.setOnline(true);
+    TestCache cache;
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, &cache, &downloader);
+
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "downloaded");
+    QVERIFY(server.requestCount("/base/1/1/0") == 1);
+
+    /* The tile is saved to cache, so it isn't downloaded next time */
+    QVERIFY(model.tileFromCache(&cache, "base", 1, TileCoords(1, 0)) == "downloaded");
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "downloaded");
+    QVERIFY(server.requestCount("/base/1/1/0") == 1);
+}
+
+void TileFetcherTest::notFound() {
+    HttpServerStub server;
+
+    RasterModelStub model(server.url());
+    model.setOnline(true);
+    TestCache cache;
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, &cache, &downloader);
+
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 1)).get() == "");
+    QVERIFY(server.requestCount("/base/1/1/1") == 1);
+    QVERIFY(cache.count() == 0);
+}
+
+void TileFetcherTest::missing() {
+    HttpServerStub server;
+    server.setResponse("/base/1/0/1", 500, "");
+
+    RasterModelStub model(server.url());
+    model.setOnline(true);
+    TestCache cache;
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, &cache, &downloader);
+
+    /* Nonexistent tile isn't downloaded again */
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 1)).get() == "");
+    QVERIFY(model.isTileMissing(&cache, "base", 1, TileCoords(1, 1)));
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 1)).get() == "");
+    QVERIFY(server.requestCount("/base/1/1/1") == 1);
+
+    /* Server errors are not remembered */
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(0, 1)).get() == "");
+    QVERIFY(!model.isTileMissing(&cache, "base", 1, TileCoords(0, 1)));
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(0, 1)).get() == "");
+    QVERIFY(server.requestCount("/base/1/0/1") == 2);
+
+    /* Saved tile is not missing anymore */
+    model.tileToCache(&cache, "base", 1, TileCoords(1, 1), "cached");
+    QVERIFY(!model.isTileMissing(&cache, "base", 1, TileCoords(1, 1)));
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 1)).get() == "cached");
+}
+
+void TileFetcherTest::offline() {
+    HttpServerStub server;
+    server.setResponse("/base/1/1/0", 200, "downloaded");
+
+    RasterModelStub model(server.url());
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, 0, &downloader);
+
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "");
+    QVERIFY(server.requestCount("/base/1/1/0") == 0);
+}
+
+void TileFetcherTest::coalesce() {
+    HttpServerStub server;
+    server.setResponse("/base/2/3/1", 200, "downloaded");
+    server.setDelay(200);
+
+    RasterModelStub model(server.url());
+    model.setOnline(true);
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, 0, &downloader);
+
+    /* All requests are made while the first is still being downloaded */
+    vector<shared_future<TileData> > futures;
+    for(int i = 0; i != 16; ++i)
+        futures.push_back(fetcher.fetch("base", 2, TileCoords(3, 1)));
+    QVERIFY(fetcher.pendingCount() == 1);
+
+    for(vector<shared_future<TileData> >::iterator it = futures.begin(); it != futures.end(); ++it)
+        QVERIFY(it->get() == "downloaded");
+    QVERIFY(server.requestCount("/base/2/3/1") == 1);
+    QVERIFY(fetcher.pendingCount() == 0);
+}
+
+void TileFetcherTest::callback() {
+    HttpServerStub server;
+    server.setResponse("/base/1/1/0", 200, "downloaded");
+    server.setDelay(100);
+
+    RasterModelStub model(server.url());
+    model.setPackageTile(0, TileCoords(0, 0));
+    model.setOnline(true);
+    HttpDownloader downloader;
+
+    atomic<int> called(0), failures(0);
+    {
+        TileFetcher fetcher(&model, 0, &downloader);
+        for(int i = 0; i != 2; ++i)
+            fetcher.fetch("base", 1, TileCoords(1, 0), [&](const string& layer, Zoom z, const TileCoords& coords, const TileData& data) {
+                if(layer != "base" || z != 1 || coords != TileCoords(1, 0) || data != "downloaded")
+                    ++failures;
+                ++called;
+            });
+        fetcher.fetch("base", 0, TileCoords(0, 0), [&](const string& layer, Zoom z, const TileCoords& coords, const TileData& data) {
+            if(data != "package") ++failures;
+            ++called;
+        });
+
+        /* Wait for the callbacks */
+        fetcher.fetch("base", 1, TileCoords(1, 0)).wait();
+        while(fetcher.pendingCount() != 0)
+            this_thread::yield();
+    }
+
+    QVERIFY(called == 3);
+    QVERIFY(failures == 0);
+    QVERIFY(server.requestCount("/base/1/1/0") == 1);
+}
+
+void TileFetcherTest::revalidate() {
+    HttpServerStub server;
+    server.setResponse("/base/1/1/0", 200, "downloaded", "Cache-Control: max-age=3600\r\n");
+    server.setETag("/base/1/1/0", "\"v1\"");
+
+    RasterModelStub model(server.url());
+    model.setOnline(true);
+    TestCache cache;
+    HttpDownloader downloader;
+    TileFetcher fetcher(&model, &cache, &downloader);
+    QVERIFY(!fetcher.revalidation());
+    fetcher.setRevalidation(true);
+
+    /* Downloaded tile is saved with metadata */
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "downloaded");
+    TileMetadata metadata = model.tileMetadataFromCache(&cache, "base", 1, TileCoords(1, 0));
+    QVERIFY(metadata.etag == "\"v1\"");
+    QVERIFY(!metadata.isExpired());
+
+    /* Tile which didn't expire is not revalidated */
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "downloaded");
+    QVERIFY(server.requestCount("/base/1/1/0") == 1);
+
+    /* Expired tile which didn't change is taken from cache */
+    model.tileToCache(&cache, "base", 1, TileCoords(1, 0), "cached");
+    metadata.expires = metadata.fetched;
+    model.tileMetadataToCache(&cache, "base", 1, TileCoords(1, 0), metadata);
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "cached");
+    QVERIFY(server.requestCount("/base/1/1/0") == 2);
+    QVERIFY(!model.tileMetadataFromCache(&cache, "base", 1, TileCoords(1, 0)).isExpired());
+
+    /* Changed tile is downloaded again */
+    model.tileMetadataToCache(&cache, "base", 1, TileCoords(1, 0), metadata);
+    server.setETag("/base/1/1/0", "\"v2\"");
+    QVERIFY(fetcher.fetch("base", 1, TileCoords(1, 0)).get() == "downloaded");
+    QVERIFY(model.tileFromCache(&cache, "base", 1, TileCoords(1, 0)) == "downloaded");
+    QVERIFY(model.tileMetadataFromCache(&cache, "base", 1, TileCoords(1, 0)).etag == "\"v2\"");
+
+    /* Expired tile is used when the server is not reachable */
+    RasterModelStub offlineModel("http://127.0.0.1:1");
+    offlineModel.setOnline(true);
+    TileFetcher offlineFetcher(&offlineModel, &cache, &downloader);
+    offlineFetcher.setRevalidation(true);
+    offlineModel.tileToCache(&cache, "base", 1, TileCoords(0, 1), "expired");
+    offlineModel.tileMetadataToCache(&cache, "base", 1, TileCoords(0, 1), metadata);
+    QVERIFY(offlineFetcher.fetch("base", 1, TileCoords(0, 1)).get() == "expired");
+}
+
+}}}
@@ -0,0 +1,69 @@
+#ifndef Kompas_Core_Test_TileFetcherTest_h
+#define Kompas_Core_Test_TileFetcherTest_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include <map>
+#include <mutex>
+#include <QtCore/QObject>
+
+#include "AbstractCache.h"
+
+namespace Kompas { namespace Core { namespace Test {
+
+class TileFetcherTest: public QObject {
+    Q_OBJECT
+
+    private slots:
+        void package();
+        void cache();
+        void download();
+        void notFound();
+        void missing();
+        void offline();
+        void coalesce();
+        void callback();
+        void revalidate();
+
+    public:
+        class TestCache: public AbstractCache {
+            public:
+                inline int features() const { return 0; }
+                inline bool initializeCache(const std::string& url) { return true; }
+                inline void finalizeCache() {}
+                inline size_t cacheSize() const { return 0; }
+                inline void setCacheSize(size_t size) {}
+                inline size_t usedSize() const { return 0; }
+                inline void purge() {}
+                inline void optimize() {}
+
+                inline size_t count() const {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return data.size();
+                }
+
+            protected:
+                std::string get(const std::string& key);
+                bool set(const std::string& key, const std::string& data);
+
+            private:
+                mutable std::mutex mutex;
+                std::map<std::string, std::string> data;
+        };
+};
+
+}}}
+
+#endif
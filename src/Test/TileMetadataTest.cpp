@@ -0,0 +1,87 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TileMetadataTest.h"
+
+#include <QtTest/QTest>
+
+#include "TileMetadata.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::TileMetadataTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+void TileMetadataTest::serialize() {
+    TileMetadata metadata;
+    QVERIFY(metadata.isEmpty());
+    QVERIFY(!metadata.hasValidator());
+
+    metadata.fetched = 1300000000;
+    metadata.expires = 1300086400;
+    metadata.etag = "\"abc 123\"";
+    metadata.lastModified = "Sun, 06 Nov 1994 08:49:37 GMT";
+    QVERIFY(metadata.hasValidator());
+
+    TileMetadata restored = TileMetadata::fromString(metadata.toString());
+    QVERIFY(!restored.isEmpty());
+    QVERIFY(restored.fetched == metadata.fetched);
+    QVERIFY(restored.expires == metadata.expires);
+    QVERIFY(restored.etag == metadata.etag);
+    QVERIFY(restored.lastModified == metadata.lastModified);
+
+    /* Metadata without validators */
+    metadata.etag.clear();
+    metadata.lastModified.clear();
+    restored = TileMetadata::fromString(metadata.toString());
+    QVERIFY(restored.fetched == metadata.fetched);
+    QVERIFY(!restored.hasValidator());
+
+    /* Invalid data */
+    QVERIFY(TileMetadata::fromString("").isEmpty());
+    QVERIFY(TileMetadata::fromString("abc def\n\n").isEmpty());
+    QVERIFY(TileMetadata::fromString("1300000000 0\netag").isEmpty());
+}
+
+void TileMetadataTest::expired() {
+    TileMetadata metadata;
+    metadata.fetched = 1000;
+
+    /* No expiration */
+    QVERIFY(!metadata.isExpired(1000));
+    QVERIFY(!metadata.isExpired());
+
+    metadata.expires = 2000;
+    QVERIFY(!metadata.isExpired(1999));
+    QVERIFY(metadata.isExpired(2000));
+    QVERIFY(metadata.isExpired());
+}
+
+void TileMetadataTest::parseHttpDate() {
+    QVERIFY(TileMetadata::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT") == 784111777);
+    QVERIFY(TileMetadata::parseHttpDate("Thu, 01 Jan 1970 00:00:00 GMT") == 0);
+    QVERIFY(TileMetadata::parseHttpDate("Tue, 29 Feb 2000 12:00:00 GMT") == 951825600);
+    QVERIFY(TileMetadata::parseHttpDate("Fri, 31 Dec 2010 23:59:59 GMT") == 1293839999);
+
+    /* Invalid dates */
+    QVERIFY(TileMetadata::parseHttpDate("") == 0);
+    QVERIFY(TileMetadata::parseHttpDate("0") == 0);
+    QVERIFY(TileMetadata::parseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT") == 0);
+    QVERIFY(TileMetadata::parseHttpDate("Sun, 06 Nov 1994 08:49:37 CET") == 0);
+    QVERIFY(TileMetadata::parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT") == 0);
+}
+
+}}}
@@ -0,0 +1,179 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "UrlTemplateTest.h"
+
+#include <QtTest/QTest>
+
+#include "UrlTemplate.h"
+
+QTEST_APPLESS_MAIN(Kompas::Core::Test::UrlTemplateTest)
+
+using namespace std;
+
+namespace Kompas { namespace Core { namespace Test {
+
+namespace {
+    vector<string> subdomains() {
+        vector<string> s;
+        s.push_back("a");
+        s.push_back("b");
+        s.push_back("cc");
+        return s;
+    }
+}
+
+void UrlTemplateTest::parse() {
+    QVERIFY(UrlTemplate("http://tile.openstreetmap.org/{z}/{x}/{y}.png").isValid());
+    QVERIFY(UrlTemplate("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", subdomains()).isValid());
+    QVERIFY(UrlTemplate("http://tiles.virtualearth.net/tiles/r{quadkey}.png").isValid());
+    QVERIFY(UrlTemplate("http://tile.openstreetmap.org/static.png").isValid());
+
+    /* Unknown or unterminated placeholder */
+    QVERIFY(!UrlTemplate("http://tile.openstreetmap.org/{zoom}/{x}/{y}.png").isValid());
+    QVERIFY(!UrlTemplate("http://tile.openstreetmap.org/{z}/{x}/{y.png").isValid());
+
+    /* Subdomain placeholder without subdomains */
+    QVERIFY(!UrlTemplate("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png").isValid());
+
+    /* Invalid template produces empty URLs */
+    UrlTemplate invalid("http://{q}/");
+    QVERIFY(invalid.format(1, TileCoords(0, 0)) == "");
+    QVERIFY(invalid.maxSize(1) == 0);
+}
+
+void UrlTemplateTest::format() {
+    UrlTemplate t("http://tile.openstreetmap.org/{z}/{x}/{y}.png");
+    QVERIFY(t.format(0, TileCoords(0, 0)) == "http://tile.openstreetmap.org/0/0/0.png");
+    QVERIFY(t.format(18, TileCoords(141759, 87758)) == "http://tile.openstreetmap.org/18/141759/87758.png");
+
+    /* Placeholders at the beginning and at the end, repeated placeholders */
+    UrlTemplate u("{z}{x}-{x}{y}");
+    QVERIFY(u.format(3, TileCoords(4, 5)) == "34-45");
+
+    char buffer[64];
+    QVERIFY(t.format(2, TileCoords(1, 3), buffer, sizeof(buffer)) == 39);
+    QVERIFY(string(buffer, 39) == "http://tile.openstreetmap.org/2/1/3.png");
+    QVERIFY(t.maxSize(2) >= 39);
+}
+
+void UrlTemplateTest::subdomain() {
+    UrlTemplate t("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", subdomains());
+    QVERIFY(t.weights() == vector<unsigned int>(3, 1));
+
+    /* The same tile has always the same subdomain, also in another instance */
+    UrlTemplate another(t.pattern(), t.subdomains());
+    for(unsigned int i = 0; i != 16; ++i) {
+        const TileCoords coords(i*7, i*3);
+        const size_t subdomain = t.subdomain(5, coords);
+        QVERIFY(subdomain < 3);
+        QVERIFY(another.subdomain(5, coords) == subdomain);
+        QVERIFY(t.format(5, coords).find("http://" + subdomains()[subdomain] + ".tile.") == 0);
+    }
+
+    /* Hash doesn't depend on platform */
+    QVERIFY(t.subdomain(0, TileCoords(0, 0)) == 0);
+    QVERIFY(t.subdomain(12, TileCoords(2216, 1387)) == 1);
+    QVERIFY(t.subdomain(18, TileCoords(141759, 87758)) == 0);
+    QVERIFY(t.subdomain(3, TileCoords(1, 2)) == 1);
+
+    QVERIFY(t.maxSize(1) >= t.format(1, TileCoords(1, 1)).size());
+}
+
+void UrlTemplateTest::weights() {
+    vector<unsigned int> weights;
+    weights.push_back(1);
+    weights.push_back(0);
+    weights.push_back(3);
+    UrlTemplate t("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", subdomains(), weights);
+    QVERIFY(t.isValid());
+    QVERIFY(t.weights() == weights);
+
+    /* Neighbouring tiles are spread by weights, subdomain with zero weight
+       is never used */
+    unsigned int counts[3] = {};
+    for(unsigned int y = 0; y != 64; ++y)
+        for(unsigned int x = 0; x != 64; ++x)
+            ++counts[t.subdomain(12, TileCoords(2000+x, 1300+y))];
+    QVERIFY(counts[1] == 0);
+    QVERIFY(counts[0] > 900 && counts[0] < 1150);
+    QVERIFY(counts[2] > 2950 && counts[2] < 3200);
+
+    /* Count of weights must match count of subdomains, some weight must be
+       nonzero */
+    weights.pop_back();
+    QVERIFY(!UrlTemplate(t.pattern(), subdomains(), weights).isValid());
+    QVERIFY(!UrlTemplate(t.pattern(), subdomains(), vector<unsigned int>(3, 0)).isValid());
+}
+
+void UrlTemplateTest::quadkey() {
+    UrlTemplate t("http://tiles.virtualearth.net/tiles/r{quadkey}.png");
+
+    /* Example from Bing maps tile system documentation */
+    QVERIFY(t.format(3, TileCoords(3, 5)) == "http://tiles.virtualearth.net/tiles/r213.png");
+    QVERIFY(t.format(0, TileCoords(0, 0)) == "http://tiles.virtualearth.net/tiles/r.png");
+    QVERIFY(t.format(18, TileCoords(141759, 87758)).size() <= t.maxSize(18));
+}
+
+void UrlTemplateTest::smallBuffer() {
+    UrlTemplate t("http://tile.openstreetmap.org/{z}/{x}/{y}.png");
+
+    /* Nothing is written to too small buffer */
+    char buffer[40];
+    buffer[0] = '!';
+    QVERIFY(t.format(12, TileCoords(2216, 1387), buffer, sizeof(buffer)) == 46);
+    QVERIFY(buffer[0] == '!');
+}
+
+void UrlTemplateTest::area() {
+    UrlTemplate t("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", subdomains());
+
+    char buffer[512];
+    size_t offsets[7];
+    const TileArea area(9, 10, 3, 2);
+    const size_t size = t.format(4, area, buffer, sizeof(buffer), offsets);
+    QVERIFY(size == offsets[6]);
+    QVERIFY(offsets[0] == 0);
+
+    /* Each URL is the same as formatted alone */
+    for(unsigned int i = 0; i != 6; ++i) {
+        const TileCoords coords(area.x + i%area.w, area.y + i/area.w);
+        QVERIFY(string(buffer+offsets[i], offsets[i+1]-offsets[i]) == t.format(4, coords));
+    }
+
+    /* Only URLs which fit whole are written, offsets are filled for all */
+    char small[100];
+    size_t smallOffsets[7];
+    QVERIFY(t.format(4, area, small, sizeof(small), smallOffsets) == size);
+    QVERIFY(smallOffsets[6] == size);
+    QVERIFY(string(small, offsets[2]) == string(buffer, offsets[2]));
+}
+
+void UrlTemplateTest::benchmark() {
+    UrlTemplate t("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", subdomains());
+
+    /* 64x64 tiles of zoom 16 */
+    const TileArea area(35000, 22000, 64, 64);
+    vector<char> buffer(area.w*area.h*t.maxSize(16));
+    vector<size_t> offsets(area.w*area.h+1);
+    size_t size = 0;
+    QBENCHMARK {
+        size = t.format(16, area, &buffer[0], buffer.size(), &offsets[0]);
+    }
+
+    QVERIFY(size <= buffer.size());
+}
+
+}}}
@@ -0,0 +1,131 @@
+#ifndef Kompas_Core_TileData_h
+#define Kompas_Core_TileData_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::TileData
+ */
+
+#include <string>
+#include <cstring>
+#include <memory>
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Shared immutable tile data
+
+Copying the object only increases reference count, the data are never copied.
+The data can be either owned by the object (when constructed from
+@c std::string), or can be part of some other memory (e.g. memory-mapped
+file or cache slot), which is then kept alive by the owner pointer.
+*/
+class TileData {
+    public:
+        /** @brief Constructor for empty data */
+        inline TileData(): _data(0), _size(0) {}
+
+        /**
+         * @brief Constructor
+         *
+         * Copies the data.
+         */
+        inline TileData(const std::string& data) {
+            std::shared_ptr<std::string> s(new std::string(data));
+            owner = s;
+            _data = s->data();
+            _size = s->size();
+        }
+
+        /**
+         * @brief Constructor
+         *
+         * Moves the data without copying.
+         */
+        inline TileData(std::string&& data) {
+            std::shared_ptr<std::string> s(new std::string);
+            s->swap(data);
+            owner = s;
+            _data = s->data();
+            _size = s->size();
+        }
+
+        /** @copydoc TileData(const std::string&) */
+        inline TileData(const char* data) {
+            std::shared_ptr<std::string> s(new std::string(data));
+            owner = s;
+            _data = s->data();
+            _size = s->size();
+        }
+
+        /**
+         * @brief Constructor for data owned by other object
+         * @param owner     Owner of the memory, must keep the data alive and
+         *      unchanged as long as it exists
+         * @param data      Data
+         * @param size      Data size
+         */
+        inline TileData(const std::shared_ptr<const void>& owner, const char* data, size_t size): owner(owner), _data(data), _size(size) {}
+
+        /** @brief Whether the data are empty */
+        inline bool empty() const { return _size == 0; }
+
+        /** @brief Data size */
+        inline size_t size() const { return _size; }
+
+        /** @brief Data */
+        inline const char* data() const { return _data; }
+
+        /** @brief Copy of the data */
+        inline std::string toString() const { return std::string(_data, _size); }
+
+        /** @brief Equality operator */
+        inline bool operator==(const TileData& other) const {
+            return _size == other._size && (_size == 0 || _data == other._data || std::memcmp(_data, other._data, _size) == 0);
+        }
+
+        /** @brief Equality operator */
+        inline bool operator==(const std::string& other) const {
+            return _size == other.size() && (_size == 0 || std::memcmp(_data, other.data(), _size) == 0);
+        }
+
+        /** @brief Equality operator */
+        inline bool operator==(const char* other) const {
+            return _size == std::strlen(other) && (_size == 0 || std::memcmp(_data, other, _size) == 0);
+        }
+
+        /** @brief Non-equality operator */
+        template<class T> inline bool operator!=(const T& other) const { return !operator==(other); }
+
+    private:
+        std::shared_ptr<const void> owner;
+        const char* _data;
+        size_t _size;
+};
+
+/** @relates TileData
+ * @brief Equality operator
+ */
+inline bool operator==(const std::string& a, const TileData& b) { return b == a; }
+
+/** @relates TileData
+ * @brief Non-equality operator
+ */
+inline bool operator!=(const std::string& a, const TileData& b) { return !(b == a); }
+
+}}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TileFetcher.h"
+
+#include "AbstractCache.h"
+#include "AbstractDownloader.h"
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+bool TileFetcher::Key::operator<(const Key& other) const {
+    if(z != other.z) return z < other.z;
+    if(coords.y != other.coords.y) return coords.y < other.coords.y;
+    if(coords.x != other.coords.x) return coords.x < other.coords.x;
+    return layer < other.layer;
+}
+
+TileFetcher::TileFetcher(const AbstractRasterModel* model, AbstractCache* cache, AbstractDownloader* downloader, unsigned int threadCount): model(model), cache(cache), downloader(downloader), _revalidation(false), stopping(false) {
+    if(threadCount == 0) threadCount = 1;
+
+    threads.reserve(threadCount);
+    for(unsigned int i = 0; i != threadCount; ++i)
+        threads.push_back(thread(&TileFetcher::worker, this));
+}
+
+TileFetcher::~TileFetcher() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for(vector<thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    /* Finish requests which weren't started, so nobody waits forever */
+    for(deque<Request*>::const_iterator it = queue.begin(); it != queue.end(); ++it)
+        finish(*it, TileData());
+}
+
+shared_future<TileData> TileFetcher::fetch(const string& layer, Zoom z, const TileCoords& coords) {
+    lock_guard<mutex> lock(queueMutex);
+    return request(layer, z, coords)->future;
+}
+
+void TileFetcher::fetch(const string& layer, Zoom z, const TileCoords& coords, const Callback& callback) {
+    lock_guard<mutex> lock(queueMutex);
+    request(layer, z, coords)->callbacks.push_back(callback);
+}
+
+size_t TileFetcher::pendingCount() const {
+    lock_guard<mutex> lock(queueMutex);
+    return requests.size();
+}
+
+TileFetcher::Request* TileFetcher::request(const string& layer, Zoom z, const TileCoords& coords) {
+    Key key(layer, z, coords);
+
+    /* The tile is already being fetched */
+    map<Key, Request*>::const_iterator found = requests.find(key);
+    if(found != requests.end()) return found->second;
+
+    Request* r = new Request(key);
+    requests.insert(make_pair(key, r));
+    queue.push_back(r);
+    condition.notify_one();
+    return r;
+}
+
+void TileFetcher::worker() {
+    for(;;) {
+        Request* r;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            while(!stopping && queue.empty())
+                condition.wait(lock);
+            if(stopping) return;
+
+            r = queue.front();
+            queue.pop_front();
+        }
+
+        finish(r, fetchTile(r->key));
+    }
+}
+
+TileData TileFetcher::fetchTile(const Key& key) {
+    TileData data = model->tileFromPackage(key.layer, key.z, key.coords);
+    if(!data.empty()) return data;
+
+    const bool online = downloader && model->online();
+    TileMetadata metadata;
+    if(cache) {
+        /* The tile doesn't exist, don't look for it again */
+        if(model->isTileMissing(cache, key.layer, key.z, key.coords))
+            return TileData();
+
+        /* Tile without metadata never expires */
+        data = model->tileFromCache(cache, key.layer, key.z, key.coords);
+        if(!data.empty()) {
+            if(!_revalidation || !online) return data;
+            metadata = model->tileMetadataFromCache(cache, key.layer, key.z, key.coords);
+            if(!metadata.isExpired()) return data;
+        }
+    }
+
+    if(!online) return TileData();
+
+    string url = model->tileUrl(key.layer, key.z, key.coords);
+    if(url.empty()) return data;
+
+    /* Expired tile is used when the download fails */
+    string downloaded;
+    int status = _revalidation ? downloader->download(url, &downloaded, &metadata) : downloader->download(url, &downloaded);
+    if(status == 304 && !data.empty()) {
+        model->tileMetadataToCache(cache, key.layer, key.z, key.coords, metadata);
+        return data;
+    }
+    if(status == 404 || status == 410) {
+        model->setTileMissing(cache, key.layer, key.z, key.coords);
+        return TileData();
+    }
+    if(status != 200 || downloaded.empty()) return data;
+
+    /* The same data are saved to cache and passed to all requesters */
+    data = TileData(std::move(downloaded));
+    model->tileToCache(cache, key.layer, key.z, key.coords, data);
+    if(_revalidation) model->tileMetadataToCache(cache, key.layer, key.z, key.coords, metadata);
+    return data;
+}
+
+void TileFetcher::finish(Request* r, const TileData& data) {
+    /* After removing the request, new requests for the same tile will be
+       fetched again, so no callback can be added after this */
+    {
+        lock_guard<mutex> lock(queueMutex);
+        requests.erase(r->key);
+    }
+
+    r->promise.set_value(data);
+    for(vector<Callback>::const_iterator it = r->callbacks.begin(); it != r->callbacks.end(); ++it)
+        (*it)(r->key.layer, r->key.z, r->key.coords, data);
+
+    delete r;
+}
+
+}}
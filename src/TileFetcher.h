@@ -0,0 +1,179 @@
+#ifndef Kompas_Core_TileFetcher_h
+#define Kompas_Core_TileFetcher_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::TileFetcher
+ */
+
+#include <deque>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+
+#include "AbstractRasterModel.h"
+
+namespace Kompas { namespace Core {
+
+class AbstractDownloader;
+
+/**
+@brief Asynchronous tile fetcher
+
+Gets tile data on background threads in the order described in
+@ref AbstractRasterModel_Usage_Read "AbstractRasterModel documentation" -- the
+tile is first looked up in model packages, then in cache and if it is not
+found anywhere and the model is online, it is downloaded and saved to cache.
+@code
+TileFetcher fetcher(&model, &cache, &downloader);
+
+// Wait for the result
+TileData data = fetcher.fetch("base", 8, TileCoords(130, 82)).get();
+
+// Or get notified when the data are ready
+fetcher.fetch("base", 8, TileCoords(131, 82), [](const std::string& layer, Zoom z, const TileCoords& coords, const TileData& data) {
+    // ...
+});
+@endcode
+
+Multiple requests for the same tile while the tile is being fetched are
+coalesced into one, so the tile is looked up or downloaded only once.
+Tiles for which the server responds with 404 or 410 are remembered in the
+cache as missing (see @ref AbstractCache_Missing), so they aren't looked up
+or downloaded again until the entry expires.
+
+If revalidation is enabled with setRevalidation(), downloaded tiles are saved
+to cache together with their metadata (see
+@ref AbstractCache_Revalidation). Expired tiles found in cache are then
+downloaded again with conditional request, which costs no data transfer if
+the tile didn't change. If the download fails, the expired tile is used.
+
+The model, cache and downloader are accessed from multiple threads at once,
+so they must be thread-safe, see @ref AbstractRasterModel_Usage_Threads. The
+model state must not be changed while the fetcher exists.
+*/
+class CORE_EXPORT TileFetcher {
+    public:
+        /**
+         * @brief Callback for fetched tile
+         *
+         * Gets layer, zoom, coordinates and data of fetched tile. The data
+         * are empty if the tile wasn't found anywhere.
+         */
+        typedef std::function<void(const std::string&, Zoom, const TileCoords&, const TileData&)> Callback;
+
+        /**
+         * @brief Constructor
+         * @param model         Raster model
+         * @param cache         Initialized cache or 0, if the cache shouldn't
+         *      be used
+         * @param downloader    Downloader or 0, if the tiles shouldn't be
+         *      downloaded
+         * @param threadCount   Count of worker threads
+         */
+        TileFetcher(const AbstractRasterModel* model, AbstractCache* cache = 0, AbstractDownloader* downloader = 0, unsigned int threadCount = 4);
+
+        /**
+         * @brief Destructor
+         *
+         * Waits for tiles which are currently being fetched. Requests which
+         * weren't started yet are finished with empty data.
+         */
+        ~TileFetcher();
+
+        /**
+         * @brief Fetch tile
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @return Future with tile data, empty if the tile wasn't found
+         *      anywhere.
+         */
+        std::shared_future<TileData> fetch(const std::string& layer, Zoom z, const TileCoords& coords);
+
+        /**
+         * @brief Fetch tile and call callback when done
+         * @param layer     Map layer or overlay
+         * @param z         Zoom level
+         * @param coords    Coordinates
+         * @param callback  Callback
+         *
+         * The callback is called from worker thread.
+         */
+        void fetch(const std::string& layer, Zoom z, const TileCoords& coords, const Callback& callback);
+
+        /** @brief Whether revalidation of expired tiles is enabled */
+        inline bool revalidation() const { return _revalidation; }
+
+        /**
+         * @brief Enable or disable revalidation of expired tiles
+         *
+         * Disabled by default, as it needs one more cache lookup for each
+         * tile found in cache. Should be set before fetching any tile.
+         */
+        inline void setRevalidation(bool enabled) { _revalidation = enabled; }
+
+        /** @brief Count of tiles being fetched or waiting in queue */
+        size_t pendingCount() const;
+
+    private:
+        struct Key {
+            inline Key(const std::string& layer, Zoom z, const TileCoords& coords): layer(layer), z(z), coords(coords) {}
+
+            bool operator<(const Key& other) const;
+
+            std::string layer;
+            Zoom z;
+            TileCoords coords;
+        };
+
+        struct Request {
+            inline Request(const Key& key): key(key), future(promise.get_future()) {}
+
+            Key key;
+            std::promise<TileData> promise;
+            std::shared_future<TileData> future;
+            std::vector<Callback> callbacks;
+        };
+
+        const AbstractRasterModel* model;
+        AbstractCache* cache;
+        AbstractDownloader* downloader;
+        bool _revalidation;
+
+        mutable std::mutex queueMutex;
+        std::condition_variable condition;
+        bool stopping;
+        std::deque<Request*> queue;
+        std::map<Key, Request*> requests;
+        std::vector<std::thread> threads;
+
+        Request* request(const std::string& layer, Zoom z, const TileCoords& coords);
+        void worker();
+        TileData fetchTile(const Key& key);
+        void finish(Request* request, const TileData& data);
+
+        TileFetcher(const TileFetcher& other);
+        TileFetcher& operator=(const TileFetcher& other);
+};
+
+}}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TileMetadata.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+namespace {
+    /* Days since Unix epoch for given date in proleptic Gregorian calendar */
+    int64_t days(int64_t year, unsigned int month, unsigned int day) {
+        year -= month <= 2;
+        const int64_t era = (year >= 0 ? year : year-399)/400;
+        const unsigned int yearOfEra = year - era*400;
+        const unsigned int dayOfYear = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day-1;
+        const unsigned int dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+        return era*146097 + dayOfEra - 719468;
+    }
+}
+
+string TileMetadata::toString() const {
+    /* Validators can't contain newlines, as they come from HTTP headers */
+    ostringstream out;
+    out << fetched << ' ' << expires << '\n' << etag << '\n' << lastModified;
+    return out.str();
+}
+
+TileMetadata TileMetadata::fromString(const string& data) {
+    TileMetadata metadata;
+
+    size_t first = data.find('\n');
+    if(first == string::npos) return metadata;
+    size_t second = data.find('\n', first+1);
+    if(second == string::npos) return metadata;
+
+    istringstream times(data.substr(0, first));
+    if(!(times >> metadata.fetched >> metadata.expires)) return TileMetadata();
+
+    metadata.etag = data.substr(first+1, second-first-1);
+    metadata.lastModified = data.substr(second+1);
+    return metadata;
+}
+
+int64_t TileMetadata::now() {
+    return time(0);
+}
+
+int64_t TileMetadata::parseHttpDate(const string& date) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    /* Sun, 06 Nov 1994 08:49:37 GMT */
+    size_t comma = date.find(", ");
+    if(comma == string::npos || date.size() < comma+2+24) return 0;
+    const char* d = date.c_str()+comma+2;
+    if(d[2] != ' ' || d[6] != ' ' || d[11] != ' ' || d[14] != ':' || d[17] != ':' || strncmp(d+20, " GMT", 4) != 0)
+        return 0;
+
+    const char* month = strstr(months, string(d+3, 3).c_str());
+    if(!month || (month-months)%3 != 0) return 0;
+
+    const int day = atoi(d), year = atoi(d+7), hour = atoi(d+12), minute = atoi(d+15), second = atoi(d+18);
+    if(day < 1 || day > 31 || year < 1970 || hour > 23 || minute > 59 || second > 60)
+        return 0;
+
+    return days(year, (month-months)/3+1, day)*86400 + hour*3600 + minute*60 + second;
+}
+
+}}
@@ -0,0 +1,90 @@
+#ifndef Kompas_Core_TileMetadata_h
+#define Kompas_Core_TileMetadata_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::TileMetadata
+ */
+
+#include <cstdint>
+#include <string>
+
+#include "utilities.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Revalidation metadata of downloaded tile
+
+Remembers when the tile was downloaded, when it expires and validators which
+the server sent with it (@c ETag and @c Last-Modified headers). When the tile
+expires, it can be downloaded again with conditional request, which the
+server answers with <tt>304 Not Modified</tt> without any data, if the tile
+didn't change.
+
+Times are in seconds since Unix epoch. Tiles without metadata (e.g. from
+packages or downloaded before) are never expired.
+@see AbstractCache::rasterTileMetadata(), AbstractDownloader::download()
+*/
+class CORE_EXPORT TileMetadata {
+    public:
+        /** @brief Constructor for empty metadata */
+        inline TileMetadata(): fetched(0), expires(0) {}
+
+        /** @brief Whether the metadata are empty */
+        inline bool isEmpty() const { return fetched == 0; }
+
+        /**
+         * @brief Whether the tile expired
+         * @param time      Current time
+         *
+         * Tile without expiration time never expires.
+         */
+        inline bool isExpired(std::int64_t time = now()) const { return expires != 0 && time >= expires; }
+
+        /** @brief Whether the tile can be revalidated with conditional request */
+        inline bool hasValidator() const { return !etag.empty() || !lastModified.empty(); }
+
+        /** @brief Serialize for saving to cache */
+        std::string toString() const;
+
+        /**
+         * @brief Deserialize
+         *
+         * Returns empty metadata, if the data are invalid.
+         */
+        static TileMetadata fromString(const std::string& data);
+
+        /** @brief Current time in seconds since Unix epoch */
+        static std::int64_t now();
+
+        /**
+         * @brief Parse HTTP date
+         * @param date      Date in RFC 1123 format, e.g.
+         *      <tt>Sun, 06 Nov 1994 08:49:37 GMT</tt>
+         * @return Seconds since Unix epoch or 0, if the date is invalid
+         */
+        static std::int64_t parseHttpDate(const std::string& date);
+
+        std::int64_t fetched;       /**< @brief Download time */
+        std::int64_t expires;       /**< @brief Expiration time or 0 */
+        std::string etag;           /**< @brief @c ETag header value */
+        std::string lastModified;   /**< @brief @c Last-Modified header value */
+};
+
+}}
+
+#endif
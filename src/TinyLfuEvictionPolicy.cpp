@@ -0,0 +1,192 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "TinyLfuEvictionPolicy.h"
+
+#include <algorithm>
+#include <deque>
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+TinyLfuEvictionPolicy::TinyLfuEvictionPolicy(size_t capacity): _capacity(0), windowCapacity(0), mainCapacity(0), protectedCapacity(0) {
+    fill(sizes, sizes+3, 0);
+
+    vector<CacheKey> evicted;
+    setCapacity(capacity, &evicted);
+}
+
+void TinyLfuEvictionPolicy::setCapacity(size_t capacity, vector<CacheKey>* evicted) {
+    _capacity = capacity;
+    windowCapacity = capacity/5;
+    mainCapacity = capacity - windowCapacity;
+    protectedCapacity = mainCapacity/5*4;
+
+    size_t width = max(capacity/256, size_t(64));
+    if(width != _sketch.width()) _sketch = CountMinSketch(width);
+
+    demoteProtected();
+    evictWindow(evicted);
+    evictMain(evicted);
+}
+
+vector<CacheKey> TinyLfuEvictionPolicy::keys() const {
+    /* Evict all entries as if only new entries were inserted. Window
+       candidate used more often than the main part victim is admitted into
+       probation and the victim is evicted instead, as in evictWindow(). */
+    deque<CacheKey> queue[3];
+    for(int i = 0; i != 3; ++i)
+        for(Entries::const_reverse_iterator it = queues[i].rbegin(); it != queues[i].rend(); ++it)
+            queue[i].push_back(it->first);
+
+    vector<CacheKey> k;
+    k.reserve(index.size());
+    for(;;) {
+        deque<CacheKey>& window = queue[Window];
+        deque<CacheKey>& victims = queue[queue[Probation].empty() ? Protected : Probation];
+        if(window.empty() && victims.empty()) break;
+
+        if(!window.empty() && !victims.empty() && _sketch.frequency(window.front().hash()) > _sketch.frequency(victims.front().hash())) {
+            k.push_back(victims.front());
+            victims.pop_front();
+            queue[Probation].push_back(window.front());
+            window.pop_front();
+        } else {
+            deque<CacheKey>& evicted = window.empty() ? victims : window;
+            k.push_back(evicted.front());
+            evicted.pop_front();
+        }
+    }
+
+    return k;
+}
+
+void TinyLfuEvictionPolicy::hit(const CacheKey& key) {
+    _sketch.increment(key.hash());
+
+    unordered_map<CacheKey, Position>::iterator found = index.find(key);
+    if(found != index.end()) use(found->second);
+}
+
+void TinyLfuEvictionPolicy::miss(const CacheKey& key) {
+    _sketch.increment(key.hash());
+}
+
+void TinyLfuEvictionPolicy::insert(const CacheKey& key, size_t size, vector<CacheKey>* evicted) {
+    unordered_map<CacheKey, Position>::iterator found = index.find(key);
+
+    /* Update size of existing entry */
+    if(found != index.end()) {
+        Position& position = found->second;
+        sizes[position.queue] -= position.it->second;
+        position.it->second = size;
+        sizes[position.queue] += size;
+        use(position);
+
+        evictWindow(evicted);
+        evictMain(evicted);
+        return;
+    }
+
+    queues[Window].push_front(make_pair(key, size));
+    index.insert(make_pair(key, Position(Window, queues[Window].begin())));
+    sizes[Window] += size;
+    evictWindow(evicted);
+}
+
+void TinyLfuEvictionPolicy::remove(const CacheKey& key) {
+    unordered_map<CacheKey, Position>::iterator found = index.find(key);
+    if(found == index.end()) return;
+
+    sizes[found->second.queue] -= found->second.it->second;
+    queues[found->second.queue].erase(found->second.it);
+    index.erase(found);
+}
+
+void TinyLfuEvictionPolicy::clear() {
+    for(int i = 0; i != 3; ++i) {
+        queues[i].clear();
+        sizes[i] = 0;
+    }
+    index.clear();
+    _sketch.clear();
+}
+
+void TinyLfuEvictionPolicy::move(Position& position, Queue to) {
+    sizes[position.queue] -= position.it->second;
+    sizes[to] += position.it->second;
+    queues[to].splice(queues[to].begin(), queues[position.queue], position.it);
+    position.queue = to;
+}
+
+void TinyLfuEvictionPolicy::use(Position& position) {
+    /* Entry used again in probation is protected */
+    if(position.queue == Probation) {
+        move(position, Protected);
+        demoteProtected();
+    } else move(position, position.queue);
+}
+
+void TinyLfuEvictionPolicy::evict(Queue queue, vector<CacheKey>* evicted) {
+    const pair<CacheKey, size_t>& entry = queues[queue].back();
+    sizes[queue] -= entry.second;
+    evicted->push_back(entry.first);
+    index.erase(entry.first);
+    queues[queue].pop_back();
+}
+
+void TinyLfuEvictionPolicy::demoteProtected() {
+    while(sizes[Protected] > protectedCapacity) {
+        const CacheKey& key = queues[Protected].back().first;
+        move(index.find(key)->second, Probation);
+    }
+}
+
+void TinyLfuEvictionPolicy::evictWindow(vector<CacheKey>* evicted) {
+    while(sizes[Window] > windowCapacity) {
+        const pair<CacheKey, size_t>& candidate = queues[Window].back();
+
+        /* The candidate would never fit */
+        if(candidate.second > mainCapacity) {
+            evict(Window, evicted);
+            continue;
+        }
+
+        /* Make space in main part, if the candidate is used more often than
+           the victims */
+        unsigned int frequency = _sketch.frequency(candidate.first.hash());
+        bool admitted = true;
+        while(sizes[Probation] + sizes[Protected] + candidate.second > mainCapacity) {
+            Queue victim = queues[Probation].empty() ? Protected : Probation;
+            if(frequency <= _sketch.frequency(queues[victim].back().first.hash())) {
+                admitted = false;
+                break;
+            }
+
+            evict(victim, evicted);
+        }
+
+        if(admitted) move(index.find(candidate.first)->second, Probation);
+        else evict(Window, evicted);
+    }
+}
+
+void TinyLfuEvictionPolicy::evictMain(vector<CacheKey>* evicted) {
+    while(sizes[Probation] + sizes[Protected] > mainCapacity)
+        evict(queues[Probation].empty() ? Protected : Probation, evicted);
+}
+
+}}
@@ -0,0 +1,114 @@
+#ifndef Kompas_Core_TinyLfuEvictionPolicy_h
+#define Kompas_Core_TinyLfuEvictionPolicy_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::TinyLfuEvictionPolicy
+ */
+
+#include <list>
+#include <unordered_map>
+
+#include "AbstractEvictionPolicy.h"
+#include "CountMinSketch.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Window TinyLFU eviction policy
+
+Frequency of all looked up keys (including those which are not in the cache)
+is tracked in CountMinSketch. New entries are put into LRU window (20% of
+capacity, which is more than usual, because map tiles are requested again on
+each redraw while they are in the view). Entries evicted from the window are
+admitted into main part of the cache only if they were used more often than
+the entry which would be evicted from the main part instead, so single pass
+over many entries can't flush frequently used entries. The main part is segmented LRU, entries used at least
+twice are protected (80% of main part) from entries used once (probation).
+
+Entries inserted without preceding lookup have zero frequency, so they are
+admitted into main part only if it is not full.
+*/
+class CORE_EXPORT TinyLfuEvictionPolicy: public AbstractEvictionPolicy {
+    public:
+        /**
+         * @brief Constructor
+         * @param capacity  Capacity
+         */
+        TinyLfuEvictionPolicy(size_t capacity = 0);
+
+        inline size_t capacity() const { return _capacity; }
+
+        /**
+         * @copydoc AbstractEvictionPolicy::setCapacity()
+         *
+         * Also resizes the sketch for four times more keys than is count of
+         * 1 kB entries which fit into the cache, which clears all
+         * frequencies.
+         */
+        void setCapacity(size_t capacity, std::vector<CacheKey>* evicted);
+
+        inline size_t usedSize() const { return sizes[Window] + sizes[Probation] + sizes[Protected]; }
+        /**
+         * @copydoc AbstractEvictionPolicy::keys()
+         *
+         * Frequencies are not restored by inserting the keys, so entries
+         * which were protected can end up in the window.
+         */
+        std::vector<CacheKey> keys() const;
+
+        /** @brief Frequency sketch */
+        inline const CountMinSketch& sketch() const { return _sketch; }
+
+        void hit(const CacheKey& key);
+        void miss(const CacheKey& key);
+        void insert(const CacheKey& key, size_t size, std::vector<CacheKey>* evicted);
+        void remove(const CacheKey& key);
+        void clear();
+
+    private:
+        enum Queue {
+            Window,         /* New entries */
+            Probation,      /* Main part, entries used once */
+            Protected       /* Main part, entries used more times */
+        };
+
+        typedef std::list<std::pair<CacheKey, size_t> > Entries;
+
+        struct Position {
+            inline Position(Queue queue, Entries::iterator it): queue(queue), it(it) {}
+
+            Queue queue;
+            Entries::iterator it;
+        };
+
+        size_t _capacity, windowCapacity, mainCapacity, protectedCapacity;
+        CountMinSketch _sketch;
+        Entries queues[3];      /* Most recently used first */
+        size_t sizes[3];
+        std::unordered_map<CacheKey, Position> index;
+
+        void move(Position& position, Queue to);
+        void use(Position& position);
+        void evict(Queue queue, std::vector<CacheKey>* evicted);
+        void demoteProtected();
+        void evictWindow(std::vector<CacheKey>* evicted);
+        void evictMain(std::vector<CacheKey>* evicted);
+};
+
+}}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include "UrlTemplate.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace Kompas { namespace Core {
+
+UrlTemplate::UrlTemplate(const string& pattern, const vector<string>& subdomains, const vector<unsigned int>& weights): _pattern(pattern), _subdomains(subdomains), _weights(weights), maxSubdomainSize(0), valid(true) {
+    for(size_t i = 0; i != Quadkey+1; ++i) counts[i] = 0;
+    for(vector<string>::const_iterator it = subdomains.begin(); it != subdomains.end(); ++it)
+        maxSubdomainSize = max(maxSubdomainSize, it->size());
+
+    /* Equal weights by default */
+    if(_weights.empty()) _weights.assign(subdomains.size(), 1);
+    else if(_weights.size() != subdomains.size()) valid = false;
+
+    unsigned int total = 0;
+    for(vector<unsigned int>::const_iterator it = _weights.begin(); it != _weights.end(); ++it)
+        limits.push_back(total += *it);
+    if(!subdomains.empty() && !total) valid = false;
+
+    size_t position = 0;
+    while(valid && position != pattern.size()) {
+        size_t begin = pattern.find('{', position);
+
+        /* Literal until next placeholder */
+        if(begin != position) {
+            if(begin == string::npos) begin = pattern.size();
+            tokens.push_back(Token(Literal, position, begin-position));
+            counts[Literal] += begin-position;
+            position = begin;
+            continue;
+        }
+
+        size_t end = pattern.find('}', begin);
+        if(end == string::npos) {
+            valid = false;
+            break;
+        }
+
+        const string name = pattern.substr(begin+1, end-begin-1);
+        Type type;
+        if(name == "s") type = Subdomain;
+        else if(name == "z") type = ZoomLevel;
+        else if(name == "x") type = X;
+        else if(name == "y") type = Y;
+        else if(name == "quadkey") type = Quadkey;
+        else {
+            valid = false;
+            break;
+        }
+
+        tokens.push_back(Token(type));
+        ++counts[type];
+        position = end+1;
+    }
+
+    if(counts[Subdomain] && subdomains.empty()) valid = false;
+    if(!valid) tokens.clear();
+}
+
+size_t UrlTemplate::maxSize(Zoom z) const {
+    if(!valid) return 0;
+
+    /* Numbers have at most 10 digits */
+    return counts[Literal] + counts[Subdomain]*maxSubdomainSize + (counts[ZoomLevel] + counts[X] + counts[Y])*10 + counts[Quadkey]*z;
+}
+
+size_t UrlTemplate::format(Zoom z, const TileCoords& coords, char* buffer, size_t size) const {
+    if(!valid) return 0;
+
+    char zoom[10], x[10], y[10];
+    const size_t zoomSize = number(z, zoom);
+    const size_t xSize = number(coords.x, x);
+    const size_t ySize = number(coords.y, y);
+    return write(z, coords, zoom, zoomSize, x, xSize, y, ySize, buffer, size);
+}
+
+string UrlTemplate::format(Zoom z, const TileCoords& coords) const {
+    string url(maxSize(z), '\0');
+    url.resize(format(z, coords, &url[0], url.size()));
+    return url;
+}
+
+size_t UrlTemplate::format(Zoom z, const TileArea& area, char* buffer, size_t size, size_t* offsets) const {
+    size_t position = 0;
+    offsets[0] = 0;
+    if(!valid) {
+        for(size_t i = 0; i != area.w*area.h; ++i) offsets[i+1] = 0;
+        return 0;
+    }
+
+    /* Zoom is the same for all tiles, Y for whole row */
+    char zoom[10], x[10], y[10];
+    const size_t zoomSize = number(z, zoom);
+    for(unsigned int row = area.y; row != area.y+area.h; ++row) {
+        const size_t ySize = number(row, y);
+        for(unsigned int column = area.x; column != area.x+area.w; ++column) {
+            const size_t xSize = number(column, x);
+
+            /* If the URL doesn't fit, nothing is written, but the position
+               is moved anyway, so no other URL is written after it */
+            position += write(z, TileCoords(column, row), zoom, zoomSize, x, xSize, y, ySize, buffer+min(position, size), position < size ? size-position : 0);
+            *++offsets = position;
+        }
+    }
+
+    return position;
+}
+
+size_t UrlTemplate::subdomain(Zoom z, const TileCoords& coords) const {
+    if(limits.empty() || !limits.back()) return 0;
+
+    /* Subdomains with zero weight have the same limit as previous one, so
+       they are never chosen */
+    const unsigned int position = hash(z, coords) % limits.back();
+    return upper_bound(limits.begin(), limits.end(), position) - limits.begin();
+}
+
+size_t UrlTemplate::write(Zoom z, const TileCoords& coords, const char* zoom, size_t zoomSize, const char* x, size_t xSize, const char* y, size_t ySize, char* buffer, size_t size) const {
+    const string* subdomain = counts[Subdomain] ? &_subdomains[this->subdomain(z, coords)] : 0;
+    const size_t length = counts[Literal] + counts[ZoomLevel]*zoomSize + counts[X]*xSize + counts[Y]*ySize + counts[Quadkey]*z + (subdomain ? counts[Subdomain]*subdomain->size() : 0);
+    if(length > size) return length;
+
+    for(vector<Token>::const_iterator it = tokens.begin(); it != tokens.end(); ++it) switch(it->type) {
+        case Literal:
+            memcpy(buffer, _pattern.data()+it->offset, it->size);
+            buffer += it->size;
+            break;
+        case Subdomain:
+            memcpy(buffer, subdomain->data(), subdomain->size());
+            buffer += subdomain->size();
+            break;
+        case ZoomLevel:
+            memcpy(buffer, zoom, zoomSize);
+            buffer += zoomSize;
+            break;
+        case X:
+            memcpy(buffer, x, xSize);
+            buffer += xSize;
+            break;
+        case Y:
+            memcpy(buffer, y, ySize);
+            buffer += ySize;
+            break;
+
+        /* One digit for each zoom level, from the highest bit */
+        case Quadkey:
+            for(Zoom i = z; i != 0; --i) {
+                const unsigned int mask = i <= 32 ? 1u << (i-1) : 0;
+                *buffer++ = '0' + ((coords.x & mask) ? 1 : 0) + ((coords.y & mask) ? 2 : 0);
+            }
+            break;
+    }
+
+    return length;
+}
+
+uint64_t UrlTemplate::hash(Zoom z, const TileCoords& coords) {
+    /* Finalizer of MurmurHash3, coordinates have at most 32 bits */
+    uint64_t h = (uint64_t(coords.x) << 32 | coords.y) ^ (uint64_t(z) * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+size_t UrlTemplate::number(unsigned int value, char* buffer) {
+    char digits[10];
+    size_t size = 0;
+    do {
+        digits[size++] = '0' + value%10;
+        value /= 10;
+    } while(value);
+
+    for(size_t i = 0; i != size; ++i)
+        buffer[i] = digits[size-i-1];
+    return size;
+}
+
+}}
@@ -0,0 +1,174 @@
+#ifndef Kompas_Core_UrlTemplate_h
+#define Kompas_Core_UrlTemplate_h
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+/** @file
+ * @brief Class Kompas::Core::UrlTemplate
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AbstractRasterModel.h"
+
+namespace Kompas { namespace Core {
+
+/**
+@brief Precompiled tile URL template
+
+Tile URL pattern with placeholders, e.g.
+<tt>http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png</tt>. Supported
+placeholders are:
+
+- @c {z} -- zoom level
+- @c {x}, @c {y} -- tile coordinates
+- @c {s} -- subdomain, one of subdomains passed in constructor, see
+  subdomain()
+- @c {quadkey} -- tile coordinates and zoom encoded in one string of base-4
+  digits, as used by Bing maps
+
+The pattern is parsed only once in constructor. Formatting into
+caller-provided buffer doesn't allocate any memory, so it can be used for
+generating many URLs at once, e.g. with the bulk variant for whole tile area.
+@code
+UrlTemplate t("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png", subdomains);
+char url[256];
+size_t size = t.format(12, TileCoords(2216, 1387), url, sizeof(url));
+@endcode
+*/
+class CORE_EXPORT UrlTemplate {
+    public:
+        /**
+         * @brief Constructor
+         * @param pattern       URL pattern
+         * @param subdomains    Subdomains for @c {s} placeholder
+         * @param weights       Relative weights of the subdomains. If empty,
+         *      all subdomains have the same weight.
+         *
+         * If the pattern contains unknown placeholder, unterminated
+         * placeholder or @c {s} without any subdomains, the template is
+         * invalid. It is invalid also if count of weights doesn't match
+         * count of subdomains or if all weights are zero.
+         */
+        UrlTemplate(const std::string& pattern = "", const std::vector<std::string>& subdomains = std::vector<std::string>(), const std::vector<unsigned int>& weights = std::vector<unsigned int>());
+
+        /** @brief Whether the template is valid */
+        inline bool isValid() const { return valid; }
+
+        /** @brief URL pattern */
+        inline const std::string& pattern() const { return _pattern; }
+
+        /** @brief Subdomains */
+        inline const std::vector<std::string>& subdomains() const { return _subdomains; }
+
+        /** @brief Subdomain weights */
+        inline const std::vector<unsigned int>& weights() const { return _weights; }
+
+        /**
+         * @brief Max size of URL for given zoom
+         *
+         * Buffer of this size is large enough for any tile of given zoom
+         * level.
+         */
+        size_t maxSize(Zoom z) const;
+
+        /**
+         * @brief Format URL into buffer
+         * @param z         Zoom level
+         * @param coords    Tile coordinates
+         * @param buffer    Output buffer
+         * @param size      Buffer size
+         * @return Size of the URL. If larger than @p size, nothing is
+         *      written. Invalid template produces empty URL.
+         *
+         * The URL is not terminated with zero.
+         */
+        size_t format(Zoom z, const TileCoords& coords, char* buffer, size_t size) const;
+
+        /**
+         * @brief Format URL
+         *
+         * Convenience variant of format(Zoom, const TileCoords&, char*, size_t) const.
+         */
+        std::string format(Zoom z, const TileCoords& coords) const;
+
+        /**
+         * @brief Format URLs of all tiles in area into buffer
+         * @param z         Zoom level
+         * @param area      Tile area
+         * @param buffer    Output buffer
+         * @param size      Buffer size
+         * @param offsets   Where to save offsets of the URLs in the buffer.
+         *      Must have place for <tt>area.w*area.h + 1</tt> items, the
+         *      last item is the offset after the last URL.
+         * @return Size of all URLs. If larger than @p size, only URLs which
+         *      fit whole are written, but the offsets are filled for all
+         *      URLs.
+         *
+         * The URLs are saved one after another in row-major order without
+         * any separator. Parts of the URL which are the same for the whole
+         * row are formatted only once.
+         */
+        size_t format(Zoom z, const TileArea& area, char* buffer, size_t size, size_t* offsets) const;
+
+        /**
+         * @brief Index of subdomain for given tile
+         *
+         * The subdomain is chosen by hash of zoom and coordinates, so the
+         * same tile has always the same URL and can be cached by browsers
+         * and proxies, and downloader can reuse connections to the same
+         * host. Neighbouring tiles are spread over the subdomains in ratio
+         * of their weights. The hash doesn't depend on platform, so the URLs
+         * are the same on all clients. Returns 0 if there are no subdomains.
+         */
+        size_t subdomain(Zoom z, const TileCoords& coords) const;
+
+    private:
+        enum Type {
+            Literal, Subdomain, ZoomLevel, X, Y, Quadkey
+        };
+
+        /* Literals are stored as offset and size in the pattern */
+        struct Token {
+            inline Token(Type type, size_t offset = 0, size_t size = 0): type(type), offset(offset), size(size) {}
+
+            Type type;
+            size_t offset, size;
+        };
+
+        std::string _pattern;
+        std::vector<std::string> _subdomains;
+        std::vector<unsigned int> _weights,
+            limits;                 /* Cumulative weights */
+        std::vector<Token> tokens;
+        size_t counts[Quadkey+1];   /* Literal count is total literal size */
+        size_t maxSubdomainSize;
+        bool valid;
+
+        /* Formats the URL with already formatted numbers, if it fits */
+        size_t write(Zoom z, const TileCoords& coords, const char* zoom, size_t zoomSize, const char* x, size_t xSize, const char* y, size_t ySize, char* buffer, size_t size) const;
+
+        /* Hash of tile position */
+        static std::uint64_t hash(Zoom z, const TileCoords& coords);
+
+        /* Formats the number and returns its length */
+        static size_t number(unsigned int value, char* buffer);
+};
+
+}}
+
+#endif
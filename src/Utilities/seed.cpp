@@ -0,0 +1,171 @@
+/*
+    Copyright © 2007, 2008, 2009, 2010, 2011 Vladimír Vondruš <mosra@centrum.cz>
+
+    This file is part of Kompas.
+
+    Kompas is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License version 3
+    only, as published by the Free Software Foundation.
+
+    Kompas is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License version 3 for more details.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <memory>
+
+#include "CacheSeeder.h"
+#include "HttpDownloader.h"
+#include "UrlTemplate.h"
+#include "OpenStreetMapRasterModel/OpenStreetMapRasterModel.h"
+#include "DiskCache/DiskCache.h"
+#include "SharedCache/SharedCache.h"
+#include "MemcachedCache/MemcachedCache.h"
+
+using namespace std;
+using namespace Kompas::Core;
+using namespace Kompas::Plugins;
+
+namespace {
+
+/* Public tile servers don't allow more parallel downloads, e.g.
+   http://wiki.openstreetmap.org/wiki/Tile_usage_policy */
+const unsigned int MaxDownloadThreads = 2;
+
+void usage() {
+    cerr << "Usage: kompas-seed [options] CACHE LAT1 LON1 LAT2 LON2 MINZOOM MAXZOOM\n\n"
+            "Fills cache with all tiles of OpenStreetMap model in region given by two\n"
+            "opposite corners and in given zoom range. CACHE is cache directory or\n"
+            "server address. Tiles are taken only from packages, unless tile server\n"
+            "is given with --url. Bulk downloading from public tile servers is usually\n"
+            "forbidden by their usage policy, use only servers which allow it.\n\n"
+            "Options:\n"
+            "  --cache=TYPE       Cache type: disk (default), shared or memcached\n"
+            "  --cache-size=MB    Cache size in megabytes\n"
+            "  --layer=NAME       Layer (default is first layer of the model)\n"
+            "  --package=FILE     Take tiles from given package, can be repeated\n"
+            "  --url=TEMPLATE     Download tiles missing in packages from given server,\n"
+            "                     e.g. http://localhost/tiles/{z}/{x}/{y}.png\n"
+            "  --threads=N        Count of worker threads (default 4, at most 2 when\n"
+            "                     downloading)\n"
+            "  --batch=N          Count of tiles checked in cache at once (default 64)\n";
+}
+
+/* OpenStreetMap model downloading from server given on command line */
+class DownloadRasterModel: public OpenStreetMapRasterModel {
+    public:
+        /* The same name as when loaded through plugin manager, so the tiles
+           are found by other applications */
+        inline DownloadRasterModel(const UrlTemplate& url): OpenStreetMapRasterModel(0, "OpenStreetMapRasterModel"), url(url) {}
+
+        inline string tileUrl(const string& layer, Zoom z, const TileCoords& coords) const {
+            return url.format(z, coords);
+        }
+
+    private:
+        UrlTemplate url;
+};
+
+/* Value of --name=value option, or null if the argument is another option */
+const char* option(const char* argument, const char* name) {
+    const size_t length = strlen(name);
+    if(strncmp(argument, name, length) != 0 || argument[length] != '=') return 0;
+    return argument+length+1;
+}
+
+}
+
+int main(int argc, char** argv) {
+    string cacheType("disk"), layer, url;
+    size_t cacheSize = 0;
+    vector<string> packages;
+    vector<const char*> arguments;
+    unsigned int threads = 4, batch = 64;
+
+    for(int i = 1; i != argc; ++i) {
+        const char* value;
+        if((value = option(argv[i], "--cache"))) cacheType = value;
+        else if((value = option(argv[i], "--cache-size"))) cacheSize = size_t(atoi(value))*1024*1024;
+        else if((value = option(argv[i], "--layer"))) layer = value;
+        else if((value = option(argv[i], "--package"))) packages.push_back(value);
+        else if((value = option(argv[i], "--url"))) url = value;
+        else if((value = option(argv[i], "--threads"))) threads = atoi(value);
+        else if((value = option(argv[i], "--batch"))) batch = atoi(value);
+        else if(argv[i][0] == '-' && argv[i][1] == '-') {
+            usage();
+            return 1;
+        } else arguments.push_back(argv[i]);
+    }
+
+    if(arguments.size() != 7) {
+        usage();
+        return 1;
+    }
+
+    const LatLonCoords a(atof(arguments[1]), atof(arguments[2])),
+        b(atof(arguments[3]), atof(arguments[4]));
+    const Zoom minZoom = atoi(arguments[5]), maxZoom = atoi(arguments[6]);
+    if(!a.isValid() || !b.isValid() || minZoom > maxZoom) {
+        cerr << "Invalid region or zoom range" << endl;
+        return 1;
+    }
+
+    const UrlTemplate urlTemplate(url);
+    if(!urlTemplate.isValid()) {
+        cerr << "Invalid URL template " << url << endl;
+        return 1;
+    }
+
+    /* Don't overload the tile server */
+    const bool download = !url.empty();
+    if(download && threads > MaxDownloadThreads) {
+        cerr << "Using " << MaxDownloadThreads << " threads for downloading" << endl;
+        threads = MaxDownloadThreads;
+    }
+
+    DownloadRasterModel model(urlTemplate);
+    for(vector<string>::const_iterator it = packages.begin(); it != packages.end(); ++it) {
+        if(model.addPackage(*it) == -1) {
+            cerr << "Cannot load package " << *it << endl;
+            return 2;
+        }
+    }
+    model.setOnline(download);
+    if(layer.empty() && !model.layers().empty()) layer = model.layers()[0];
+
+    unique_ptr<AbstractCache> cache;
+    if(cacheType == "disk") cache.reset(new DiskCache);
+    else if(cacheType == "shared") cache.reset(new SharedCache);
+    else if(cacheType == "memcached") cache.reset(new MemcachedCache);
+    else {
+        usage();
+        return 1;
+    }
+
+    if(cacheSize) cache->setCacheSize(cacheSize);
+    if(!cache->initializeCache(arguments[0])) {
+        cerr << "Cannot initialize cache " << arguments[0] << endl;
+        return 2;
+    }
+
+    HttpDownloader downloader;
+    CacheSeeder seeder(&model, cache.get(), download ? &downloader : 0, threads);
+    seeder.setBatchSize(batch);
+    seeder.setProgressCallback([](const CacheSeeder::Progress& p) {
+        cerr << '\r' << p.done << '/' << p.total << " tiles, " << p.seeded << " seeded, "
+             << p.present << " present, " << p.missing << " missing, " << p.failed << " failed" << flush;
+    });
+
+    CacheSeeder::Progress p = seeder.seed(layer, a, b, minZoom, maxZoom);
+    cerr << '\r' << p.done << '/' << p.total << " tiles, " << p.seeded << " seeded, "
+         << p.present << " present, " << p.missing << " missing, " << p.failed << " failed" << endl;
+
+    cache->finalizeCache();
+    return p.failed ? 3 : 0;
+}